@@ -4,14 +4,48 @@
 
 #include <math.h>
 
+#include "sweep.h"
+
 static void init_arguments(struct getplmux_arguments *args) {
   args->dvbsrc_extra_props = NULL;
+  args->cache_file = NULL;
+  args->batch_file = NULL;
+  args->job_file = NULL;
+  args->plan_out = NULL;
+  args->channels_out = NULL;
+  args->plan_file = NULL;
+  args->shm_socket = NULL;
+  args->segment_command = NULL;
+  args->dvb_root = NULL;
+  args->dvbsrc_params = NULL;
+  args->split_services_list = NULL;
   args->capture_duration_seconds = 30;
+  args->sweep_lock_timeout_ms = SWEEP_LOCK_TIMEOUT_MS;
+  args->quality_gate_seconds = 0;
+  args->segment_seconds = 0;
+  args->segment_size_mb = 0;
+  args->flow_stats_seconds = 0;
+  args->profile_tuning_rounds = 0;
   args->force_refresh = FALSE;
+  args->offline = FALSE;
+  args->harvest = FALSE;
+  args->list_frontends = FALSE;
+  args->sweep = FALSE;
+  args->ignore_nit = FALSE;
+  args->si_only = FALSE;
+  args->split_services = FALSE;
+  args->dedup = FALSE;
+  args->profile_startup = FALSE;
+  mux_filter_init(&args->filter);
+  watchdog_limits_init(&args->watchdog);
   args->latitude = args->longitude = NAN;
 }
 
-static GstStructure *parse_as_gst_struct(const gchar *value, GError **error) {
+gboolean uses_segments(const struct getplmux_arguments *args) {
+  return args->segment_seconds > 0 || args->segment_size_mb > 0;
+}
+
+GstStructure *parse_as_gst_struct(const gchar *value, GError **error) {
   /* the serialized representation always starts with the struct name which we
    * must add manually here. */
   gchar *const serialized = g_strdup_printf("dvbsrc_params, %s", value);
@@ -60,19 +94,18 @@ struct argparse_ctx {
   struct getplmux_arguments *const args;
 };
 
-#define latlon_parse_or_error(member, strval)                                  \
+#define latlon_parse_or_error(out, name, strval)                               \
   do {                                                                         \
-    if (!latlon_parse(&args->member, (strval))) {                              \
+    if (!latlon_parse((out), (strval))) {                                      \
       *error = g_error_new(G_OPTION_ERROR, G_OPTION_ERROR_FAILED,              \
-                           "Could not parse %s as " #member, (strval));        \
+                           "Could not parse %s as " name, (strval));           \
       goto beach;                                                              \
     }                                                                          \
   } while (0)
 
-static gboolean location_parse(const gchar *option_name, const gchar *value,
-                               gpointer data, GError **error) {
-  (void)option_name;
-  gchar **splitted = g_strsplit(value, ":", -1);
+gboolean location_from_string(const gchar *str, double *lat, double *lon,
+                              GError **error) {
+  gchar **splitted = g_strsplit(str, ":", -1);
   gboolean rv = FALSE;
   if (get_num_splitted_strs(splitted) != 2) {
     *error = g_error_new(G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
@@ -81,10 +114,104 @@ static gboolean location_parse(const gchar *option_name, const gchar *value,
     goto beach;
   }
 
+  latlon_parse_or_error(lat, "latitude", splitted[0]);
+  latlon_parse_or_error(lon, "longitude", splitted[1]);
+  rv = TRUE;
+
+beach:
+  g_strfreev(splitted);
+  return rv;
+}
+
+#undef latlon_parse_or_error
+
+static gboolean location_parse(const gchar *option_name, const gchar *value,
+                               gpointer data, GError **error) {
+  (void)option_name;
   struct argparse_ctx *const parse_ctx = data;
   struct getplmux_arguments *const args = parse_ctx->args;
-  latlon_parse_or_error(latitude, splitted[0]);
-  latlon_parse_or_error(longitude, splitted[1]);
+  return location_from_string(value, &args->latitude, &args->longitude, error);
+}
+
+static gboolean mux_parse(const gchar *option_name, const gchar *value,
+                          gpointer data, GError **error) {
+  (void)option_name;
+  (void)error;
+  struct argparse_ctx *const parse_ctx = data;
+  struct mux_filter *const filter = &parse_ctx->args->filter;
+  /* the option can be given several times, as well as with a comma-separated
+   * list, so the names are appended to what was given before. */
+  gchar **const splitted = g_strsplit(value, ",", -1);
+  GStrvBuilder *const builder = g_strv_builder_new();
+  if (filter->muxes) {
+    g_strv_builder_addv(builder, (const char **)filter->muxes);
+  }
+  for (gchar **it = splitted; *it; ++it) {
+    g_strstrip(*it);
+    if (**it) {
+      g_strv_builder_add(builder, *it);
+    }
+  }
+  g_strfreev(filter->muxes);
+  filter->muxes = g_strv_builder_end(builder);
+  g_strv_builder_unref(builder);
+  g_strfreev(splitted);
+  return TRUE;
+}
+
+static gboolean split_services_parse(const gchar *option_name,
+                                     const gchar *value, gpointer data,
+                                     GError **error) {
+  (void)option_name;
+  struct argparse_ctx *const parse_ctx = data;
+  struct getplmux_arguments *const args = parse_ctx->args;
+  args->split_services = TRUE;
+  if (!value) {
+    return TRUE;
+  }
+
+  if (!args->split_services_list) {
+    args->split_services_list = g_array_new(FALSE, FALSE, sizeof(guint16));
+  }
+  gchar **const splitted = g_strsplit(value, ",", -1);
+  gboolean rv = TRUE;
+  for (gchar **it = splitted; *it && rv; ++it) {
+    g_strstrip(*it);
+    guint64 program_number;
+    rv = g_ascii_string_to_unsigned(*it, 10, 1, G_MAXUINT16, &program_number,
+                                    error);
+    if (rv) {
+      const guint16 val = (guint16)program_number;
+      g_array_append_val(args->split_services_list, val);
+    }
+  }
+  g_strfreev(splitted);
+  return rv;
+}
+
+static gboolean read_fails_parse(const gchar *option_name, const gchar *value,
+                                 gpointer data, GError **error) {
+  struct argparse_ctx *const parse_ctx = data;
+  struct watchdog_limits *const limits = &parse_ctx->args->watchdog;
+  struct watchdog_window *const window =
+      g_str_equal(option_name, "--read-fails-pre-lock") ? &limits->pre_lock
+                                                         : &limits->locked;
+  gchar **const splitted = g_strsplit(value, ":", -1);
+  gboolean rv = FALSE;
+  guint64 max_fails, window_s;
+  if (get_num_splitted_strs(splitted) != 2 ||
+      !g_ascii_string_to_unsigned(splitted[0], 10, 1, G_MAXUINT, &max_fails,
+                                  NULL) ||
+      !g_ascii_string_to_unsigned(splitted[1], 10, 1, G_MAXINT, &window_s,
+                                  NULL)) {
+    *error = g_error_new(G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                         "Could not parse %s as a number of read failures and "
+                         "seconds, for example : 10:10",
+                         value);
+    goto beach;
+  }
+  window->max_fails = (guint)max_fails;
+  window->window_us = (gint64)window_s * G_USEC_PER_SEC;
   rv = TRUE;
 
 beach:
@@ -92,12 +219,30 @@ beach:
   return rv;
 }
 
-#undef latlon_parse_or_error
+static gboolean delsys_parse(const gchar *option_name, const gchar *value,
+                             gpointer data, GError **error) {
+  (void)option_name;
+  struct argparse_ctx *const parse_ctx = data;
+  struct mux_filter *const filter = &parse_ctx->args->filter;
+  if (g_ascii_strcasecmp(value, "dvb-t") == 0 ||
+      g_ascii_strcasecmp(value, "t") == 0) {
+    filter->delsys = SYS_DVBT;
+  } else if (g_ascii_strcasecmp(value, "dvb-t2") == 0 ||
+             g_ascii_strcasecmp(value, "t2") == 0) {
+    filter->delsys = SYS_DVBT2;
+  } else {
+    *error = g_error_new(G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                         "Unknown delivery system %s, expected dvb-t or dvb-t2",
+                         value);
+    return FALSE;
+  }
+  return TRUE;
+}
 
-int parse_arguments(struct getplmux_arguments *args, int argc, char **argv) {
+int parse_arguments(struct getplmux_arguments *args, int *argc, char ***argv) {
   init_arguments(args);
 
-  gchar *dvbsrc_params = NULL;
+  gint stall_timeout_s = WATCHDOG_MAX_STALL_S;
   const GOptionEntry options[] = {
       {"duration", 'd', 0, G_OPTION_ARG_INT, &args->capture_duration_seconds,
        "Capture duration (in seconds)", NULL},
@@ -107,10 +252,128 @@ int parse_arguments(struct getplmux_arguments *args, int argc, char **argv) {
        NULL},
       {"refresh", 'r', 0, G_OPTION_ARG_NONE, &args->force_refresh,
        "Force refreshing cached transmitter data", NULL},
-      {"dvbsrc-extra-params", 0, 0, G_OPTION_ARG_STRING, &dvbsrc_params,
+      {"dvbsrc-extra-params", 0, 0, G_OPTION_ARG_STRING, &args->dvbsrc_params,
        "Additional properties to apply to the dvbsrc element as a serialized "
        "GstStructure, for example : adapter=5,frontend=2",
        NULL},
+      {"cache", 0, 0, G_OPTION_ARG_FILENAME, &args->cache_file,
+       "Use the given transmitter cache file instead of the default one",
+       NULL},
+      {"batch", 0, 0, G_OPTION_ARG_FILENAME, &args->batch_file,
+       "Fetch transmitters for every location listed in the given file, one "
+       "per line in the same format as --location, save each into its own "
+       "cache and quit",
+       NULL},
+      {"jobs", 0, 0, G_OPTION_ARG_FILENAME, &args->job_file,
+       "Run the captures listed in the given job file, using all the "
+       "frontends at the same time, instead of capturing every MUX once",
+       NULL},
+      {"compile-plan", 0, 0, G_OPTION_ARG_FILENAME, &args->plan_out,
+       "Save the transmitters which would be captured, in the order they "
+       "would be tried, into the given plan file and quit",
+       NULL},
+      {"export-channels", 0, 0, G_OPTION_ARG_FILENAME, &args->channels_out,
+       "Save the transmitters which would be captured into the given "
+       "channels.conf for the dvbv5 tools and quit",
+       NULL},
+      {"plan", 0, 0, G_OPTION_ARG_FILENAME, &args->plan_file,
+       "Capture the transmitters in the given plan file, in its order and "
+       "without reading the cache",
+       NULL},
+      {"offline", 0, 0, G_OPTION_ARG_NONE, &args->offline,
+       "Look up transmitters for the location in the local transmitter "
+       "database instead of fetching them",
+       NULL},
+      {"harvest", 0, 0, G_OPTION_ARG_NONE, &args->harvest,
+       "Add the transmitters for the location to the local transmitter "
+       "database and quit",
+       NULL},
+      {"mux", 0, 0, G_OPTION_ARG_CALLBACK, mux_parse,
+       "Only use transmitters of the given MUX, for example : MUX-1. Can be "
+       "given more than once or as a comma-separated list",
+       NULL},
+      {"max-distance", 0, 0, G_OPTION_ARG_DOUBLE, &args->filter.max_distance,
+       "Only use transmitters at most this many kilometres away", NULL},
+      {"delsys", 0, 0, G_OPTION_ARG_CALLBACK, delsys_parse,
+       "Only use transmitters using the given delivery system, either dvb-t "
+       "or dvb-t2",
+       NULL},
+      {"list-frontends", 0, 0, G_OPTION_ARG_NONE, &args->list_frontends,
+       "List the DVB frontends along with the delivery systems they support "
+       "and quit",
+       NULL},
+      {"sweep", 0, 0, G_OPTION_ARG_NONE, &args->sweep,
+       "Find transmissions by trying every UHF channel on all frontends "
+       "instead of fetching the transmitters",
+       NULL},
+      {"sweep-timeout", 0, 0, G_OPTION_ARG_INT, &args->sweep_lock_timeout_ms,
+       "How long to wait for a lock on each channel when sweeping (in "
+       "milliseconds)",
+       NULL},
+      {"ignore-nit", 0, 0, G_OPTION_ARG_NONE, &args->ignore_nit,
+       "Don't update the cached transmitters with the tuning parameters "
+       "broadcast in the NIT",
+       NULL},
+      {"si-only", 0, 0, G_OPTION_ARG_NONE, &args->si_only,
+       "Only keep the service information tables, such as the EPG, writing "
+       "every new section once into a .si log instead of the whole stream",
+       NULL},
+      {"split-services", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK,
+       split_services_parse,
+       "Also write every service, or only the ones with the given "
+       "comma-separated program numbers, into its own file while capturing",
+       NULL},
+      {"quality-gate", 0, 0, G_OPTION_ARG_INT, &args->quality_gate_seconds,
+       "Hold the given number of seconds at the start of every capture in "
+       "memory and only write the capture once the stream turns out to be "
+       "free of errors, trying the next transmitter otherwise",
+       NULL},
+      {"dedup", 0, 0, G_OPTION_ARG_NONE, &args->dedup,
+       "Replace the incomplete captures of a MUX which carry the same "
+       "transport stream as its complete capture with hard links to it",
+       NULL},
+      {"read-fails", 0, 0, G_OPTION_ARG_CALLBACK, read_fails_parse,
+       "Give up on a transmitter after this many read failures within this "
+       "many seconds once data is coming in, as colon-separated numbers, for "
+       "example : 5:10",
+       NULL},
+      {"read-fails-pre-lock", 0, 0, G_OPTION_ARG_CALLBACK, read_fails_parse,
+       "The same as --read-fails, but before any data has come in, for "
+       "example : 2:3",
+       NULL},
+      {"stall-timeout", 0, 0, G_OPTION_ARG_INT, &stall_timeout_s,
+       "Give up on a transmitter when no data has come in for this many "
+       "seconds, 0 to never do that",
+       NULL},
+      {"shm-socket", 0, 0, G_OPTION_ARG_FILENAME, &args->shm_socket,
+       "Also publish the capture over shared memory to local readers, "
+       "which connect to the given socket with shmsrc",
+       NULL},
+      {"segment-seconds", 0, 0, G_OPTION_ARG_INT, &args->segment_seconds,
+       "Write every capture as segments of the given number of seconds, "
+       "listed in an index along with their offsets, PCRs and start times",
+       NULL},
+      {"segment-size", 0, 0, G_OPTION_ARG_INT, &args->segment_size_mb,
+       "Write every capture as segments of at most the given number of "
+       "megabytes, listed in an index like with --segment-seconds",
+       NULL},
+      {"segment-command", 0, 0, G_OPTION_ARG_STRING, &args->segment_command,
+       "Run the given command with the path of every segment appended as "
+       "soon as the segment is done",
+       NULL},
+      {"profile-startup", 0, 0, G_OPTION_ARG_NONE, &args->profile_startup,
+       "Print how long every step before the first tune took", NULL},
+      {"flow-stats", 0, 0, G_OPTION_ARG_INT, &args->flow_stats_seconds,
+       "Every given number of seconds, print the latency, sizes, jitter and "
+       "write durations of the buffers going from dvbsrc to the sink",
+       NULL},
+      {"profile-tuning", 0, 0, G_OPTION_ARG_INT, &args->profile_tuning_rounds,
+       "Instead of capturing, tune to every transmitter the given number of "
+       "times and print how long it took to lock and to get the first data",
+       NULL},
+      /* only useful for testing without real hardware. */
+      {"dvb-root", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME,
+       &args->dvb_root, "Look for DVB devices in the given directory", NULL},
       G_OPTION_ENTRY_NULL};
 
   struct argparse_ctx parse_ctx = {.args = args};
@@ -121,9 +384,145 @@ int parse_arguments(struct getplmux_arguments *args, int argc, char **argv) {
       g_option_group_new(NULL, NULL, NULL, &parse_ctx, NULL);
   g_option_group_add_entries(main_group, options);
   g_option_context_set_main_group(option_ctx, main_group);
+  g_option_context_set_ignore_unknown_options(option_ctx, TRUE);
+  GError *err = NULL;
+  if (!g_option_context_parse(option_ctx, argc, argv, &err)) {
+    g_printerr("Error initializing: %s\n", GST_STR_NULL(err->message));
+    g_error_free(err);
+    goto beach;
+  }
+
+  if (args->si_only && args->split_services) {
+    g_printerr("--split-services can't be used along with --si-only\n");
+    goto beach;
+  }
+
+  if (stall_timeout_s < 0) {
+    g_printerr("The stall timeout can't be negative\n");
+    goto beach;
+  }
+  args->watchdog.max_stall_us = (gint64)stall_timeout_s * G_USEC_PER_SEC;
+
+  if (args->quality_gate_seconds < 0) {
+    g_printerr("The quality gate can't last a negative number of seconds\n");
+    goto beach;
+  }
+
+  if (args->si_only && args->quality_gate_seconds > 0) {
+    g_printerr("--quality-gate can't be used along with --si-only\n");
+    goto beach;
+  }
+
+  if (args->job_file &&
+      (args->si_only || args->split_services ||
+       args->quality_gate_seconds > 0 || args->profile_tuning_rounds > 0)) {
+    g_printerr("--jobs only captures whole streams, so it can't be used along "
+               "with --si-only, --split-services, --quality-gate or "
+               "--profile-tuning\n");
+    goto beach;
+  }
+
+  /* a plan is used without fetching or parsing anything. */
+  if (args->plan_file &&
+      (args->sweep || args->force_refresh || args->plan_out ||
+       args->channels_out || args->harvest || args->batch_file)) {
+    g_printerr("--plan can't be used along with --sweep, --refresh, "
+               "--compile-plan, --export-channels, --harvest or --batch\n");
+    goto beach;
+  }
+
+  if (args->dedup && (args->si_only || args->job_file ||
+                      args->profile_tuning_rounds > 0)) {
+    g_printerr("--dedup can't be used along with --si-only, --jobs or "
+               "--profile-tuning\n");
+    goto beach;
+  }
+
+  if (args->shm_socket &&
+      (args->job_file || args->profile_tuning_rounds > 0)) {
+    g_printerr("--shm-socket can't be used along with --jobs or "
+               "--profile-tuning\n");
+    goto beach;
+  }
+
+  if (args->segment_seconds < 0 || args->segment_size_mb < 0) {
+    g_printerr("Segments can't be a negative number of seconds or "
+               "megabytes\n");
+    goto beach;
+  }
+
+  if (uses_segments(args) &&
+      (args->si_only || args->quality_gate_seconds > 0 || args->dedup ||
+       args->job_file || args->profile_tuning_rounds > 0)) {
+    g_printerr("--segment-seconds and --segment-size can't be used along "
+               "with --si-only, --quality-gate, --dedup, --jobs or "
+               "--profile-tuning\n");
+    goto beach;
+  }
+
+  if (args->segment_command) {
+    gchar **argv_check = NULL;
+    if (!uses_segments(args)) {
+      g_printerr("--segment-command needs --segment-seconds or "
+                 "--segment-size\n");
+      goto beach;
+    }
+    if (!g_shell_parse_argv(args->segment_command, NULL, &argv_check,
+                            &err)) {
+      g_printerr("Could not parse the segment command : %s\n",
+                 err->message);
+      g_error_free(err);
+      goto beach;
+    }
+    g_strfreev(argv_check);
+  }
+
+  if (args->flow_stats_seconds < 0) {
+    g_printerr("The flow of buffers can't be summed up every negative number "
+               "of seconds\n");
+    goto beach;
+  }
+
+  if (args->profile_tuning_rounds < 0) {
+    g_printerr("The tuning can't be profiled a negative number of times\n");
+    goto beach;
+  }
+
+  if (args->profile_tuning_rounds > 0 &&
+      (args->si_only || args->split_services ||
+       args->quality_gate_seconds > 0)) {
+    g_printerr("--profile-tuning doesn't capture anything, so it can't be used "
+               "along with --si-only, --split-services or --quality-gate\n");
+    goto beach;
+  }
+
+  rv = 0;
+
+beach:
+  g_option_context_free(option_ctx);
+  return rv;
+}
+
+int check_leftover_arguments(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (g_str_equal(argv[i], "--")) {
+      break;
+    }
+    if (argv[i][0] == '-' && argv[i][1] != '\0' &&
+        !g_str_has_prefix(argv[i], "--gst-")) {
+      g_printerr("Error initializing: Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int init_gstreamer(struct getplmux_arguments *args, int *argc, char ***argv) {
+  int rv = 1;
+  GOptionContext *const option_ctx = g_option_context_new(NULL);
   g_option_context_add_group(option_ctx, gst_init_get_option_group());
   GError *err = NULL;
-  if (!g_option_context_parse(option_ctx, &argc, &argv, &err)) {
+  if (!g_option_context_parse(option_ctx, argc, argv, &err)) {
     g_printerr("Error initializing: %s\n", GST_STR_NULL(err->message));
     g_error_free(err);
     goto beach;
@@ -132,9 +531,9 @@ int parse_arguments(struct getplmux_arguments *args, int argc, char **argv) {
   /* I tried integrating this as a G_OPTION_ARG_CALLBACK, but the gst_structure
    * functions segfaulted, which I presume is due to to gst_init() not being
    * called before the argument-parsing callback is. oh well. */
-  if (dvbsrc_params) {
-    GstStructure *const stru = parse_as_gst_struct(dvbsrc_params, &err);
-    g_free(dvbsrc_params);
+  if (args->dvbsrc_params) {
+    GstStructure *const stru = parse_as_gst_struct(args->dvbsrc_params, &err);
+    g_clear_pointer(&args->dvbsrc_params, g_free);
     if (!stru) {
       g_printerr("Error initializing: %s\n", GST_STR_NULL(err->message));
       g_error_free(err);
@@ -152,4 +551,16 @@ beach:
 
 void free_arguments(struct getplmux_arguments *args) {
   gst_clear_structure(&args->dvbsrc_extra_props);
+  g_clear_pointer(&args->cache_file, g_free);
+  g_clear_pointer(&args->batch_file, g_free);
+  g_clear_pointer(&args->job_file, g_free);
+  g_clear_pointer(&args->plan_out, g_free);
+  g_clear_pointer(&args->channels_out, g_free);
+  g_clear_pointer(&args->plan_file, g_free);
+  g_clear_pointer(&args->shm_socket, g_free);
+  g_clear_pointer(&args->segment_command, g_free);
+  g_clear_pointer(&args->dvb_root, g_free);
+  g_clear_pointer(&args->dvbsrc_params, g_free);
+  g_clear_pointer(&args->split_services_list, g_array_unref);
+  mux_filter_clear(&args->filter);
 }
@@ -3,18 +3,79 @@
 
 #include <glib.h>
 
+#include "mux_filter.h"
+#include "watchdog.h"
+
 typedef struct _GstStructure GstStructure;
 
 struct getplmux_arguments {
   GstStructure *dvbsrc_extra_props;
+  gchar *cache_file;
+  gchar *batch_file;
+  gchar *job_file;
+  /* where to save the plan and the dvbv5 channels instead of capturing */
+  gchar *plan_out;
+  gchar *channels_out;
+  /* NULL unless tuning straight from a plan */
+  gchar *plan_file;
+  /* NULL unless the capture is published to local readers */
+  gchar *shm_socket;
+  /* run on every segment once it's done, NULL if nothing is */
+  gchar *segment_command;
+  gchar *dvb_root;
+  /* only set until init_gstreamer() turns it into dvbsrc_extra_props */
+  gchar *dvbsrc_params;
+  /* guint16 program numbers to split, NULL for all of them */
+  GArray *split_services_list;
+  struct mux_filter filter;
+  struct watchdog_limits watchdog;
   double latitude;
   double longitude;
   gint capture_duration_seconds;
+  gint sweep_lock_timeout_ms;
+  /* 0 if the quality gate isn't used */
+  gint quality_gate_seconds;
+  /* both 0 unless the captures are cut into segments */
+  gint segment_seconds;
+  gint segment_size_mb;
+  /* 0 if the flow of buffers isn't summed up */
+  gint flow_stats_seconds;
+  /* 0 unless profiling the tuning instead of capturing */
+  gint profile_tuning_rounds;
   gboolean force_refresh;
+  gboolean offline;
+  gboolean harvest;
+  gboolean list_frontends;
+  gboolean sweep;
+  gboolean ignore_nit;
+  gboolean si_only;
+  gboolean split_services;
+  gboolean dedup;
+  gboolean profile_startup;
 };
 
-int parse_arguments(struct getplmux_arguments *args, int argc, char **argv);
+/* whether the captures are written as segments instead of a single file. */
+gboolean uses_segments(const struct getplmux_arguments *args);
+
+/* GStreamer's own options are left in argv for init_gstreamer(), as
+ * initialising it can take a while and isn't needed for everything. */
+int parse_arguments(struct getplmux_arguments *args, int *argc, char ***argv);
+
+/* for the modes which don't initialise GStreamer, complains about whatever
+ * option parse_arguments() left in argv that isn't one of GStreamer's. */
+int check_leftover_arguments(int argc, char **argv);
+
+/* also parses the arguments which need GStreamer to be initialised. */
+int init_gstreamer(struct getplmux_arguments *args, int *argc, char ***argv);
 
 void free_arguments(struct getplmux_arguments *args);
 
+/* parses the value of --dvbsrc-extra-params, which can only be done once
+ * GStreamer is initialised. */
+GstStructure *parse_as_gst_struct(const gchar *value, GError **error);
+
+/* parses a colon-separated latitude and longitude, as given to --location. */
+gboolean location_from_string(const gchar *str, double *lat, double *lon,
+                              GError **error);
+
 #endif
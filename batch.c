@@ -0,0 +1,167 @@
+#include "batch.h"
+
+#include <gio/gio.h>
+
+#include "cache.h"
+#include "fetch.h"
+#include "parser.h"
+
+/* how many locations are fetched at the same time, and the minimum time that
+ * has to pass between starting two requests, so as not to hammer the site. */
+#define BATCH_MAX_PARALLEL_FETCHES 4
+#define BATCH_REQUEST_INTERVAL_MS 1000
+
+struct batch_location {
+  gdouble latitude;
+  gdouble longitude;
+  gchar latlon_str[2 * G_ASCII_DTOSTR_BUF_SIZE];
+};
+
+struct batch_ctx {
+  const TuneParamsIndex *index;
+
+  GMutex lock;
+  gint64 next_request_time;
+  guint num_failed;
+};
+
+static GArray *read_locations(const gchar *path) {
+  gchar *contents;
+  GError *err = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, &err)) {
+    g_printerr("Could not read %s : %s\n", path, err->message);
+    g_error_free(err);
+    return NULL;
+  }
+
+  GArray *locations = g_array_new(FALSE, FALSE, sizeof(struct batch_location));
+  gchar **const lines = g_strsplit(contents, "\n", -1);
+  for (guint i = 0; lines[i]; ++i) {
+    gchar *const line = g_strstrip(lines[i]);
+    if (*line == 0 || *line == '#') {
+      continue;
+    }
+
+    struct batch_location loc;
+    if (!location_from_string(line, &loc.latitude, &loc.longitude, &err)) {
+      g_printerr("%s:%u : %s\n", path, i + 1, err->message);
+      g_error_free(err);
+      g_array_free(locations, TRUE);
+      locations = NULL;
+      break;
+    }
+    g_strlcpy(loc.latlon_str, line, sizeof(loc.latlon_str));
+    g_array_append_val(locations, loc);
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+  return locations;
+}
+
+static void wait_for_request_slot(struct batch_ctx *ctx) {
+  g_mutex_lock(&ctx->lock);
+  const gint64 now = g_get_monotonic_time();
+  const gint64 slot = MAX(now, ctx->next_request_time);
+  ctx->next_request_time = slot + BATCH_REQUEST_INTERVAL_MS * 1000;
+  g_mutex_unlock(&ctx->lock);
+
+  if (slot > now) {
+    g_usleep(slot - now);
+  }
+}
+
+static void batch_location_failed(struct batch_ctx *ctx) {
+  g_mutex_lock(&ctx->lock);
+  ctx->num_failed++;
+  g_mutex_unlock(&ctx->lock);
+}
+
+static void process_location(gpointer data, gpointer user_data) {
+  const struct batch_location *const loc = data;
+  struct batch_ctx *const ctx = user_data;
+
+  wait_for_request_slot(ctx);
+
+  CURLcode err;
+  GString *const content =
+      fetch_mux_data_for_location(loc->latitude, loc->longitude, &err);
+  if (!content) {
+    g_printerr("%s : could not obtain location-based transmitter list : %s\n",
+               loc->latlon_str, curl_easy_strerror(err));
+    batch_location_failed(ctx);
+    return;
+  }
+
+  MuxData *const md =
+      parse_mux_params_from_html(content->str, (int)content->len, NULL);
+  g_string_free(content, TRUE);
+  tune_params_index_apply(ctx->index, md);
+
+  GFile *const f = cache_get_location_file(loc->latitude, loc->longitude);
+  gchar *const path = g_file_get_path(f);
+  if (mux_data_save_to_file(md, f)) {
+    g_print("%s : saved to %s\n", loc->latlon_str, path);
+  } else {
+    g_printerr("%s : could not save to %s\n", loc->latlon_str, path);
+    batch_location_failed(ctx);
+  }
+  g_free(path);
+  g_object_unref(f);
+  mux_data_destroy(md);
+}
+
+static TuneParamsIndex *fetch_tune_params_index(void) {
+  CURLcode err;
+  GString *const content = fetch_tune_params_html(&err);
+  if (!content) {
+    g_printerr("Could not obtain complete transmitter list : %s\n",
+               curl_easy_strerror(err));
+    return NULL;
+  }
+  TuneParamsIndex *const index =
+      parse_tune_params_index(content->str, (int)content->len, NULL);
+  g_string_free(content, TRUE);
+  return index;
+}
+
+int run_batch(const struct getplmux_arguments *args) {
+  GArray *const locations = read_locations(args->batch_file);
+  if (!locations) {
+    return 1;
+  }
+
+  int rv = 1;
+  struct batch_ctx ctx = {
+      .index = NULL, .next_request_time = 0, .num_failed = 0};
+  g_mutex_init(&ctx.lock);
+
+  /* the complete list is the same for every location, so it's fetched and
+   * parsed only once, and it also counts towards the rate limit. */
+  wait_for_request_slot(&ctx);
+  TuneParamsIndex *const index = fetch_tune_params_index();
+  if (!index) {
+    goto beach;
+  }
+  ctx.index = index;
+
+  GThreadPool *const pool = g_thread_pool_new(
+      process_location, &ctx,
+      parser_is_thread_safe() ? BATCH_MAX_PARALLEL_FETCHES : 1, TRUE, NULL);
+  for (guint i = 0; i < locations->len; ++i) {
+    g_thread_pool_push(
+        pool, &g_array_index(locations, struct batch_location, i), NULL);
+  }
+  /* waits for all the queued locations to be processed. */
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  g_print("%u of %u locations processed successfully\n",
+          locations->len - ctx.num_failed, locations->len);
+  rv = ctx.num_failed == 0 ? 0 : 1;
+  tune_params_index_destroy(index);
+
+beach:
+  g_mutex_clear(&ctx.lock);
+  g_array_free(locations, TRUE);
+  return rv;
+}
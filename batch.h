@@ -0,0 +1,10 @@
+#ifndef GETPLMUX_BATCH_H
+#define GETPLMUX_BATCH_H
+
+#include "arguments.h"
+
+/* fetches the transmitters for all the locations listed in args->batch_file
+ * and saves each into its own cache. returns the process exit code. */
+int run_batch(const struct getplmux_arguments *args);
+
+#endif
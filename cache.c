@@ -0,0 +1,150 @@
+#include "cache.h"
+
+#include <glib/gstdio.h>
+
+#include "cachelog.h"
+#include "deser.h"
+
+static GFile *cache_get_file(const gchar *basename) {
+  return g_file_new_build_filename(g_get_user_data_dir(), "getplmux", basename,
+                                   NULL);
+}
+
+GFile *cache_get_default_file(void) {
+  return cache_get_file("transmitters.xml");
+}
+
+GFile *cache_get_location_file(double lat, double lon) {
+  char latstr[G_ASCII_DTOSTR_BUF_SIZE];
+  g_ascii_dtostr(latstr, sizeof(latstr), lat);
+  char lonstr[G_ASCII_DTOSTR_BUF_SIZE];
+  g_ascii_dtostr(lonstr, sizeof(lonstr), lon);
+  gchar *const basename =
+      g_strdup_printf("transmitters-%s_%s.xml", latstr, lonstr);
+  GFile *const f = cache_get_file(basename);
+  g_free(basename);
+  return f;
+}
+
+GFile *cache_get_transmitter_db_file(void) {
+  return cache_get_file("transmitter-db.ini");
+}
+
+GFile *cache_get_stats_file(void) { return cache_get_file("stats.ini"); }
+
+GFile *cache_get_frontends_file(void) {
+  return cache_get_file("frontends.ini");
+}
+
+static gchar *cache_get_log_path(GFile *f) {
+  gchar *const path = g_file_get_path(f);
+  gchar *const log_path = g_strconcat(path, ".log", NULL);
+  g_free(path);
+  return log_path;
+}
+
+struct outstream_ctx {
+  GOutputStream *out;
+  gboolean failed;
+};
+
+static void write_to_outstream(const guint8 *buf, gssize bufsiz, void *ctx) {
+  struct outstream_ctx *const out_ctx = ctx;
+  if (!out_ctx->failed &&
+      !g_output_stream_write_all(
+          out_ctx->out, buf,
+          bufsiz < 0 ? strlen((const char *)buf) : (gsize)bufsiz, NULL, NULL,
+          NULL)) {
+    out_ctx->failed = TRUE;
+  }
+}
+
+gboolean mux_data_save_to_file(MuxData *md, GFile *f) {
+  {
+    GFile *const parent = g_file_get_parent(f);
+    g_file_make_directory_with_parents(parent, NULL, NULL);
+    g_object_unref(parent);
+  }
+
+  /* replacing rather than overwriting in place, so that a shorter cache
+   * doesn't leave the tail of the previous one behind. the new file is only
+   * moved over the old one once it's complete, so closing it cancelled after
+   * a failed write keeps the old one. */
+  GFileOutputStream *const out =
+      g_file_replace(f, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL);
+  if (!out) {
+    return FALSE;
+  }
+
+  struct outstream_ctx out_ctx = {.out = G_OUTPUT_STREAM(out),
+                                  .failed = FALSE};
+  serialize_muxdata_hash(md, write_to_outstream, &out_ctx);
+  GCancellable *const cancellable = g_cancellable_new();
+  if (out_ctx.failed) {
+    g_cancellable_cancel(cancellable);
+  }
+  const gboolean rv =
+      g_output_stream_close(G_OUTPUT_STREAM(out), cancellable, NULL) &&
+      !out_ctx.failed;
+  g_object_unref(cancellable);
+  g_object_unref(out);
+
+  /* the changes in the log are in the cache now. */
+  if (rv) {
+    gchar *const log_path = cache_get_log_path(f);
+    g_unlink(log_path);
+    g_free(log_path);
+    mux_data_set_dirty(md, FALSE);
+  }
+  return rv;
+}
+
+MuxData *mux_data_read_from_file(GFile *f, const struct mux_filter *filter) {
+  gchar *const path = g_file_get_path(f);
+  GMappedFile *const mapped = g_mapped_file_new(path, FALSE, NULL);
+  MuxData *md = NULL;
+  if (mapped) {
+    md = deserialize_muxdata_from_memory(g_mapped_file_get_contents(mapped),
+                                         g_mapped_file_get_length(mapped),
+                                         filter, NULL);
+    g_mapped_file_unref(mapped);
+  }
+  g_free(path);
+  if (!md) {
+    return NULL;
+  }
+
+  mux_data_set_dirty(md, FALSE);
+  gchar *const log_path = cache_get_log_path(f);
+  guint num_records;
+  GError *err = NULL;
+  if (!cache_log_replay(log_path, md, &num_records, &err)) {
+    g_printerr("Could not read the changes to the cache : %s\n",
+               err->message);
+    g_error_free(err);
+  } else if (num_records > 0) {
+    /* so that the log is folded into the cache when it's saved next. */
+    mux_data_set_dirty(md, TRUE);
+  }
+  g_free(log_path);
+  return md;
+}
+
+gboolean mux_data_log_updates(GFile *f, const GArray *updates) {
+  gchar *const log_path = cache_get_log_path(f);
+  GError *err = NULL;
+  const gboolean rv = cache_log_append(log_path, updates, &err);
+  if (!rv) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+  }
+  g_free(log_path);
+  return rv;
+}
+
+gboolean mux_data_log_is_long(GFile *f) {
+  gchar *const log_path = cache_get_log_path(f);
+  const gboolean rv = cache_log_is_long(log_path);
+  g_free(log_path);
+  return rv;
+}
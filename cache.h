@@ -0,0 +1,36 @@
+#ifndef GETPLMUX_CACHE_H
+#define GETPLMUX_CACHE_H
+
+#include <gio/gio.h>
+
+#include "muxdata.h"
+
+/* $XDG_DATA_HOME/getplmux/transmitters.xml */
+GFile *cache_get_default_file(void);
+
+/* the cache written for the given location in batch mode. */
+GFile *cache_get_location_file(double lat, double lon);
+
+/* the local transmitter database used in offline mode. */
+GFile *cache_get_transmitter_db_file(void);
+
+/* the results of previous captures, see stats.h. */
+GFile *cache_get_stats_file(void);
+
+/* the capabilities of the DVB frontends, see frontend.h. */
+GFile *cache_get_frontends_file(void);
+
+/* also folds the changes logged by mux_data_log_updates() into the file. */
+gboolean mux_data_save_to_file(MuxData *md, GFile *f);
+/* applies the logged changes on top of what's in the file. */
+MuxData *mux_data_read_from_file(GFile *f, const struct mux_filter *filter);
+
+/* logs the struct cache_update, see cachelog.h, to be applied on top of the
+ * file instead of saving all of it again. */
+gboolean mux_data_log_updates(GFile *f, const GArray *updates);
+
+/* whether the log has grown enough that mux_data_save_to_file() should be
+ * used instead. */
+gboolean mux_data_log_is_long(GFile *f);
+
+#endif
@@ -0,0 +1,207 @@
+#include "cachelog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#define CACHE_LOG_NUM_FIELDS 7
+
+static void cache_update_clear(gpointer p) {
+  struct cache_update *const update = p;
+  g_free(update->mux);
+  g_free(update->name);
+}
+
+static GArray *cache_updates_new(void) {
+  GArray *const updates =
+      g_array_new(FALSE, FALSE, sizeof(struct cache_update));
+  g_array_set_clear_func(updates, cache_update_clear);
+  return updates;
+}
+
+static gboolean tune_params_differ(const struct tune_params *a,
+                                   const struct tune_params *b) {
+  return a->freq_khz != b->freq_khz || a->bw_mhz != b->bw_mhz ||
+         a->mod != b->mod || a->dvb_type != b->dvb_type;
+}
+
+static void snapshot_mux(const gchar *mux, const GArray *transmitters,
+                         void *ctx) {
+  GArray *const snapshot = ctx;
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    const struct cache_update update = {.mux = g_strdup(mux),
+                                        .name = g_strdup(par->name),
+                                        .freq_khz = par->tune_parms.freq_khz,
+                                        .tune_parms = par->tune_parms};
+    g_array_append_val(snapshot, update);
+  }
+}
+
+GArray *cache_snapshot_take(MuxData *md) {
+  GArray *const snapshot = cache_updates_new();
+  mux_data_foreach(md, snapshot_mux, snapshot);
+  return snapshot;
+}
+
+static struct mux_params *find_transmitter(MuxData *md, const gchar *mux,
+                                           const gchar *name,
+                                           guint freq_khz) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  for (guint i = 0; transmitters && i < transmitters->len; ++i) {
+    struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    if (par->tune_parms.freq_khz == freq_khz &&
+        g_strcmp0(par->name, name) == 0) {
+      return par;
+    }
+  }
+  return NULL;
+}
+
+/* the transmitters are looked up in the order of the snapshot, which is the
+ * order they're in, so only the changed ones need to be searched for. */
+GArray *cache_snapshot_diff(const GArray *snapshot, MuxData *md) {
+  GArray *const updates = cache_updates_new();
+  GArray *const now = cache_snapshot_take(md);
+  for (guint i = 0; i < snapshot->len && i < now->len; ++i) {
+    const struct cache_update *const before =
+        &g_array_index(snapshot, struct cache_update, i);
+    const struct cache_update *const after =
+        &g_array_index(now, struct cache_update, i);
+    if (g_strcmp0(before->mux, after->mux) != 0 ||
+        g_strcmp0(before->name, after->name) != 0 ||
+        !tune_params_differ(&before->tune_parms, &after->tune_parms)) {
+      continue;
+    }
+    const struct cache_update update = {.mux = g_strdup(before->mux),
+                                        .name = g_strdup(before->name),
+                                        .freq_khz = before->freq_khz,
+                                        .tune_parms = after->tune_parms};
+    g_array_append_val(updates, update);
+  }
+  g_array_unref(now);
+  return updates;
+}
+
+static void append_line(GString *out, const struct cache_update *update) {
+  gchar *const mux = g_strescape(update->mux, NULL);
+  gchar *const name = g_strescape(update->name, NULL);
+  g_string_append_printf(out, "%s\t%s\t%u\t%u\t%u\t%u\t%u\n", mux, name,
+                         update->freq_khz, update->tune_parms.freq_khz,
+                         update->tune_parms.bw_mhz,
+                         (guint)update->tune_parms.mod,
+                         (guint)update->tune_parms.dvb_type);
+  g_free(mux);
+  g_free(name);
+}
+
+/* whether the last line in the file was cut short, so that the next one
+ * doesn't end up glued to it. */
+static gboolean ends_mid_line(int fd) {
+  guint8 last;
+  return lseek(fd, -1, SEEK_END) >= 0 && read(fd, &last, 1) == 1 &&
+         last != '\n';
+}
+
+gboolean cache_log_is_long(const gchar *path) {
+  GStatBuf st;
+  return g_stat(path, &st) == 0 && st.st_size > CACHE_LOG_MAX_BYTES;
+}
+
+gboolean cache_log_append(const gchar *path, const GArray *updates,
+                          GError **error) {
+  if (updates->len == 0) {
+    return TRUE;
+  }
+  const int fd = g_open(path, O_RDWR | O_APPEND | O_CREAT, 0666);
+  if (fd < 0) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not open %s : %s", path, g_strerror(errsv));
+    return FALSE;
+  }
+
+  GString *const out = g_string_new(ends_mid_line(fd) ? "\n" : "");
+  for (guint i = 0; i < updates->len; ++i) {
+    append_line(out, &g_array_index(updates, struct cache_update, i));
+  }
+  /* a single write, so that a crash loses at most the end of the batch. */
+  gboolean rv = write(fd, out->str, out->len) == (gssize)out->len &&
+                fsync(fd) == 0;
+  if (!rv) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", path, g_strerror(errsv));
+  }
+  g_string_free(out, TRUE);
+  rv = g_close(fd, rv ? error : NULL) && rv;
+  return rv;
+}
+
+static gboolean parse_uint(const gchar *str, guint *value) {
+  guint64 parsed;
+  if (!g_ascii_string_to_unsigned(str, 10, 0, G_MAXUINT, &parsed, NULL)) {
+    return FALSE;
+  }
+  *value = (guint)parsed;
+  return TRUE;
+}
+
+static gboolean parse_line(const gchar *line, struct cache_update *update) {
+  gchar **const fields = g_strsplit(line, "\t", -1);
+  guint mod, dvb_type;
+  const gboolean rv =
+      g_strv_length(fields) == CACHE_LOG_NUM_FIELDS &&
+      parse_uint(fields[2], &update->freq_khz) &&
+      parse_uint(fields[3], &update->tune_parms.freq_khz) &&
+      parse_uint(fields[4], &update->tune_parms.bw_mhz) &&
+      parse_uint(fields[5], &mod) && parse_uint(fields[6], &dvb_type);
+  if (rv) {
+    update->mux = g_strcompress(fields[0]);
+    update->name = g_strcompress(fields[1]);
+    update->tune_parms.mod = (enum fe_modulation)mod;
+    update->tune_parms.dvb_type = (enum fe_delivery_system)dvb_type;
+  }
+  g_strfreev(fields);
+  return rv;
+}
+
+gboolean cache_log_replay(const gchar *path, MuxData *md, guint *num_records,
+                          GError **error) {
+  *num_records = 0;
+  gchar *contents;
+  gsize len;
+  GError *err = NULL;
+  if (!g_file_get_contents(path, &contents, &len, &err)) {
+    if (g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_error_free(err);
+      return TRUE;
+    }
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+
+  gchar *line = contents;
+  for (gchar *end; (end = memchr(line, '\n', len - (gsize)(line - contents)));
+       line = end + 1) {
+    *end = '\0';
+    struct cache_update update;
+    if (!parse_line(line, &update)) {
+      continue;
+    }
+    ++*num_records;
+    struct mux_params *const par =
+        find_transmitter(md, update.mux, update.name, update.freq_khz);
+    if (par) {
+      par->tune_parms = update.tune_parms;
+    }
+    cache_update_clear(&update);
+  }
+  g_free(contents);
+  return TRUE;
+}
@@ -0,0 +1,51 @@
+#ifndef GETPLMUX_CACHELOG_H
+#define GETPLMUX_CACHELOG_H
+
+#include <glib.h>
+
+#include "muxdata.h"
+
+/* changes to the tuning parameters of cached transmitters, which are
+ * appended to a log next to the cache instead of rewriting all of it. the
+ * log has one line per change :
+ *
+ *   MUX<TAB>name<TAB>frequency<TAB>new frequency<TAB>bandwidth<TAB>
+ *   modulation<TAB>delivery system
+ *
+ * with the MUX and name escaped as by g_strescape(), and everything else as
+ * decimal numbers. a line cut short by a crash is ignored, as are changes to
+ * transmitters which aren't there anymore. */
+struct cache_update {
+  gchar *mux;
+  gchar *name;
+  /* the frequency before the change, which identifies the transmitter
+   * along with the MUX and name */
+  guint freq_khz;
+  struct tune_params tune_parms;
+};
+
+/* struct cache_update, with the current parameters of every transmitter. */
+GArray *cache_snapshot_take(MuxData *md);
+
+/* struct cache_update, for the transmitters whose parameters are different
+ * from the snapshot now. */
+GArray *cache_snapshot_diff(const GArray *snapshot, MuxData *md);
+
+gboolean cache_log_append(const gchar *path, const GArray *updates,
+                          GError **error);
+
+/* past this, replaying the log takes about as long as reading a cache
+ * saved from scratch, so it should be folded into the cache. */
+#define CACHE_LOG_MAX_BYTES (64 * 1024)
+
+/* whether the log has grown past CACHE_LOG_MAX_BYTES. a missing log
+ * hasn't. */
+gboolean cache_log_is_long(const gchar *path);
+
+/* applies the changes in the log, in the order they were made. a missing
+ * log is the same as an empty one. num_records is set to the number of
+ * changes read, whether their transmitters were found or not. */
+gboolean cache_log_replay(const gchar *path, MuxData *md, guint *num_records,
+                          GError **error);
+
+#endif
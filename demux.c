@@ -0,0 +1,402 @@
+#include "demux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "ts.h"
+
+#define TABLE_ID_PAT 0x00
+#define TABLE_ID_PMT 0x02
+
+/* writev() can't take more than IOV_MAX at once, which is at least this. */
+#define MAX_PENDING_IOVECS 1024
+
+struct service_output {
+  guint16 program_number;
+  guint16 pmt_pid;
+  /* CRC of the PMT the PIDs were taken from */
+  guint32 pmt_crc;
+  gboolean has_pmt;
+  /* the PMT packets are only passed on from the start of a section */
+  gboolean pmt_synced;
+  gchar *path;
+  /* -1 until the PMT is known */
+  int fd;
+  /* the PIDs which are routed to this output */
+  GArray *pids;
+
+  /* a PAT listing only this service */
+  guint8 pat_packet[TS_PACKET_SIZE];
+  guint8 pat_cc;
+  gboolean pat_pending;
+  /* packets waiting to be written */
+  struct iovec pending[MAX_PENDING_IOVECS];
+  guint num_pending;
+};
+
+struct ServiceDemux_ {
+  gchar *prefix;
+  GArray *program_numbers;
+  struct ts_splitter splitter;
+  TsSectionAssembler *assembler;
+  /* struct service_output */
+  GPtrArray *outputs;
+  /* the outputs each PID is written to, NULL if none */
+  GPtrArray *routes[TS_NUM_PIDS];
+  GError *error;
+};
+
+static void output_free(gpointer p) {
+  struct service_output *const output = p;
+  if (output->fd >= 0) {
+    close(output->fd);
+  }
+  g_array_free(output->pids, TRUE);
+  g_free(output->path);
+  g_free(output);
+}
+
+static void output_flush(ServiceDemux *demux, struct service_output *output) {
+  struct iovec *iov = output->pending;
+  guint num = output->num_pending;
+  output->num_pending = 0;
+  output->pat_pending = FALSE;
+
+  while (num > 0 && output->fd >= 0) {
+    const ssize_t written = writev(output->fd, iov, (int)num);
+    if (written < 0) {
+      const int errsv = errno;
+      if (errsv == EINTR) {
+        continue;
+      }
+      if (!demux->error) {
+        g_set_error(&demux->error, G_FILE_ERROR,
+                    g_file_error_from_errno(errsv),
+                    "Could not write to %s : %s", output->path,
+                    g_strerror(errsv));
+      }
+      /* the output is unusable from now on. */
+      close(output->fd);
+      output->fd = -1;
+      return;
+    }
+    gsize left = (gsize)written;
+    while (num > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --num;
+    }
+    if (num > 0) {
+      iov->iov_base = (guint8 *)iov->iov_base + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+static void output_queue(ServiceDemux *demux, struct service_output *output,
+                         const guint8 *packet) {
+  if (output->num_pending > 0) {
+    struct iovec *const last = &output->pending[output->num_pending - 1];
+    /* consecutive packets go out in one piece. */
+    if ((const guint8 *)last->iov_base + last->iov_len == packet) {
+      last->iov_len += TS_PACKET_SIZE;
+      return;
+    }
+  }
+  if (output->num_pending == MAX_PENDING_IOVECS) {
+    output_flush(demux, output);
+  }
+  output->pending[output->num_pending++] =
+      (struct iovec){.iov_base = (void *)packet, .iov_len = TS_PACKET_SIZE};
+}
+
+static void output_queue_pat(ServiceDemux *demux,
+                             struct service_output *output) {
+  /* the packet is reused, so it can only be queued once per flush. */
+  if (output->pat_pending) {
+    return;
+  }
+  output->pat_packet[3] = 0x10 | output->pat_cc;
+  output->pat_cc = (output->pat_cc + 1) & 0x0f;
+  output_queue(demux, output, output->pat_packet);
+  output->pat_pending = TRUE;
+}
+
+static void output_set_pat(struct service_output *output, guint16 ts_id) {
+  guint8 *const pkt = output->pat_packet;
+  memset(pkt, 0xff, TS_PACKET_SIZE);
+  pkt[0] = TS_SYNC_BYTE;
+  pkt[1] = 0x40 | (TS_PID_PAT >> 8);
+  pkt[2] = TS_PID_PAT & 0xff;
+  /* pointer_field */
+  pkt[4] = 0;
+
+  guint8 *const section = pkt + 5;
+  const guint8 pat[] = {TABLE_ID_PAT,
+                        0xb0,
+                        13,
+                        ts_id >> 8,
+                        ts_id & 0xff,
+                        0xc1,
+                        0,
+                        0,
+                        output->program_number >> 8,
+                        output->program_number & 0xff,
+                        0xe0 | (output->pmt_pid >> 8),
+                        output->pmt_pid & 0xff};
+  memcpy(section, pat, sizeof(pat));
+  const guint32 crc = ts_crc32(section, sizeof(pat));
+  for (int i = 0; i < 4; ++i) {
+    section[sizeof(pat) + i] = (guint8)(crc >> (24 - 8 * i));
+  }
+}
+
+static void route_remove(ServiceDemux *demux, struct service_output *output) {
+  for (guint i = 0; i < output->pids->len; ++i) {
+    const guint16 pid = g_array_index(output->pids, guint16, i);
+    g_ptr_array_remove(demux->routes[pid], output);
+    if (demux->routes[pid]->len == 0) {
+      g_clear_pointer(&demux->routes[pid], g_ptr_array_unref);
+    }
+  }
+  g_array_set_size(output->pids, 0);
+}
+
+static void route_add(ServiceDemux *demux, struct service_output *output,
+                      guint16 pid) {
+  if (pid == TS_NULL_PID || pid == TS_PID_PAT) {
+    return;
+  }
+  for (guint i = 0; i < output->pids->len; ++i) {
+    if (g_array_index(output->pids, guint16, i) == pid) {
+      return;
+    }
+  }
+  g_array_append_val(output->pids, pid);
+  if (!demux->routes[pid]) {
+    demux->routes[pid] = g_ptr_array_new();
+  }
+  g_ptr_array_add(demux->routes[pid], output);
+}
+
+static gboolean is_wanted(const ServiceDemux *demux, guint16 program_number) {
+  if (!demux->program_numbers) {
+    return TRUE;
+  }
+  for (guint i = 0; i < demux->program_numbers->len; ++i) {
+    if (g_array_index(demux->program_numbers, guint16, i) == program_number) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static struct service_output *find_output(ServiceDemux *demux,
+                                          guint16 program_number) {
+  for (guint i = 0; i < demux->outputs->len; ++i) {
+    struct service_output *const output = demux->outputs->pdata[i];
+    if (output->program_number == program_number) {
+      return output;
+    }
+  }
+  return NULL;
+}
+
+static void on_pat(ServiceDemux *demux, const guint8 *section, gsize len,
+                   const struct ts_section_header *hdr) {
+  for (gsize pos = TS_LONG_SECTION_HEADER_SIZE; pos + 4 + 4 <= len;
+       pos += 4) {
+    const guint16 program_number = ts_read_u16(section + pos);
+    const guint16 pmt_pid = ts_read_u16(section + pos + 2) & 0x1fff;
+    /* program 0 is the NIT */
+    if (program_number == 0 || !is_wanted(demux, program_number)) {
+      continue;
+    }
+
+    struct service_output *output = find_output(demux, program_number);
+    if (!output) {
+      output = g_new0(struct service_output, 1);
+      output->program_number = program_number;
+      output->fd = -1;
+      output->pids = g_array_new(FALSE, FALSE, sizeof(guint16));
+      output->path =
+          g_strdup_printf("%s_%u.ts", demux->prefix, program_number);
+      g_ptr_array_add(demux->outputs, output);
+    } else if (output->pmt_pid == pmt_pid) {
+      continue;
+    }
+
+    /* new service, or one whose PMT moved. a queued PAT must go out before
+     * its packet is rewritten. */
+    if (output->pat_pending) {
+      output_flush(demux, output);
+    }
+    route_remove(demux, output);
+    output->pmt_pid = pmt_pid;
+    output->has_pmt = FALSE;
+    output->pmt_synced = FALSE;
+    output_set_pat(output, hdr->table_id_extension);
+    ts_section_assembler_add_pid(demux->assembler, pmt_pid);
+  }
+}
+
+static void on_pmt(ServiceDemux *demux, guint16 pid, const guint8 *section,
+                   gsize len, const struct ts_section_header *hdr) {
+  struct service_output *const output =
+      find_output(demux, hdr->table_id_extension);
+  const guint32 crc = ts_read_u32(section + len - 4);
+  if (!output || output->pmt_pid != pid ||
+      (output->has_pmt && output->pmt_crc == crc) ||
+      len < TS_LONG_SECTION_HEADER_SIZE + 4 + 4) {
+    return;
+  }
+
+  route_remove(demux, output);
+  route_add(demux, output, pid);
+  route_add(demux, output, ts_read_u16(section + 8) & 0x1fff);
+  const gsize end = len - 4;
+  gsize pos = 12 + (ts_read_u16(section + 10) & 0x0fff);
+  while (pos + 5 <= end) {
+    route_add(demux, output, ts_read_u16(section + pos + 1) & 0x1fff);
+    pos += 5 + (ts_read_u16(section + pos + 3) & 0x0fff);
+  }
+  output->has_pmt = TRUE;
+  output->pmt_crc = crc;
+
+  if (output->fd < 0) {
+    output->fd =
+        g_open(output->path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (output->fd < 0) {
+      const int errsv = errno;
+      if (!demux->error) {
+        g_set_error(&demux->error, G_FILE_ERROR,
+                    g_file_error_from_errno(errsv), "Could not open %s : %s",
+                    output->path, g_strerror(errsv));
+      }
+      route_remove(demux, output);
+      return;
+    }
+    output_queue_pat(demux, output);
+  }
+}
+
+static void on_section(guint16 pid, const guint8 *section, gsize len,
+                       void *ctx) {
+  ServiceDemux *const demux = ctx;
+  struct ts_section_header hdr;
+  if (!ts_section_parse_header(section, len, &hdr) || !hdr.current_next) {
+    return;
+  }
+  if (pid == TS_PID_PAT && hdr.table_id == TABLE_ID_PAT) {
+    on_pat(demux, section, len, &hdr);
+  } else if (hdr.table_id == TABLE_ID_PMT) {
+    on_pmt(demux, pid, section, len, &hdr);
+  }
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  ServiceDemux *const demux = ctx;
+  struct ts_packet pkt;
+  if (!ts_packet_parse(data, &pkt)) {
+    return;
+  }
+  ts_section_assembler_push(demux->assembler, &pkt);
+
+  if (pkt.pid == TS_PID_PAT) {
+    /* every output gets its own PAT as often as the original one comes. */
+    if (pkt.payload_unit_start) {
+      for (guint i = 0; i < demux->outputs->len; ++i) {
+        struct service_output *const output = demux->outputs->pdata[i];
+        if (output->fd >= 0) {
+          output_queue_pat(demux, output);
+        }
+      }
+    }
+    return;
+  }
+
+  GPtrArray *const routes = demux->routes[pkt.pid];
+  if (!routes) {
+    return;
+  }
+  for (guint i = 0; i < routes->len; ++i) {
+    struct service_output *const output = routes->pdata[i];
+    if (output->fd < 0) {
+      continue;
+    }
+    if (pkt.pid == output->pmt_pid && !output->pmt_synced) {
+      if (!pkt.payload_unit_start) {
+        continue;
+      }
+      output->pmt_synced = TRUE;
+    }
+    output_queue(demux, output, data);
+    /* packets crossing the boundary of the pushed data are put together in
+     * a buffer which is reused, so they have to be written right away. */
+    if (data == demux->splitter.partial) {
+      output_flush(demux, output);
+    }
+  }
+}
+
+ServiceDemux *service_demux_new(const gchar *prefix,
+                                const GArray *program_numbers) {
+  ServiceDemux *const demux = g_new0(ServiceDemux, 1);
+  demux->prefix = g_strdup(prefix);
+  if (program_numbers) {
+    demux->program_numbers =
+        g_array_sized_new(FALSE, FALSE, sizeof(guint16), program_numbers->len);
+    g_array_append_vals(demux->program_numbers, program_numbers->data,
+                        program_numbers->len);
+  }
+  ts_splitter_init(&demux->splitter);
+  demux->assembler = ts_section_assembler_new(on_section, demux);
+  ts_section_assembler_add_pid(demux->assembler, TS_PID_PAT);
+  demux->outputs = g_ptr_array_new_with_free_func(output_free);
+  demux->error = NULL;
+  return demux;
+}
+
+void service_demux_push(ServiceDemux *demux, const guint8 *data, gsize len) {
+  ts_splitter_push(&demux->splitter, data, len, on_packet, demux);
+  /* the pushed data is only valid until this returns. */
+  for (guint i = 0; i < demux->outputs->len; ++i) {
+    output_flush(demux, demux->outputs->pdata[i]);
+  }
+}
+
+guint service_demux_get_num_outputs(const ServiceDemux *demux) {
+  guint num = 0;
+  for (guint i = 0; i < demux->outputs->len; ++i) {
+    const struct service_output *const output = demux->outputs->pdata[i];
+    if (output->fd >= 0) {
+      ++num;
+    }
+  }
+  return num;
+}
+
+gboolean service_demux_close(ServiceDemux *demux, GError **error) {
+  GError *const err = demux->error;
+  ts_section_assembler_destroy(demux->assembler);
+  for (gsize i = 0; i < G_N_ELEMENTS(demux->routes); ++i) {
+    g_clear_pointer(&demux->routes[i], g_ptr_array_unref);
+  }
+  g_ptr_array_unref(demux->outputs);
+  if (demux->program_numbers) {
+    g_array_free(demux->program_numbers, TRUE);
+  }
+  g_free(demux->prefix);
+  g_free(demux);
+
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  return TRUE;
+}
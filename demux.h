@@ -0,0 +1,32 @@
+#ifndef GETPLMUX_DEMUX_H
+#define GETPLMUX_DEMUX_H
+
+#include <glib.h>
+
+/* splits a capture into one file per service while it's being received. the
+ * PAT and the PMTs are followed as they come, and every service gets its own
+ * PAT listing only itself, followed by the packets of its PMT, PCR and
+ * elementary streams. the packets are written straight out of the buffers
+ * they're pushed in, with one writev() per file per push.
+ *
+ * the files are named <prefix>_<program number>.ts and are only created once
+ * the PMT of their service has been received. */
+typedef struct ServiceDemux_ ServiceDemux;
+
+/* program_numbers is an array of guint16 with the services to keep, or NULL
+ * for all of them. */
+ServiceDemux *service_demux_new(const gchar *prefix,
+                                const GArray *program_numbers);
+
+/* feeds the captured stream, which doesn't need to be aligned to packet
+ * boundaries. this may be called from a different thread than the rest, but
+ * never at the same time. */
+void service_demux_push(ServiceDemux *demux, const guint8 *data, gsize len);
+
+guint service_demux_get_num_outputs(const ServiceDemux *demux);
+
+/* also reports the first error that happened while pushing. the demux is
+ * freed either way. */
+gboolean service_demux_close(ServiceDemux *demux, GError **error);
+
+#endif
@@ -65,8 +65,10 @@ void serialize_muxdata_hash(MuxData *muxdata,
 
 struct gmarkup_parse_state {
   MuxData *mux_data;
+  const struct mux_filter *filter;
   gchar *elem_name;
   gchar *cur_mux;
+  gboolean skip_mux;
   GString *text_buf;
   struct mux_params mux_parm_buf;
 };
@@ -88,7 +90,9 @@ static void on_transmitter_end_element(GMarkupParseContext *context,
   const gchar *const input = state->text_buf->str;
 
   if (g_strcmp0(element_name, "name") == 0) {
-    muxparm->name = g_strdup(input);
+    if (!state->skip_mux) {
+      muxparm->name = g_strdup(input);
+    }
   } else if (g_strcmp0(element_name, "distance") == 0) {
     muxparm->distance = g_ascii_strtod(input, NULL);
   } else if (g_strcmp0(element_name, "frequency") == 0) {
@@ -117,12 +121,29 @@ static void on_transmitter_text(GMarkupParseContext *context, const gchar *text,
   g_string_append_len(state->text_buf, text, text_len);
 }
 
-static const GMarkupParser transmitter_parser = {.start_element = NULL,
-                                                 .end_element =
-                                                     on_transmitter_end_element,
-                                                 .text = on_transmitter_text,
-                                                 .passthrough = NULL,
-                                                 .error = NULL};
+static void on_transmitter_start_element(GMarkupParseContext *context,
+                                         const gchar *element_name,
+                                         const gchar **attribute_names,
+                                         const gchar **attribute_values,
+                                         gpointer user_data, GError **error) {
+  (void)context;
+  (void)element_name;
+  (void)attribute_names;
+  (void)attribute_values;
+  (void)error;
+
+  /* drop the indentation preceding the element so that it doesn't end up as
+   * part of its contents. */
+  struct gmarkup_parse_state *const state = user_data;
+  g_string_set_size(state->text_buf, 0);
+}
+
+static const GMarkupParser transmitter_parser = {
+    .start_element = on_transmitter_start_element,
+    .end_element = on_transmitter_end_element,
+    .text = on_transmitter_text,
+    .passthrough = NULL,
+    .error = NULL};
 
 static void on_toplevel_start_element(GMarkupParseContext *context,
                                       const gchar *element_name,
@@ -138,6 +159,8 @@ static void on_toplevel_start_element(GMarkupParseContext *context,
                                       G_MARKUP_COLLECT_STRDUP, "name", &muxname,
                                       G_MARKUP_COLLECT_INVALID)) {
         state->cur_mux = muxname;
+        state->skip_mux =
+            !mux_filter_accepts_mux(state->filter, muxname, strlen(muxname));
       }
     } else {
       *error =
@@ -159,9 +182,16 @@ static void on_toplevel_end_element(GMarkupParseContext *context,
 
   if (g_strcmp0(element_name, "transmitter") == 0) {
     g_markup_parse_context_pop(context);
-    mux_data_append_transmitter(state->mux_data, state->cur_mux,
-                                &state->mux_parm_buf);
-    memset(&state->mux_parm_buf, 0, sizeof(state->mux_parm_buf));
+    struct mux_params *const muxparm = &state->mux_parm_buf;
+    if (!state->skip_mux &&
+        mux_filter_accepts_distance(state->filter, muxparm->distance) &&
+        mux_filter_accepts_delsys(state->filter,
+                                  muxparm->tune_parms.dvb_type)) {
+      mux_data_append_transmitter(state->mux_data, state->cur_mux, muxparm);
+    } else {
+      mux_params_clear(muxparm);
+    }
+    memset(muxparm, 0, sizeof(*muxparm));
   } else if (g_strcmp0(element_name, "mux") == 0) {
     g_clear_pointer(&state->cur_mux, g_free);
   } else {
@@ -178,11 +208,14 @@ static const GMarkupParser toplevel_parser = {
     .error = NULL};
 
 MuxData *deserialize_muxdata_hash(gssize (*readfn)(guint8 *, gsize, void *),
-                                  void *readfn_ctx, GError **error) {
+                                  void *readfn_ctx,
+                                  const struct mux_filter *filter,
+                                  GError **error) {
   MuxData *md = mux_data_new();
   struct gmarkup_parse_state state;
   memset(&state, 0, sizeof(state));
   state.mux_data = md;
+  state.filter = filter;
   state.text_buf = g_string_new(NULL);
 
   GMarkupParseContext *const markup_ctx =
@@ -208,3 +241,294 @@ beach:
   parse_state_destroy(&state);
   return md;
 }
+
+/* everything below is a fast path for reading back exactly what
+ * serialize_muxdata_hash() writes, straight from memory. as soon as it sees
+ * anything it doesn't expect (entities, comments, attributes in a different
+ * form, stray text...), it gives up and the whole input is handed over to
+ * GMarkup instead, so that the result - or the error - is always the same. */
+
+struct fast_scanner {
+  const gchar *pos;
+  const gchar *const end;
+};
+
+static gboolean is_markup_space(gchar c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void scan_skip_whitespace(struct fast_scanner *scan) {
+  while (scan->pos < scan->end && is_markup_space(*scan->pos)) {
+    ++scan->pos;
+  }
+}
+
+static gboolean scan_literal(struct fast_scanner *scan, const char *lit,
+                             gsize len) {
+  if ((gsize)(scan->end - scan->pos) < len ||
+      memcmp(scan->pos, lit, len) != 0) {
+    return FALSE;
+  }
+  scan->pos += len;
+  return TRUE;
+}
+
+#define scan_literal_str(scan, lit) scan_literal((scan), (lit), sizeof(lit) - 1)
+
+/* returns the text up to the next occurrence of c, and moves past c. */
+static gboolean scan_until(struct fast_scanner *scan, char c,
+                           const gchar **text, gsize *len) {
+  const gchar *const found = memchr(scan->pos, c, scan->end - scan->pos);
+  if (!found) {
+    return FALSE;
+  }
+  *text = scan->pos;
+  *len = (gsize)(found - scan->pos);
+  scan->pos = found + 1;
+  return TRUE;
+}
+
+enum transmitter_field {
+  FIELD_NAME,
+  FIELD_DISTANCE,
+  FIELD_FREQUENCY,
+  FIELD_BANDWIDTH,
+  FIELD_MODULATION,
+  FIELD_DELSYS
+};
+
+struct field_tag {
+  const char *tag;
+  gsize len;
+  enum transmitter_field field;
+};
+
+/* the length and the first letter are enough to tell all the transmitter
+ * fields apart. should a new field ever collide with an existing one, the
+ * duplicate designated initializer gets reported by -Woverride-init. */
+#define FIELD_TAG_HASH(len, first) (((len) + (guchar)(first)) & 0xf)
+
+#define FIELD_TAG(tag, first, field)                                           \
+  [FIELD_TAG_HASH(sizeof(tag) - 1, first)] = {tag, sizeof(tag) - 1, field}
+
+static const struct field_tag field_tags[16] = {
+    FIELD_TAG("name", 'n', FIELD_NAME),
+    FIELD_TAG("distance", 'd', FIELD_DISTANCE),
+    FIELD_TAG("frequency", 'f', FIELD_FREQUENCY),
+    FIELD_TAG("bandwidth", 'b', FIELD_BANDWIDTH),
+    FIELD_TAG("modulation", 'm', FIELD_MODULATION),
+    FIELD_TAG("delsys", 'd', FIELD_DELSYS)};
+
+#undef FIELD_TAG
+
+static const struct field_tag *field_tag_lookup(const gchar *tag, gsize len) {
+  if (len == 0) {
+    return NULL;
+  }
+  const struct field_tag *const ft = &field_tags[FIELD_TAG_HASH(len, tag[0])];
+  if (ft->tag && ft->len == len && memcmp(ft->tag, tag, len) == 0) {
+    return ft;
+  }
+  return NULL;
+}
+
+static gboolean is_plain_text(const gchar *text, gsize len) {
+  return !memchr(text, '&', len) && !memchr(text, '<', len) &&
+         !memchr(text, '\r', len) && g_utf8_validate(text, len, NULL);
+}
+
+static gboolean parse_uint_field(const gchar *text, gsize len, guint64 *out) {
+  /* 19 digits always fit into a guint64. */
+  if (len == 0 || len > 19) {
+    return FALSE;
+  }
+  guint64 val = 0;
+  for (gsize i = 0; i < len; ++i) {
+    if (!g_ascii_isdigit(text[i])) {
+      return FALSE;
+    }
+    val = val * 10 + (guint64)(text[i] - '0');
+  }
+  *out = val;
+  return TRUE;
+}
+
+/* the name is kept as a slice of the input until the whole transmitter has
+ * been scanned, so that nothing is allocated for the ones that get filtered
+ * out. */
+struct fast_transmitter {
+  const gchar *name;
+  gsize name_len;
+  struct mux_params muxparm;
+};
+
+static gboolean fast_set_field(struct fast_transmitter *transmitter,
+                               enum transmitter_field field, const gchar *text,
+                               gsize len) {
+  struct mux_params *const muxparm = &transmitter->muxparm;
+  struct tune_params *const tuneparms = &muxparm->tune_parms;
+  switch (field) {
+  case FIELD_NAME:
+    if (!is_plain_text(text, len)) {
+      return FALSE;
+    }
+    transmitter->name = text;
+    transmitter->name_len = len;
+    return TRUE;
+  case FIELD_DISTANCE: {
+    /* the text is always followed by the '<' of the closing tag, so strtod
+     * can't run past the end of the buffer. */
+    gchar *endp;
+    muxparm->distance = g_ascii_strtod(text, &endp);
+    return len > 0 && endp == text + len;
+  }
+  default:
+    break;
+  }
+
+  guint64 val;
+  if (!parse_uint_field(text, len, &val)) {
+    return FALSE;
+  }
+  switch (field) {
+  case FIELD_FREQUENCY:
+    tuneparms->freq_khz = val;
+    break;
+  case FIELD_BANDWIDTH:
+    tuneparms->bw_mhz = val;
+    break;
+  case FIELD_MODULATION:
+    tuneparms->mod = val;
+    break;
+  case FIELD_DELSYS:
+    tuneparms->dvb_type = val;
+    break;
+  default:
+    break;
+  }
+  return TRUE;
+}
+
+static gboolean scan_transmitter(struct fast_scanner *scan,
+                                 struct fast_transmitter *transmitter) {
+  memset(transmitter, 0, sizeof(*transmitter));
+  for (;;) {
+    scan_skip_whitespace(scan);
+    if (scan_literal_str(scan, "</transmitter>")) {
+      return TRUE;
+    }
+
+    const gchar *tag, *text;
+    gsize tag_len, text_len;
+    if (!scan_literal_str(scan, "<") ||
+        !scan_until(scan, '>', &tag, &tag_len)) {
+      return FALSE;
+    }
+    const struct field_tag *const ft = field_tag_lookup(tag, tag_len);
+    if (!ft || !scan_until(scan, '<', &text, &text_len) ||
+        !scan_literal_str(scan, "/") || !scan_literal(scan, ft->tag, ft->len) ||
+        !scan_literal_str(scan, ">") ||
+        !fast_set_field(transmitter, ft->field, text, text_len)) {
+      return FALSE;
+    }
+  }
+}
+
+static gboolean scan_mux(struct fast_scanner *scan, MuxData *md,
+                         const struct mux_filter *filter) {
+  const gchar *mux;
+  gsize mux_len;
+  if (!scan_literal_str(scan, "<mux name=\"") ||
+      !scan_until(scan, '"', &mux, &mux_len) || !scan_literal_str(scan, ">") ||
+      !is_plain_text(mux, mux_len)) {
+    return FALSE;
+  }
+
+  /* transmitters of filtered out MUXes are still scanned, as anything
+   * unexpected in them must still result in falling back to GMarkup. */
+  const gboolean skip_mux = !mux_filter_accepts_mux(filter, mux, mux_len);
+  gchar *const mux_name = skip_mux ? NULL : g_strndup(mux, mux_len);
+  gboolean rv = FALSE;
+  for (;;) {
+    scan_skip_whitespace(scan);
+    if (scan_literal_str(scan, "</mux>")) {
+      rv = TRUE;
+      break;
+    }
+
+    struct fast_transmitter transmitter;
+    if (!scan_literal_str(scan, "<transmitter>") ||
+        !scan_transmitter(scan, &transmitter)) {
+      break;
+    }
+
+    struct mux_params *const muxparm = &transmitter.muxparm;
+    if (!skip_mux &&
+        mux_filter_accepts_distance(filter, muxparm->distance) &&
+        mux_filter_accepts_delsys(filter, muxparm->tune_parms.dvb_type)) {
+      if (transmitter.name) {
+        muxparm->name = g_strndup(transmitter.name, transmitter.name_len);
+      }
+      mux_data_append_transmitter(md, mux_name, muxparm);
+    }
+  }
+  g_free(mux_name);
+  return rv;
+}
+
+static MuxData *scan_muxdata(const gchar *data, gsize len,
+                             const struct mux_filter *filter) {
+  struct fast_scanner scan = {.pos = data, .end = data + len};
+  MuxData *md = mux_data_new();
+  gboolean empty = TRUE;
+
+  for (;;) {
+    scan_skip_whitespace(&scan);
+    if (scan.pos == scan.end) {
+      break;
+    }
+    if (!scan_mux(&scan, md, filter)) {
+      goto fail;
+    }
+    empty = FALSE;
+  }
+
+  /* GMarkup treats an empty document as an error, so let it report that. */
+  if (empty) {
+    goto fail;
+  }
+
+  mux_data_sort_transmitters(md);
+  return md;
+
+fail:
+  mux_data_destroy(md);
+  return NULL;
+}
+
+struct memory_read_ctx {
+  const gchar *const data;
+  const gsize len;
+  gsize pos;
+};
+
+static gssize read_from_memory(guint8 *buf, gsize bufsiz, void *ctx) {
+  struct memory_read_ctx *const readctx = ctx;
+  const gsize left = readctx->len - readctx->pos;
+  const gsize to_copy = (left > bufsiz) ? bufsiz : left;
+  memcpy(buf, readctx->data + readctx->pos, to_copy);
+  readctx->pos += to_copy;
+  return to_copy;
+}
+
+MuxData *deserialize_muxdata_from_memory(const gchar *data, gsize len,
+                                         const struct mux_filter *filter,
+                                         GError **error) {
+  MuxData *const md = scan_muxdata(data, len, filter);
+  if (md) {
+    return md;
+  }
+
+  struct memory_read_ctx ctx = {.data = data, .len = len, .pos = 0};
+  return deserialize_muxdata_hash(read_from_memory, &ctx, filter, error);
+}
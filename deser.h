@@ -9,7 +9,16 @@ void serialize_muxdata_hash(MuxData *muxdata,
                             void (*savefn)(const guint8 *, gssize, void *),
                             void *savefn_ctx);
 
+/* transmitters not accepted by the filter are skipped while parsing. */
 MuxData *deserialize_muxdata_hash(gssize (*readfn)(guint8 *, gsize, void *),
-                                  void *readfn_ctx, GError **error);
+                                  void *readfn_ctx,
+                                  const struct mux_filter *filter,
+                                  GError **error);
+
+/* same as deserialize_muxdata_hash(), but reads directly from a buffer which
+ * usually is a mapping of the whole file. */
+MuxData *deserialize_muxdata_from_memory(const gchar *data, gsize len,
+                                         const struct mux_filter *filter,
+                                         GError **error);
 
 #endif
@@ -0,0 +1,155 @@
+#include "diskspace.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+/* written in chunks of this size. */
+#define DISK_PROBE_CHUNK (1024 * 1024)
+
+gboolean disk_query(const gchar *dir, struct disk_info *info,
+                    GError **error) {
+  struct stat st;
+  struct statvfs vfs;
+  if (stat(dir, &st) != 0 || statvfs(dir, &vfs) != 0) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not query the filesystem of %s : %s", dir,
+                g_strerror(errsv));
+    return FALSE;
+  }
+  info->fs_id = (guint64)st.st_dev;
+  info->free_bytes = (guint64)vfs.f_bavail * vfs.f_frsize;
+  return TRUE;
+}
+
+guint64 disk_measure_write_rate(const gchar *dir, GError **error) {
+  gchar *const path = g_build_filename(dir, ".get-pl-mux-probe-XXXXXX", NULL);
+  const int fd = g_mkstemp(path);
+  if (fd < 0) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not create %s : %s", path, g_strerror(errsv));
+    g_free(path);
+    return 0;
+  }
+  /* so that nothing is left behind whatever happens. */
+  g_unlink(path);
+
+  /* not zeroes, in case the filesystem compresses. */
+  guint8 *const chunk = g_malloc(DISK_PROBE_CHUNK);
+  for (gsize i = 0; i < DISK_PROBE_CHUNK; ++i) {
+    chunk[i] = (guint8)g_random_int();
+  }
+  const gint64 start_us = g_get_monotonic_time();
+  gboolean ok = TRUE;
+  for (guint i = 0; ok && i < DISK_PROBE_BYTES / DISK_PROBE_CHUNK; ++i) {
+    ok = write(fd, chunk, DISK_PROBE_CHUNK) == DISK_PROBE_CHUNK;
+  }
+  ok = ok && fsync(fd) == 0;
+  const gint64 elapsed_us = g_get_monotonic_time() - start_us;
+
+  guint64 rate = 0;
+  if (ok) {
+    rate = (guint64)DISK_PROBE_BYTES * G_USEC_PER_SEC / MAX(elapsed_us, 1);
+  } else {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", path, g_strerror(errsv));
+  }
+  g_close(fd, NULL);
+  g_free(chunk);
+  g_free(path);
+  return rate;
+}
+
+guint64 capture_estimate_size(guint64 bitrate, guint duration_s) {
+  const guint64 size = bitrate / 8 * duration_s;
+  return size + size / 8;
+}
+
+gboolean disk_has_room(guint64 free_bytes, guint64 size) {
+  return free_bytes >= DISK_RESERVE_BYTES &&
+         free_bytes - DISK_RESERVE_BYTES >= size;
+}
+
+struct fs_state {
+  guint64 fs_id;
+  /* 0 if unknown */
+  guint64 write_rate;
+  guint num_writers;
+  /* of the captures being written */
+  guint64 reserved;
+  guint64 byte_rate;
+};
+
+struct DiskAdmission_ {
+  /* fs_id -> struct fs_state, which holds the key */
+  GHashTable *filesystems;
+};
+
+DiskAdmission *disk_admission_new(void) {
+  DiskAdmission *const adm = g_new(DiskAdmission, 1);
+  adm->filesystems =
+      g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+  return adm;
+}
+
+void disk_admission_destroy(DiskAdmission *adm) {
+  g_hash_table_destroy(adm->filesystems);
+  g_free(adm);
+}
+
+static struct fs_state *get_fs_state(DiskAdmission *adm, guint64 fs_id) {
+  struct fs_state *fs = g_hash_table_lookup(adm->filesystems, &fs_id);
+  if (!fs) {
+    fs = g_new0(struct fs_state, 1);
+    fs->fs_id = fs_id;
+    g_hash_table_insert(adm->filesystems, &fs->fs_id, fs);
+  }
+  return fs;
+}
+
+void disk_admission_set_write_rate(DiskAdmission *adm, guint64 fs_id,
+                                   guint64 write_rate) {
+  get_fs_state(adm, fs_id)->write_rate = write_rate;
+}
+
+enum disk_verdict disk_admission_request(DiskAdmission *adm,
+                                         const struct disk_info *info,
+                                         guint64 size, guint64 byte_rate,
+                                         struct disk_writer *writer) {
+  struct fs_state *const fs = get_fs_state(adm, info->fs_id);
+  /* what the ones being written have already taken is counted twice, which
+   * errs on the safe side. */
+  const guint64 free_bytes =
+      info->free_bytes > fs->reserved ? info->free_bytes - fs->reserved : 0;
+  if (!disk_has_room(free_bytes, size)) {
+    return fs->num_writers > 0 ? DISK_WAIT : DISK_FULL;
+  }
+  if (fs->num_writers > 0 && fs->write_rate > 0 &&
+      (fs->byte_rate + byte_rate) * 100 >
+          fs->write_rate * DISK_WRITE_HEADROOM_PCT) {
+    return DISK_WAIT;
+  }
+
+  ++fs->num_writers;
+  fs->reserved += size;
+  fs->byte_rate += byte_rate;
+  writer->fs_id = info->fs_id;
+  writer->size = size;
+  writer->byte_rate = byte_rate;
+  return DISK_ADMIT;
+}
+
+void disk_admission_release(DiskAdmission *adm,
+                            const struct disk_writer *writer) {
+  struct fs_state *const fs = get_fs_state(adm, writer->fs_id);
+  g_return_if_fail(fs->num_writers > 0);
+  --fs->num_writers;
+  fs->reserved -= writer->size;
+  fs->byte_rate -= writer->byte_rate;
+}
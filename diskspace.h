@@ -0,0 +1,85 @@
+#ifndef GETPLMUX_DISKSPACE_H
+#define GETPLMUX_DISKSPACE_H
+
+#include <glib.h>
+
+/* where the captures are written. */
+#define DISK_CAPTURE_DIR "."
+
+/* what's left free on top of the estimated size of every capture, for the
+ * cache, the logs and everything else on the filesystem. */
+#define DISK_RESERVE_BYTES (64 * 1024 * 1024)
+
+/* how much is written to measure how fast the filesystem takes writes. */
+#define DISK_PROBE_BYTES (8 * 1024 * 1024)
+
+/* the share of the measured write rate the captures may take together, in
+ * percent, so that the writes don't fall behind the DVR reads. */
+#define DISK_WRITE_HEADROOM_PCT 75
+
+struct disk_info {
+  /* tells the filesystems apart */
+  guint64 fs_id;
+  /* as much as an unprivileged user may use */
+  guint64 free_bytes;
+};
+
+/* about the filesystem dir is on. */
+gboolean disk_query(const gchar *dir, struct disk_info *info, GError **error);
+
+/* writes DISK_PROBE_BYTES to a temporary file in dir and syncs it, returning
+ * how many bytes per second that took, or 0 on failure. */
+guint64 disk_measure_write_rate(const gchar *dir, GError **error);
+
+/* the size of a capture of a stream with the given bitrate in bits per
+ * second, with a margin for the bitrate not being quite what it was. */
+guint64 capture_estimate_size(guint64 bitrate, guint duration_s);
+
+/* whether there's room for a capture of the given size, leaving
+ * DISK_RESERVE_BYTES free. */
+gboolean disk_has_room(guint64 free_bytes, guint64 size);
+
+/* keeps track of the captures being written to every filesystem, so that
+ * a capture is only started when there's room for it and the filesystem
+ * can keep up with it on top of the ones already being written. */
+typedef struct DiskAdmission_ DiskAdmission;
+
+enum disk_verdict {
+  DISK_ADMIT,
+  /* there may be once some of the captures being written finish */
+  DISK_WAIT,
+  /* there won't be, however long it waits */
+  DISK_FULL,
+};
+
+/* a capture being written, as handed out by disk_admission_request(). */
+struct disk_writer {
+  guint64 fs_id;
+  guint64 size;
+  guint64 byte_rate;
+};
+
+DiskAdmission *disk_admission_new(void);
+void disk_admission_destroy(DiskAdmission *adm);
+
+/* the write rate of a filesystem in bytes per second. the ones it isn't
+ * known for take any number of captures. */
+void disk_admission_set_write_rate(DiskAdmission *adm, guint64 fs_id,
+                                   guint64 write_rate);
+
+/* whether a capture of the given size and rate in bytes per second can be
+ * written to the filesystem described by info, which should be up to date,
+ * as the captures which are already done only count towards what's used
+ * through it. the space the ones being written are yet to take is counted
+ * as their whole estimated size. the first capture on a filesystem is
+ * always admitted if there's room for it. writer is filled in if it is. */
+enum disk_verdict disk_admission_request(DiskAdmission *adm,
+                                         const struct disk_info *info,
+                                         guint64 size, guint64 byte_rate,
+                                         struct disk_writer *writer);
+
+/* when the capture is done, whether it succeeded or not. */
+void disk_admission_release(DiskAdmission *adm,
+                            const struct disk_writer *writer);
+
+#endif
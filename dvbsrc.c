@@ -0,0 +1,41 @@
+#include "dvbsrc.h"
+
+void dvbsrc_set_extra_params(GstElement *dvbsrc,
+                             const GstStructure *extra_params) {
+  for (gint i = 0; i < gst_structure_n_fields(extra_params); ++i) {
+    const gchar *fieldname = gst_structure_nth_field_name(extra_params, i);
+    const GValue *const value =
+        gst_structure_get_value(extra_params, fieldname);
+    g_object_set_property(G_OBJECT(dvbsrc), fieldname, value);
+  }
+}
+
+void dvbsrc_override_params(GstElement *dvbsrc, const GstStructure *params,
+                            GstStructure *saved) {
+  for (gint i = 0; i < gst_structure_n_fields(params); ++i) {
+    const gchar *fieldname = gst_structure_nth_field_name(params, i);
+    GParamSpec *const pspec =
+        g_object_class_find_property(G_OBJECT_GET_CLASS(dvbsrc), fieldname);
+    /* setting it complains about the unknown ones. */
+    if (pspec && !gst_structure_has_field(saved, fieldname)) {
+      GValue value = G_VALUE_INIT;
+      g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+      g_object_get_property(G_OBJECT(dvbsrc), fieldname, &value);
+      gst_structure_take_value(saved, fieldname, &value);
+    }
+  }
+  dvbsrc_set_extra_params(dvbsrc, params);
+}
+
+void dvbsrc_restore_params(GstElement *dvbsrc, GstStructure *saved) {
+  dvbsrc_set_extra_params(dvbsrc, saved);
+  gst_structure_remove_all_fields(saved);
+}
+
+void dvbsrc_set_tune_params(GstElement *dvbsrc,
+                            const struct tune_params *params) {
+  const guint bw_hz = params->bw_mhz * 1000000;
+  const guint freq_hz = params->freq_khz * 1000;
+  g_object_set(dvbsrc, "bandwidth-hz", bw_hz, "delsys", params->dvb_type,
+               "frequency", freq_hz, "modulation", params->mod, NULL);
+}
@@ -0,0 +1,24 @@
+#ifndef GETPLMUX_DVBSRC_H
+#define GETPLMUX_DVBSRC_H
+
+#include <gst/gst.h>
+
+#include "tune_params.h"
+
+/* sets every field of the structure as a property of dvbsrc. */
+void dvbsrc_set_extra_params(GstElement *dvbsrc,
+                             const GstStructure *extra_params);
+
+/* like dvbsrc_set_extra_params(), but first keeps the value every property
+ * had in saved, unless it's there already, so that it can be put back with
+ * dvbsrc_restore_params() once whatever needed the params is done. */
+void dvbsrc_override_params(GstElement *dvbsrc, const GstStructure *params,
+                            GstStructure *saved);
+
+/* sets the properties back to the values kept in saved, and empties it. */
+void dvbsrc_restore_params(GstElement *dvbsrc, GstStructure *saved);
+
+void dvbsrc_set_tune_params(GstElement *dvbsrc,
+                            const struct tune_params *params);
+
+#endif
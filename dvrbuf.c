@@ -0,0 +1,97 @@
+#include "dvrbuf.h"
+
+#include "ts.h"
+
+guint64 dvr_default_bitrate(enum fe_delivery_system delsys) {
+  return delsys == SYS_DVBT2 ? DVR_DEFAULT_BITRATE_DVBT2
+                             : DVR_DEFAULT_BITRATE_DVBT;
+}
+
+static guint packets_for(guint64 bitrate, guint ms, guint min_size,
+                         guint max_size) {
+  const guint64 bytes = bitrate / 8 * ms / 1000;
+  const guint64 packets = (bytes + TS_PACKET_SIZE - 1) / TS_PACKET_SIZE;
+  return CLAMP(packets * TS_PACKET_SIZE, min_size, max_size);
+}
+
+void dvr_buffer_sizes_for_bitrate(guint64 bitrate,
+                                  struct dvr_buffer_sizes *sizes) {
+  sizes->buffer_size = packets_for(bitrate, DVR_BUFFER_MS, DVR_BUFFER_MIN_SIZE,
+                                   DVR_BUFFER_MAX_SIZE);
+  sizes->blocksize = packets_for(bitrate, DVR_BLOCK_MS, DVR_BLOCK_MIN_SIZE,
+                                 DVR_BLOCK_MAX_SIZE);
+}
+
+guint dvr_buffer_size_grow(guint buffer_size) {
+  return MIN(buffer_size * 2, DVR_BUFFER_MAX_SIZE);
+}
+
+struct DvrMonitor_ {
+  struct ts_splitter splitter;
+  struct ts_stats stats;
+  gint64 first_us;
+  guint64 bytes;
+  guint64 bitrate;
+  guint64 overruns;
+};
+
+DvrMonitor *dvr_monitor_new(void) {
+  DvrMonitor *const mon = g_new(DvrMonitor, 1);
+  dvr_monitor_start(mon);
+  return mon;
+}
+
+void dvr_monitor_destroy(DvrMonitor *mon) { g_free(mon); }
+
+void dvr_monitor_start(DvrMonitor *mon) {
+  ts_splitter_init(&mon->splitter);
+  ts_stats_init(&mon->stats);
+  mon->first_us = 0;
+  mon->bytes = 0;
+  mon->bitrate = 0;
+  mon->overruns = 0;
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  DvrMonitor *const mon = ctx;
+  struct ts_packet pkt;
+  if (ts_packet_parse(data, &pkt)) {
+    ts_stats_push(&mon->stats, &pkt);
+  }
+}
+
+gboolean dvr_monitor_push(DvrMonitor *mon, const guint8 *data, gsize len,
+                          gint64 now_us) {
+  /* an overrun loses whatever didn't fit between two reads, so it shows up
+   * as discontinuities in a single buffer without any transport errors. */
+  const guint64 cc_errors = mon->stats.cc_errors;
+  const guint64 transport_errors = mon->stats.transport_errors;
+  ts_splitter_push(&mon->splitter, data, len, on_packet, mon);
+  if (mon->stats.cc_errors > cc_errors &&
+      mon->stats.transport_errors == transport_errors) {
+    ++mon->overruns;
+  }
+
+  if (mon->bitrate > 0) {
+    return FALSE;
+  }
+  if (mon->first_us == 0) {
+    /* the first buffer has been sitting in the kernel for an unknown time,
+     * so it doesn't count. */
+    mon->first_us = now_us;
+    return FALSE;
+  }
+  mon->bytes += len;
+  const gint64 elapsed_us = now_us - mon->first_us;
+  if (elapsed_us < (gint64)DVR_MEASURE_S * G_USEC_PER_SEC) {
+    return FALSE;
+  }
+  mon->bitrate = MAX(mon->bytes * 8 * G_USEC_PER_SEC / (guint64)elapsed_us, 1);
+  return TRUE;
+}
+
+guint64 dvr_monitor_get_bitrate(const DvrMonitor *mon) { return mon->bitrate; }
+
+guint64 dvr_monitor_get_overruns(const DvrMonitor *mon) {
+  return mon->overruns;
+}
@@ -0,0 +1,65 @@
+#ifndef GETPLMUX_DVRBUF_H
+#define GETPLMUX_DVRBUF_H
+
+#include <glib.h>
+
+#include "tune_params.h"
+
+/* sizes the kernel DVR buffer and the reads from it after the bitrate of the
+ * MUX, as dvbsrc's defaults are meant for low bitrates and overflow on busy
+ * machines with the high ones of DVB-T2. */
+struct dvr_buffer_sizes {
+  /* dvbsrc's dvb-buffer-size, which only applies when the device is opened */
+  guint buffer_size;
+  /* dvbsrc's blocksize, which can be changed while capturing */
+  guint blocksize;
+};
+
+/* how much of the stream the buffer and a single read should hold. */
+#define DVR_BUFFER_MS 1000
+#define DVR_BLOCK_MS 20
+
+/* the lower limit is dvbsrc's default. */
+#define DVR_BUFFER_MIN_SIZE (10 * 188 * 1024)
+#define DVR_BUFFER_MAX_SIZE (64 * 188 * 1024)
+#define DVR_BLOCK_MIN_SIZE (10 * 188)
+#define DVR_BLOCK_MAX_SIZE (1024 * 188)
+
+/* what's assumed for MUXes which were never captured before. */
+#define DVR_DEFAULT_BITRATE_DVBT 24000000
+#define DVR_DEFAULT_BITRATE_DVBT2 45000000
+
+/* how long to measure the bitrate for at the start of a capture. */
+#define DVR_MEASURE_S 3
+
+guint64 dvr_default_bitrate(enum fe_delivery_system delsys);
+
+/* both sizes are multiples of the packet size. */
+void dvr_buffer_sizes_for_bitrate(guint64 bitrate,
+                                  struct dvr_buffer_sizes *sizes);
+
+/* the buffer size to use after an overrun, which is the same if it can't
+ * be made any bigger. */
+guint dvr_buffer_size_grow(guint buffer_size);
+
+/* measures the bitrate at the start of a capture and watches for packets
+ * going missing without the frontend flagging any errors, which is what an
+ * overrun of the DVR buffer looks like. */
+typedef struct DvrMonitor_ DvrMonitor;
+
+DvrMonitor *dvr_monitor_new(void);
+void dvr_monitor_destroy(DvrMonitor *mon);
+
+/* forgets everything about the previous capture. */
+void dvr_monitor_start(DvrMonitor *mon);
+
+/* returns TRUE once, when DVR_MEASURE_S have passed since the first buffer
+ * and the bitrate is known. now_us is monotonic time. */
+gboolean dvr_monitor_push(DvrMonitor *mon, const guint8 *data, gsize len,
+                          gint64 now_us);
+
+/* 0 until it's been measured. */
+guint64 dvr_monitor_get_bitrate(const DvrMonitor *mon);
+guint64 dvr_monitor_get_overruns(const DvrMonitor *mon);
+
+#endif
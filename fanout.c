@@ -0,0 +1,46 @@
+#include "fanout.h"
+
+/* about a second of a MUX with dvbsrc's default blocksize, which is the
+ * most a reader can fall behind before it starts losing data. */
+#define FANOUT_QUEUE_BUFFERS 64
+
+static void discard_element(GstElement *element) {
+  if (element) {
+    gst_object_unref(gst_object_ref_sink(element));
+  }
+}
+
+gboolean shm_fanout_link(GstBin *bin, GstElement *src, GstElement *sink,
+                         const gchar *socket_path) {
+  GstElement *const tee = gst_element_factory_make("tee", NULL);
+  GstElement *const queue = gst_element_factory_make("queue", NULL);
+  GstElement *const shmsink = gst_element_factory_make("shmsink", NULL);
+  if (!tee || !queue || !shmsink) {
+    g_printerr("Failed to create the elements publishing the capture.\n"
+               "Make sure you have gst-plugins-bad installed.\n");
+    goto fail;
+  }
+
+  /* the sink still gets the buffers on dvbsrc's streaming thread, so that
+   * writing the capture works the same as without the readers. */
+  g_object_set(tee, "allow-not-linked", TRUE, NULL);
+  g_object_set(queue, "leaky", 2 /* downstream */, "max-size-buffers",
+               FANOUT_QUEUE_BUFFERS, "max-size-bytes", 0, "max-size-time",
+               (guint64)0, NULL);
+  g_object_set(shmsink, "socket-path", socket_path, "wait-for-connection",
+               FALSE, "sync", FALSE, "async", FALSE, NULL);
+
+  gst_bin_add_many(bin, tee, queue, shmsink, NULL);
+  if (!gst_element_link(src, tee) || !gst_element_link(tee, sink) ||
+      !gst_element_link_many(tee, queue, shmsink, NULL)) {
+    g_printerr("Failed to link the elements publishing the capture.\n");
+    return FALSE;
+  }
+  return TRUE;
+
+fail:
+  discard_element(tee);
+  discard_element(queue);
+  discard_element(shmsink);
+  return FALSE;
+}
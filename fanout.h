@@ -0,0 +1,15 @@
+#ifndef GETPLMUX_FANOUT_H
+#define GETPLMUX_FANOUT_H
+
+#include <gst/gst.h>
+
+/* links src to sink through a tee which also hands every buffer to a
+ * shmsink listening on the given socket, so that any number of local
+ * readers can follow the capture with shmsrc. the readers sit behind a
+ * leaky queue, so that a slow one loses data instead of holding up the
+ * sink. the elements are added to the bin, which src and sink have to be
+ * in already. */
+gboolean shm_fanout_link(GstBin *bin, GstElement *src, GstElement *sink,
+                         const gchar *socket_path);
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <curl/curl.h>
 
+#include "parser.h"
+
 static size_t write_callback(char *ptr, size_t size, size_t nmemb,
                              void *userdata) {
   const size_t realsiz = size * nmemb;
@@ -25,6 +27,8 @@ static GString *do_fetch(const char *url, gsize init_size, CURLcode *err,
   curl_easy_setopt(curl, CURLOPT_URL, url);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, content);
+  /* fetches can happen on several threads at once in batch mode. */
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
   if (handle_init != NULL) {
     handle_init(curl, handle_init_ctx);
   }
@@ -62,3 +66,78 @@ GString *fetch_tune_params_html(CURLcode *err) {
   return do_fetch("http://sat-charts.eu/dvb-t.php", 512 * 1024, err, NULL,
                   NULL);
 }
+
+GString *fetch_transmitter_info_html(const char *href, CURLcode *err) {
+  if (g_str_has_prefix(href, "http://") || g_str_has_prefix(href, "https://")) {
+    return do_fetch(href, 16 * 1024, err, NULL, NULL);
+  }
+
+  /* the links on the site are relative to its root. */
+  while (*href == '/') {
+    ++href;
+  }
+  gchar *const url = g_strconcat("http://sat-charts.eu/", href, NULL);
+  GString *const content = do_fetch(url, 16 * 1024, err, NULL, NULL);
+  g_free(url);
+  return content;
+}
+
+struct tune_params_fetch {
+  const struct mux_filter *filter;
+  TuneParamsIndex *index;
+  CURLcode err;
+};
+
+static gpointer fetch_tune_params_index(gpointer data) {
+  struct tune_params_fetch *const fetch = data;
+  GString *const content = fetch_tune_params_html(&fetch->err);
+  if (content) {
+    fetch->index = parse_tune_params_index(content->str, (int)content->len,
+                                           fetch->filter);
+    g_string_free(content, TRUE);
+  }
+  return fetch;
+}
+
+MuxData *fetch_muxdata(double lat, double lon,
+                       const struct mux_filter *filter) {
+  /* the complete list is about ten times larger than the location-based one,
+   * and only needs to be merged with it at the very end, so it's fetched and
+   * parsed on a separate thread into its own index. */
+  struct tune_params_fetch tune_params = {
+      .filter = filter, .index = NULL, .err = CURLE_OK};
+  GThread *const worker =
+      parser_is_thread_safe()
+          ? g_thread_new("tune-params", fetch_tune_params_index, &tune_params)
+          : NULL;
+
+  CURLcode err;
+  MuxData *parsed = NULL;
+  GString *const content = fetch_mux_data_for_location(lat, lon, &err);
+  if (content) {
+    parsed =
+        parse_mux_params_from_html(content->str, (int)content->len, filter);
+    g_string_free(content, TRUE);
+  } else {
+    g_printerr("Could not obtain location-based transmitter list : %s\n",
+               curl_easy_strerror(err));
+  }
+
+  if (worker) {
+    g_thread_join(worker);
+  } else if (parsed) {
+    fetch_tune_params_index(&tune_params);
+  }
+
+  if (parsed && !tune_params.index) {
+    g_printerr("Could not obtain complete transmitter list : %s\n",
+               curl_easy_strerror(tune_params.err));
+    g_clear_pointer(&parsed, mux_data_destroy);
+  }
+
+  if (parsed) {
+    tune_params_index_apply(tune_params.index, parsed);
+  }
+  g_clear_pointer(&tune_params.index, tune_params_index_destroy);
+  return parsed;
+}
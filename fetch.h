@@ -4,7 +4,18 @@
 #include <curl/curl.h>
 #include <glib.h>
 
+#include "muxdata.h"
+
 GString *fetch_mux_data_for_location(double lat, double lon, CURLcode *err);
 GString *fetch_tune_params_html(CURLcode *err);
 
+/* fetches the page of a single transmitter, as linked to by
+ * mux_params.info_html. */
+GString *fetch_transmitter_info_html(const char *href, CURLcode *err);
+
+/* fetches and parses both lists for the location, with the tune params of the
+ * complete one merged in. NULL if either couldn't be fetched, after saying
+ * why. a NULL filter loads everything, including info_html. */
+MuxData *fetch_muxdata(double lat, double lon, const struct mux_filter *filter);
+
 #endif
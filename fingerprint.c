@@ -0,0 +1,155 @@
+#include "fingerprint.h"
+
+#include "ts.h"
+
+#define TABLE_ID_PAT 0x00
+#define TABLE_ID_PMT 0x02
+#define TABLE_ID_NIT_ACTUAL 0x40
+#define TABLE_ID_SDT_ACTUAL 0x42
+
+struct CaptureFingerprint_ {
+  struct ts_splitter splitter;
+  TsSectionAssembler *assembler;
+  /* (PID, table_id, table_id_extension, section_number) -> CRC of the
+   * latest version */
+  GHashTable *sections;
+  gboolean has_pat;
+};
+
+static gint64 section_key(guint16 pid, const struct ts_section_header *hdr) {
+  return ((gint64)pid << 40) | ((gint64)hdr->table_id << 32) |
+         ((gint64)hdr->table_id_extension << 16) | hdr->section_number;
+}
+
+static void on_pat(CaptureFingerprint *fp, const guint8 *section, gsize len) {
+  for (gsize pos = TS_LONG_SECTION_HEADER_SIZE; pos + 4 + 4 <= len;
+       pos += 4) {
+    /* program 0 is the NIT */
+    if (ts_read_u16(section + pos) != 0) {
+      ts_section_assembler_add_pid(fp->assembler,
+                                   ts_read_u16(section + pos + 2) & 0x1fff);
+    }
+  }
+  fp->has_pat = TRUE;
+}
+
+static void on_section(guint16 pid, const guint8 *section, gsize len,
+                       void *ctx) {
+  CaptureFingerprint *const fp = ctx;
+  struct ts_section_header hdr;
+  if (!ts_section_parse_header(section, len, &hdr) || !hdr.current_next) {
+    return;
+  }
+  switch (hdr.table_id) {
+  case TABLE_ID_PAT:
+    if (pid != TS_PID_PAT) {
+      return;
+    }
+    on_pat(fp, section, len);
+    break;
+  case TABLE_ID_PMT:
+  case TABLE_ID_NIT_ACTUAL:
+  case TABLE_ID_SDT_ACTUAL:
+    break;
+  default:
+    return;
+  }
+  const gint64 key = section_key(pid, &hdr);
+  g_hash_table_insert(fp->sections, g_memdup2(&key, sizeof(key)),
+                      GUINT_TO_POINTER(ts_read_u32(section + len - 4)));
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  CaptureFingerprint *const fp = ctx;
+  struct ts_packet pkt;
+  if (ts_packet_parse(data, &pkt)) {
+    ts_section_assembler_push(fp->assembler, &pkt);
+  }
+}
+
+CaptureFingerprint *capture_fingerprint_new(void) {
+  CaptureFingerprint *const fp = g_new(CaptureFingerprint, 1);
+  ts_splitter_init(&fp->splitter);
+  fp->assembler = ts_section_assembler_new(on_section, fp);
+  ts_section_assembler_add_pid(fp->assembler, TS_PID_PAT);
+  ts_section_assembler_add_pid(fp->assembler, TS_PID_NIT);
+  ts_section_assembler_add_pid(fp->assembler, TS_PID_SDT);
+  fp->sections =
+      g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+  fp->has_pat = FALSE;
+  return fp;
+}
+
+void capture_fingerprint_destroy(CaptureFingerprint *fp) {
+  ts_section_assembler_destroy(fp->assembler);
+  g_hash_table_destroy(fp->sections);
+  g_free(fp);
+}
+
+void capture_fingerprint_push(CaptureFingerprint *fp, const guint8 *data,
+                              gsize len) {
+  ts_splitter_push(&fp->splitter, data, len, on_packet, fp);
+}
+
+static gint by_key_cmpfn(gconstpointer a, gconstpointer b) {
+  const gint64 kA = *(const gint64 *)a, kB = *(const gint64 *)b;
+  return kA < kB ? -1 : kA > kB;
+}
+
+gchar *capture_fingerprint_get_digest(const CaptureFingerprint *fp) {
+  if (!fp->has_pat) {
+    return NULL;
+  }
+  /* the order the sections came in differs between captures. */
+  GArray *const keys = g_array_sized_new(
+      FALSE, FALSE, sizeof(gint64), g_hash_table_size(fp->sections));
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, fp->sections);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    g_array_append_val(keys, *(const gint64 *)key);
+  }
+  g_array_sort(keys, by_key_cmpfn);
+
+  GChecksum *const checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  for (guint i = 0; i < keys->len; ++i) {
+    const gint64 k = g_array_index(keys, gint64, i);
+    const guint32 crc =
+        GPOINTER_TO_UINT(g_hash_table_lookup(fp->sections, &k));
+    guint8 record[12];
+    for (int j = 0; j < 8; ++j) {
+      record[j] = (guint8)((guint64)k >> (56 - 8 * j));
+    }
+    for (int j = 0; j < 4; ++j) {
+      record[8 + j] = (guint8)(crc >> (24 - 8 * j));
+    }
+    g_checksum_update(checksum, record, sizeof(record));
+  }
+  gchar *const digest = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+  g_array_unref(keys);
+  return digest;
+}
+
+void mux_capture_clear(struct mux_capture *capture) {
+  g_clear_pointer(&capture->path, g_free);
+  g_clear_pointer(&capture->fingerprint, g_free);
+}
+
+const struct mux_capture *mux_captures_find_original(const GArray *captures,
+                                                     guint idx) {
+  const struct mux_capture *const capture =
+      &g_array_index(captures, struct mux_capture, idx);
+  if (capture->complete || !capture->fingerprint) {
+    return NULL;
+  }
+  for (guint i = 0; i < captures->len; ++i) {
+    const struct mux_capture *const other =
+        &g_array_index(captures, struct mux_capture, i);
+    if (other->complete &&
+        g_strcmp0(other->fingerprint, capture->fingerprint) == 0) {
+      return other;
+    }
+  }
+  return NULL;
+}
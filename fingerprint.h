@@ -0,0 +1,42 @@
+#ifndef GETPLMUX_FINGERPRINT_H
+#define GETPLMUX_FINGERPRINT_H
+
+#include <glib.h>
+
+/* tells captures of the same transport stream apart from different ones,
+ * e.g. the transmitters of a single frequency network, which broadcast the
+ * very same stream, from regional variants of a MUX. the PAT, the PMTs and
+ * the NIT and SDT of the stream itself are hashed, keeping the CRC of the
+ * latest version of every section. the rest of the stream isn't, as two
+ * captures of the same transport stream made one after the other never
+ * carry the same audio and video. */
+typedef struct CaptureFingerprint_ CaptureFingerprint;
+
+CaptureFingerprint *capture_fingerprint_new(void);
+void capture_fingerprint_destroy(CaptureFingerprint *fp);
+
+/* feeds the captured stream, which doesn't need to be aligned to packet
+ * boundaries. */
+void capture_fingerprint_push(CaptureFingerprint *fp, const guint8 *data,
+                              gsize len);
+
+/* the hex digest of what was seen so far, NULL if no PAT was. */
+gchar *capture_fingerprint_get_digest(const CaptureFingerprint *fp);
+
+/* a capture written while trying the transmitters of a MUX. */
+struct mux_capture {
+  gchar *path;
+  /* NULL if it's not known */
+  gchar *fingerprint;
+  /* whether it ran for as long as it should have */
+  gboolean complete;
+};
+
+void mux_capture_clear(struct mux_capture *capture);
+
+/* the complete capture which makes the incomplete one at idx redundant, as
+ * it's of the same transport stream, NULL if there's none. */
+const struct mux_capture *mux_captures_find_original(const GArray *captures,
+                                                     guint idx);
+
+#endif
@@ -0,0 +1,220 @@
+#include "flowstats.h"
+
+#include <math.h>
+#include <string.h>
+
+/* single producer, single consumer. head and tail count the samples ever
+ * written and collected, wrapping around, which FLOW_RING_SIZE being a power
+ * of 2 makes harmless. */
+struct flow_ring {
+  /* only written by the thread owning the ring */
+  gint head;
+  gint64 last_arrival_us;
+  /* the recorder's epoch last_arrival_us is from */
+  gint epoch;
+  /* set once the thread is gone, after which the ring is freed as soon as
+   * it's been collected */
+  gint orphaned;
+  /* only written by the collector */
+  gint tail;
+  gint dropped;
+  struct flow_sample samples[FLOW_RING_SIZE];
+};
+
+G_STATIC_ASSERT((FLOW_RING_SIZE & (FLOW_RING_SIZE - 1)) == 0);
+
+struct FlowRecorder_ {
+  guint id;
+  /* bumped by flow_recorder_reset(), starts at 1 */
+  gint epoch;
+  GMutex lock;
+  /* struct flow_ring, one for every thread which pushed something */
+  GPtrArray *rings;
+};
+
+/* the ring of the current thread. recorder ids are never reused, so a ring
+ * belonging to a recorder which is gone is never looked at. */
+struct thread_ring {
+  guint recorder_id;
+  struct flow_ring *ring;
+};
+
+/* id -> FlowRecorder, so that a thread going away can find out whether
+ * the recorder its ring belongs to is still there. */
+static GMutex recorders_lock;
+static GHashTable *recorders;
+
+/* the ring is left to the recorder, which frees it once it's collected. */
+static void thread_ring_release(struct thread_ring *tr) {
+  g_mutex_lock(&recorders_lock);
+  FlowRecorder *const rec =
+      recorders ? g_hash_table_lookup(recorders,
+                                      GUINT_TO_POINTER(tr->recorder_id))
+                : NULL;
+  if (rec) {
+    g_atomic_int_set(&tr->ring->orphaned, TRUE);
+  }
+  g_mutex_unlock(&recorders_lock);
+}
+
+static void thread_ring_free(gpointer p) {
+  thread_ring_release(p);
+  g_free(p);
+}
+
+static GPrivate thread_ring_key = G_PRIVATE_INIT(thread_ring_free);
+static gint next_recorder_id = 1;
+
+FlowRecorder *flow_recorder_new(void) {
+  FlowRecorder *const rec = g_new(FlowRecorder, 1);
+  rec->id = (guint)g_atomic_int_add(&next_recorder_id, 1);
+  rec->epoch = 1;
+  g_mutex_init(&rec->lock);
+  rec->rings = g_ptr_array_new_with_free_func(g_free);
+  g_mutex_lock(&recorders_lock);
+  if (!recorders) {
+    recorders = g_hash_table_new(NULL, NULL);
+  }
+  g_hash_table_insert(recorders, GUINT_TO_POINTER(rec->id), rec);
+  g_mutex_unlock(&recorders_lock);
+  return rec;
+}
+
+void flow_recorder_destroy(FlowRecorder *rec) {
+  g_mutex_lock(&recorders_lock);
+  g_hash_table_remove(recorders, GUINT_TO_POINTER(rec->id));
+  g_mutex_unlock(&recorders_lock);
+  g_ptr_array_unref(rec->rings);
+  g_mutex_clear(&rec->lock);
+  g_free(rec);
+}
+
+void flow_recorder_reset(FlowRecorder *rec) {
+  g_atomic_int_inc(&rec->epoch);
+}
+
+static struct flow_ring *get_thread_ring(FlowRecorder *rec) {
+  struct thread_ring *tr = g_private_get(&thread_ring_key);
+  if (tr && tr->recorder_id == rec->id) {
+    return tr->ring;
+  }
+  if (tr) {
+    thread_ring_release(tr);
+  } else {
+    tr = g_new(struct thread_ring, 1);
+    g_private_set(&thread_ring_key, tr);
+  }
+  tr->recorder_id = rec->id;
+  tr->ring = g_new0(struct flow_ring, 1);
+  g_mutex_lock(&rec->lock);
+  g_ptr_array_add(rec->rings, tr->ring);
+  g_mutex_unlock(&rec->lock);
+  return tr->ring;
+}
+
+void flow_recorder_push(FlowRecorder *rec, const struct flow_sample *sample) {
+  struct flow_ring *const ring = get_thread_ring(rec);
+  /* the interval is kept right even if the sample itself is dropped. */
+  const gint epoch = g_atomic_int_get(&rec->epoch);
+  const gint64 interval_us = ring->epoch == epoch
+                                 ? sample->arrival_us - ring->last_arrival_us
+                                 : 0;
+  ring->last_arrival_us = sample->arrival_us;
+  ring->epoch = epoch;
+
+  const guint head = (guint)ring->head;
+  if (head - (guint)g_atomic_int_get(&ring->tail) >= FLOW_RING_SIZE) {
+    g_atomic_int_inc(&ring->dropped);
+    return;
+  }
+  struct flow_sample *const slot = &ring->samples[head % FLOW_RING_SIZE];
+  *slot = *sample;
+  slot->interval_us = interval_us;
+  g_atomic_int_set(&ring->head, (gint)(head + 1));
+}
+
+static void summary_add(struct flow_summary *summary,
+                        const struct flow_sample *sample) {
+  ++summary->buffers;
+  summary->bytes += sample->size;
+  summary->size_max = MAX(summary->size_max, sample->size);
+  if (sample->latency_us >= 0) {
+    ++summary->latencies;
+    summary->latency_sum_us += sample->latency_us;
+    summary->latency_max_us = MAX(summary->latency_max_us, sample->latency_us);
+  }
+  summary->write_sum_us += sample->write_us;
+  summary->write_max_us = MAX(summary->write_max_us, sample->write_us);
+  if (sample->interval_us > 0) {
+    ++summary->intervals;
+    summary->interval_sum_us += sample->interval_us;
+    summary->interval_sum_sq +=
+        (gdouble)sample->interval_us * (gdouble)sample->interval_us;
+  }
+}
+
+void flow_recorder_collect(FlowRecorder *rec, struct flow_summary *summary) {
+  memset(summary, 0, sizeof(*summary));
+  g_mutex_lock(&rec->lock);
+  for (guint i = 0; i < rec->rings->len; ++i) {
+    struct flow_ring *const ring = g_ptr_array_index(rec->rings, i);
+    /* before the head, so that nothing pushed is missed. */
+    const gboolean orphaned = g_atomic_int_get(&ring->orphaned);
+    const guint head = (guint)g_atomic_int_get(&ring->head);
+    for (guint j = (guint)ring->tail; j != head; ++j) {
+      summary_add(summary, &ring->samples[j % FLOW_RING_SIZE]);
+    }
+    g_atomic_int_set(&ring->tail, (gint)head);
+    const gint dropped = g_atomic_int_get(&ring->dropped);
+    g_atomic_int_add(&ring->dropped, -dropped);
+    summary->dropped += (guint)dropped;
+    if (orphaned) {
+      g_ptr_array_remove_index_fast(rec->rings, i--);
+    }
+  }
+  g_mutex_unlock(&rec->lock);
+}
+
+static gdouble to_ms(gdouble us) { return us / 1000; }
+
+gchar *flow_summary_format(const struct flow_summary *summary,
+                           gint64 period_us) {
+  GString *const out = g_string_new(NULL);
+  const gdouble period_s = (gdouble)period_us / G_USEC_PER_SEC;
+  g_string_append_printf(out, "Flow over the last %.1f s : ", period_s);
+  if (summary->buffers == 0) {
+    g_string_append(out, "no buffers\n");
+  } else {
+    const gdouble buffers = (gdouble)summary->buffers;
+    g_string_append_printf(
+        out, "%" G_GUINT64_FORMAT " buffers, %.1f Mbit/s\n", summary->buffers,
+        period_s > 0 ? (gdouble)summary->bytes * 8 / period_s / 1000000 : 0);
+    g_string_append_printf(out,
+                           "  size       : avg %.0f bytes, max %u bytes\n",
+                           (gdouble)summary->bytes / buffers,
+                           summary->size_max);
+    if (summary->latencies > 0) {
+      g_string_append_printf(
+          out, "  latency    : avg %.1f ms, max %.1f ms\n",
+          to_ms((gdouble)summary->latency_sum_us / (gdouble)summary->latencies),
+          to_ms((gdouble)summary->latency_max_us));
+    }
+    g_string_append_printf(out, "  sink write : avg %.1f ms, max %.1f ms\n",
+                           to_ms((gdouble)summary->write_sum_us / buffers),
+                           to_ms((gdouble)summary->write_max_us));
+  }
+  if (summary->intervals > 0) {
+    const gdouble n = (gdouble)summary->intervals;
+    const gdouble mean = (gdouble)summary->interval_sum_us / n;
+    const gdouble variance = summary->interval_sum_sq / n - mean * mean;
+    g_string_append_printf(out, "  interval   : avg %.1f ms, jitter %.1f ms\n",
+                           to_ms(mean), to_ms(sqrt(MAX(variance, 0))));
+  }
+  if (summary->dropped > 0) {
+    g_string_append_printf(out,
+                           "  dropped    : %" G_GUINT64_FORMAT
+                           " samples which didn't fit into the rings\n",
+                           summary->dropped);
+  }
+  return g_string_free(out, FALSE);
+}
@@ -0,0 +1,66 @@
+#ifndef GETPLMUX_FLOWSTATS_H
+#define GETPLMUX_FLOWSTATS_H
+
+#include <glib.h>
+
+/* records how every buffer made its way from dvbsrc through the sink, so
+ * that buffers backing up during long captures can be told apart from the
+ * frontend delivering less. the samples go into a ring of its own for every
+ * thread pushing them, which needs no locking, and are summed up by
+ * whoever collects them every now and then. the ring of a thread which is
+ * gone is freed once it's been collected. */
+struct flow_sample {
+  /* monotonic, when the buffer left dvbsrc */
+  gint64 arrival_us;
+  /* since the previous buffer on the same thread, filled in when recorded
+   * and 0 for the first one */
+  gint64 interval_us;
+  /* from dvbsrc timestamping the buffer until the sink was done with it, -1
+   * if the buffer wasn't timestamped */
+  gint64 latency_us;
+  /* how long the sink took to write the buffer */
+  gint64 write_us;
+  guint32 size;
+};
+
+/* samples which don't fit are dropped until the ring is collected. */
+#define FLOW_RING_SIZE 4096
+
+struct flow_summary {
+  guint64 buffers;
+  guint64 bytes;
+  guint32 size_max;
+  /* the samples dropped because a ring was full */
+  guint64 dropped;
+  guint64 latencies;
+  gint64 latency_sum_us;
+  gint64 latency_max_us;
+  gint64 write_sum_us;
+  gint64 write_max_us;
+  guint64 intervals;
+  gint64 interval_sum_us;
+  /* for the standard deviation of the intervals, i.e. the jitter */
+  gdouble interval_sum_sq;
+};
+
+typedef struct FlowRecorder_ FlowRecorder;
+
+FlowRecorder *flow_recorder_new(void);
+/* no thread may be recording anymore. */
+void flow_recorder_destroy(FlowRecorder *rec);
+
+void flow_recorder_push(FlowRecorder *rec, const struct flow_sample *sample);
+
+/* forgets when the latest buffers came in, so that the first interval of a
+ * new capture doesn't cover the time spent tuning. may be called from any
+ * thread. */
+void flow_recorder_reset(FlowRecorder *rec);
+
+/* sums up and empties the rings of all threads. */
+void flow_recorder_collect(FlowRecorder *rec, struct flow_summary *summary);
+
+/* period_us is how long the summary covers, for the throughput. */
+gchar *flow_summary_format(const struct flow_summary *summary,
+                           gint64 period_us);
+
+#endif
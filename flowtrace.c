@@ -0,0 +1,93 @@
+#include "flowtrace.h"
+
+typedef struct {
+  GstTracer parent;
+  /* NULL once destroyed */
+  GstPad *pad;
+  FlowRecorder *rec;
+  /* the buffer being pushed, only ever touched by the streaming thread of
+   * the pad */
+  GstClockTime push_ts;
+  struct flow_sample sample;
+} FlowTracer;
+
+typedef struct {
+  GstTracerClass parent_class;
+} FlowTracerClass;
+
+G_DEFINE_TYPE(FlowTracer, flow_tracer, GST_TYPE_TRACER)
+
+static void flow_tracer_class_init(FlowTracerClass *klass) { (void)klass; }
+
+static void flow_tracer_init(FlowTracer *self) {
+  self->pad = NULL;
+  self->rec = NULL;
+}
+
+/* how long ago the buffer was timestamped by its source, -1 if it wasn't. */
+static gint64 get_buffer_age_us(GstPad *pad, GstBuffer *buf) {
+  const GstClockTime pts = GST_BUFFER_PTS(buf);
+  GstElement *const element = GST_PAD_PARENT(pad);
+  if (!GST_CLOCK_TIME_IS_VALID(pts) || !element) {
+    return -1;
+  }
+  GstClock *const clock = gst_element_get_clock(element);
+  if (!clock) {
+    return -1;
+  }
+  const GstClockTime running_time =
+      gst_clock_get_time(clock) - gst_element_get_base_time(element);
+  gst_object_unref(clock);
+  return running_time > pts ? (gint64)GST_TIME_AS_USECONDS(running_time - pts)
+                            : 0;
+}
+
+/* the timestamps are monotonic, from GStreamer's own clock. */
+static void on_pad_push_pre(GObject *self, GstClockTime ts, GstPad *pad,
+                            GstBuffer *buf) {
+  FlowTracer *const tracer = (FlowTracer *)self;
+  if (pad != tracer->pad) {
+    return;
+  }
+  tracer->push_ts = ts;
+  tracer->sample.arrival_us = (gint64)GST_TIME_AS_USECONDS(ts);
+  tracer->sample.latency_us = get_buffer_age_us(pad, buf);
+  tracer->sample.size = (guint32)gst_buffer_get_size(buf);
+}
+
+static void on_pad_push_post(GObject *self, GstClockTime ts, GstPad *pad,
+                             GstFlowReturn res) {
+  (void)res;
+
+  FlowTracer *const tracer = (FlowTracer *)self;
+  if (pad != tracer->pad) {
+    return;
+  }
+  /* nothing downstream runs on a thread of its own, so the push returns
+   * once the sink is done with the buffer. */
+  tracer->sample.write_us = (gint64)GST_TIME_AS_USECONDS(ts - tracer->push_ts);
+  if (tracer->sample.latency_us >= 0) {
+    tracer->sample.latency_us += tracer->sample.write_us;
+  }
+  flow_recorder_push(tracer->rec, &tracer->sample);
+}
+
+GstTracer *flow_tracer_new(GstPad *pad, FlowRecorder *rec) {
+  FlowTracer *const tracer = g_object_new(flow_tracer_get_type(), NULL);
+  gst_object_ref_sink(tracer);
+  tracer->pad = gst_object_ref(pad);
+  tracer->rec = rec;
+  gst_tracing_register_hook(GST_TRACER(tracer), "pad-push-pre",
+                            G_CALLBACK(on_pad_push_pre));
+  gst_tracing_register_hook(GST_TRACER(tracer), "pad-push-post",
+                            G_CALLBACK(on_pad_push_post));
+  return GST_TRACER(tracer);
+}
+
+void flow_tracer_destroy(GstTracer *tracer) {
+  FlowTracer *const self = (FlowTracer *)tracer;
+  g_clear_pointer(&self->pad, gst_object_unref);
+  self->rec = NULL;
+  /* the hooks keep their own reference. */
+  gst_object_unref(tracer);
+}
@@ -0,0 +1,16 @@
+#ifndef GETPLMUX_FLOWTRACE_H
+#define GETPLMUX_FLOWTRACE_H
+
+#include <gst/gst.h>
+
+#include "flowstats.h"
+
+/* a GStreamer tracer recording every buffer pushed from the given pad into
+ * the recorder, along with how long whatever is downstream of the pad took
+ * to deal with it. tracers can't be unhooked, so it keeps being called
+ * until GStreamer is shut down, and has to be destroyed once nothing is
+ * being pushed anymore and before the recorder is. */
+GstTracer *flow_tracer_new(GstPad *pad, FlowRecorder *rec);
+void flow_tracer_destroy(GstTracer *tracer);
+
+#endif
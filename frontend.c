@@ -0,0 +1,369 @@
+/* for O_NONBLOCK */
+#define _POSIX_C_SOURCE 200809L
+
+#include "frontend.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+#include <glib/gstdio.h>
+
+#define KEY_DEVICE "device"
+#define KEY_CHANGED "changed"
+#define KEY_NAME "name"
+#define KEY_DELSYS "delsys"
+
+static void dvb_frontend_clear(gpointer p) {
+  struct dvb_frontend *const fe = p;
+  g_free(fe->path);
+  g_free(fe->name);
+}
+
+static void add_delsys(struct dvb_frontend *fe, guint delsys) {
+  if (delsys < 64) {
+    fe->delsys_mask |= G_GUINT64_CONSTANT(1) << delsys;
+  }
+}
+
+gboolean dvb_frontend_supports(const struct dvb_frontend *fe,
+                               enum fe_delivery_system delsys) {
+  return delsys == SYS_UNDEFINED ||
+         ((guint)delsys < 64 &&
+          (fe->delsys_mask & (G_GUINT64_CONSTANT(1) << delsys)));
+}
+
+static const gchar *const delsys_names[] = {
+    [SYS_DVBC_ANNEX_A] = "DVB-C",  [SYS_DVBC_ANNEX_B] = "DVB-C/B",
+    [SYS_DVBT] = "DVB-T",          [SYS_DSS] = "DSS",
+    [SYS_DVBS] = "DVB-S",          [SYS_DVBS2] = "DVB-S2",
+    [SYS_DVBH] = "DVB-H",          [SYS_ISDBT] = "ISDB-T",
+    [SYS_ISDBS] = "ISDB-S",        [SYS_ISDBC] = "ISDB-C",
+    [SYS_ATSC] = "ATSC",           [SYS_ATSCMH] = "ATSC-MH",
+    [SYS_DTMB] = "DTMB",           [SYS_CMMB] = "CMMB",
+    [SYS_DAB] = "DAB",             [SYS_DVBT2] = "DVB-T2",
+    [SYS_TURBO] = "TURBO",         [SYS_DVBC_ANNEX_C] = "DVB-C/C"};
+
+gchar *dvb_frontend_describe_delsys(const struct dvb_frontend *fe) {
+  GString *const str = g_string_new(NULL);
+  for (guint i = 0; i < 64; ++i) {
+    if (!(fe->delsys_mask & (G_GUINT64_CONSTANT(1) << i))) {
+      continue;
+    }
+    if (str->len) {
+      g_string_append(str, ", ");
+    }
+    if (i < G_N_ELEMENTS(delsys_names) && delsys_names[i]) {
+      g_string_append(str, delsys_names[i]);
+    } else {
+      g_string_append_printf(str, "%u", i);
+    }
+  }
+  return g_string_free(str, FALSE);
+}
+
+const struct dvb_frontend *frontends_find(const GArray *frontends,
+                                          enum fe_delivery_system delsys) {
+  for (guint i = 0; i < frontends->len; ++i) {
+    const struct dvb_frontend *const fe =
+        &g_array_index(frontends, struct dvb_frontend, i);
+    if (dvb_frontend_supports(fe, delsys)) {
+      return fe;
+    }
+  }
+  return NULL;
+}
+
+static void add_delsys_from_type(struct dvb_frontend *fe,
+                                 const struct dvb_frontend_info *info) {
+  const gboolean gen2 = (info->caps & FE_CAN_2G_MODULATION) != 0;
+  switch (info->type) {
+  case FE_OFDM:
+    add_delsys(fe, SYS_DVBT);
+    if (gen2) {
+      add_delsys(fe, SYS_DVBT2);
+    }
+    break;
+  case FE_QAM:
+    add_delsys(fe, SYS_DVBC_ANNEX_A);
+    break;
+  case FE_QPSK:
+    add_delsys(fe, SYS_DVBS);
+    if (gen2) {
+      add_delsys(fe, SYS_DVBS2);
+    }
+    break;
+  case FE_ATSC:
+    add_delsys(fe, SYS_ATSC);
+    break;
+  default:
+    break;
+  }
+}
+
+gboolean frontend_probe_device(const gchar *path, struct dvb_frontend *fe,
+                               void *ctx) {
+  (void)ctx;
+  /* opening read-only is enough for querying, and works even while another
+   * process is using the frontend. */
+  const int fd = g_open(path, O_RDONLY | O_NONBLOCK, 0);
+  if (fd < 0) {
+    return FALSE;
+  }
+
+  gboolean rv = FALSE;
+  struct dvb_frontend_info info;
+  if (ioctl(fd, FE_GET_INFO, &info) != 0) {
+    goto beach;
+  }
+  fe->name = g_strndup(info.name, sizeof(info.name));
+
+  struct dtv_property prop = {.cmd = DTV_ENUM_DELSYS};
+  struct dtv_properties props = {.num = 1, .props = &prop};
+  if (ioctl(fd, FE_GET_PROPERTY, &props) == 0) {
+    const guint len = MIN(prop.u.buffer.len, sizeof(prop.u.buffer.data));
+    for (guint i = 0; i < len; ++i) {
+      add_delsys(fe, prop.u.buffer.data[i]);
+    }
+  } else {
+    /* DVB API older than 5.5 : all that's known is the type. */
+    add_delsys_from_type(fe, &info);
+  }
+  rv = TRUE;
+
+beach:
+  g_close(fd, NULL);
+  return rv;
+}
+
+static gboolean parse_numbered(const gchar *name, const gchar *prefix,
+                               guint *out) {
+  if (!g_str_has_prefix(name, prefix)) {
+    return FALSE;
+  }
+  guint64 num;
+  if (!g_ascii_string_to_unsigned(name + strlen(prefix), 10, 0, G_MAXUINT,
+                                  &num, NULL)) {
+    return FALSE;
+  }
+  *out = (guint)num;
+  return TRUE;
+}
+
+/* cached capabilities are only used if the device node is still the same,
+ * which is not the case after the device is replugged or its driver is
+ * reloaded. */
+static gboolean cache_lookup(GKeyFile *cache, const gchar *path,
+                             const GStatBuf *st, struct dvb_frontend *fe) {
+  GError *err = NULL;
+  const guint64 device = g_key_file_get_uint64(cache, path, KEY_DEVICE, &err);
+  const gint64 changed =
+      err ? 0 : g_key_file_get_int64(cache, path, KEY_CHANGED, &err);
+  gsize num_delsys = 0;
+  gint *const delsys =
+      err ? NULL
+          : g_key_file_get_integer_list(cache, path, KEY_DELSYS, &num_delsys,
+                                        &err);
+  gboolean rv = FALSE;
+  if (err || device != (guint64)st->st_rdev || changed != st->st_ctime) {
+    goto beach;
+  }
+
+  fe->name = g_key_file_get_string(cache, path, KEY_NAME, NULL);
+  for (gsize i = 0; i < num_delsys; ++i) {
+    if (delsys[i] >= 0) {
+      add_delsys(fe, (guint)delsys[i]);
+    }
+  }
+  rv = TRUE;
+
+beach:
+  g_clear_error(&err);
+  g_free(delsys);
+  return rv;
+}
+
+static void cache_store(GKeyFile *cache, const gchar *path,
+                        const GStatBuf *st, const struct dvb_frontend *fe) {
+  gint delsys[64];
+  gsize num_delsys = 0;
+  for (guint i = 0; i < 64; ++i) {
+    if (fe->delsys_mask & (G_GUINT64_CONSTANT(1) << i)) {
+      delsys[num_delsys++] = (gint)i;
+    }
+  }
+  g_key_file_set_uint64(cache, path, KEY_DEVICE, (guint64)st->st_rdev);
+  g_key_file_set_int64(cache, path, KEY_CHANGED, st->st_ctime);
+  g_key_file_set_string(cache, path, KEY_NAME, fe->name ? fe->name : "");
+  g_key_file_set_integer_list(cache, path, KEY_DELSYS, delsys, num_delsys);
+}
+
+static void discover_adapter(const gchar *adapter_path, guint adapter,
+                             GKeyFile *old_cache, GKeyFile *new_cache,
+                             gboolean *cache_dirty, frontend_probe_fn probe,
+                             void *probe_ctx, GArray *frontends) {
+  GDir *const dir = g_dir_open(adapter_path, 0, NULL);
+  if (!dir) {
+    return;
+  }
+
+  const gchar *name;
+  while ((name = g_dir_read_name(dir))) {
+    struct dvb_frontend fe = {.adapter = adapter};
+    if (!parse_numbered(name, "frontend", &fe.frontend)) {
+      continue;
+    }
+    gchar *const path = g_build_filename(adapter_path, name, NULL);
+    GStatBuf st;
+    if (g_stat(path, &st) == 0) {
+      fe.path = g_strdup(path);
+      if (cache_lookup(old_cache, path, &st, &fe)) {
+        cache_store(new_cache, path, &st, &fe);
+        g_array_append_val(frontends, fe);
+      } else if (probe(path, &fe, probe_ctx)) {
+        cache_store(new_cache, path, &st, &fe);
+        *cache_dirty = TRUE;
+        g_array_append_val(frontends, fe);
+      } else {
+        dvb_frontend_clear(&fe);
+      }
+    }
+    g_free(path);
+  }
+  g_dir_close(dir);
+}
+
+static gint by_adapter_cmpfn(gconstpointer a, gconstpointer b) {
+  const struct dvb_frontend *const fA = a, *fB = b;
+  if (fA->adapter != fB->adapter) {
+    return fA->adapter < fB->adapter ? -1 : 1;
+  } else if (fA->frontend != fB->frontend) {
+    return fA->frontend < fB->frontend ? -1 : 1;
+  } else {
+    return 0;
+  }
+}
+
+GArray *frontends_discover(const gchar *dev_root, const gchar *cache_path,
+                           frontend_probe_fn probe, void *probe_ctx) {
+  GArray *const frontends =
+      g_array_new(FALSE, FALSE, sizeof(struct dvb_frontend));
+  g_array_set_clear_func(frontends, dvb_frontend_clear);
+
+  GKeyFile *const old_cache = g_key_file_new();
+  if (cache_path) {
+    g_key_file_load_from_file(old_cache, cache_path, G_KEY_FILE_NONE, NULL);
+  }
+  /* only the devices which are still there are written back. */
+  GKeyFile *const new_cache = g_key_file_new();
+  gboolean cache_dirty = FALSE;
+
+  GDir *const dir = g_dir_open(dev_root, 0, NULL);
+  if (dir) {
+    const gchar *name;
+    while ((name = g_dir_read_name(dir))) {
+      guint adapter;
+      if (parse_numbered(name, "adapter", &adapter)) {
+        gchar *const adapter_path = g_build_filename(dev_root, name, NULL);
+        discover_adapter(adapter_path, adapter, old_cache, new_cache,
+                         &cache_dirty, probe, probe_ctx, frontends);
+        g_free(adapter_path);
+      }
+    }
+    g_dir_close(dir);
+  }
+  g_array_sort(frontends, by_adapter_cmpfn);
+
+  if (cache_path) {
+    gsize num_old = 0;
+    g_strfreev(g_key_file_get_groups(old_cache, &num_old));
+    if (cache_dirty || num_old != frontends->len) {
+      g_key_file_save_to_file(new_cache, cache_path, NULL);
+    }
+  }
+  g_key_file_free(old_cache);
+  g_key_file_free(new_cache);
+  return frontends;
+}
+
+struct FrontendTuner_ {
+  int fd;
+};
+
+FrontendTuner *frontend_tuner_open(const struct dvb_frontend *fe,
+                                   GError **error) {
+  const int fd = g_open(fe->path, O_RDWR | O_NONBLOCK, 0);
+  if (fd < 0) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not open %s : %s", fe->path, g_strerror(errsv));
+    return NULL;
+  }
+  FrontendTuner *const tuner = g_new(FrontendTuner, 1);
+  tuner->fd = fd;
+  return tuner;
+}
+
+void frontend_tuner_close(FrontendTuner *tuner) {
+  g_close(tuner->fd, NULL);
+  g_free(tuner);
+}
+
+#define POLL_INTERVAL_MS 20
+
+static gboolean tuner_set_params(FrontendTuner *tuner,
+                                 const struct tune_params *params) {
+  /* everything but what's given is left to the frontend to detect. */
+  struct dtv_property props[] = {
+      {.cmd = DTV_CLEAR},
+      {.cmd = DTV_DELIVERY_SYSTEM, .u.data = params->dvb_type},
+      {.cmd = DTV_FREQUENCY, .u.data = params->freq_khz * 1000},
+      {.cmd = DTV_BANDWIDTH_HZ, .u.data = params->bw_mhz * 1000000},
+      {.cmd = DTV_MODULATION, .u.data = params->mod},
+      {.cmd = DTV_INVERSION, .u.data = INVERSION_AUTO},
+      {.cmd = DTV_CODE_RATE_HP, .u.data = FEC_AUTO},
+      {.cmd = DTV_CODE_RATE_LP, .u.data = FEC_AUTO},
+      {.cmd = DTV_GUARD_INTERVAL, .u.data = GUARD_INTERVAL_AUTO},
+      {.cmd = DTV_TRANSMISSION_MODE, .u.data = TRANSMISSION_MODE_AUTO},
+      {.cmd = DTV_HIERARCHY, .u.data = HIERARCHY_AUTO},
+      {.cmd = DTV_TUNE}};
+  struct dtv_properties cmdseq = {.num = G_N_ELEMENTS(props), .props = props};
+  return ioctl(tuner->fd, FE_SET_PROPERTY, &cmdseq) == 0;
+}
+
+static void tuner_get_modulation(FrontendTuner *tuner,
+                                 struct tune_params *params) {
+  struct dtv_property prop = {.cmd = DTV_MODULATION};
+  struct dtv_properties props = {.num = 1, .props = &prop};
+  if (ioctl(tuner->fd, FE_GET_PROPERTY, &props) == 0) {
+    params->mod = prop.u.data;
+  }
+}
+
+enum frontend_lock_status
+frontend_tuner_try_lock(FrontendTuner *tuner, struct tune_params *params,
+                        guint signal_timeout_ms, guint lock_timeout_ms) {
+  if (!tuner_set_params(tuner, params)) {
+    return FRONTEND_TUNE_ERROR;
+  }
+
+  const gint64 start = g_get_monotonic_time();
+  for (;;) {
+    fe_status_t status = 0;
+    if (ioctl(tuner->fd, FE_READ_STATUS, &status) != 0) {
+      return FRONTEND_TUNE_ERROR;
+    }
+    if (status & FE_HAS_LOCK) {
+      tuner_get_modulation(tuner, params);
+      return FRONTEND_LOCKED;
+    }
+
+    const gint64 elapsed_ms = (g_get_monotonic_time() - start) / 1000;
+    if (!(status & FE_HAS_SIGNAL) && elapsed_ms >= signal_timeout_ms) {
+      return FRONTEND_NO_SIGNAL;
+    } else if (elapsed_ms >= lock_timeout_ms) {
+      return FRONTEND_NO_LOCK;
+    }
+    g_usleep(POLL_INTERVAL_MS * 1000);
+  }
+}
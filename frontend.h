@@ -0,0 +1,71 @@
+#ifndef GETPLMUX_FRONTEND_H
+#define GETPLMUX_FRONTEND_H
+
+#include <glib.h>
+
+#include "tune_params.h"
+
+#define FRONTEND_DEFAULT_DEV_ROOT "/dev/dvb"
+
+struct dvb_frontend {
+  guint adapter;
+  guint frontend;
+  gchar *path;
+  gchar *name;
+  /* bit n is set if enum fe_delivery_system n is supported */
+  guint64 delsys_mask;
+};
+
+/* fills in the name and delsys_mask of the frontend at the given path,
+ * returning FALSE if it can't be used. this is what's replaced in order to
+ * test discovery without real hardware. */
+typedef gboolean (*frontend_probe_fn)(const gchar *path,
+                                      struct dvb_frontend *fe, void *ctx);
+
+/* asks the device itself via FE_GET_INFO and DTV_ENUM_DELSYS. */
+gboolean frontend_probe_device(const gchar *path, struct dvb_frontend *fe,
+                               void *ctx);
+
+/* finds all dev_root/adapterN/frontendM devices, sorted by adapter and then
+ * frontend number. probing is skipped for devices found in the cache at
+ * cache_path, as long as the device node hasn't changed since, and the cache
+ * is rewritten if anything had to be probed. cache_path may be NULL. */
+GArray *frontends_discover(const gchar *dev_root, const gchar *cache_path,
+                           frontend_probe_fn probe, void *probe_ctx);
+
+gboolean dvb_frontend_supports(const struct dvb_frontend *fe,
+                               enum fe_delivery_system delsys);
+
+/* a comma-separated list of the supported delivery systems' names. */
+gchar *dvb_frontend_describe_delsys(const struct dvb_frontend *fe);
+
+/* the first frontend able to receive the given delivery system, or NULL.
+ * SYS_UNDEFINED means that it's not known, which any frontend accepts. */
+const struct dvb_frontend *frontends_find(const GArray *frontends,
+                                          enum fe_delivery_system delsys);
+
+/* direct access to a frontend, for when there's no point in setting up a
+ * whole pipeline just to see whether something can be received. */
+typedef struct FrontendTuner_ FrontendTuner;
+
+enum frontend_lock_status {
+  FRONTEND_LOCKED,
+  /* not even a signal, so nothing is transmitted on that frequency */
+  FRONTEND_NO_SIGNAL,
+  /* there's a signal, but it couldn't be decoded with the given params */
+  FRONTEND_NO_LOCK,
+  FRONTEND_TUNE_ERROR
+};
+
+FrontendTuner *frontend_tuner_open(const struct dvb_frontend *fe,
+                                   GError **error);
+void frontend_tuner_close(FrontendTuner *tuner);
+
+/* tunes and waits for a lock for up to lock_timeout_ms, giving up early if
+ * there's no signal after signal_timeout_ms. on lock, the modulation is
+ * updated to what the frontend detected. */
+enum frontend_lock_status
+frontend_tuner_try_lock(FrontendTuner *tuner, struct tune_params *params,
+                        guint signal_timeout_ms, guint lock_timeout_ms);
+
+#endif
@@ -0,0 +1,191 @@
+#include "gate.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <glib/gstdio.h>
+
+struct CaptureGate_ {
+  gchar *path;
+  struct capture_gate_limits limits;
+  capture_gate_data_fn fn;
+  void *fn_ctx;
+  enum capture_gate_state state;
+  gchar *reason;
+
+  struct ts_splitter splitter;
+  struct ts_stats stats;
+  /* GBytes received while the decision is pending */
+  GPtrArray *buffered;
+  gsize buffered_len;
+  gint64 first_us;
+  guint64 bytes_received;
+
+  /* NULL until the stream is accepted */
+  FILE *f;
+  GError *write_error;
+};
+
+void capture_gate_limits_init(struct capture_gate_limits *limits,
+                              gint64 window_us) {
+  limits->window_us = window_us;
+  limits->max_buffered = CAPTURE_GATE_MAX_BUFFERED;
+  limits->max_error_ratio = CAPTURE_GATE_MAX_ERROR_RATIO;
+  limits->min_bitrate = CAPTURE_GATE_MIN_BITRATE;
+}
+
+CaptureGate *capture_gate_new(const gchar *path,
+                              const struct capture_gate_limits *limits,
+                              capture_gate_data_fn fn, void *ctx) {
+  CaptureGate *const gate = g_new0(CaptureGate, 1);
+  gate->path = g_strdup(path);
+  gate->limits = *limits;
+  gate->fn = fn;
+  gate->fn_ctx = ctx;
+  gate->state = CAPTURE_GATE_PENDING;
+  ts_splitter_init(&gate->splitter);
+  ts_stats_init(&gate->stats);
+  gate->buffered = g_ptr_array_new_with_free_func(
+      (GDestroyNotify)g_bytes_unref);
+  return gate;
+}
+
+static void write_data(CaptureGate *gate, const guint8 *data, gsize len) {
+  if (gate->fn) {
+    gate->fn(data, len, gate->fn_ctx);
+  }
+  if (gate->write_error) {
+    return;
+  }
+  if (fwrite(data, len, 1, gate->f) != 1) {
+    const int errsv = errno;
+    g_set_error(&gate->write_error, G_FILE_ERROR,
+                g_file_error_from_errno(errsv), "Could not write to %s : %s",
+                gate->path, g_strerror(errsv));
+  }
+}
+
+static void gate_accept(CaptureGate *gate) {
+  gate->state = CAPTURE_GATE_ACCEPTED;
+  gate->f = g_fopen(gate->path, "wb");
+  if (!gate->f) {
+    const int errsv = errno;
+    g_set_error(&gate->write_error, G_FILE_ERROR,
+                g_file_error_from_errno(errsv), "Could not open %s : %s",
+                gate->path, g_strerror(errsv));
+  }
+  for (guint i = 0; i < gate->buffered->len; ++i) {
+    gsize len;
+    const guint8 *const data = g_bytes_get_data(gate->buffered->pdata[i], &len);
+    write_data(gate, data, len);
+  }
+}
+
+static void gate_reject(CaptureGate *gate, gchar *reason) {
+  gate->state = CAPTURE_GATE_REJECTED;
+  gate->reason = reason;
+}
+
+static void decide(CaptureGate *gate, gint64 now_us) {
+  const struct ts_stats *const stats = &gate->stats;
+  const gint64 elapsed_us = now_us - gate->first_us;
+  /* a capture which ends right after it started doesn't tell anything about
+   * the bitrate. */
+  const guint64 bitrate =
+      elapsed_us > 0
+          ? gate->bytes_received * 8 * G_USEC_PER_SEC / (guint64)elapsed_us
+          : G_MAXUINT64;
+  if (stats->packets == 0) {
+    gate_reject(gate, g_strdup("nothing was received"));
+  } else if ((gdouble)(stats->transport_errors + stats->cc_errors) /
+                 stats->packets >
+             gate->limits.max_error_ratio) {
+    gate_reject(gate,
+                g_strdup_printf("%" G_GUINT64_FORMAT
+                                " damaged packets and %" G_GUINT64_FORMAT
+                                " discontinuities out of %" G_GUINT64_FORMAT,
+                                stats->transport_errors, stats->cc_errors,
+                                stats->packets));
+  } else if (bitrate < gate->limits.min_bitrate) {
+    gate_reject(gate, g_strdup_printf("the bitrate of %" G_GUINT64_FORMAT
+                                      " bit/s is too low",
+                                      bitrate));
+  } else {
+    gate_accept(gate);
+  }
+  g_ptr_array_set_size(gate->buffered, 0);
+  gate->buffered_len = 0;
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  CaptureGate *const gate = ctx;
+  struct ts_packet pkt;
+  if (ts_packet_parse(data, &pkt)) {
+    ts_stats_push(&gate->stats, &pkt);
+  }
+}
+
+enum capture_gate_state capture_gate_push(CaptureGate *gate,
+                                          const guint8 *data, gsize len,
+                                          gint64 now_us) {
+  gate->bytes_received += len;
+  switch (gate->state) {
+  case CAPTURE_GATE_PENDING:
+    if (gate->buffered->len == 0) {
+      gate->first_us = now_us;
+    }
+    ts_splitter_push(&gate->splitter, data, len, on_packet, gate);
+    g_ptr_array_add(gate->buffered, g_bytes_new(data, len));
+    gate->buffered_len += len;
+    if (now_us - gate->first_us >= gate->limits.window_us ||
+        gate->buffered_len >= gate->limits.max_buffered) {
+      decide(gate, now_us);
+    }
+    break;
+  case CAPTURE_GATE_ACCEPTED:
+    write_data(gate, data, len);
+    break;
+  case CAPTURE_GATE_REJECTED:
+    break;
+  }
+  return gate->state;
+}
+
+enum capture_gate_state capture_gate_get_state(const CaptureGate *gate) {
+  return gate->state;
+}
+
+guint64 capture_gate_get_bytes_received(const CaptureGate *gate) {
+  return gate->bytes_received;
+}
+
+const gchar *capture_gate_get_reason(const CaptureGate *gate) {
+  return gate->reason;
+}
+
+enum capture_gate_state capture_gate_end(CaptureGate *gate, gint64 now_us) {
+  if (gate->state == CAPTURE_GATE_PENDING) {
+    decide(gate, now_us);
+  }
+  return gate->state;
+}
+
+gboolean capture_gate_close(CaptureGate *gate, GError **error) {
+  GError *err = g_steal_pointer(&gate->write_error);
+  if (gate->f && fclose(gate->f) != 0 && !err) {
+    const int errsv = errno;
+    g_set_error(&err, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", gate->path, g_strerror(errsv));
+  }
+
+  g_ptr_array_unref(gate->buffered);
+  g_free(gate->reason);
+  g_free(gate->path);
+  g_free(gate);
+
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  return TRUE;
+}
@@ -0,0 +1,67 @@
+#ifndef GETPLMUX_GATE_H
+#define GETPLMUX_GATE_H
+
+#include <glib.h>
+
+#include "ts.h"
+
+/* holds the beginning of a capture in memory until it's known whether the
+ * stream is any good, so that captures of a bad signal never end up on disk.
+ * the decision is made once the window has passed or the buffer is full,
+ * whichever comes first, or when the gate is closed before that. from then
+ * on, the stream is either written straight to the file or thrown away. */
+typedef struct CaptureGate_ CaptureGate;
+
+struct capture_gate_limits {
+  gint64 window_us;
+  gsize max_buffered;
+  /* damaged packets, according to struct ts_stats, per received packet */
+  gdouble max_error_ratio;
+  /* in bits per second */
+  guint64 min_bitrate;
+};
+
+#define CAPTURE_GATE_MAX_BUFFERED (64 * 1024 * 1024)
+#define CAPTURE_GATE_MAX_ERROR_RATIO 0.001
+#define CAPTURE_GATE_MIN_BITRATE 1000000
+
+/* fills in the defaults above. */
+void capture_gate_limits_init(struct capture_gate_limits *limits,
+                              gint64 window_us);
+
+enum capture_gate_state {
+  CAPTURE_GATE_PENDING,
+  CAPTURE_GATE_ACCEPTED,
+  CAPTURE_GATE_REJECTED
+};
+
+/* gets everything that's written to the file, in order. */
+typedef void (*capture_gate_data_fn)(const guint8 *data, gsize len,
+                                     void *ctx);
+
+/* the file is only created once the stream is accepted. fn may be NULL. */
+CaptureGate *capture_gate_new(const gchar *path,
+                              const struct capture_gate_limits *limits,
+                              capture_gate_data_fn fn, void *ctx);
+
+/* feeds the captured stream and returns the state after taking it into
+ * account. now_us is monotonic time. this may be called from a different
+ * thread than the rest, but never at the same time. */
+enum capture_gate_state capture_gate_push(CaptureGate *gate,
+                                          const guint8 *data, gsize len,
+                                          gint64 now_us);
+
+enum capture_gate_state capture_gate_get_state(const CaptureGate *gate);
+guint64 capture_gate_get_bytes_received(const CaptureGate *gate);
+/* why the stream was rejected, NULL unless it was. */
+const gchar *capture_gate_get_reason(const CaptureGate *gate);
+
+/* called once the capture is over, this makes the decision if it's still
+ * pending, based on what was received so far. */
+enum capture_gate_state capture_gate_end(CaptureGate *gate, gint64 now_us);
+
+/* reports the first error that happened while writing. the gate is freed
+ * either way. */
+gboolean capture_gate_close(CaptureGate *gate, GError **error);
+
+#endif
@@ -0,0 +1,104 @@
+#include "harvest.h"
+
+#include <gio/gio.h>
+
+#include "cache.h"
+#include "fetch.h"
+#include "parser.h"
+#include "txdb.h"
+
+/* the transmitter pages are fetched one by one, and not too often. */
+#define HARVEST_REQUEST_INTERVAL_MS 1000
+
+static gboolean harvest_transmitter(TransmitterDb *db, const gchar *mux,
+                                    const struct mux_params *params) {
+  CURLcode err;
+  GString *const content = fetch_transmitter_info_html(params->info_html, &err);
+  if (!content) {
+    g_printerr("%s %s : could not fetch %s : %s\n", mux, params->name,
+               params->info_html, curl_easy_strerror(err));
+    return FALSE;
+  }
+
+  double lat, lon;
+  const gboolean found = parse_transmitter_location_from_html(
+      content->str, (int)content->len, &lat, &lon);
+  g_string_free(content, TRUE);
+  if (!found) {
+    g_printerr("%s %s : no coordinates found on %s\n", mux, params->name,
+               params->info_html);
+    return FALSE;
+  }
+
+  transmitter_db_add(db, mux, params, lat, lon);
+  return TRUE;
+}
+
+int run_harvest(const struct getplmux_arguments *args) {
+  MuxData *const md = fetch_muxdata(args->latitude, args->longitude, NULL);
+  if (!md) {
+    return 1;
+  }
+
+  GFile *const f = cache_get_transmitter_db_file();
+  {
+    GFile *const parent = g_file_get_parent(f);
+    g_file_make_directory_with_parents(parent, NULL, NULL);
+    g_object_unref(parent);
+  }
+  gchar *const path = g_file_get_path(f);
+  g_object_unref(f);
+
+  TransmitterDb *db = NULL;
+  if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+    GError *err = NULL;
+    db = transmitter_db_load(path, &err);
+    if (!db) {
+      g_printerr("Could not load %s : %s\n", path, err->message);
+      g_error_free(err);
+      g_free(path);
+      mux_data_destroy(md);
+      return 1;
+    }
+  } else {
+    db = transmitter_db_new();
+  }
+
+  guint num_added = 0, num_failed = 0;
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    const gchar *const mux = mux_data_get_mux_at(md, m);
+    const GArray *const transmitters = mux_data_get_transmitters_at(md, m);
+    for (guint i = 0; i < transmitters->len; ++i) {
+      const struct mux_params *const params =
+          &g_array_index(transmitters, struct mux_params, i);
+      if (!params->info_html || !params->name ||
+          transmitter_db_contains(db, mux, params)) {
+        continue;
+      }
+      if (num_added + num_failed > 0) {
+        g_usleep(HARVEST_REQUEST_INTERVAL_MS * 1000);
+      }
+      if (harvest_transmitter(db, mux, params)) {
+        num_added++;
+      } else {
+        num_failed++;
+      }
+    }
+  }
+
+  int rv = 0;
+  GError *err = NULL;
+  if (transmitter_db_save(db, path, &err)) {
+    g_print("Added %u transmitters (%u failed), %s now contains %u\n",
+            num_added, num_failed, path, transmitter_db_size(db));
+  } else {
+    g_printerr("Could not save %s : %s\n", path, err->message);
+    g_error_free(err);
+    rv = 1;
+  }
+
+  transmitter_db_destroy(db);
+  g_free(path);
+  mux_data_destroy(md);
+  return rv;
+}
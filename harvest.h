@@ -0,0 +1,11 @@
+#ifndef GETPLMUX_HARVEST_H
+#define GETPLMUX_HARVEST_H
+
+#include "arguments.h"
+
+/* adds all the transmitters visible from the location given in args to the
+ * local transmitter database, fetching the coordinates of the ones which
+ * aren't there yet. returns the process exit code. */
+int run_harvest(const struct getplmux_arguments *args);
+
+#endif
@@ -0,0 +1,462 @@
+#include "jobrun.h"
+
+#include <gst/gst.h>
+
+#include "diskspace.h"
+#include "dvbsrc.h"
+#include "dvrbuf.h"
+#include "frontend.h"
+#include "jobs.h"
+
+struct job_runner;
+
+/* a pipeline of its own for every frontend. */
+struct tuner {
+  struct job_runner *runner;
+  const struct dvb_frontend *fe;
+  guint fe_idx;
+  GstElement *pipeline;
+  GstElement *dvbsrc;
+  GstElement *sink;
+  /* what the job's own params changed on dvbsrc, put back once it's done
+   * so that the next job on the frontend starts from the same settings */
+  GstStructure *saved_props;
+  guint bus_watch_id;
+
+  /* NULL once there's nothing left for this frontend to do */
+  const struct capture_job *job;
+  /* the transmitters of the job's MUX, and the one being tried */
+  GArray *transmitters;
+  guint transmitter_idx;
+  guint timeout_src_id;
+  gboolean tuning_failed;
+  /* the capture ran for as long as the job asked for */
+  gboolean captured;
+  /* for room on the disk, before trying the transmitter */
+  gboolean waiting;
+  /* the disk_writer is only valid while this is set */
+  gboolean writing;
+  struct disk_writer writer;
+};
+
+struct job_runner {
+  const struct getplmux_arguments *args;
+  MuxData *muxdata;
+  TransmitterStats *stats;
+  const GArray *frontends;
+  DiskAdmission *disk;
+  /* the parsed dvbsrc params of the jobs which have any */
+  GHashTable *job_props;
+  JobScheduler *sched;
+  GMainLoop *loop;
+  struct tuner *tuners;
+  guint num_busy;
+  guint num_failed;
+};
+
+static gboolean transmitter_is_usable(const struct capture_job *job,
+                                      const struct mux_params *par,
+                                      const struct dvb_frontend *fe) {
+  return (!job->transmitter || g_str_equal(job->transmitter, par->name)) &&
+         dvb_frontend_supports(fe, par->tune_parms.dvb_type);
+}
+
+static gboolean job_fits(const struct capture_job *job,
+                         const struct dvb_frontend *fe, void *ctx) {
+  struct job_runner *const runner = ctx;
+  const GArray *const transmitters =
+      mux_data_get_transmitters_for_mux(runner->muxdata, job->mux);
+  for (guint i = 0; transmitters && i < transmitters->len; ++i) {
+    if (transmitter_is_usable(
+            job, &g_array_index(transmitters, struct mux_params, i), fe)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static gchar *job_file_name(const struct capture_job *job,
+                            const struct mux_params *par) {
+  GString *const name = g_string_new(job->name);
+  g_string_replace(name, "\"", "", 0);
+  g_string_replace(name, " ", "_", 0);
+  g_string_replace(name, "/", "_", 0);
+  g_string_append_printf(name, "_%u_kHz.ts", par->tune_parms.freq_khz);
+  return g_string_free(name, FALSE);
+}
+
+static void tuner_start_next_job(struct tuner *tuner);
+
+/* whether the capture may start now, and if it may not, whether it ever
+ * will. */
+static enum disk_verdict tuner_admit(struct tuner *tuner,
+                                     const struct mux_params *par) {
+  struct job_runner *const runner = tuner->runner;
+  GError *err = NULL;
+  struct disk_info info;
+  if (!disk_query(DISK_CAPTURE_DIR, &info, &err)) {
+    /* the filesink will have its own say about it. */
+    g_printerr("%s : %s\n", tuner->job->name, err->message);
+    g_error_free(err);
+    return DISK_ADMIT;
+  }
+  guint64 bitrate;
+  if (!transmitter_stats_get_bitrate(runner->stats, tuner->job->mux, par,
+                                     &bitrate)) {
+    bitrate = dvr_default_bitrate(par->tune_parms.dvb_type);
+  }
+  const guint64 size =
+      capture_estimate_size(bitrate, tuner->job->duration_s);
+  const enum disk_verdict verdict = disk_admission_request(
+      runner->disk, &info, size, bitrate / 8, &tuner->writer);
+  switch (verdict) {
+  case DISK_ADMIT:
+    tuner->writing = TRUE;
+    break;
+  case DISK_WAIT:
+    g_print("%s : waiting for the other captures to make room on the disk\n",
+            tuner->job->name);
+    break;
+  case DISK_FULL:
+    g_printerr("%s : not enough free space for about %" G_GUINT64_FORMAT
+               " MB, giving up\n",
+               tuner->job->name, size / (1024 * 1024));
+    break;
+  }
+  return verdict;
+}
+
+/* moves on to the next transmitter the job can use, or gives up on the job
+ * if there are no more. */
+static void tuner_try_transmitter(struct tuner *tuner) {
+  const struct capture_job *const job = tuner->job;
+  while (tuner->transmitter_idx < tuner->transmitters->len &&
+         !transmitter_is_usable(job,
+                                &g_array_index(tuner->transmitters,
+                                               struct mux_params,
+                                               tuner->transmitter_idx),
+                                tuner->fe)) {
+    ++tuner->transmitter_idx;
+  }
+  if (tuner->transmitter_idx >= tuner->transmitters->len) {
+    g_print("%s : all transmitters tried, giving up\n", job->name);
+    ++tuner->runner->num_failed;
+    tuner_start_next_job(tuner);
+    return;
+  }
+
+  const struct mux_params *const par = &g_array_index(
+      tuner->transmitters, struct mux_params, tuner->transmitter_idx);
+  switch (tuner_admit(tuner, par)) {
+  case DISK_ADMIT:
+    break;
+  case DISK_WAIT:
+    tuner->waiting = TRUE;
+    return;
+  case DISK_FULL:
+    ++tuner->runner->num_failed;
+    tuner_start_next_job(tuner);
+    return;
+  }
+
+  gchar *const fname = job_file_name(job, par);
+  g_object_set(tuner->sink, "location", fname, NULL);
+  g_free(fname);
+  g_object_set(tuner->dvbsrc, "adapter", (gint)tuner->fe->adapter,
+               "frontend", (gint)tuner->fe->frontend, NULL);
+  dvbsrc_set_tune_params(tuner->dvbsrc, &par->tune_parms);
+  if (tuner->runner->args->dvbsrc_extra_props) {
+    dvbsrc_set_extra_params(tuner->dvbsrc,
+                            tuner->runner->args->dvbsrc_extra_props);
+  }
+  const GstStructure *const props =
+      g_hash_table_lookup(tuner->runner->job_props, job);
+  if (props) {
+    dvbsrc_override_params(tuner->dvbsrc, props, tuner->saved_props);
+  }
+
+  tuner->tuning_failed = FALSE;
+  tuner->captured = FALSE;
+  g_print("%s : tuning adapter%u/frontend%u to %s, transmitter %s\n",
+          job->name, tuner->fe->adapter, tuner->fe->frontend, job->mux,
+          par->name);
+  gst_element_set_state(tuner->pipeline, GST_STATE_PLAYING);
+}
+
+static void tuner_start_next_job(struct tuner *tuner) {
+  struct job_runner *const runner = tuner->runner;
+  tuner->job = job_scheduler_next(runner->sched, tuner->fe_idx);
+  if (!tuner->job) {
+    /* the remaining jobs can only get fewer, so none will ever fit. */
+    if (--runner->num_busy == 0) {
+      g_main_loop_quit(runner->loop);
+    }
+    return;
+  }
+  tuner->transmitters =
+      mux_data_get_transmitters_for_mux(runner->muxdata, tuner->job->mux);
+  tuner->transmitter_idx = 0;
+  tuner_try_transmitter(tuner);
+}
+
+static gboolean tuner_set_null_state(gpointer user_data) {
+  struct tuner *const tuner = user_data;
+  tuner->timeout_src_id = 0;
+  gst_element_set_state(tuner->pipeline, GST_STATE_NULL);
+  return FALSE;
+}
+
+static gboolean on_job_done(gpointer user_data) {
+  struct tuner *const tuner = user_data;
+  tuner->captured = TRUE;
+  return tuner_set_null_state(tuner);
+}
+
+/* gives the tuners waiting for room on the disk another go, before the one
+ * which made the room can take it again. */
+static void runner_wake_waiting(struct job_runner *runner) {
+  for (guint i = 0; i < runner->frontends->len; ++i) {
+    struct tuner *const tuner = &runner->tuners[i];
+    if (tuner->waiting) {
+      tuner->waiting = FALSE;
+      tuner_try_transmitter(tuner);
+    }
+  }
+}
+
+static void tuner_stopped(struct tuner *tuner) {
+  dvbsrc_restore_params(tuner->dvbsrc, tuner->saved_props);
+  if (tuner->writing) {
+    disk_admission_release(tuner->runner->disk, &tuner->writer);
+    tuner->writing = FALSE;
+    runner_wake_waiting(tuner->runner);
+  }
+  if (tuner->captured) {
+    g_print("%s : done\n", tuner->job->name);
+    tuner_start_next_job(tuner);
+  } else {
+    ++tuner->transmitter_idx;
+    tuner_try_transmitter(tuner);
+  }
+}
+
+static gboolean tuner_bus_call(GstBus *bus, GstMessage *msg, gpointer data) {
+  (void)bus;
+
+  struct tuner *const tuner = data;
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_EOS:
+    g_idle_add(tuner_set_null_state, tuner);
+    break;
+
+  case GST_MESSAGE_ERROR: {
+    if (tuner->timeout_src_id) {
+      g_source_remove(tuner->timeout_src_id);
+      tuner->timeout_src_id = 0;
+    }
+    if (msg->src == GST_OBJECT(tuner->dvbsrc) && tuner->tuning_failed) {
+      g_print("%s : tuning failed, trying next transmitter if available\n",
+              tuner->job->name);
+    } else {
+      gchar *debug;
+      GError *error;
+      gst_message_parse_error(msg, &error, &debug);
+      g_free(debug);
+      g_printerr("%s : error : %s\n", tuner->job->name, error->message);
+      g_error_free(error);
+    }
+    g_idle_add(tuner_set_null_state, tuner);
+  } break;
+
+  case GST_MESSAGE_STATE_CHANGED:
+    if (msg->src == GST_OBJECT(tuner->pipeline)) {
+      GstState old_state, new_state;
+      gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+      if (old_state == GST_STATE_PAUSED && new_state == GST_STATE_PLAYING) {
+        g_print("%s : capturing for %u seconds...\n", tuner->job->name,
+                tuner->job->duration_s);
+        tuner->timeout_src_id = g_timeout_add_seconds(tuner->job->duration_s,
+                                                      on_job_done, tuner);
+      } else if (new_state == GST_STATE_NULL) {
+        tuner_stopped(tuner);
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return TRUE;
+}
+
+static void on_tuning_fail(GstElement *object, gpointer user_data) {
+  (void)object;
+
+  struct tuner *const tuner = user_data;
+  tuner->tuning_failed = TRUE;
+}
+
+static gboolean tuner_init(struct tuner *tuner, struct job_runner *runner,
+                           guint fe_idx) {
+  tuner->runner = runner;
+  tuner->fe_idx = fe_idx;
+  tuner->fe = &g_array_index(runner->frontends, struct dvb_frontend, fe_idx);
+  tuner->job = NULL;
+  tuner->timeout_src_id = 0;
+  tuner->waiting = tuner->writing = FALSE;
+  tuner->dvbsrc = gst_element_factory_make("dvbsrc", NULL);
+  tuner->sink = gst_element_factory_make("filesink", NULL);
+  if (!tuner->dvbsrc || !tuner->sink) {
+    g_clear_pointer(&tuner->dvbsrc, gst_object_unref);
+    g_clear_pointer(&tuner->sink, gst_object_unref);
+    tuner->pipeline = NULL;
+    return FALSE;
+  }
+  tuner->saved_props = gst_structure_new_empty("saved_props");
+  tuner->pipeline = gst_pipeline_new(NULL);
+  gst_bin_add_many(GST_BIN(tuner->pipeline), tuner->dvbsrc, tuner->sink,
+                   NULL);
+  gst_element_link(tuner->dvbsrc, tuner->sink);
+  gst_pipeline_set_auto_flush_bus(GST_PIPELINE(tuner->pipeline), FALSE);
+
+  GstBus *const bus = gst_pipeline_get_bus(GST_PIPELINE(tuner->pipeline));
+  tuner->bus_watch_id = gst_bus_add_watch(bus, tuner_bus_call, tuner);
+  gst_object_unref(bus);
+  g_signal_connect(G_OBJECT(tuner->dvbsrc), "tuning-fail",
+                   G_CALLBACK(on_tuning_fail), tuner);
+  return TRUE;
+}
+
+static void tuner_clear(struct tuner *tuner) {
+  if (!tuner->pipeline) {
+    return;
+  }
+  gst_element_set_state(tuner->pipeline, GST_STATE_NULL);
+  g_source_remove(tuner->bus_watch_id);
+  gst_object_unref(tuner->pipeline);
+  gst_structure_free(tuner->saved_props);
+}
+
+/* so that mistakes are found before anything is captured. */
+static GHashTable *parse_job_props(const GPtrArray *jobs) {
+  GHashTable *const job_props = g_hash_table_new_full(
+      NULL, NULL, NULL, (GDestroyNotify)gst_structure_free);
+  for (guint i = 0; i < jobs->len; ++i) {
+    const struct capture_job *const job = g_ptr_array_index(jobs, i);
+    if (!job->dvbsrc_params) {
+      continue;
+    }
+    GError *err = NULL;
+    GstStructure *const props = parse_as_gst_struct(job->dvbsrc_params, &err);
+    if (!props) {
+      g_printerr("%s : %s\n", job->name, err->message);
+      g_error_free(err);
+      g_hash_table_unref(job_props);
+      return NULL;
+    }
+    g_hash_table_insert(job_props, (gpointer)job, props);
+  }
+  return job_props;
+}
+
+/* only matters when there's more than one capture to write at a time. */
+static void measure_write_rate(DiskAdmission *disk) {
+  GError *err = NULL;
+  struct disk_info info;
+  guint64 rate = 0;
+  if (disk_query(DISK_CAPTURE_DIR, &info, &err)) {
+    rate = disk_measure_write_rate(DISK_CAPTURE_DIR, &err);
+  }
+  if (rate == 0) {
+    g_printerr("Could not measure how fast the disk is, not limiting the "
+               "captures written at a time : %s\n",
+               err->message);
+    g_error_free(err);
+    return;
+  }
+  g_print("The disk takes %" G_GUINT64_FORMAT " kB/s\n", rate / 1024);
+  disk_admission_set_write_rate(disk, info.fs_id, rate);
+}
+
+int run_jobs(const struct getplmux_arguments *args, MuxData *muxdata,
+             TransmitterStats *stats, const GArray *frontends) {
+  GError *err = NULL;
+  GPtrArray *const jobs = capture_jobs_load(
+      args->job_file, (guint)args->capture_duration_seconds, &err);
+  if (!jobs) {
+    g_printerr("Could not load the jobs from %s : %s\n", args->job_file,
+               err->message);
+    g_error_free(err);
+    return 1;
+  }
+
+  int rv = 1;
+  struct job_runner runner = {.args = args,
+                              .muxdata = muxdata,
+                              .stats = stats,
+                              .frontends = frontends,
+                              .disk = disk_admission_new(),
+                              .job_props = parse_job_props(jobs),
+                              .sched = NULL,
+                              .loop = NULL,
+                              .tuners = NULL,
+                              .num_busy = 0,
+                              .num_failed = 0};
+  if (!runner.job_props) {
+    goto beach;
+  }
+  if (frontends->len == 0) {
+    g_printerr("Running jobs needs the DVB frontends, but none were found\n");
+    goto beach;
+  }
+
+  runner.sched = job_scheduler_new(jobs, frontends, job_fits, &runner);
+  const GPtrArray *const unfit = job_scheduler_get_unfit(runner.sched);
+  for (guint i = 0; i < unfit->len; ++i) {
+    const struct capture_job *const job = g_ptr_array_index(unfit, i);
+    g_printerr("%s : no such transmitter, or none of the frontends can "
+               "receive it, skipping\n",
+               job->name);
+  }
+  runner.num_failed = unfit->len;
+
+  if (frontends->len > 1) {
+    measure_write_rate(runner.disk);
+  }
+
+  runner.loop = g_main_loop_new(NULL, FALSE);
+  runner.tuners = g_new0(struct tuner, frontends->len);
+  for (guint i = 0; i < frontends->len; ++i) {
+    if (!tuner_init(&runner.tuners[i], &runner, i)) {
+      g_printerr("Failed to create a 'dvbsrc' element.\n"
+                 "Make sure you have gst-plugins-bad installed.\n");
+      goto beach;
+    }
+  }
+
+  runner.num_busy = frontends->len;
+  for (guint i = 0; i < frontends->len; ++i) {
+    tuner_start_next_job(&runner.tuners[i]);
+  }
+  if (runner.num_busy > 0) {
+    g_main_loop_run(runner.loop);
+  }
+
+  g_print("%u of %u jobs completed\n", jobs->len - runner.num_failed,
+          jobs->len);
+  rv = runner.num_failed == 0 ? 0 : 1;
+
+beach:
+  for (guint i = 0; runner.tuners && i < frontends->len; ++i) {
+    tuner_clear(&runner.tuners[i]);
+  }
+  g_free(runner.tuners);
+  g_clear_pointer(&runner.loop, g_main_loop_unref);
+  g_clear_pointer(&runner.sched, job_scheduler_destroy);
+  g_clear_pointer(&runner.job_props, g_hash_table_unref);
+  disk_admission_destroy(runner.disk);
+  g_ptr_array_unref(jobs);
+  return rv;
+}
@@ -0,0 +1,17 @@
+#ifndef GETPLMUX_JOBRUN_H
+#define GETPLMUX_JOBRUN_H
+
+#include "arguments.h"
+#include "muxdata.h"
+#include "stats.h"
+
+/* runs the captures listed in args->job_file, with a pipeline of its own
+ * for every frontend so that they all capture at the same time. a capture
+ * only starts once there's room for it on the disk, going by the bitrate
+ * of the previous captures in stats, and the disk can keep up with it.
+ * GStreamer has to be initialised already. returns the process exit
+ * code. */
+int run_jobs(const struct getplmux_arguments *args, MuxData *muxdata,
+             TransmitterStats *stats, const GArray *frontends);
+
+#endif
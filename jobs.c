@@ -0,0 +1,231 @@
+#include "jobs.h"
+
+#define KEY_MUX "mux"
+#define KEY_TRANSMITTER "transmitter"
+#define KEY_DURATION "duration"
+#define KEY_ADAPTER "adapter"
+#define KEY_FRONTEND "frontend"
+#define KEY_PROFILE "profile"
+#define KEY_DVBSRC_PARAMS "dvbsrc-extra-params"
+
+static void capture_job_free(gpointer p) {
+  struct capture_job *const job = p;
+  g_free(job->name);
+  g_free(job->mux);
+  g_free(job->transmitter);
+  g_free(job->dvbsrc_params);
+  g_free(job);
+}
+
+/* leaves value alone if there's no such key. */
+static gboolean get_optional_int(GKeyFile *kf, const gchar *group,
+                                 const gchar *key, gint min, gint *value,
+                                 GError **error) {
+  if (!g_key_file_has_key(kf, group, key, NULL)) {
+    return TRUE;
+  }
+  GError *err = NULL;
+  const gint read = g_key_file_get_integer(kf, group, key, &err);
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  if (read < min) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "%s can't be less than %d", key, min);
+    return FALSE;
+  }
+  *value = read;
+  return TRUE;
+}
+
+static gboolean read_profile(GKeyFile *kf, const gchar *name,
+                             struct capture_job *job, GError **error) {
+  gchar *const group = g_strconcat(JOBS_PROFILE_PREFIX, name, NULL);
+  const gboolean found = g_key_file_has_group(kf, group);
+  if (found) {
+    job->dvbsrc_params =
+        g_key_file_get_string(kf, group, KEY_DVBSRC_PARAMS, NULL);
+  } else {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+                "unknown profile %s", name);
+  }
+  g_free(group);
+  return found;
+}
+
+static struct capture_job *read_job(GKeyFile *kf, const gchar *group,
+                                    guint default_duration_s,
+                                    GError **error) {
+  struct capture_job *job = g_new0(struct capture_job, 1);
+  job->name = g_strdup(group);
+  job->adapter = job->frontend = -1;
+  gint duration_s = (gint)default_duration_s;
+  gchar *profile = NULL;
+
+  job->mux = g_key_file_get_string(kf, group, KEY_MUX, error);
+  if (!job->mux ||
+      !get_optional_int(kf, group, KEY_DURATION, 1, &duration_s, error) ||
+      !get_optional_int(kf, group, KEY_ADAPTER, 0, &job->adapter, error) ||
+      !get_optional_int(kf, group, KEY_FRONTEND, 0, &job->frontend, error)) {
+    goto fail;
+  }
+  job->duration_s = (guint)duration_s;
+  job->transmitter = g_key_file_get_string(kf, group, KEY_TRANSMITTER, NULL);
+  profile = g_key_file_get_string(kf, group, KEY_PROFILE, NULL);
+  if (profile && !read_profile(kf, profile, job, error)) {
+    goto fail;
+  }
+  g_free(profile);
+  return job;
+
+fail:
+  g_prefix_error(error, "%s : ", group);
+  g_free(profile);
+  capture_job_free(job);
+  return NULL;
+}
+
+GPtrArray *capture_jobs_load_from_data(const gchar *data, gsize len,
+                                       guint default_duration_s,
+                                       GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  GPtrArray *jobs = NULL;
+  if (!g_key_file_load_from_data(kf, data, len, G_KEY_FILE_NONE, error)) {
+    goto beach;
+  }
+
+  jobs = g_ptr_array_new_with_free_func(capture_job_free);
+  gchar **const groups = g_key_file_get_groups(kf, NULL);
+  for (guint i = 0; groups[i]; ++i) {
+    if (g_str_has_prefix(groups[i], JOBS_PROFILE_PREFIX)) {
+      continue;
+    }
+    struct capture_job *const job =
+        read_job(kf, groups[i], default_duration_s, error);
+    if (!job) {
+      g_clear_pointer(&jobs, g_ptr_array_unref);
+      break;
+    }
+    g_ptr_array_add(jobs, job);
+  }
+  g_strfreev(groups);
+
+  if (jobs && jobs->len == 0) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+                "no jobs listed");
+    g_clear_pointer(&jobs, g_ptr_array_unref);
+  }
+
+beach:
+  g_key_file_free(kf);
+  return jobs;
+}
+
+GPtrArray *capture_jobs_load(const gchar *path, guint default_duration_s,
+                             GError **error) {
+  gchar *contents;
+  gsize len;
+  if (!g_file_get_contents(path, &contents, &len, error)) {
+    return NULL;
+  }
+  GPtrArray *const jobs =
+      capture_jobs_load_from_data(contents, len, default_duration_s, error);
+  g_free(contents);
+  return jobs;
+}
+
+struct scheduled_job {
+  const struct capture_job *job;
+  /* how many frontends can run it */
+  guint num_fits;
+  /* in the job file */
+  guint index;
+};
+
+struct JobScheduler_ {
+  const GArray *frontends;
+  job_fits_fn fits;
+  void *ctx;
+  /* struct scheduled_job, in the order they should run */
+  GArray *pending;
+  GPtrArray *unfit;
+};
+
+static gboolean job_runs_on(const JobScheduler *sched,
+                            const struct capture_job *job,
+                            const struct dvb_frontend *fe) {
+  if ((job->adapter >= 0 && (guint)job->adapter != fe->adapter) ||
+      (job->frontend >= 0 && (guint)job->frontend != fe->frontend)) {
+    return FALSE;
+  }
+  return sched->fits(job, fe, sched->ctx);
+}
+
+static gint by_priority_cmpfn(gconstpointer a, gconstpointer b) {
+  const struct scheduled_job *const jA = a, *jB = b;
+  if (jA->num_fits != jB->num_fits) {
+    return jA->num_fits < jB->num_fits ? -1 : 1;
+  }
+  if (jA->job->duration_s != jB->job->duration_s) {
+    return jA->job->duration_s > jB->job->duration_s ? -1 : 1;
+  }
+  return jA->index < jB->index ? -1 : jA->index > jB->index;
+}
+
+JobScheduler *job_scheduler_new(const GPtrArray *jobs, const GArray *frontends,
+                                job_fits_fn fits, void *ctx) {
+  JobScheduler *const sched = g_new(JobScheduler, 1);
+  sched->frontends = frontends;
+  sched->fits = fits;
+  sched->ctx = ctx;
+  sched->pending = g_array_new(FALSE, FALSE, sizeof(struct scheduled_job));
+  sched->unfit = g_ptr_array_new();
+
+  for (guint i = 0; i < jobs->len; ++i) {
+    struct scheduled_job scheduled = {
+        .job = g_ptr_array_index(jobs, i), .num_fits = 0, .index = i};
+    for (guint j = 0; j < frontends->len; ++j) {
+      if (job_runs_on(sched, scheduled.job,
+                      &g_array_index(frontends, struct dvb_frontend, j))) {
+        ++scheduled.num_fits;
+      }
+    }
+    if (scheduled.num_fits > 0) {
+      g_array_append_val(sched->pending, scheduled);
+    } else {
+      g_ptr_array_add(sched->unfit, (gpointer)scheduled.job);
+    }
+  }
+  g_array_sort(sched->pending, by_priority_cmpfn);
+  return sched;
+}
+
+void job_scheduler_destroy(JobScheduler *sched) {
+  g_array_unref(sched->pending);
+  g_ptr_array_unref(sched->unfit);
+  g_free(sched);
+}
+
+const struct capture_job *job_scheduler_next(JobScheduler *sched,
+                                             guint fe_idx) {
+  const struct dvb_frontend *const fe =
+      &g_array_index(sched->frontends, struct dvb_frontend, fe_idx);
+  for (guint i = 0; i < sched->pending->len; ++i) {
+    const struct capture_job *const job =
+        g_array_index(sched->pending, struct scheduled_job, i).job;
+    if (job_runs_on(sched, job, fe)) {
+      g_array_remove_index(sched->pending, i);
+      return job;
+    }
+  }
+  return NULL;
+}
+
+guint job_scheduler_get_num_pending(const JobScheduler *sched) {
+  return sched->pending->len;
+}
+
+const GPtrArray *job_scheduler_get_unfit(const JobScheduler *sched) {
+  return sched->unfit;
+}
@@ -0,0 +1,72 @@
+#ifndef GETPLMUX_JOBS_H
+#define GETPLMUX_JOBS_H
+
+#include <glib.h>
+
+#include "frontend.h"
+
+/* captures listed in a key file, with a group named after every capture :
+ *
+ *   [EPG]
+ *   mux=MUX-3
+ *   transmitter=Poznań/Śrem
+ *   duration=60
+ *   adapter=1
+ *   frontend=0
+ *   profile=narrow
+ *
+ * of which only the MUX is required. groups named "profile NAME" hold the
+ * settings shared by the jobs using that profile :
+ *
+ *   [profile narrow]
+ *   dvbsrc-extra-params=dvb-buffer-size=1925120
+ */
+#define JOBS_PROFILE_PREFIX "profile "
+
+struct capture_job {
+  gchar *name;
+  gchar *mux;
+  /* NULL to try the transmitters of the MUX in order until one works */
+  gchar *transmitter;
+  /* as given to --dvbsrc-extra-params, NULL if there aren't any */
+  gchar *dvbsrc_params;
+  guint duration_s;
+  /* -1 if any will do */
+  gint adapter;
+  gint frontend;
+};
+
+/* struct capture_job *, in the order they're listed in. jobs without a
+ * duration get default_duration_s. */
+GPtrArray *capture_jobs_load(const gchar *path, guint default_duration_s,
+                             GError **error);
+GPtrArray *capture_jobs_load_from_data(const gchar *data, gsize len,
+                                       guint default_duration_s,
+                                       GError **error);
+
+/* whether the frontend can receive what the job needs, apart from the
+ * adapter and frontend the job asks for, which are checked anyway. */
+typedef gboolean (*job_fits_fn)(const struct capture_job *job,
+                                const struct dvb_frontend *fe, void *ctx);
+
+/* hands out the jobs to the frontends as they become free. the jobs which
+ * the fewest frontends can run go first, so that they don't end up waiting
+ * for the others, and then the longest ones, so that the frontends finish
+ * at about the same time. */
+typedef struct JobScheduler_ JobScheduler;
+
+JobScheduler *job_scheduler_new(const GPtrArray *jobs, const GArray *frontends,
+                                job_fits_fn fits, void *ctx);
+void job_scheduler_destroy(JobScheduler *sched);
+
+/* the job the frontend with the given index should run next, or NULL if
+ * none of the remaining ones can run on it. */
+const struct capture_job *job_scheduler_next(JobScheduler *sched,
+                                             guint fe_idx);
+guint job_scheduler_get_num_pending(const JobScheduler *sched);
+
+/* the jobs which none of the frontends can run, which are never handed
+ * out. */
+const GPtrArray *job_scheduler_get_unfit(const JobScheduler *sched);
+
+#endif
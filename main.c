@@ -1,130 +1,636 @@
+#include <errno.h>
 #include <locale.h>
 #include <math.h>
+#include <unistd.h>
 
 #include <gio/gio.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gst/gst.h>
 
 #include "arguments.h"
-#include "deser.h"
+#include "batch.h"
+#include "cache.h"
+#include "cachelog.h"
+#include "demux.h"
+#include "diskspace.h"
+#include "dvbsrc.h"
+#include "dvrbuf.h"
+#include "fanout.h"
 #include "fetch.h"
+#include "fingerprint.h"
+#include "flowstats.h"
+#include "flowtrace.h"
+#include "frontend.h"
+#include "gate.h"
+#include "harvest.h"
+#include "jobrun.h"
 #include "mux_params.h"
+#include "nit.h"
 #include "parser.h"
+#include "plan.h"
+#include "profile.h"
+#include "segment.h"
+#include "silog.h"
+#include "stats.h"
+#include "sweep.h"
+#include "tuneprof.h"
+#include "txdb.h"
+#include "watchdog.h"
 
 struct gstdvb_context {
   const struct getplmux_arguments *const program_args;
   GMainLoop *const mainloop;
   GstElement *const pipeline;
   GstElement *const dvbsrc;
-  GstElement *const filesink;
+  /* a fakesink unless the capture is written by the filesink */
+  GstElement *const sink;
 
   MuxData *const muxdata;
-  GList *muxdata_cur_key;
+  /* every round of profiling the tuning starts over from the first one. it's
+   * the number of MUXes once they've all been captured. */
+  guint muxdata_mux_idx;
   GArray *muxdata_cur_vals;
   guint muxdata_val_idx;
 
+  TransmitterStats *const stats;
+  /* empty if none could be found, in which case dvbsrc uses its defaults */
+  const GArray *const frontends;
+  /* monotonic time, the lock time is 0 until the pipeline starts playing */
+  gint64 tune_start_us;
+  gint64 lock_us;
+  guint64 bytes_captured;
+  /* NULL if the NIT isn't used */
+  NitCollector *const nit;
+  /* the log of the current capture if only the SI is kept */
+  SiLog *si_log;
+  /* splits the current capture per service if requested */
+  ServiceDemux *demux;
+  /* writes the current capture if the quality gate is used */
+  CaptureGate *gate;
+  /* writes the current capture if it's cut into segments */
+  SegmentWriter *segments;
+  /* of the current capture if the whole stream is written */
+  CaptureFingerprint *fingerprint;
+  /* struct mux_capture, written so far for the current MUX */
+  GArray *const mux_captures;
+
+  ReadWatchdog *const watchdog;
+  DvrMonitor *const dvr_monitor;
+  /* chosen for the current capture */
+  struct dvr_buffer_sizes dvr_sizes;
+
+  /* NULL unless the flow of buffers is recorded */
+  FlowRecorder *const flow;
+  /* when the flow was last summed up */
+  gint64 flow_since_us;
+
+  /* NULL unless profiling the tuning */
+  TuneProfiler *const tune_prof;
+  guint tune_round;
+  /* of the current tune. the lock is recorded while the pipeline is being
+   * started and the rest on the streaming thread, which is stopped before
+   * it's read. */
+  struct tune_timing tune_timing;
+
   int timeout_src_id;
+  guint watchdog_src_id;
+  guint flow_src_id;
   gboolean tuning_failed;
+  gboolean capture_rejected;
+  gboolean watchdog_tripped;
+  gboolean tune_profiled;
   unsigned int num_read_fails;
 };
 
-#define READ_FAILS_THRESHOLD 10
+/* how often to check whether data is still coming in. */
+#define WATCHDOG_INTERVAL_MS 500
 
-static GFile *mux_data_get_target_file(void) {
-  return g_file_new_build_filename(g_get_user_data_dir(), "getplmux",
-                                   "transmitters.xml", NULL);
+static gboolean uses_filesink(const struct getplmux_arguments *args) {
+  return !args->si_only && args->quality_gate_seconds == 0 &&
+         args->profile_tuning_rounds == 0 && !uses_segments(args);
 }
 
-static const struct mux_params *
-gstdvb_ctx_get_current_muxparm(const struct gstdvb_context *ctx) {
-  return &g_array_index(ctx->muxdata_cur_vals, struct mux_params,
-                        ctx->muxdata_val_idx);
+/* by the filesink, the quality gate or the segment writer. */
+static gboolean writes_whole_stream(const struct getplmux_arguments *args) {
+  return !args->si_only && args->profile_tuning_rounds == 0;
 }
 
-static void dvbsrc_set_extra_params(GstElement *dvbsrc,
-                                    const GstStructure *extra_params) {
-  for (gint i = 0; i < gst_structure_n_fields(extra_params); ++i) {
-    const gchar *fieldname = gst_structure_nth_field_name(extra_params, i);
-    const GValue *const value =
-        gst_structure_get_value(extra_params, fieldname);
-    g_object_set_property(G_OBJECT(dvbsrc), fieldname, value);
-  }
+static gboolean gstdvb_ctx_has_mux(const struct gstdvb_context *ctx) {
+  return ctx->muxdata_mux_idx < mux_data_get_num_muxes(ctx->muxdata);
 }
 
-static void dvbsrc_set_tune_params(GstElement *dvbsrc,
-                                   const struct tune_params *params) {
-  const guint bw_hz = params->bw_mhz * 1000000;
-  const guint freq_hz = params->freq_khz * 1000;
-  g_object_set(dvbsrc, "bandwidth-hz", bw_hz, "delsys", params->dvb_type,
-               "frequency", freq_hz, "modulation", params->mod, NULL);
+static const gchar *
+gstdvb_ctx_get_current_mux(const struct gstdvb_context *ctx) {
+  return mux_data_get_mux_at(ctx->muxdata, ctx->muxdata_mux_idx);
 }
 
-static void filesink_set_filename(const struct gstdvb_context *ctx) {
+static const struct mux_params *
+gstdvb_ctx_get_current_muxparm(const struct gstdvb_context *ctx) {
+  return &g_array_index(ctx->muxdata_cur_vals, struct mux_params,
+                        ctx->muxdata_val_idx);
+}
+
+static gchar *capture_file_name(const struct gstdvb_context *ctx,
+                                const gchar *suffix) {
   const struct mux_params *const muxparm = gstdvb_ctx_get_current_muxparm(ctx);
 
   GString *const dup_name = g_string_new(muxparm->name);
   g_string_replace(dup_name, "\"", "", 0);
   g_string_replace(dup_name, " ", "_", 0);
 
-  gchar *const fname =
-      g_strdup_printf("%s_%s_%u_kHz.ts", (char *)ctx->muxdata_cur_key->data,
-                      dup_name->str, muxparm->tune_parms.freq_khz);
-  g_object_set(ctx->filesink, "location", fname, NULL);
+  gchar *const fname = g_strdup_printf(
+      "%s_%s_%u_kHz%s", gstdvb_ctx_get_current_mux(ctx), dup_name->str,
+      muxparm->tune_parms.freq_khz, suffix);
+  g_string_free(dup_name, TRUE);
+  return fname;
+}
 
+static void filesink_set_filename(const struct gstdvb_context *ctx) {
+  gchar *const fname = capture_file_name(ctx, ".ts");
+  g_object_set(ctx->sink, "location", fname, NULL);
   g_free(fname);
-  g_string_free(dup_name, TRUE);
+}
+
+static void dvbsrc_set_frontend(GstElement *dvbsrc, const GArray *frontends,
+                                const struct tune_params *params) {
+  /* transmitters which no frontend supports have already been removed. */
+  const struct dvb_frontend *const fe =
+      frontends_find(frontends, params->dvb_type);
+  if (fe) {
+    g_object_set(dvbsrc, "adapter", (gint)fe->adapter, "frontend",
+                 (gint)fe->frontend, NULL);
+  }
 }
 
 static void pipeline_set_properties(const struct gstdvb_context *ctx) {
-  filesink_set_filename(ctx);
-  dvbsrc_set_tune_params(ctx->dvbsrc,
-                         &gstdvb_ctx_get_current_muxparm(ctx)->tune_parms);
+  const struct tune_params *const tune_parms =
+      &gstdvb_ctx_get_current_muxparm(ctx)->tune_parms;
+  if (uses_filesink(ctx->program_args)) {
+    filesink_set_filename(ctx);
+  }
+  dvbsrc_set_frontend(ctx->dvbsrc, ctx->frontends, tune_parms);
+  dvbsrc_set_tune_params(ctx->dvbsrc, tune_parms);
+  g_object_set(ctx->dvbsrc, "dvb-buffer-size", ctx->dvr_sizes.buffer_size,
+               "blocksize", ctx->dvr_sizes.blocksize, NULL);
   if (ctx->program_args->dvbsrc_extra_props) {
     dvbsrc_set_extra_params(ctx->dvbsrc, ctx->program_args->dvbsrc_extra_props);
   }
 }
 
+static gboolean si_log_start(struct gstdvb_context *ctx) {
+  gchar *const fname = capture_file_name(ctx, ".si");
+  GError *err = NULL;
+  ctx->si_log = si_log_open(fname, &err);
+  g_free(fname);
+  if (!ctx->si_log) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void si_log_finish(struct gstdvb_context *ctx) {
+  const guint num_sections = si_log_get_sections_written(ctx->si_log);
+  ctx->bytes_captured = si_log_get_bytes_received(ctx->si_log);
+  GError *err = NULL;
+  if (!si_log_close(g_steal_pointer(&ctx->si_log), &err)) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+  } else if (num_sections > 0) {
+    g_print("Kept %u sections out of %" G_GUINT64_FORMAT " bytes\n",
+            num_sections, ctx->bytes_captured);
+  } else {
+    /* nothing was received, most likely because tuning failed. */
+    gchar *const fname = capture_file_name(ctx, ".si");
+    g_unlink(fname);
+    g_free(fname);
+  }
+}
+
+static void demux_start(struct gstdvb_context *ctx) {
+  gchar *const prefix = capture_file_name(ctx, "");
+  ctx->demux = service_demux_new(prefix,
+                                 ctx->program_args->split_services_list);
+  g_free(prefix);
+}
+
+static void demux_finish(struct gstdvb_context *ctx) {
+  const guint num_outputs = service_demux_get_num_outputs(ctx->demux);
+  GError *err = NULL;
+  if (!service_demux_close(g_steal_pointer(&ctx->demux), &err)) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+  }
+  if (num_outputs > 0) {
+    g_print("Wrote %u services into separate files\n", num_outputs);
+  }
+}
+
+static void on_gate_data(const guint8 *data, gsize len, void *user_data) {
+  struct gstdvb_context *const ctx = user_data;
+  if (ctx->demux) {
+    service_demux_push(ctx->demux, data, len);
+  }
+}
+
+static void gate_start(struct gstdvb_context *ctx) {
+  gchar *const fname = capture_file_name(ctx, ".ts");
+  const gint64 window_us =
+      (gint64)ctx->program_args->quality_gate_seconds * G_USEC_PER_SEC;
+  struct capture_gate_limits limits;
+  capture_gate_limits_init(&limits, window_us);
+  ctx->gate = capture_gate_new(fname, &limits, on_gate_data, ctx);
+  g_free(fname);
+}
+
+static void gate_finish(struct gstdvb_context *ctx) {
+  ctx->bytes_captured = capture_gate_get_bytes_received(ctx->gate);
+  if (capture_gate_end(ctx->gate, g_get_monotonic_time()) ==
+      CAPTURE_GATE_REJECTED) {
+    g_print("Capture discarded : %s\n", capture_gate_get_reason(ctx->gate));
+    ctx->capture_rejected = TRUE;
+  }
+  GError *err = NULL;
+  if (!capture_gate_close(g_steal_pointer(&ctx->gate), &err)) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+  }
+}
+
+/* runs on the streaming thread, apart from the last segment. */
+static void on_segment_done(const gchar *path, void *user_data) {
+  const struct gstdvb_context *const ctx = user_data;
+  const gchar *const command = ctx->program_args->segment_command;
+  if (!command) {
+    return;
+  }
+  /* it was already checked when parsing the arguments. */
+  gchar **argv;
+  g_shell_parse_argv(command, NULL, &argv, NULL);
+  const guint argc = g_strv_length(argv);
+  argv = g_renew(gchar *, argv, argc + 2);
+  argv[argc] = g_strdup(path);
+  argv[argc + 1] = NULL;
+  GError *err = NULL;
+  if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL,
+                     &err)) {
+    g_printerr("Could not run the segment command on %s : %s\n", path,
+               err->message);
+    g_error_free(err);
+  }
+  g_strfreev(argv);
+}
+
+static void segments_start(struct gstdvb_context *ctx) {
+  gchar *const prefix = capture_file_name(ctx, "");
+  const struct segment_limits limits = {
+      .max_duration_us =
+          (gint64)ctx->program_args->segment_seconds * G_USEC_PER_SEC,
+      .max_bytes = (guint64)ctx->program_args->segment_size_mb * 1024 * 1024};
+  ctx->segments = segment_writer_new(prefix, &limits, on_segment_done, ctx);
+  g_free(prefix);
+}
+
+static void segments_finish(struct gstdvb_context *ctx) {
+  ctx->bytes_captured = segment_writer_get_bytes_written(ctx->segments);
+  GError *err = NULL;
+  if (!segment_writer_close(g_steal_pointer(&ctx->segments), &err)) {
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+  }
+}
+
+/* of the previous captures, or a guess if there were none. */
+static guint64 capture_bitrate(const struct gstdvb_context *ctx) {
+  const struct mux_params *const muxparm = gstdvb_ctx_get_current_muxparm(ctx);
+  guint64 bitrate;
+  if (!transmitter_stats_get_bitrate(ctx->stats,
+                                     gstdvb_ctx_get_current_mux(ctx), muxparm,
+                                     &bitrate)) {
+    bitrate = dvr_default_bitrate(muxparm->tune_parms.dvb_type);
+  }
+  return bitrate;
+}
+
+static void dvr_choose_sizes(struct gstdvb_context *ctx) {
+  const struct mux_params *const muxparm = gstdvb_ctx_get_current_muxparm(ctx);
+  const gchar *const mux = gstdvb_ctx_get_current_mux(ctx);
+  dvr_buffer_sizes_for_bitrate(capture_bitrate(ctx), &ctx->dvr_sizes);
+  /* a bigger buffer may have turned out to be needed before. */
+  ctx->dvr_sizes.buffer_size =
+      MAX(ctx->dvr_sizes.buffer_size,
+          transmitter_stats_get_dvr_buffer_size(ctx->stats, mux, muxparm));
+}
+
+/* runs on the streaming thread. */
+static void dvr_on_bitrate_measured(const struct gstdvb_context *ctx) {
+  const guint64 bitrate = dvr_monitor_get_bitrate(ctx->dvr_monitor);
+  struct dvr_buffer_sizes sizes;
+  dvr_buffer_sizes_for_bitrate(bitrate, &sizes);
+  g_print("Measured %.1f Mbit/s, reading %u bytes at a time\n",
+          (gdouble)bitrate / 1000000, sizes.blocksize);
+  g_object_set(ctx->dvbsrc, "blocksize", sizes.blocksize, NULL);
+}
+
+/* the DVR buffer is made bigger for the next capture if it overflowed. */
+static guint dvr_next_buffer_size(const struct gstdvb_context *ctx) {
+  const guint64 overruns = dvr_monitor_get_overruns(ctx->dvr_monitor);
+  if (overruns == 0) {
+    return ctx->dvr_sizes.buffer_size;
+  }
+  const guint next = dvr_buffer_size_grow(ctx->dvr_sizes.buffer_size);
+  g_print("The DVR buffer of %u bytes overflowed %" G_GUINT64_FORMAT
+          " times, using %u bytes next time\n",
+          ctx->dvr_sizes.buffer_size, overruns, next);
+  return next;
+}
+
+static void tune_timing_start(struct gstdvb_context *ctx) {
+  gint adapter, frontend;
+  g_object_get(ctx->dvbsrc, "adapter", &adapter, "frontend", &frontend, NULL);
+  const struct tune_timing timing = {
+      .adapter = (guint)adapter,
+      .frontend = (guint)frontend,
+      .freq_khz = gstdvb_ctx_get_current_muxparm(ctx)->tune_parms.freq_khz,
+      .playing_us = g_get_monotonic_time()};
+  ctx->tune_timing = timing;
+  ctx->tune_profiled = FALSE;
+}
+
+static void tune_timing_finish(const struct gstdvb_context *ctx) {
+  gchar *const described = tune_timing_describe(&ctx->tune_timing);
+  g_print("%s\n", described);
+  g_free(described);
+  tune_profiler_add(ctx->tune_prof, &ctx->tune_timing);
+}
+
+/* when the disk fills up, every capture after that fails, so the scan stops
+ * before starting one there's no room for. */
+static gboolean disk_has_room_for_capture(const struct gstdvb_context *ctx) {
+  GError *err = NULL;
+  struct disk_info info;
+  if (!disk_query(DISK_CAPTURE_DIR, &info, &err)) {
+    /* the filesink will have its own say about it. */
+    g_printerr("%s\n", err->message);
+    g_error_free(err);
+    return TRUE;
+  }
+  const guint64 size = capture_estimate_size(
+      capture_bitrate(ctx), (guint)ctx->program_args->capture_duration_seconds);
+  if (disk_has_room(info.free_bytes, size)) {
+    return TRUE;
+  }
+  g_printerr("Not enough free space for capturing %s, which takes about "
+             "%" G_GUINT64_FORMAT " MB, stopping\n",
+             gstdvb_ctx_get_current_mux(ctx), size / (1024 * 1024));
+  return FALSE;
+}
+
 static void capture_start(struct gstdvb_context *ctx) {
   ctx->tuning_failed = FALSE;
+  ctx->capture_rejected = FALSE;
+  ctx->watchdog_tripped = FALSE;
   ctx->num_read_fails = 0;
+  read_watchdog_start(ctx->watchdog);
+  dvr_monitor_start(ctx->dvr_monitor);
+  dvr_choose_sizes(ctx);
+  ctx->tune_start_us = g_get_monotonic_time();
+  ctx->lock_us = 0;
+  ctx->bytes_captured = 0;
+  if (writes_whole_stream(ctx->program_args) &&
+      !disk_has_room_for_capture(ctx)) {
+    g_main_loop_quit(ctx->mainloop);
+    return;
+  }
+  if (ctx->program_args->si_only && !si_log_start(ctx)) {
+    g_main_loop_quit(ctx->mainloop);
+    return;
+  }
+  if (ctx->program_args->split_services) {
+    demux_start(ctx);
+  }
+  if (ctx->program_args->quality_gate_seconds > 0) {
+    gate_start(ctx);
+  }
+  if (uses_segments(ctx->program_args)) {
+    segments_start(ctx);
+  }
+  if (writes_whole_stream(ctx->program_args)) {
+    ctx->fingerprint = capture_fingerprint_new();
+  }
+  if (ctx->flow) {
+    flow_recorder_reset(ctx->flow);
+  }
   pipeline_set_properties(ctx);
   const struct mux_params *const muxparm = gstdvb_ctx_get_current_muxparm(ctx);
+  if (ctx->nit) {
+    nit_collector_start(ctx->nit, gstdvb_ctx_get_current_mux(ctx),
+                        muxparm->tune_parms.freq_khz);
+  }
   g_print("Starting tune to %s, transmitter %s\n",
-          (const char *)ctx->muxdata_cur_key->data, muxparm->name);
+          gstdvb_ctx_get_current_mux(ctx), muxparm->name);
+  if (ctx->tune_prof) {
+    tune_timing_start(ctx);
+  }
   gst_element_set_state(ctx->pipeline, GST_STATE_PLAYING);
 }
 
 static gboolean pipeline_set_null_state(gpointer user_data) {
   struct gstdvb_context *const ctx = user_data;
+  ctx->timeout_src_id = 0;
+  if (ctx->watchdog_src_id) {
+    g_source_remove(ctx->watchdog_src_id);
+    ctx->watchdog_src_id = 0;
+  }
+  if (ctx->flow_src_id) {
+    g_source_remove(ctx->flow_src_id);
+    ctx->flow_src_id = 0;
+  }
+  gint64 pos;
+  if (gst_element_query_position(ctx->sink, GST_FORMAT_BYTES, &pos)) {
+    ctx->bytes_captured = (guint64)pos;
+  }
   gst_element_set_state(ctx->pipeline, GST_STATE_NULL);
   return FALSE;
 }
 
-static void switch_to_next_mux(struct gstdvb_context *ctx) {
-  ctx->muxdata_cur_key = ctx->muxdata_cur_key->next;
+static void flow_print_summary(struct gstdvb_context *ctx) {
+  const gint64 now_us = g_get_monotonic_time();
+  struct flow_summary summary;
+  flow_recorder_collect(ctx->flow, &summary);
+  gchar *const formatted =
+      flow_summary_format(&summary, now_us - ctx->flow_since_us);
+  g_print("%s", formatted);
+  g_free(formatted);
+  ctx->flow_since_us = now_us;
+}
+
+static void switch_to_mux(struct gstdvb_context *ctx, guint idx) {
+  ctx->muxdata_mux_idx = idx;
   ctx->muxdata_val_idx = 0;
-  if (ctx->muxdata_cur_key) {
-    ctx->muxdata_cur_vals = mux_data_get_transmitters_for_mux(
-        ctx->muxdata, ctx->muxdata_cur_key->data);
+  if (gstdvb_ctx_has_mux(ctx)) {
+    ctx->muxdata_cur_vals = mux_data_get_transmitters_at(ctx->muxdata, idx);
   }
 }
 
-static void switch_to_next_param(struct gstdvb_context *ctx) {
-  if (ctx->tuning_failed || ctx->num_read_fails >= READ_FAILS_THRESHOLD) {
+static void switch_to_next_mux(struct gstdvb_context *ctx) {
+  switch_to_mux(ctx, ctx->muxdata_mux_idx + 1);
+}
+
+/* when profiling, every transmitter is tuned to once per round. */
+static void switch_to_next_tune(struct gstdvb_context *ctx) {
+  if (++ctx->muxdata_val_idx < ctx->muxdata_cur_vals->len) {
+    return;
+  }
+  switch_to_next_mux(ctx);
+  if (!gstdvb_ctx_has_mux(ctx) &&
+      ++ctx->tune_round < (guint)ctx->program_args->profile_tuning_rounds) {
+    switch_to_mux(ctx, 0);
+  }
+}
+
+static void capture_record_stats(const struct gstdvb_context *ctx,
+                                 const gchar *fingerprint) {
+  const gint64 now_us = g_get_monotonic_time();
+  /* a capture thrown away by the quality gate is as good as none. */
+  const gboolean locked =
+      !ctx->tuning_failed && !ctx->capture_rejected && ctx->lock_us != 0;
+  const struct capture_result result = {
+      .locked = locked,
+      .time_to_lock_s =
+          locked ? (gdouble)(ctx->lock_us - ctx->tune_start_us) / G_USEC_PER_SEC
+                 : 0,
+      .duration_s =
+          locked ? (gdouble)(now_us - ctx->lock_us) / G_USEC_PER_SEC : 0,
+      .read_fails = ctx->num_read_fails,
+      .bytes = ctx->bytes_captured,
+      .filtered = !writes_whole_stream(ctx->program_args),
+      .dvr_buffer_size = locked ? dvr_next_buffer_size(ctx) : 0,
+      .fingerprint = fingerprint};
+  transmitter_stats_record(ctx->stats, gstdvb_ctx_get_current_mux(ctx),
+                           gstdvb_ctx_get_current_muxparm(ctx), &result,
+                           g_get_real_time() / G_USEC_PER_SEC);
+}
+
+static gboolean capture_succeeded(const struct gstdvb_context *ctx) {
+  return !ctx->tuning_failed && !ctx->capture_rejected &&
+         !ctx->watchdog_tripped;
+}
+
+/* keeps the capture just finished for mux_captures_dedup(), if this run
+ * wrote it. a file which is there anyway is left over from an earlier run,
+ * or from a capture the quality gate threw away, and may well be a
+ * different recording. takes the fingerprint. */
+static void mux_captures_add(struct gstdvb_context *ctx, gchar *fingerprint) {
+  /* segments are files of their own, which are never deduplicated. */
+  if (!writes_whole_stream(ctx->program_args) ||
+      uses_segments(ctx->program_args) || ctx->bytes_captured == 0 ||
+      ctx->capture_rejected) {
+    g_free(fingerprint);
+    return;
+  }
+  gchar *const fname = capture_file_name(ctx, ".ts");
+  const struct mux_capture capture = {.path = fname,
+                                      .fingerprint = fingerprint,
+                                      .complete = capture_succeeded(ctx)};
+  g_array_append_val(ctx->mux_captures, capture);
+}
+
+/* the new link is renamed over the capture, so that the capture doesn't go
+ * missing if linking fails. */
+static void replace_with_link(const gchar *path, const gchar *target) {
+  gchar *const tmp = g_strconcat(path, ".dedup", NULL);
+  g_unlink(tmp);
+  if (link(target, tmp) != 0 || g_rename(tmp, path) != 0) {
+    const int errsv = errno;
+    g_printerr("Could not replace %s with a link to %s : %s\n", path, target,
+               g_strerror(errsv));
+    g_unlink(tmp);
+  } else {
+    g_print("Replaced %s with a link to %s\n", path, target);
+  }
+  g_free(tmp);
+}
+
+/* incomplete captures of a MUX are usually followed by a complete one from
+ * the next transmitter, which is the very same stream if they're in a
+ * single frequency network. */
+static void mux_captures_dedup(struct gstdvb_context *ctx) {
+  for (guint i = 0; i < ctx->mux_captures->len; ++i) {
+    const struct mux_capture *const capture =
+        &g_array_index(ctx->mux_captures, struct mux_capture, i);
+    const struct mux_capture *const original =
+        mux_captures_find_original(ctx->mux_captures, i);
+    if (!original) {
+      continue;
+    }
+    if (ctx->program_args->dedup) {
+      replace_with_link(capture->path, original->path);
+    } else {
+      g_print("%s is redundant, as %s has the same transport stream\n",
+              capture->path, original->path);
+    }
+  }
+  g_array_set_size(ctx->mux_captures, 0);
+}
+
+/* moves on to the next MUX once a capture of the current one succeeds. */
+static void switch_to_next_capture(struct gstdvb_context *ctx) {
+  if (!capture_succeeded(ctx)) {
     /* capture incomplete/failed : try with next transmitter for this MUX */
     ctx->muxdata_val_idx++;
     if (ctx->muxdata_val_idx >= ctx->muxdata_cur_vals->len) {
       g_print(
           "All transmitters for %s tried, switching to next MUX if available\n",
-          (const char *)ctx->muxdata_cur_key->data);
+          gstdvb_ctx_get_current_mux(ctx));
       switch_to_next_mux(ctx);
     }
   } else {
     /* capture for this MUX successful, go to next one */
     switch_to_next_mux(ctx);
   }
+}
 
-  if (ctx->muxdata_cur_key) {
+static void switch_to_next_param(struct gstdvb_context *ctx) {
+  if (ctx->si_log) {
+    si_log_finish(ctx);
+  }
+  /* the gate may still pass on what it's holding to the demux. */
+  if (ctx->gate) {
+    gate_finish(ctx);
+  }
+  if (ctx->segments) {
+    segments_finish(ctx);
+  }
+  if (ctx->demux) {
+    demux_finish(ctx);
+  }
+  /* whatever came in since the last summary. */
+  if (ctx->flow) {
+    flow_print_summary(ctx);
+  }
+  if (ctx->tune_prof) {
+    /* the tunes are cut short, so they'd only spoil the statistics. */
+    tune_timing_finish(ctx);
+    switch_to_next_tune(ctx);
+  } else {
+    gchar *fingerprint = NULL;
+    if (ctx->fingerprint) {
+      fingerprint = capture_fingerprint_get_digest(ctx->fingerprint);
+      g_clear_pointer(&ctx->fingerprint, capture_fingerprint_destroy);
+    }
+    capture_record_stats(ctx, fingerprint);
+    const guint mux_idx = ctx->muxdata_mux_idx;
+    mux_captures_add(ctx, fingerprint);
+    switch_to_next_capture(ctx);
+    if (ctx->muxdata_mux_idx != mux_idx) {
+      mux_captures_dedup(ctx);
+    }
+  }
+
+  if (gstdvb_ctx_has_mux(ctx)) {
     capture_start(ctx);
   } else {
     /* we're done */
@@ -132,18 +638,64 @@ static void switch_to_next_param(struct gstdvb_context *ctx) {
   }
 }
 
+/* stops the capture before its time is up. */
+static void capture_stop(struct gstdvb_context *ctx) {
+  if (ctx->timeout_src_id) {
+    g_source_remove(ctx->timeout_src_id);
+    ctx->timeout_src_id = 0;
+    g_idle_add(pipeline_set_null_state, ctx);
+  }
+}
+
+static void watchdog_trip(struct gstdvb_context *ctx) {
+  if (!ctx->watchdog_tripped) {
+    ctx->watchdog_tripped = TRUE;
+    g_print("Signal lost, jumping to next param : %s\n",
+            read_watchdog_get_reason(ctx->watchdog));
+    capture_stop(ctx);
+  }
+}
+
+static gboolean on_watchdog_interval(gpointer user_data) {
+  struct gstdvb_context *const ctx = user_data;
+  if (read_watchdog_check_stall(ctx->watchdog, g_get_monotonic_time())) {
+    ctx->watchdog_src_id = 0;
+    watchdog_trip(ctx);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean on_flow_interval(gpointer user_data) {
+  flow_print_summary(user_data);
+  return TRUE;
+}
+
 static void pipeline_state_changed(GstMessage *msg,
                                    struct gstdvb_context *ctx) {
   GstState old_state, new_state;
   gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
 
   if (old_state == GST_STATE_PAUSED && new_state == GST_STATE_PLAYING) {
+    ctx->lock_us = g_get_monotonic_time();
     g_print("Tuned to %d kHz, starting capture for %d seconds...\n",
             gstdvb_ctx_get_current_muxparm(ctx)->tune_parms.freq_khz,
             ctx->program_args->capture_duration_seconds);
     ctx->timeout_src_id =
         g_timeout_add_seconds(ctx->program_args->capture_duration_seconds,
                               pipeline_set_null_state, ctx);
+    ctx->watchdog_src_id =
+        g_timeout_add(WATCHDOG_INTERVAL_MS, on_watchdog_interval, ctx);
+    if (ctx->flow) {
+      ctx->flow_since_us = g_get_monotonic_time();
+      ctx->flow_src_id = g_timeout_add_seconds(
+          ctx->program_args->flow_stats_seconds, on_flow_interval, ctx);
+    }
+    /* the first write may come in before the pipeline is done changing its
+     * state. */
+    if (ctx->tune_profiled) {
+      capture_stop(ctx);
+    }
   } else if (new_state == GST_STATE_NULL) {
     switch_to_next_param(ctx);
   }
@@ -195,15 +747,24 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer data) {
       const gchar *const name = gst_structure_get_name(stru);
       if (g_strcmp0(name, "dvb-read-failure") == 0) {
         ++ctx->num_read_fails;
-      }
-      if (ctx->num_read_fails >= READ_FAILS_THRESHOLD) {
-        g_print("Signal lost, jumping to next param");
-        g_source_remove(ctx->timeout_src_id);
-        g_idle_add(pipeline_set_null_state, ctx);
+        if (read_watchdog_fail(ctx->watchdog, g_get_monotonic_time())) {
+          watchdog_trip(ctx);
+        }
       }
     }
     break;
 
+  case GST_MESSAGE_APPLICATION:
+    if (gst_message_has_name(msg, "capture-rejected")) {
+      g_print("Stream quality too poor, jumping to next param\n");
+      capture_stop(ctx);
+    } else if (gst_message_has_name(msg, "tune-profiled")) {
+      /* nothing more to find out about this tune. */
+      ctx->tune_profiled = TRUE;
+      capture_stop(ctx);
+    }
+    break;
+
   case GST_MESSAGE_STATE_CHANGED: {
     /* we don't really care about individual elements */
     if (msg->src == GST_OBJECT(ctx->pipeline)) {
@@ -219,6 +780,41 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer data) {
   return TRUE;
 }
 
+/* runs on whichever thread posted the message, which for the lock is the one
+ * setting the pipeline to PLAYING, as that's when dvbsrc tunes. */
+static void on_sync_element_message(GstBus *bus, GstMessage *msg,
+                                    gpointer user_data) {
+  (void)bus;
+
+  struct gstdvb_context *const ctx = user_data;
+  gint64 *const lock_us = &ctx->tune_timing.stage_us[TUNE_STAGE_LOCK];
+  const GstStructure *const stru = gst_message_get_structure(msg);
+  gboolean locked;
+  if (*lock_us == 0 && msg->src == GST_OBJECT(ctx->dvbsrc) &&
+      gst_structure_has_name(stru, "dvb-frontend-stats") &&
+      gst_structure_get_boolean(stru, "lock", &locked) && locked) {
+    *lock_us = g_get_monotonic_time();
+  }
+}
+
+/* runs on the streaming thread when the sink gets a buffer, which is where
+ * it would be written to disk if it wasn't only profiling the tuning. */
+static void on_sink_handoff(GstElement *object, GstBuffer *buf, GstPad *pad,
+                            gpointer user_data) {
+  (void)buf;
+  (void)pad;
+
+  struct gstdvb_context *const ctx = user_data;
+  gint64 *const write_us = &ctx->tune_timing.stage_us[TUNE_STAGE_FIRST_WRITE];
+  if (*write_us == 0) {
+    *write_us = g_get_monotonic_time();
+    gst_element_post_message(
+        object, gst_message_new_application(
+                    GST_OBJECT(object),
+                    gst_structure_new_empty("tune-profiled")));
+  }
+}
+
 static void on_tuning_fail(GstElement *object, gpointer user_data) {
   (void)object;
 
@@ -226,185 +822,612 @@ static void on_tuning_fail(GstElement *object, gpointer user_data) {
   ctx->tuning_failed = TRUE;
 }
 
+/* runs on the streaming thread, which is stopped whenever the pipeline is. */
+static GstPadProbeReturn on_dvbsrc_buffer(GstPad *pad, GstPadProbeInfo *info,
+                                          gpointer user_data) {
+  (void)pad;
+
+  struct gstdvb_context *const ctx = user_data;
+  const gint64 now_us = g_get_monotonic_time();
+  read_watchdog_buffer(ctx->watchdog, now_us);
+  if (ctx->tune_prof &&
+      ctx->tune_timing.stage_us[TUNE_STAGE_FIRST_BUFFER] == 0) {
+    ctx->tune_timing.stage_us[TUNE_STAGE_FIRST_BUFFER] = now_us;
+  }
+  GstBuffer *const buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  GstMapInfo map;
+  if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+    if (dvr_monitor_push(ctx->dvr_monitor, map.data, map.size, now_us)) {
+      dvr_on_bitrate_measured(ctx);
+    }
+    if (ctx->nit) {
+      nit_collector_push(ctx->nit, map.data, map.size);
+    }
+    if (ctx->si_log) {
+      si_log_push(ctx->si_log, map.data, map.size, g_get_real_time());
+    }
+    if (ctx->gate) {
+      const gboolean was_pending =
+          capture_gate_get_state(ctx->gate) == CAPTURE_GATE_PENDING;
+      if (capture_gate_push(ctx->gate, map.data, map.size, now_us) ==
+              CAPTURE_GATE_REJECTED &&
+          was_pending) {
+        /* the rest of the capture isn't worth waiting for. */
+        gst_element_post_message(
+            ctx->dvbsrc,
+            gst_message_new_application(
+                GST_OBJECT(ctx->dvbsrc),
+                gst_structure_new_empty("capture-rejected")));
+      }
+    } else if (ctx->demux) {
+      service_demux_push(ctx->demux, map.data, map.size);
+    }
+    if (ctx->segments) {
+      segment_writer_push(ctx->segments, map.data, map.size, now_us,
+                          g_get_real_time());
+    }
+    if (ctx->fingerprint) {
+      capture_fingerprint_push(ctx->fingerprint, map.data, map.size);
+    }
+    gst_buffer_unmap(buf, &map);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
 static gboolean on_event_loop_start(gpointer user_data) {
   capture_start(user_data);
   return FALSE;
 }
 
-static MuxData *fetch_muxdata_hash(double lat, double lon) {
-  CURLcode err;
-  GString *content = fetch_mux_data_for_location(lat, lon, &err);
-  if (!content) {
-    g_printerr("Could not obtain location-based transmitter list : %s",
-               curl_easy_strerror(err));
-    return NULL;
-  }
-  MuxData *const parsed =
-      parse_mux_params_from_html(content->str, (int)content->len);
-  g_string_free(content, TRUE);
+static MuxData *lookup_muxdata_offline(double lat, double lon,
+                                       const struct mux_filter *filter) {
+  GFile *const f = cache_get_transmitter_db_file();
+  gchar *const path = g_file_get_path(f);
+  g_object_unref(f);
 
-  content = fetch_tune_params_html(&err);
-  if (!content) {
-    g_printerr("Could not obtain complete transmitter list : %s",
-               curl_easy_strerror(err));
-    mux_data_destroy(parsed);
+  GError *err = NULL;
+  TransmitterDb *const db = transmitter_db_load(path, &err);
+  g_free(path);
+  if (!db) {
+    g_printerr("Could not load the transmitter database : %s\n", err->message);
+    g_error_free(err);
     return NULL;
   }
 
-  parse_tune_params_to_mux_params(parsed, content->str, (int)content->len);
-  g_string_free(content, TRUE);
-  return parsed;
+  /* no point in looking further than the filter would let through anyway. */
+  const double max_km = isfinite(filter->max_distance)
+                            ? MIN(filter->max_distance,
+                                  TRANSMITTER_DB_LOOKUP_RADIUS_KM)
+                            : TRANSMITTER_DB_LOOKUP_RADIUS_KM;
+  MuxData *const md = transmitter_db_lookup(db, lat, lon, max_km);
+  transmitter_db_destroy(db);
+  return md;
 }
 
-static void write_to_outstream(const guint8 *buf, gssize bufsiz, void *ctx) {
-  g_output_stream_write(ctx, buf,
-                        bufsiz < 0 ? strlen((const char *)buf) : (gsize)bufsiz,
-                        NULL, NULL);
+static TransmitterStats *load_transmitter_stats(const gchar *path) {
+  GError *err = NULL;
+  TransmitterStats *const stats = transmitter_stats_load(path, &err);
+  if (stats) {
+    return stats;
+  }
+  /* not being able to use the history shouldn't prevent capturing. */
+  g_printerr("Could not load capture statistics from %s : %s\n", path,
+             err->message);
+  g_error_free(err);
+  return transmitter_stats_new();
 }
 
-static void mux_data_save_to_file(MuxData *md) {
-  GFile *const f = mux_data_get_target_file();
+static void save_transmitter_stats(TransmitterStats *stats, GFile *f) {
   {
     GFile *const parent = g_file_get_parent(f);
     g_file_make_directory_with_parents(parent, NULL, NULL);
     g_object_unref(parent);
   }
+  gchar *const path = g_file_get_path(f);
+  GError *err = NULL;
+  if (!transmitter_stats_save(stats, path, &err)) {
+    g_printerr("Could not save capture statistics to %s : %s\n", path,
+               err->message);
+    g_error_free(err);
+  }
+  g_free(path);
+}
 
-  GOutputStream *out =
-      G_OUTPUT_STREAM(g_file_create(f, G_FILE_CREATE_NONE, NULL, NULL));
-  GObject *unref_me = G_OBJECT(out);
-  if (!out) {
-    GFileIOStream *io = g_file_open_readwrite(f, NULL, NULL);
-    if (!io) {
-      goto beach;
-    }
-    out = g_io_stream_get_output_stream(G_IO_STREAM(io));
-    unref_me = G_OBJECT(io);
+static GArray *discover_frontends(const struct getplmux_arguments *args) {
+  GFile *const f = cache_get_frontends_file();
+  {
+    GFile *const parent = g_file_get_parent(f);
+    g_file_make_directory_with_parents(parent, NULL, NULL);
+    g_object_unref(parent);
   }
+  gchar *const cache_path = g_file_get_path(f);
+  g_object_unref(f);
 
-  serialize_muxdata_hash(md, write_to_outstream, out);
-  g_object_unref(unref_me);
+  GArray *const frontends = frontends_discover(
+      args->dvb_root ? args->dvb_root : FRONTEND_DEFAULT_DEV_ROOT, cache_path,
+      frontend_probe_device, NULL);
+  g_free(cache_path);
+  return frontends;
+}
 
-beach:
-  g_object_unref(f);
+static void print_frontends(const GArray *frontends) {
+  for (guint i = 0; i < frontends->len; ++i) {
+    const struct dvb_frontend *const fe =
+        &g_array_index(frontends, struct dvb_frontend, i);
+    gchar *const delsys = dvb_frontend_describe_delsys(fe);
+    g_print("adapter%u/frontend%u : %s : %s\n", fe->adapter, fe->frontend,
+            fe->name, delsys);
+    g_free(delsys);
+  }
 }
 
-static gssize read_from_input_stream(guint8 *buf, gsize bufsiz, void *ctx) {
-  return g_input_stream_read(ctx, buf, bufsiz, NULL, NULL);
+/* if the frontend is chosen explicitly, it's the only one that can be used.
+ * dvbsrc defaults to 0 for both. */
+static void restrict_frontends(GArray *frontends,
+                               const GstStructure *extra_props) {
+  if (!extra_props || (!gst_structure_has_field(extra_props, "adapter") &&
+                       !gst_structure_has_field(extra_props, "frontend"))) {
+    return;
+  }
+  gint adapter = 0, frontend = 0;
+  gst_structure_get_int(extra_props, "adapter", &adapter);
+  gst_structure_get_int(extra_props, "frontend", &frontend);
+  for (guint i = frontends->len; i-- > 0;) {
+    const struct dvb_frontend *const fe =
+        &g_array_index(frontends, struct dvb_frontend, i);
+    if (fe->adapter != (guint)adapter || fe->frontend != (guint)frontend) {
+      g_array_remove_index(frontends, i);
+    }
+  }
 }
 
-static MuxData *mux_data_read_from_file(void) {
-  GFile *const f = mux_data_get_target_file();
-  GFileInputStream *const is = g_file_read(f, NULL, NULL);
-  MuxData *md = NULL;
-  if (is) {
-    md = deserialize_muxdata_hash(read_from_input_stream, is, NULL);
-    g_object_unref(is);
+static gboolean is_unsupported_by_frontends(const gchar *mux,
+                                            const struct mux_params *par,
+                                            void *ctx) {
+  const GArray *const frontends = ctx;
+  if (frontends_find(frontends, par->tune_parms.dvb_type)) {
+    return FALSE;
   }
-  g_object_unref(f);
-  return md;
+  g_print("Skipping %s transmitter %s, as no frontend supports its delivery "
+          "system\n",
+          mux, par->name);
+  return TRUE;
+}
+
+/* the muxdata used for capturing has been filtered and reordered, so the
+ * cache is read again in full and only the changes are logged. runs with a
+ * filter never save the cache, so this is also where a long log is folded
+ * back into it. */
+static void update_cache_from_nit(NitCollector *nit, GFile *cache_file) {
+  MuxData *const cached = mux_data_read_from_file(cache_file, NULL);
+  if (!cached) {
+    return;
+  }
+  GArray *const snapshot = cache_snapshot_take(cached);
+  nit_collector_apply(nit, cached);
+  GArray *const updates = cache_snapshot_diff(snapshot, cached);
+  if (updates->len > 0) {
+    g_print("Updating %u cached transmitters with the parameters from the "
+            "NIT\n",
+            updates->len);
+    if (mux_data_log_is_long(cache_file)) {
+      mux_data_save_to_file(cached, cache_file);
+    } else {
+      mux_data_log_updates(cache_file, updates);
+    }
+  }
+  g_array_unref(updates);
+  g_array_unref(snapshot);
+  mux_data_destroy(cached);
 }
 
 static gboolean location_is_specified(const struct getplmux_arguments *args) {
   return isfinite(args->latitude) && isfinite(args->longitude);
 }
 
+/* drops what the filter rejects and caches the rest. */
+static void finish_muxdata(MuxData *muxdata,
+                           const struct getplmux_arguments *args,
+                           GFile *cache_file) {
+  /* the parsers already skip most of what the filter rejects, but the
+   * delivery system of the location-based transmitters is only known after
+   * merging, and the offline database doesn't filter at all. */
+  mux_data_apply_filter(muxdata, &args->filter);
+
+  /* saving a filtered list would make the cache incomplete for later runs
+   * without the filter. this is done before the transmitters are reordered,
+   * as that drops the ones which are known not to work at the moment. a
+   * cache read as it was isn't written at all, and one with changes logged
+   * since it was saved gets them folded in. */
+  if (!mux_filter_is_active(&args->filter) && mux_data_is_dirty(muxdata)) {
+    mux_data_save_to_file(muxdata, cache_file);
+  }
+}
+
+static MuxData *load_plan(const struct getplmux_arguments *args,
+                          Profile *profile) {
+  const gint64 start_us = g_get_monotonic_time();
+  GError *err = NULL;
+  MuxData *const muxdata = plan_load(args->plan_file, &err);
+  if (!muxdata) {
+    g_printerr("Could not load the plan : %s\n", err->message);
+    g_error_free(err);
+    return NULL;
+  }
+  mux_data_apply_filter(muxdata, &args->filter);
+  profile_add(profile, "loading the plan", start_us, g_get_monotonic_time());
+  return muxdata;
+}
+
+/* returns the process exit code. */
+static int export_plan(const struct getplmux_arguments *args,
+                       MuxData *muxdata) {
+  GError *err = NULL;
+  if (args->plan_out && !plan_save(muxdata, args->plan_out, &err)) {
+    g_printerr("Could not save the plan : %s\n", err->message);
+    g_error_free(err);
+    return 1;
+  }
+  if (args->channels_out) {
+    gchar *const conf = plan_format_channels_conf(muxdata);
+    const gboolean saved =
+        g_file_set_contents(args->channels_out, conf, -1, &err);
+    g_free(conf);
+    if (!saved) {
+      g_printerr("Could not save the channels : %s\n", err->message);
+      g_error_free(err);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+struct muxdata_load {
+  const struct getplmux_arguments *args;
+  GFile *cache_file;
+  Profile *profile;
+  MuxData *muxdata;
+};
+
+/* reads the cached transmitters, or looks them up if there aren't any. */
+static gpointer load_muxdata(gpointer data) {
+  struct muxdata_load *const load = data;
+  const struct getplmux_arguments *const args = load->args;
+  const gint64 start_us = g_get_monotonic_time();
+
+  MuxData *muxdata = NULL;
+  if (!args->force_refresh) {
+    muxdata = mux_data_read_from_file(load->cache_file, &args->filter);
+  }
+  if (!muxdata) {
+    if (location_is_specified(args)) {
+      muxdata = args->offline
+                    ? lookup_muxdata_offline(args->latitude, args->longitude,
+                                             &args->filter)
+                    : fetch_muxdata(args->latitude, args->longitude,
+                                         &args->filter);
+    } else {
+      g_printerr("Cached transmitters not available, but location not "
+                 "specified so cannot fetch - quitting.\n");
+    }
+  }
+  if (muxdata) {
+    finish_muxdata(muxdata, args, load->cache_file);
+  }
+
+  profile_add(load->profile, "loading the transmitters", start_us,
+              g_get_monotonic_time());
+  load->muxdata = muxdata;
+  return NULL;
+}
+
 int main(int argc, char **argv) {
+  const gint64 start_us = g_get_monotonic_time();
   setlocale(LC_ALL, "");
 
-  {
+  int rv = 1;
+  struct getplmux_arguments program_args;
+  if (parse_arguments(&program_args, &argc, &argv)) {
+    goto beach;
+  }
+
+  /* a plan has everything needed for tuning already. */
+  if (!program_args.plan_file) {
     CURLcode init_rv = curl_global_init(CURL_GLOBAL_ALL);
     if (init_rv != CURLE_OK) {
       g_printerr("Failed to initialise libcurl : %s",
                  curl_easy_strerror(init_rv));
-      return 1;
+      goto beach;
     }
+    parser_init();
   }
 
-  int rv = 1;
-  struct getplmux_arguments program_args;
-  if (parse_arguments(&program_args, argc, argv)) {
+  /* GStreamer would otherwise be the one to complain about them. */
+  if ((program_args.list_frontends || program_args.batch_file ||
+       program_args.harvest) &&
+      check_leftover_arguments(argc, argv)) {
     goto beach;
   }
 
-  GstElement *source = gst_element_factory_make("dvbsrc", NULL);
-  if (!source) {
-    g_printerr("Failed to create a 'dvbsrc' element.\n"
-               "Make sure you have gst-plugins-bad installed.\n");
+  if (program_args.list_frontends) {
+    GArray *const frontends = discover_frontends(&program_args);
+    print_frontends(frontends);
+    g_array_unref(frontends);
+    rv = 0;
     goto beach;
   }
 
-  MuxData *muxdata = NULL;
-  if (!program_args.force_refresh) {
-    muxdata = mux_data_read_from_file();
+  if (program_args.batch_file) {
+    rv = run_batch(&program_args);
+    goto beach;
   }
 
-  if (!muxdata) {
+  if (program_args.harvest) {
     if (location_is_specified(&program_args)) {
-      muxdata =
-          fetch_muxdata_hash(program_args.latitude, program_args.longitude);
+      rv = run_harvest(&program_args);
     } else {
-      g_printerr("Cached transmitters not available, but location not "
-                 "specified so cannot fetch - quitting.\n");
+      g_printerr("Harvesting transmitters requires a location.\n");
+    }
+    goto beach;
+  }
+
+  Profile *const profile =
+      program_args.profile_startup ? profile_new("Startup", start_us) : NULL;
+  profile_add(profile, "parsing the options", start_us, g_get_monotonic_time());
+
+  GFile *const cache_file = program_args.cache_file
+                               ? g_file_new_for_path(program_args.cache_file)
+                               : cache_get_default_file();
+
+  /* GStreamer scans for plugins while initialising, which can take a while
+   * on slow storage, so the transmitters are loaded in the meantime. sweeping
+   * needs the frontends though, which can only be chosen afterwards. */
+  struct muxdata_load load = {.args = &program_args,
+                              .cache_file = cache_file,
+                              .profile = profile,
+                              .muxdata = NULL};
+  MuxData *muxdata = NULL;
+  GThread *loader = NULL;
+  if (program_args.plan_file) {
+    /* quick enough not to need a thread of its own. */
+    muxdata = load_plan(&program_args, profile);
+  } else if (!program_args.sweep) {
+    loader = g_thread_new("load", load_muxdata, &load);
+  }
+
+  gint64 step_us = g_get_monotonic_time();
+  GstElement *pipeline = NULL;
+  GstElement *source = NULL;
+  GstElement *sink = NULL;
+  if (init_gstreamer(&program_args, &argc, &argv) == 0) {
+    profile_add(profile, "initialising GStreamer", step_us,
+                g_get_monotonic_time());
+    step_us = g_get_monotonic_time();
+    source = gst_element_factory_make("dvbsrc", NULL);
+    if (source) {
+      sink = gst_element_factory_make(
+          uses_filesink(&program_args) ? "filesink" : "fakesink", NULL);
+      pipeline = gst_pipeline_new("mux-recorder");
+      gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
+      if (!program_args.shm_socket) {
+        gst_element_link(source, sink);
+      } else if (!shm_fanout_link(GST_BIN(pipeline), source, sink,
+                                  program_args.shm_socket)) {
+        g_clear_pointer(&pipeline, gst_object_unref);
+      }
+      profile_add(profile, "creating the pipeline", step_us,
+                  g_get_monotonic_time());
+    } else {
+      g_printerr("Failed to create a 'dvbsrc' element.\n"
+                 "Make sure you have gst-plugins-bad installed.\n");
+    }
+  }
+
+  step_us = g_get_monotonic_time();
+  GArray *const frontends = discover_frontends(&program_args);
+  restrict_frontends(frontends, program_args.dvbsrc_extra_props);
+  profile_add(profile, "discovering the frontends", step_us,
+              g_get_monotonic_time());
+
+  if (loader) {
+    step_us = g_get_monotonic_time();
+    g_thread_join(loader);
+    muxdata = load.muxdata;
+    profile_add(profile, "waiting for the transmitters", step_us,
+                g_get_monotonic_time());
+  }
+
+  if (!pipeline) {
+    goto beach2;
+  }
+
+  if (program_args.sweep) {
+    muxdata = sweep_muxdata(frontends, &sweep_default_tuner_ops,
+                            (guint)MAX(program_args.sweep_lock_timeout_ms, 0));
+    /* don't overwrite a usable cache with nothing. */
+    if (mux_data_is_empty(muxdata)) {
+      g_printerr("Nothing found while sweeping.\n");
+      g_clear_pointer(&muxdata, mux_data_destroy);
+      goto beach2;
     }
+    finish_muxdata(muxdata, &program_args, cache_file);
   }
 
   if (!muxdata) {
     goto beach2;
   }
 
-  GList *const muxdata_keys = mux_data_get_muxes(muxdata);
-  if (muxdata_keys == NULL) {
+  step_us = g_get_monotonic_time();
+  GFile *const stats_file = cache_get_stats_file();
+  TransmitterStats *stats;
+  {
+    gchar *const stats_path = g_file_get_path(stats_file);
+    stats = load_transmitter_stats(stats_path);
+    g_free(stats_path);
+  }
+
+  if (program_args.job_file) {
+    rv = run_jobs(&program_args, muxdata, stats, frontends);
+    goto beach3;
+  }
+
+  if (frontends->len > 0) {
+    mux_data_remove_transmitters(muxdata, is_unsupported_by_frontends,
+                                 frontends);
+  } else {
+    g_printerr("No usable DVB frontends found, not checking whether they "
+               "support the transmitters\n");
+  }
+
+  /* the plan is already in the order it was compiled in. */
+  if (!program_args.plan_file) {
+    transmitter_stats_order_muxdata(stats, muxdata,
+                                    g_get_real_time() / G_USEC_PER_SEC);
+  }
+  profile_add(profile, "loading the capture history", step_us,
+              g_get_monotonic_time());
+
+  /* a plan without transmitters couldn't be loaded again. */
+  if (mux_data_is_empty(muxdata)) {
     g_printerr("No transmitters found.\n");
     goto beach3;
   }
 
+  if (program_args.plan_out || program_args.channels_out) {
+    rv = export_plan(&program_args, muxdata);
+    goto beach3;
+  }
+
   rv = 0;
 
-  GstElement *const sink = gst_element_factory_make("filesink", NULL);
-  GstElement *const pipeline = gst_pipeline_new("mux-recorder");
   gst_pipeline_set_auto_flush_bus(GST_PIPELINE(pipeline), FALSE);
 
   GstBus *const bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
   GMainLoop *const loop = g_main_loop_new(NULL, FALSE);
+  NitCollector *const nit =
+      program_args.ignore_nit ? NULL : nit_collector_new();
+  ReadWatchdog *const watchdog = read_watchdog_new(&program_args.watchdog);
+  DvrMonitor *const dvr_monitor = dvr_monitor_new();
+  FlowRecorder *const flow =
+      program_args.flow_stats_seconds > 0 ? flow_recorder_new() : NULL;
+  TuneProfiler *const tune_prof =
+      program_args.profile_tuning_rounds > 0 ? tune_profiler_new() : NULL;
+  GArray *const mux_captures =
+      g_array_new(FALSE, FALSE, sizeof(struct mux_capture));
+  g_array_set_clear_func(mux_captures, (GDestroyNotify)mux_capture_clear);
 
   struct gstdvb_context ctx = {
       .program_args = &program_args,
       .mainloop = loop,
       .pipeline = pipeline,
       .dvbsrc = source,
-      .filesink = sink,
+      .sink = sink,
       .muxdata = muxdata,
-      .muxdata_cur_key = muxdata_keys,
-      .muxdata_cur_vals =
-          mux_data_get_transmitters_for_mux(muxdata, muxdata_keys->data),
-      .muxdata_val_idx = 0};
+      .muxdata_mux_idx = 0,
+      .muxdata_cur_vals = mux_data_get_transmitters_at(muxdata, 0),
+      .muxdata_val_idx = 0,
+      .stats = stats,
+      .frontends = frontends,
+      .nit = nit,
+      .si_log = NULL,
+      .demux = NULL,
+      .gate = NULL,
+      .segments = NULL,
+      .fingerprint = NULL,
+      .mux_captures = mux_captures,
+      .watchdog = watchdog,
+      .dvr_monitor = dvr_monitor,
+      .flow = flow,
+      .flow_since_us = 0,
+      .tune_prof = tune_prof,
+      .tune_round = 0,
+      .watchdog_src_id = 0,
+      .flow_src_id = 0};
 
   const guint bus_watch_id = gst_bus_add_watch(bus, bus_call, &ctx);
+  if (tune_prof) {
+    gst_bus_enable_sync_message_emission(bus);
+    g_signal_connect(G_OBJECT(bus), "sync-message::element",
+                     G_CALLBACK(on_sync_element_message), &ctx);
+    g_object_set(sink, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(G_OBJECT(sink), "handoff", G_CALLBACK(on_sink_handoff),
+                     &ctx);
+  }
   gst_object_unref(bus);
 
-  gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
-  gst_element_link(source, sink);
-
   g_signal_connect(G_OBJECT(source), "tuning-fail", G_CALLBACK(on_tuning_fail),
                    &ctx);
-  source = NULL; /* ownership transferred to pipeline */
+  GstTracer *flow_tracer = NULL;
+  if (program_args.si_only) {
+    /* the rest is dropped by the demux already. */
+    g_object_set(source, "pids", SI_LOG_PIDS, NULL);
+  }
+  {
+    GstPad *const pad = gst_element_get_static_pad(source, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_dvbsrc_buffer, &ctx,
+                      NULL);
+    if (flow) {
+      flow_tracer = flow_tracer_new(pad, flow);
+    }
+    gst_object_unref(pad);
+  }
+
+  {
+    gchar *const formatted = profile_format(profile, g_get_monotonic_time());
+    if (formatted) {
+      g_print("%s", formatted);
+      g_free(formatted);
+    }
+  }
 
   g_print("Starting...\n");
   g_idle_add(on_event_loop_start, &ctx);
   g_main_loop_run(loop);
+  /* an error may have ended the loop while still capturing, and nothing may
+   * be streaming anymore when the context goes away. */
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  /* what was written so far is still worth indexing. */
+  if (ctx.segments) {
+    segments_finish(&ctx);
+  }
+  /* and the captures of the MUX it stopped at worth deduplicating. */
+  if (mux_captures->len > 0) {
+    mux_captures_dedup(&ctx);
+  }
   g_print("All captures completed, shutting down\n");
-  gst_object_unref(GST_OBJECT(pipeline));
+  if (tune_prof) {
+    gchar *const formatted = tune_profiler_format(tune_prof);
+    g_print("%s", formatted);
+    g_free(formatted);
+    tune_profiler_destroy(tune_prof);
+  }
   g_source_remove(bus_watch_id);
   g_main_loop_unref(loop);
-  g_list_free(muxdata_keys);
+  read_watchdog_destroy(watchdog);
+  dvr_monitor_destroy(dvr_monitor);
+  g_clear_pointer(&ctx.fingerprint, capture_fingerprint_destroy);
+  g_array_unref(mux_captures);
+  if (flow) {
+    flow_tracer_destroy(flow_tracer);
+    flow_recorder_destroy(flow);
+  }
+
+  save_transmitter_stats(stats, stats_file);
+  if (nit) {
+    update_cache_from_nit(nit, cache_file);
+    nit_collector_destroy(nit);
+  }
 
 beach3:
-  mux_data_save_to_file(muxdata);
-  mux_data_destroy(muxdata);
+  transmitter_stats_destroy(stats);
+  g_object_unref(stats_file);
 
 beach2:
-  g_clear_pointer(&source, gst_object_unref);
+  g_clear_pointer(&muxdata, mux_data_destroy);
+  g_array_unref(frontends);
+  g_object_unref(cache_file);
+  g_clear_pointer(&pipeline, gst_object_unref);
+  profile_destroy(profile);
 
 beach:
   free_arguments(&program_args);
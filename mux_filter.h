@@ -0,0 +1,73 @@
+#ifndef GETPLMUX_MUX_FILTER_H
+#define GETPLMUX_MUX_FILTER_H
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "mux_params.h"
+
+/* restricts the transmitters which are loaded, so that the ones which will
+ * never be used can be skipped as early as possible. functions taking a
+ * filter accept NULL, which means loading everything, including info_html. */
+struct mux_filter {
+  /* NULL-terminated list of MUX names, or NULL for all of them */
+  gchar **muxes;
+  /* in km, NAN for no limit */
+  gdouble max_distance;
+  /* SYS_UNDEFINED for any */
+  enum fe_delivery_system delsys;
+  gboolean want_info_html;
+};
+
+static inline void mux_filter_init(struct mux_filter *filter) {
+  filter->muxes = NULL;
+  filter->max_distance = NAN;
+  filter->delsys = SYS_UNDEFINED;
+  filter->want_info_html = FALSE;
+}
+
+static inline void mux_filter_clear(struct mux_filter *filter) {
+  g_clear_pointer(&filter->muxes, g_strfreev);
+}
+
+/* whether the filter drops anything that would otherwise be loaded. */
+static inline gboolean mux_filter_is_active(const struct mux_filter *filter) {
+  return filter && (filter->muxes || isfinite(filter->max_distance) ||
+                    filter->delsys != SYS_UNDEFINED);
+}
+
+/* the name doesn't have to be NUL-terminated, so that it can be checked
+ * before being copied out of the input. */
+static inline gboolean mux_filter_accepts_mux(const struct mux_filter *filter,
+                                              const gchar *mux, gsize len) {
+  if (!filter || !filter->muxes) {
+    return TRUE;
+  }
+  for (gchar **it = filter->muxes; *it; ++it) {
+    if (strlen(*it) == len && memcmp(*it, mux, len) == 0) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static inline gboolean
+mux_filter_accepts_distance(const struct mux_filter *filter, gdouble distance) {
+  return !filter || !isfinite(filter->max_distance) ||
+         distance <= filter->max_distance;
+}
+
+static inline gboolean
+mux_filter_accepts_delsys(const struct mux_filter *filter,
+                          enum fe_delivery_system delsys) {
+  return !filter || filter->delsys == SYS_UNDEFINED ||
+         filter->delsys == delsys;
+}
+
+static inline gboolean
+mux_filter_wants_info_html(const struct mux_filter *filter) {
+  return !filter || filter->want_info_html;
+}
+
+#endif
@@ -1,45 +1,127 @@
 #include "muxdata.h"
 
 #include <glib.h>
+#include <string.h>
+
+struct mux_entry {
+  gchar *name;
+  GArray *transmitters;
+};
 
 struct MuxData_ {
+  /* struct mux_entry, in the order of mux_data_compare_muxes */
+  GArray *muxes;
+  /* name of the MUX -> its transmitters, with the keys owned by muxes */
   GHashTable *hash;
+  gboolean dirty;
 };
 
 static void mux_params_clear_wrap(gpointer p) { mux_params_clear(p); }
 
-static void garray_free_with_segment(gpointer p) { g_array_free(p, TRUE); }
-
-static gint g_strcmp0_gcomparefunc(gconstpointer a, gconstpointer b) {
-  return g_strcmp0(a, b);
+static void mux_entry_clear(gpointer p) {
+  struct mux_entry *const entry = p;
+  g_free(entry->name);
+  g_array_free(entry->transmitters, TRUE);
 }
 
 MuxData *mux_data_new(void) {
   MuxData *rv = g_new(MuxData, 1);
-  rv->hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
-                                   garray_free_with_segment);
+  rv->muxes = g_array_new(FALSE, FALSE, sizeof(struct mux_entry));
+  g_array_set_clear_func(rv->muxes, mux_entry_clear);
+  rv->hash = g_hash_table_new(g_str_hash, g_str_equal);
+  rv->dirty = TRUE;
   return rv;
 }
 
 void mux_data_destroy(MuxData *md) {
   g_hash_table_destroy(md->hash);
+  g_array_free(md->muxes, TRUE);
   g_free(md);
 }
 
-GList *mux_data_get_muxes(MuxData *md) {
-  return g_list_sort(g_hash_table_get_keys(md->hash), g_strcmp0_gcomparefunc);
+static const gchar *skip_zeros(const gchar *s) {
+  while (*s == '0' && g_ascii_isdigit(s[1])) {
+    ++s;
+  }
+  return s;
+}
+
+static gsize digits_len(const gchar *s) {
+  gsize len = 0;
+  while (g_ascii_isdigit(s[len])) {
+    ++len;
+  }
+  return len;
+}
+
+gint mux_data_compare_muxes(const gchar *a, const gchar *b) {
+  const gchar *pA = a, *pB = b;
+  while (*pA && *pB) {
+    if (g_ascii_isdigit(*pA) && g_ascii_isdigit(*pB)) {
+      pA = skip_zeros(pA);
+      pB = skip_zeros(pB);
+      const gsize lenA = digits_len(pA), lenB = digits_len(pB);
+      if (lenA != lenB) {
+        return lenA < lenB ? -1 : 1;
+      }
+      const gint cmp = strncmp(pA, pB, lenA);
+      if (cmp != 0) {
+        return cmp;
+      }
+      pA += lenA;
+      pB += lenB;
+    } else if (*pA != *pB) {
+      return (guchar)*pA < (guchar)*pB ? -1 : 1;
+    } else {
+      ++pA;
+      ++pB;
+    }
+  }
+  if (*pA || *pB) {
+    return *pA ? 1 : -1;
+  }
+  /* only leading zeros are left to tell "MUX-01" from "MUX-1". */
+  return strcmp(a, b);
+}
+
+/* where the MUX goes so that the array stays in order. */
+static guint insertion_index(const GArray *muxes, const gchar *mux) {
+  guint lo = 0, hi = muxes->len;
+  while (lo < hi) {
+    const guint mid = lo + (hi - lo) / 2;
+    if (mux_data_compare_muxes(
+            g_array_index(muxes, struct mux_entry, mid).name, mux) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+guint mux_data_get_num_muxes(MuxData *md) { return md->muxes->len; }
+
+const gchar *mux_data_get_mux_at(MuxData *md, guint idx) {
+  return g_array_index(md->muxes, struct mux_entry, idx).name;
+}
+
+GArray *mux_data_get_transmitters_at(MuxData *md, guint idx) {
+  return g_array_index(md->muxes, struct mux_entry, idx).transmitters;
 }
 
 void mux_data_append_transmitter(MuxData *md, const gchar *mux,
                                  const struct mux_params *params) {
-  GHashTable *const hash = md->hash;
-  GArray *param_array = g_hash_table_lookup(hash, mux);
+  GArray *param_array = g_hash_table_lookup(md->hash, mux);
   if (!param_array) {
     param_array = g_array_new(FALSE, FALSE, sizeof(struct mux_params));
     g_array_set_clear_func(param_array, mux_params_clear_wrap);
-    g_hash_table_insert(hash, g_strdup(mux), param_array);
+    const struct mux_entry entry = {.name = g_strdup(mux),
+                                    .transmitters = param_array};
+    g_array_insert_val(md->muxes, insertion_index(md->muxes, mux), entry);
+    g_hash_table_insert(md->hash, entry.name, param_array);
   }
   g_array_append_val(param_array, *params);
+  md->dirty = TRUE;
 }
 
 static gint by_distance_cmpfn(gconstpointer a, gconstpointer b) {
@@ -53,34 +135,72 @@ static gint by_distance_cmpfn(gconstpointer a, gconstpointer b) {
   }
 }
 
-static void sort_transmitter_array(gpointer key, gpointer value,
-                                   gpointer user_data) {
-  (void)key;
-  (void)user_data;
-  g_array_sort(value, by_distance_cmpfn);
-}
-
 void mux_data_sort_transmitters(MuxData *md) {
-  g_hash_table_foreach(md->hash, sort_transmitter_array, NULL);
+  for (guint i = 0; i < md->muxes->len; ++i) {
+    g_array_sort(mux_data_get_transmitters_at(md, i), by_distance_cmpfn);
+  }
+  md->dirty = TRUE;
 }
 
 GArray *mux_data_get_transmitters_for_mux(MuxData *md, const gchar *mux) {
   return g_hash_table_lookup(md->hash, mux);
 }
 
-struct foreach_wrap_ctx {
-  void (*fn)(const gchar *, const GArray *, void *);
-  void *fn_ctx;
-};
+gboolean mux_data_is_empty(MuxData *md) {
+  return md->muxes->len == 0;
+}
 
-static void foreach_wrap_fn(gpointer key, gpointer value, gpointer user_data) {
-  struct foreach_wrap_ctx *const wrapctx = user_data;
-  wrapctx->fn(key, value, wrapctx->fn_ctx);
+gboolean mux_data_is_dirty(MuxData *md) { return md->dirty; }
+
+void mux_data_set_dirty(MuxData *md, gboolean dirty) { md->dirty = dirty; }
+
+void mux_data_remove_transmitters(
+    MuxData *md, gboolean (*pred)(const gchar *, const struct mux_params *,
+                                  void *),
+    void *pred_ctx) {
+  gboolean removed = FALSE;
+  for (guint m = md->muxes->len; m-- > 0;) {
+    const struct mux_entry *const entry =
+        &g_array_index(md->muxes, struct mux_entry, m);
+    GArray *const transmitters = entry->transmitters;
+    for (guint i = transmitters->len; i-- > 0;) {
+      const struct mux_params *const par =
+          &g_array_index(transmitters, struct mux_params, i);
+      if (pred(entry->name, par, pred_ctx)) {
+        g_array_remove_index(transmitters, i);
+        removed = TRUE;
+      }
+    }
+    if (transmitters->len == 0) {
+      g_hash_table_remove(md->hash, entry->name);
+      g_array_remove_index(md->muxes, m);
+    }
+  }
+  if (removed) {
+    md->dirty = TRUE;
+  }
+}
+
+static gboolean rejected_by_filter(const gchar *mux,
+                                   const struct mux_params *par, void *ctx) {
+  const struct mux_filter *const filter = ctx;
+  return !mux_filter_accepts_mux(filter, mux, strlen(mux)) ||
+         !mux_filter_accepts_distance(filter, par->distance) ||
+         !mux_filter_accepts_delsys(filter, par->tune_parms.dvb_type);
+}
+
+void mux_data_apply_filter(MuxData *md, const struct mux_filter *filter) {
+  if (mux_filter_is_active(filter)) {
+    mux_data_remove_transmitters(md, rejected_by_filter, (void *)filter);
+  }
 }
 
 void mux_data_foreach(MuxData *md,
                       void (*fn)(const gchar *, const GArray *, void *),
                       void *fn_ctx) {
-  struct foreach_wrap_ctx wrapctx = {.fn = fn, .fn_ctx = fn_ctx};
-  g_hash_table_foreach(md->hash, foreach_wrap_fn, &wrapctx);
+  for (guint i = 0; i < md->muxes->len; ++i) {
+    const struct mux_entry *const entry =
+        &g_array_index(md->muxes, struct mux_entry, i);
+    fn(entry->name, entry->transmitters, fn_ctx);
+  }
 }
@@ -3,19 +3,48 @@
 
 typedef struct MuxData_ MuxData;
 
+#include "mux_filter.h"
 #include "mux_params.h"
 
 MuxData *mux_data_new(void);
 void mux_data_destroy(MuxData *);
 
+/* visits the MUXes in order. */
 void mux_data_foreach(MuxData *,
                       void (*)(const gchar *, const GArray *, void *), void *);
 
-GList *mux_data_get_muxes(MuxData *);
+/* the order the MUXes are kept in : like strcmp, except that runs of digits
+ * compare as numbers, so "MUX-2" comes before "MUX-10". */
+gint mux_data_compare_muxes(const gchar *, const gchar *);
+
+/* the MUXes are indexed from 0 up to the number of them, in order. adding
+ * or removing a MUX shifts the indexes of the ones after it. */
+guint mux_data_get_num_muxes(MuxData *);
+const gchar *mux_data_get_mux_at(MuxData *, guint);
+GArray *mux_data_get_transmitters_at(MuxData *, guint);
 
 void mux_data_append_transmitter(MuxData *, const gchar *,
                                  const struct mux_params *);
 void mux_data_sort_transmitters(MuxData *);
 GArray *mux_data_get_transmitters_for_mux(MuxData *, const gchar *);
+gboolean mux_data_is_empty(MuxData *);
+
+/* whether it differs from the cache it was read from, which it does until
+ * it's been read or saved. only the functions above which change the
+ * transmitters set it, so whoever changes them directly has to as well. */
+gboolean mux_data_is_dirty(MuxData *);
+void mux_data_set_dirty(MuxData *, gboolean);
+
+/* removes every transmitter for which the predicate returns TRUE, along with
+ * MUXes which are left without any. */
+void mux_data_remove_transmitters(MuxData *,
+                                  gboolean (*)(const gchar *,
+                                               const struct mux_params *,
+                                               void *),
+                                  void *);
+
+/* removes everything the filter doesn't accept, including MUXes which are
+ * left without any transmitters. */
+void mux_data_apply_filter(MuxData *, const struct mux_filter *);
 
 #endif
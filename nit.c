@@ -0,0 +1,339 @@
+#include "nit.h"
+
+#include "ts.h"
+
+#define TABLE_ID_NIT_ACTUAL 0x40
+#define TABLE_ID_NIT_OTHER 0x41
+
+#define DESC_TERRESTRIAL_DELIVERY 0x5a
+#define DESC_FREQUENCY_LIST 0x62
+#define DESC_EXTENSION 0x7f
+#define DESC_EXT_T2_DELIVERY 0x04
+
+/* frequencies in the descriptors are given in units of 10 Hz. */
+#define FREQ_UNITS_PER_KHZ 100
+
+struct nit_delivery {
+  /* original_network_id << 16 | transport_stream_id */
+  guint32 ts_key;
+  struct tune_params tune_parms;
+};
+
+struct NitCollector_ {
+  struct ts_splitter splitter;
+  TsSectionAssembler *assembler;
+  /* (table_id, network_id, section_number) -> version + 1 of the sections
+   * parsed during the current capture */
+  GHashTable *seen_sections;
+  GArray *deliveries;
+  /* MUX name -> ts_key of the transport stream it was captured as */
+  GHashTable *mux_streams;
+  gchar *cur_mux;
+  guint cur_freq_khz;
+};
+
+/* what the descriptors of a single transport stream say. */
+struct ts_description {
+  guint bw_mhz;
+  enum fe_modulation mod;
+  enum fe_delivery_system delsys;
+  GArray *freqs_khz;
+};
+
+static guint bw_from_terrestrial(guint8 code) {
+  static const guint bw_mhz[] = {8, 7, 6, 5};
+  return code < G_N_ELEMENTS(bw_mhz) ? bw_mhz[code] : 0;
+}
+
+static guint bw_from_t2(guint8 code) {
+  /* 1.712 MHz isn't something dvbsrc can be told. */
+  static const guint bw_mhz[] = {8, 7, 6, 5, 10};
+  return code < G_N_ELEMENTS(bw_mhz) ? bw_mhz[code] : 0;
+}
+
+static void add_freq(struct ts_description *desc, const guint8 *p) {
+  const guint freq_khz = ts_read_u32(p) / FREQ_UNITS_PER_KHZ;
+  if (freq_khz > 0) {
+    g_array_append_val(desc->freqs_khz, freq_khz);
+  }
+}
+
+static void parse_terrestrial(struct ts_description *desc, const guint8 *d,
+                              gsize len) {
+  static const enum fe_modulation constellations[] = {QPSK, QAM_16, QAM_64};
+  if (len < 6) {
+    return;
+  }
+  add_freq(desc, d);
+  desc->bw_mhz = bw_from_terrestrial(d[4] >> 5);
+  const guint8 constellation = d[5] >> 6;
+  desc->mod = constellation < G_N_ELEMENTS(constellations)
+                  ? constellations[constellation]
+                  : QAM_AUTO;
+  if (desc->delsys == SYS_UNDEFINED) {
+    desc->delsys = SYS_DVBT;
+  }
+}
+
+static void parse_t2(struct ts_description *desc, const guint8 *d, gsize len) {
+  desc->delsys = SYS_DVBT2;
+  /* the bandwidth and the cells are optional. */
+  if (len < 6) {
+    return;
+  }
+  desc->bw_mhz = bw_from_t2((d[4] >> 2) & 0x0f);
+  const gboolean tfs = d[5] & 0x01;
+  gsize pos = 6;
+  while (pos + 2 <= len) {
+    /* cell_id */
+    pos += 2;
+    if (tfs) {
+      if (pos >= len) {
+        return;
+      }
+      const gsize loop_len = d[pos++];
+      for (gsize i = 0; i + 4 <= loop_len && pos + i + 4 <= len; i += 4) {
+        add_freq(desc, d + pos + i);
+      }
+      pos += loop_len;
+    } else {
+      if (pos + 4 > len) {
+        return;
+      }
+      add_freq(desc, d + pos);
+      pos += 4;
+    }
+    if (pos >= len) {
+      return;
+    }
+    const gsize subcells_len = d[pos++];
+    /* cell_id_extension followed by the transposer frequency */
+    for (gsize i = 0; i + 5 <= subcells_len && pos + i + 5 <= len; i += 5) {
+      add_freq(desc, d + pos + i + 1);
+    }
+    pos += subcells_len;
+  }
+}
+
+static void parse_frequency_list(struct ts_description *desc, const guint8 *d,
+                                 gsize len) {
+  if (len < 1 || (d[0] & 0x03) != 0x03) {
+    /* not terrestrial */
+    return;
+  }
+  for (gsize pos = 1; pos + 4 <= len; pos += 4) {
+    add_freq(desc, d + pos);
+  }
+}
+
+static void parse_descriptors(struct ts_description *desc, const guint8 *p,
+                              gsize len) {
+  gsize pos = 0;
+  while (pos + 2 <= len) {
+    const guint8 tag = p[pos];
+    const gsize desc_len = p[pos + 1];
+    const guint8 *const d = p + pos + 2;
+    pos += 2 + desc_len;
+    if (pos > len) {
+      return;
+    }
+    if (tag == DESC_TERRESTRIAL_DELIVERY) {
+      parse_terrestrial(desc, d, desc_len);
+    } else if (tag == DESC_FREQUENCY_LIST) {
+      parse_frequency_list(desc, d, desc_len);
+    } else if (tag == DESC_EXTENSION && desc_len > 0 &&
+               d[0] == DESC_EXT_T2_DELIVERY) {
+      parse_t2(desc, d, desc_len);
+    }
+  }
+}
+
+static guint freq_distance(guint a, guint b) { return a > b ? a - b : b - a; }
+
+static struct nit_delivery *find_delivery(NitCollector *nit, guint32 ts_key,
+                                          guint freq_khz) {
+  struct nit_delivery *best = NULL;
+  for (guint i = 0; i < nit->deliveries->len; ++i) {
+    struct nit_delivery *const d =
+        &g_array_index(nit->deliveries, struct nit_delivery, i);
+    const guint dist = freq_distance(d->tune_parms.freq_khz, freq_khz);
+    if (d->ts_key == ts_key && dist <= NIT_FREQ_TOLERANCE_KHZ &&
+        (!best || dist < freq_distance(best->tune_parms.freq_khz, freq_khz))) {
+      best = d;
+    }
+  }
+  return best;
+}
+
+static void add_deliveries(NitCollector *nit, guint32 ts_key,
+                           const struct ts_description *desc,
+                           gboolean is_actual) {
+  /* without the bandwidth, it can't be tuned to anyway. */
+  if (desc->bw_mhz == 0 || desc->delsys == SYS_UNDEFINED) {
+    return;
+  }
+  for (guint i = 0; i < desc->freqs_khz->len; ++i) {
+    const struct nit_delivery delivery = {
+        .ts_key = ts_key,
+        .tune_parms = {
+            .freq_khz = g_array_index(desc->freqs_khz, guint, i),
+            .bw_mhz = desc->bw_mhz,
+            /* the modulation of T2 is given per PLP, not in the NIT. */
+            .mod = desc->delsys == SYS_DVBT2 ? QAM_AUTO : desc->mod,
+            .dvb_type = desc->delsys}};
+    struct nit_delivery *const known =
+        find_delivery(nit, ts_key, delivery.tune_parms.freq_khz);
+    if (known && known->tune_parms.freq_khz == delivery.tune_parms.freq_khz) {
+      *known = delivery;
+    } else {
+      g_array_append_val(nit->deliveries, delivery);
+    }
+
+    if (is_actual && nit->cur_mux &&
+        freq_distance(delivery.tune_parms.freq_khz, nit->cur_freq_khz) <=
+            NIT_FREQ_TOLERANCE_KHZ) {
+      g_hash_table_insert(nit->mux_streams, g_strdup(nit->cur_mux),
+                          GUINT_TO_POINTER(ts_key));
+    }
+  }
+}
+
+static void parse_nit(NitCollector *nit, const guint8 *section, gsize len,
+                      const struct ts_section_header *hdr) {
+  /* everything after the header, up to the CRC */
+  const guint8 *p = section + TS_LONG_SECTION_HEADER_SIZE;
+  gsize left = len - TS_LONG_SECTION_HEADER_SIZE - 4;
+
+  if (left < 2) {
+    return;
+  }
+  const gsize network_desc_len = ts_read_u16(p) & 0x0fff;
+  if (left < 2 + network_desc_len + 2) {
+    return;
+  }
+  p += 2 + network_desc_len;
+  left -= 2 + network_desc_len;
+
+  const gsize loop_len = MIN(ts_read_u16(p) & 0x0fffu, left - 2);
+  p += 2;
+  gsize pos = 0;
+  struct ts_description desc = {.freqs_khz =
+                                    g_array_new(FALSE, FALSE, sizeof(guint))};
+  while (pos + 6 <= loop_len) {
+    const guint16 ts_id = ts_read_u16(p + pos);
+    const guint16 onid = ts_read_u16(p + pos + 2);
+    const gsize desc_len = ts_read_u16(p + pos + 4) & 0x0fff;
+    pos += 6;
+    if (pos + desc_len > loop_len) {
+      break;
+    }
+    desc.bw_mhz = 0;
+    desc.mod = QAM_AUTO;
+    desc.delsys = SYS_UNDEFINED;
+    g_array_set_size(desc.freqs_khz, 0);
+    parse_descriptors(&desc, p + pos, desc_len);
+    add_deliveries(nit, ((guint32)onid << 16) | ts_id, &desc,
+                   hdr->table_id == TABLE_ID_NIT_ACTUAL);
+    pos += desc_len;
+  }
+  g_array_free(desc.freqs_khz, TRUE);
+}
+
+static void on_section(guint16 pid, const guint8 *section, gsize len,
+                       void *ctx) {
+  (void)pid;
+  NitCollector *const nit = ctx;
+  struct ts_section_header hdr;
+  if (!ts_section_parse_header(section, len, &hdr) || !hdr.current_next ||
+      (hdr.table_id != TABLE_ID_NIT_ACTUAL &&
+       hdr.table_id != TABLE_ID_NIT_OTHER)) {
+    return;
+  }
+
+  /* the same sections are repeated many times a second. */
+  const gpointer key = GUINT_TO_POINTER(((guint)hdr.table_id << 24) |
+                                        ((guint)hdr.table_id_extension << 8) |
+                                        hdr.section_number);
+  const gpointer version = GUINT_TO_POINTER(hdr.version + 1u);
+  if (g_hash_table_lookup(nit->seen_sections, key) == version) {
+    return;
+  }
+  g_hash_table_insert(nit->seen_sections, key, version);
+  parse_nit(nit, section, len, &hdr);
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  NitCollector *const nit = ctx;
+  struct ts_packet pkt;
+  if (ts_packet_parse(data, &pkt)) {
+    ts_section_assembler_push(nit->assembler, &pkt);
+  }
+}
+
+NitCollector *nit_collector_new(void) {
+  NitCollector *rv = g_new(NitCollector, 1);
+  ts_splitter_init(&rv->splitter);
+  rv->assembler = ts_section_assembler_new(on_section, rv);
+  ts_section_assembler_add_pid(rv->assembler, TS_PID_NIT);
+  rv->seen_sections = g_hash_table_new(g_direct_hash, g_direct_equal);
+  rv->deliveries = g_array_new(FALSE, FALSE, sizeof(struct nit_delivery));
+  rv->mux_streams =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  rv->cur_mux = NULL;
+  rv->cur_freq_khz = 0;
+  return rv;
+}
+
+void nit_collector_destroy(NitCollector *nit) {
+  ts_section_assembler_destroy(nit->assembler);
+  g_hash_table_destroy(nit->seen_sections);
+  g_array_free(nit->deliveries, TRUE);
+  g_hash_table_destroy(nit->mux_streams);
+  g_free(nit->cur_mux);
+  g_free(nit);
+}
+
+void nit_collector_start(NitCollector *nit, const gchar *mux, guint freq_khz) {
+  ts_splitter_init(&nit->splitter);
+  ts_section_assembler_reset(nit->assembler);
+  /* other MUXes of the same network carry the same sections, which need to be
+   * parsed again to find out which transport stream this one is. */
+  g_hash_table_remove_all(nit->seen_sections);
+  g_free(nit->cur_mux);
+  nit->cur_mux = g_strdup(mux);
+  nit->cur_freq_khz = freq_khz;
+}
+
+void nit_collector_push(NitCollector *nit, const guint8 *data, gsize len) {
+  ts_splitter_push(&nit->splitter, data, len, on_packet, nit);
+}
+
+static gboolean tune_params_equal(const struct tune_params *a,
+                                  const struct tune_params *b) {
+  return a->freq_khz == b->freq_khz && a->bw_mhz == b->bw_mhz &&
+         a->mod == b->mod && a->dvb_type == b->dvb_type;
+}
+
+guint nit_collector_apply(NitCollector *nit, MuxData *md) {
+  guint changed = 0;
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    gpointer ts_key;
+    if (!g_hash_table_lookup_extended(nit->mux_streams,
+                                      mux_data_get_mux_at(md, m), NULL,
+                                      &ts_key)) {
+      continue;
+    }
+    GArray *const transmitters = mux_data_get_transmitters_at(md, m);
+    for (guint i = 0; i < transmitters->len; ++i) {
+      struct tune_params *const params =
+          &g_array_index(transmitters, struct mux_params, i).tune_parms;
+      const struct nit_delivery *const d =
+          find_delivery(nit, GPOINTER_TO_UINT(ts_key), params->freq_khz);
+      if (d && !tune_params_equal(params, &d->tune_parms)) {
+        *params = d->tune_parms;
+        ++changed;
+      }
+    }
+  }
+  return changed;
+}
@@ -0,0 +1,36 @@
+#ifndef GETPLMUX_NIT_H
+#define GETPLMUX_NIT_H
+
+#include <glib.h>
+
+#include "muxdata.h"
+
+/* learns the actual tuning parameters of the MUXes from the terrestrial and
+ * T2 delivery system descriptors of the NIT carried in the captured streams.
+ * the NIT of a MUX usually lists all the frequencies it's broadcast on, so a
+ * single capture is enough to fix up all of its transmitters. */
+
+/* how far off the frequency of a transmitter may be from the one in the NIT
+ * for the two to be considered the same. */
+#define NIT_FREQ_TOLERANCE_KHZ 500
+
+typedef struct NitCollector_ NitCollector;
+
+NitCollector *nit_collector_new(void);
+void nit_collector_destroy(NitCollector *);
+
+/* starts collecting from a capture of the given MUX on the given frequency.
+ * what was learned from previous captures is kept. */
+void nit_collector_start(NitCollector *, const gchar *mux, guint freq_khz);
+
+/* feeds the captured stream, which doesn't need to be aligned to packet
+ * boundaries. this may be called from a different thread than the rest, but
+ * never at the same time. */
+void nit_collector_push(NitCollector *, const guint8 *data, gsize len);
+
+/* updates the transmitters of every MUX captured so far with what its NIT
+ * says about the transport stream broadcast on their frequencies. returns the
+ * number of transmitters changed. */
+guint nit_collector_apply(NitCollector *, MuxData *md);
+
+#endif
@@ -10,11 +10,15 @@ struct muxparams_parser_ctx {
 
   htmlSAXHandlerPtr sax;
   MuxData *muxdata;
+  const struct mux_filter *filter;
 
   int cur_row;
   int cur_column;
   bool in_dvb_table;
   bool encoder_error;
+  /* set when the row's MUX is filtered out, so that the rest of it isn't
+   * copied out anymore. */
+  bool skip_row;
 };
 
 static void reset_parse_state(struct muxparams_parser_ctx *ctx) {
@@ -22,6 +26,7 @@ static void reset_parse_state(struct muxparams_parser_ctx *ctx) {
   g_clear_pointer(&ctx->parse_buf_mux, g_free);
   ctx->cur_row = ctx->cur_column = 0;
   ctx->in_dvb_table = false;
+  ctx->skip_row = false;
 }
 
 static const xmlChar *get_attr(const xmlChar **attrs, const char *name) {
@@ -52,6 +57,12 @@ static gboolean sanitize_mux_id(gchar *mux_id, gsize len) {
   }
 }
 
+/* the length of the MUX identifier after sanitize_mux_id(), for checking it
+ * against the filter before it's copied. */
+static gsize sanitized_mux_id_len(const gchar *mux_id, gsize len) {
+  return len >= 2 && memcmp(mux_id + len - 2, "T2", 2) == 0 ? len - 2 : len;
+}
+
 static void characters(void *ctx, const xmlChar *ch, int leni) {
   struct muxparams_parser_ctx *const my_ctx = ctx;
   if ((ch[0] == '~' && ch[1] == 0) || leni <= 0)
@@ -59,12 +70,19 @@ static void characters(void *ctx, const xmlChar *ch, int leni) {
 
   const gsize len = (gsize)leni;
   const char *const chch = (const char *)ch;
+  if (my_ctx->skip_row)
+    return;
   switch (my_ctx->cur_column) {
   case 1:
     my_ctx->parse_buf.tune_parms.freq_khz =
         (guint)(g_ascii_strtod(chch, NULL) * 1000.0);
     break;
   case 2: {
+    if (!mux_filter_accepts_mux(my_ctx->filter, chch,
+                                sanitized_mux_id_len(chch, len))) {
+      my_ctx->skip_row = true;
+      break;
+    }
     gchar *const mux_id = g_strndup(chch, len);
     sanitize_mux_id(mux_id, len);
     my_ctx->parse_buf_mux = mux_id;
@@ -103,7 +121,8 @@ static void start_element(void *ctx, const xmlChar *name,
       if (my_ctx->cur_row >= 1)
         my_ctx->sax->characters = characters;
     }
-    if (strcmp((const char *)name, "a") == 0 && my_ctx->cur_row >= 1) {
+    if (strcmp((const char *)name, "a") == 0 && my_ctx->cur_row >= 1 &&
+        !my_ctx->skip_row && mux_filter_wants_info_html(my_ctx->filter)) {
       const char *const href = (const char *)get_attr(atts, "href");
       if (href) {
         my_ctx->parse_buf.info_html = g_strdup((const gchar *)href);
@@ -122,12 +141,17 @@ static void end_element(void *ctx, const xmlChar *name) {
       my_ctx->cur_column++;
     } else if (strcmp((const char *)name, "tr") == 0) {
       if (my_ctx->cur_row >= 1 && my_ctx->cur_column >= 6 &&
-          my_ctx->parse_buf_mux) {
+          my_ctx->parse_buf_mux &&
+          mux_filter_accepts_distance(my_ctx->filter,
+                                      my_ctx->parse_buf.distance)) {
         mux_data_append_transmitter(my_ctx->muxdata, my_ctx->parse_buf_mux,
                                     &my_ctx->parse_buf);
-        memset(&my_ctx->parse_buf, 0, sizeof(my_ctx->parse_buf));
+      } else {
+        mux_params_clear(&my_ctx->parse_buf);
       }
+      memset(&my_ctx->parse_buf, 0, sizeof(my_ctx->parse_buf));
       g_clear_pointer(&my_ctx->parse_buf_mux, g_free);
+      my_ctx->skip_row = false;
       my_ctx->cur_row++;
       my_ctx->cur_column = -1;
     }
@@ -141,7 +165,8 @@ static void xml_error(void *ctx, xmlErrorPtr error) {
   }
 }
 
-MuxData *parse_mux_params_from_html(const char *html, int size) {
+MuxData *parse_mux_params_from_html(const char *html, int size,
+                                    const struct mux_filter *filter) {
   /* while developing this, I learned that libxml's SAX parser is much better
    * suited to processing files whose encoding is borked. the tree parser falls
    * back to ISO-8859-1 encoding as a "safe default" even if the API call is
@@ -176,6 +201,7 @@ MuxData *parse_mux_params_from_html(const char *html, int size) {
   memset(&my_ctx, 0, sizeof(my_ctx));
   my_ctx.sax = &sax;
   my_ctx.muxdata = mux_data_new();
+  my_ctx.filter = filter;
 
   htmlParserCtxtPtr ctxt = htmlNewParserCtxt();
   htmlSAXHandlerPtr oldsax = ctxt->sax;
@@ -187,9 +213,16 @@ MuxData *parse_mux_params_from_html(const char *html, int size) {
    * returns well-encoded files in CP1250, sometimes it does ... weird things
    * when it comes to the character encoding, which is why we try reading it
    * twice : once as actual CP1250 and then, if it fails, in "broken" mode. */
+  /* the encoding errors are reported by libxml's I/O layer, which doesn't know
+   * about the parser context and always goes through the global handler.
+   * when libxml is built with thread support, its "globals" are thread-local,
+   * so installing a handler here is safe while other threads are parsing.
+   * the previous handler is restored in case the caller had one. */
+  const xmlStructuredErrorFunc old_handler = xmlStructuredError;
+  void *const old_handler_ctx = xmlStructuredErrorContext;
   xmlSetStructuredErrorFunc(&my_ctx, xml_error);
   htmlCtxtReadMemory(ctxt, html, size, NULL, "CP1250", 0);
-  xmlSetStructuredErrorFunc(NULL, NULL);
+  xmlSetStructuredErrorFunc(old_handler_ctx, old_handler);
   if (my_ctx.encoder_error) {
     /* when forcing UTF-8 as the character encoding, libxml turns off all
      * validation of the incoming bytes, which is just what we want here seeing
@@ -214,57 +247,102 @@ MuxData *parse_mux_params_from_html(const char *html, int size) {
   return my_ctx.muxdata;
 }
 
-struct tuneparams_parser_ctx {
-  MuxData *muxdata;
-  htmlSAXHandlerPtr sax;
+struct TuneParamsIndex_ {
+  GHashTable *hash;
+};
 
-  struct mux_params parse_buf;
-  gchar *parse_buf_mux;
+struct tune_params_key {
+  gchar *mux;
+  gchar *name;
+  guint freq_khz;
+};
 
-  bool in_table;
-  int cur_row;
-  int cur_column;
+struct tune_params_entry {
+  struct tune_params_key key;
+  struct tune_params tune_parms;
 };
 
-static void for_each_mux_param(const GArray *transmitters,
-                               const struct mux_params *wanted,
-                               void (*func)(struct mux_params *, const void *),
-                               const void *func_ctx) {
-  /* the array is sorted by distance so we need to do a linear search. this
-   * shouldn't really be a problem since it shouldn't have more than 10 elements
-   * at most. */
-  for (guint i = 0; i < transmitters->len; ++i) {
-    struct mux_params *const par =
-        &g_array_index(transmitters, struct mux_params, i);
-    if (par->tune_parms.freq_khz == wanted->tune_parms.freq_khz &&
-        strcmp(par->name, wanted->name) == 0) {
-      func(par, func_ctx);
-    }
-  }
+static guint tune_params_key_hash(gconstpointer p) {
+  const struct tune_params_key *const key = p;
+  return (g_str_hash(key->mux) * 31 + g_str_hash(key->name)) * 31 +
+         key->freq_khz;
+}
+
+static gboolean tune_params_key_equal(gconstpointer a, gconstpointer b) {
+  const struct tune_params_key *const kA = a, *kB = b;
+  return kA->freq_khz == kB->freq_khz && strcmp(kA->mux, kB->mux) == 0 &&
+         strcmp(kA->name, kB->name) == 0;
+}
+
+static void tune_params_entry_free(gpointer p) {
+  struct tune_params_entry *const entry = p;
+  g_free(entry->key.mux);
+  g_free(entry->key.name);
+  g_free(entry);
+}
+
+static TuneParamsIndex *tune_params_index_new(void) {
+  TuneParamsIndex *rv = g_new(TuneParamsIndex, 1);
+  /* the key is a part of the entry, so freeing the value is enough. */
+  rv->hash = g_hash_table_new_full(tune_params_key_hash, tune_params_key_equal,
+                                   NULL, tune_params_entry_free);
+  return rv;
 }
 
-static void set_new_tune_params(struct mux_params *found_muxparms,
-                                const void *ctx) {
-  const struct tune_params *const new_tuneparms = ctx;
-  found_muxparms->tune_parms = *new_tuneparms;
+void tune_params_index_destroy(TuneParamsIndex *index) {
+  g_hash_table_destroy(index->hash);
+  g_free(index);
 }
 
-static void add_tuneparams_to_muxdata(MuxData *md,
-                                      const struct mux_params *with_tuneparms,
-                                      const gchar *mux) {
-  /* try to locate the currently parsed transmitter in the hash which is
-   * assumed to contain all the previously fetched and parsed location-based
-   * transmitters, and fill in its mux_params structure with what we've parsed.
-   */
-  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
-  if (!transmitters) {
+static void tune_params_index_insert(TuneParamsIndex *index, const gchar *mux,
+                                     const struct mux_params *with_tuneparms) {
+  if (!with_tuneparms->name) {
     return;
   }
+  struct tune_params_entry *const entry = g_new(struct tune_params_entry, 1);
+  entry->key.mux = g_strdup(mux);
+  entry->key.name = g_strdup(with_tuneparms->name);
+  entry->key.freq_khz = with_tuneparms->tune_parms.freq_khz;
+  entry->tune_parms = with_tuneparms->tune_parms;
+  /* if the same transmitter is listed more than once, the last one wins. */
+  g_hash_table_replace(index->hash, &entry->key, entry);
+}
 
-  for_each_mux_param(transmitters, with_tuneparms, set_new_tune_params,
-                     &with_tuneparms->tune_parms);
+void tune_params_index_apply(const TuneParamsIndex *index, MuxData *md) {
+  /* fill in the mux_params of every location-based transmitter that is also
+   * present in the complete list. */
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    const gchar *const mux = mux_data_get_mux_at(md, m);
+    GArray *const transmitters = mux_data_get_transmitters_at(md, m);
+    for (guint i = 0; i < transmitters->len; ++i) {
+      struct mux_params *const par =
+          &g_array_index(transmitters, struct mux_params, i);
+      const struct tune_params_key key = {.mux = (gchar *)mux,
+                                          .name = par->name,
+                                          .freq_khz = par->tune_parms.freq_khz};
+      const struct tune_params_entry *const entry =
+          g_hash_table_lookup(index->hash, &key);
+      if (entry) {
+        par->tune_parms = entry->tune_parms;
+      }
+    }
+  }
 }
 
+struct tuneparams_parser_ctx {
+  TuneParamsIndex *index;
+  htmlSAXHandlerPtr sax;
+  const struct mux_filter *filter;
+
+  struct mux_params parse_buf;
+  gchar *parse_buf_mux;
+
+  bool in_table;
+  bool skip_row;
+  int cur_row;
+  int cur_column;
+};
+
 static void tune_params_set_dvb_mod(struct tune_params *tuneparms,
                                     enum fe_delivery_system dvb_type,
                                     enum fe_modulation mod) {
@@ -276,6 +354,7 @@ static void reset_parse_buf(struct tuneparams_parser_ctx *ctx) {
   mux_params_clear(&ctx->parse_buf);
   memset(&ctx->parse_buf, 0, sizeof(ctx->parse_buf));
   g_clear_pointer(&ctx->parse_buf_mux, g_free);
+  ctx->skip_row = false;
   /* tune_params are set to DVB-T/64QAM by default, and overridden in
    * tuneparams_characters() only if the data clearly shows that this is a
    * DVB-T2 transmission */
@@ -290,6 +369,8 @@ static void tuneparams_characters(void *ctx, const xmlChar *ch, int len) {
   const gsize siz = (gsize)len;
   const char *const chch = (const char *)ch;
   struct tune_params *const tune_parms = &my_ctx->parse_buf.tune_parms;
+  if (my_ctx->skip_row)
+    return;
   switch (my_ctx->cur_column) {
   case 1:
     tune_parms->freq_khz = (guint)(g_ascii_strtod(chch, NULL) * 1000.0);
@@ -301,6 +382,11 @@ static void tuneparams_characters(void *ctx, const xmlChar *ch, int len) {
      * sound too nice for the webadmin's PoV. */
     tune_parms->bw_mhz = strcmp(chch, "MUX-8") == 0 ? 7 : 8;
 
+    if (!mux_filter_accepts_mux(my_ctx->filter, chch,
+                                sanitized_mux_id_len(chch, siz))) {
+      my_ctx->skip_row = true;
+      break;
+    }
     gchar *const mux_id = g_strndup(chch, siz);
     if (sanitize_mux_id(mux_id, siz)) {
       tune_params_set_dvb_mod(tune_parms, SYS_DVBT2, QAM_256);
@@ -349,9 +435,11 @@ static void tuneparams_end_element(void *ctx, const xmlChar *name) {
       my_ctx->cur_column++;
     } else if (strcmp((const char *)name, "tr") == 0) {
       if (my_ctx->cur_row >= 1 && my_ctx->cur_column == 7 &&
-          my_ctx->parse_buf_mux) {
-        add_tuneparams_to_muxdata(my_ctx->muxdata, &my_ctx->parse_buf,
-                                  my_ctx->parse_buf_mux);
+          my_ctx->parse_buf_mux &&
+          mux_filter_accepts_delsys(my_ctx->filter,
+                                    my_ctx->parse_buf.tune_parms.dvb_type)) {
+        tune_params_index_insert(my_ctx->index, my_ctx->parse_buf_mux,
+                                 &my_ctx->parse_buf);
       }
       reset_parse_buf(my_ctx);
       my_ctx->cur_row++;
@@ -360,8 +448,8 @@ static void tuneparams_end_element(void *ctx, const xmlChar *name) {
   }
 }
 
-void parse_tune_params_to_mux_params(MuxData *muxdata, const char *html,
-                                     int size) {
+TuneParamsIndex *parse_tune_params_index(const char *html, int size,
+                                         const struct mux_filter *filter) {
   htmlSAXHandler sax;
   memset(&sax, 0, sizeof(sax));
   sax.startElement = tuneparams_start_element;
@@ -371,7 +459,8 @@ void parse_tune_params_to_mux_params(MuxData *muxdata, const char *html,
   memset(&my_ctx, 0, sizeof(my_ctx));
   reset_parse_buf(&my_ctx);
   my_ctx.sax = &sax;
-  my_ctx.muxdata = muxdata;
+  my_ctx.filter = filter;
+  my_ctx.index = tune_params_index_new();
 
   htmlParserCtxtPtr ctxt = htmlNewParserCtxt();
   htmlSAXHandlerPtr oldsax = ctxt->sax;
@@ -384,4 +473,82 @@ void parse_tune_params_to_mux_params(MuxData *muxdata, const char *html,
   ctxt->sax = oldsax;
   ctxt->userData = oldctx;
   htmlFreeParserCtxt(ctxt);
+
+  mux_params_clear(&my_ctx.parse_buf);
+  g_free(my_ctx.parse_buf_mux);
+
+  return my_ctx.index;
+}
+
+void parse_tune_params_to_mux_params(MuxData *muxdata, const char *html,
+                                     int size) {
+  TuneParamsIndex *const index = parse_tune_params_index(html, size, NULL);
+  tune_params_index_apply(index, muxdata);
+  tune_params_index_destroy(index);
+}
+
+void parser_init(void) { LIBXML_TEST_VERSION; }
+
+gboolean parser_is_thread_safe(void) {
+  return xmlHasFeature(XML_WITH_THREAD) != 0;
+}
+
+/* the transmitter pages aren't structured in any useful way, so the
+ * coordinates are looked for in the raw bytes, in all the forms they're known
+ * to appear in : map links, degrees/minutes/seconds and decimal degrees.
+ * the degree sign might be in CP1250, UTF-8, or an entity. */
+#define DEG_SIGN "(?:\\xb0|\\xc2\\xb0|&deg;|&#176;)"
+#define DMS(hemisphere)                                                        \
+  "(\\d{1,3})\\s*" DEG_SIGN "\\s*(\\d{1,2})\\s*"                               \
+  "(?:'|\\x92|&#39;)\\s*(\\d{1,2}(?:[.,]\\d+)?)\\s*"                           \
+  "(?:\"|''|&quot;)?\\s*" hemisphere
+
+static const char *const coordinate_patterns[] = {
+    "[?&](?:amp;)?lat=(-?\\d{1,2}\\.\\d+)&(?:amp;)?(?:lng|lon)="
+    "(-?\\d{1,3}\\.\\d+)",
+    DMS("N") "\\D{0,40}?" DMS("E"),
+    "(?<![\\d.])(\\d{1,2}\\.\\d{3,})\\s*" DEG_SIGN "?\\s*N?[\\s,;]+"
+    "(\\d{1,3}\\.\\d{3,})"};
+
+#undef DMS
+#undef DEG_SIGN
+
+static gdouble match_fetch_double(const GMatchInfo *match, gint idx) {
+  gchar *const str = g_match_info_fetch(match, idx);
+  g_strdelimit(str, ",", '.');
+  const gdouble rv = g_ascii_strtod(str, NULL);
+  g_free(str);
+  return rv;
+}
+
+static gdouble match_fetch_dms(const GMatchInfo *match, gint first_idx) {
+  return match_fetch_double(match, first_idx) +
+         match_fetch_double(match, first_idx + 1) / 60.0 +
+         match_fetch_double(match, first_idx + 2) / 3600.0;
+}
+
+gboolean parse_transmitter_location_from_html(const char *html, int size,
+                                              double *lat, double *lon) {
+  /* the page is matched as raw bytes, so it must be NUL-terminated. */
+  gchar *const page = g_strndup(html, size);
+  gboolean found = FALSE;
+  for (gsize i = 0; i < G_N_ELEMENTS(coordinate_patterns) && !found; ++i) {
+    GRegex *const regex = g_regex_new(coordinate_patterns[i],
+                                      G_REGEX_RAW | G_REGEX_CASELESS, 0, NULL);
+    GMatchInfo *match = NULL;
+    if (g_regex_match(regex, page, 0, &match)) {
+      if (i == 1) {
+        *lat = match_fetch_dms(match, 1);
+        *lon = match_fetch_dms(match, 4);
+      } else {
+        *lat = match_fetch_double(match, 1);
+        *lon = match_fetch_double(match, 2);
+      }
+      found = *lat >= -90.0 && *lat <= 90.0 && *lon >= -180.0 && *lon <= 180.0;
+    }
+    g_match_info_free(match);
+    g_regex_unref(regex);
+  }
+  g_free(page);
+  return found;
 }
@@ -9,12 +9,37 @@
  * value : GArray of mux_params sorted by distance
  * everything will be freed when the hash table is destroyed. if you want to
  * keep something, steal it.
+ * transmitters not accepted by the filter are skipped while parsing, and
+ * info_html is only filled in when the filter asks for it.
  */
-MuxData *parse_mux_params_from_html(const char *html, int size);
+MuxData *parse_mux_params_from_html(const char *html, int size,
+                                    const struct mux_filter *filter);
+
+typedef struct TuneParamsIndex_ TuneParamsIndex;
 
 /* parse the list of all transmitters in order to fill in missing tune_params
  * members, namely bandwidth, modulation, and DVB-T/T2. */
 void parse_tune_params_to_mux_params(MuxData *muxdata, const char *html,
                                      int size);
 
+/* same as above, but split in two so that the list, which is the same for all
+ * locations, only needs to be parsed once. the index is keyed by MUX,
+ * transmitter name and frequency. */
+TuneParamsIndex *parse_tune_params_index(const char *html, int size,
+                                         const struct mux_filter *filter);
+void tune_params_index_apply(const TuneParamsIndex *index, MuxData *muxdata);
+void tune_params_index_destroy(TuneParamsIndex *index);
+
+/* looks for the coordinates of a transmitter on its page, as linked to by
+ * mux_params.info_html. */
+gboolean parse_transmitter_location_from_html(const char *html, int size,
+                                              double *lat, double *lon);
+
+/* must be called from the main thread before parsing on any other thread. */
+void parser_init(void);
+
+/* whether documents can be parsed on several threads at the same time, which
+ * depends on libxml being built with thread support. */
+gboolean parser_is_thread_safe(void);
+
 #endif
@@ -0,0 +1,258 @@
+#include "plan.h"
+
+#define GROUP_PLAN "plan"
+#define GROUP_TRANSMITTER_FMT "transmitter %u"
+#define KEY_VERSION "version"
+#define KEY_TRANSMITTERS "transmitters"
+#define KEY_MUX "mux"
+#define KEY_NAME "name"
+#define KEY_DISTANCE "distance"
+#define KEY_FREQUENCY "frequency"
+#define KEY_BANDWIDTH "bandwidth"
+#define KEY_MODULATION "modulation"
+#define KEY_DELSYS "delivery-system"
+
+#define PLAN_MAX_BANDWIDTH_MHZ 10
+
+struct named_value {
+  const gchar *name;
+  guint value;
+};
+
+/* the names are the ones the dvbv5 tools use. */
+static const struct named_value modulations[] = {
+    {"QPSK", QPSK},       {"QAM/16", QAM_16},   {"QAM/32", QAM_32},
+    {"QAM/64", QAM_64},   {"QAM/128", QAM_128}, {"QAM/256", QAM_256},
+    {"QAM/AUTO", QAM_AUTO}};
+
+static const struct named_value delivery_systems[] = {
+    {"DVB-T", SYS_DVBT}, {"DVB-T2", SYS_DVBT2}, {"AUTO", SYS_UNDEFINED}};
+
+static const gchar *name_of(const struct named_value *values, gsize num,
+                            guint value) {
+  for (gsize i = 0; i < num; ++i) {
+    if (values[i].value == value) {
+      return values[i].name;
+    }
+  }
+  return NULL;
+}
+
+static gboolean value_of(const struct named_value *values, gsize num,
+                         const gchar *name, guint *value) {
+  for (gsize i = 0; i < num; ++i) {
+    if (g_strcmp0(values[i].name, name) == 0) {
+      *value = values[i].value;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+struct plan_writer {
+  GKeyFile *kf;
+  guint num_transmitters;
+};
+
+static void write_mux(const gchar *mux, const GArray *transmitters,
+                      struct plan_writer *writer) {
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    const struct tune_params *const tp = &par->tune_parms;
+    gchar *const group = g_strdup_printf(GROUP_TRANSMITTER_FMT,
+                                         ++writer->num_transmitters);
+    const gchar *const mod =
+        name_of(modulations, G_N_ELEMENTS(modulations), tp->mod);
+    const gchar *const delsys = name_of(
+        delivery_systems, G_N_ELEMENTS(delivery_systems), tp->dvb_type);
+    g_key_file_set_string(writer->kf, group, KEY_MUX, mux);
+    g_key_file_set_string(writer->kf, group, KEY_NAME, par->name);
+    g_key_file_set_double(writer->kf, group, KEY_DISTANCE, par->distance);
+    g_key_file_set_integer(writer->kf, group, KEY_FREQUENCY,
+                           (gint)tp->freq_khz);
+    g_key_file_set_integer(writer->kf, group, KEY_BANDWIDTH,
+                           (gint)tp->bw_mhz);
+    /* anything else can't be tuned to by the rest of the program either. */
+    g_key_file_set_string(writer->kf, group, KEY_MODULATION,
+                          mod ? mod : "QAM/AUTO");
+    g_key_file_set_string(writer->kf, group, KEY_DELSYS,
+                          delsys ? delsys : "AUTO");
+    g_free(group);
+  }
+}
+
+gboolean plan_save(MuxData *md, const gchar *path, GError **error) {
+  struct plan_writer writer = {.kf = g_key_file_new(), .num_transmitters = 0};
+  g_key_file_set_integer(writer.kf, GROUP_PLAN, KEY_VERSION, PLAN_VERSION);
+  /* set again once they're counted, but the group should come first. */
+  g_key_file_set_integer(writer.kf, GROUP_PLAN, KEY_TRANSMITTERS, 0);
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    write_mux(mux_data_get_mux_at(md, m), mux_data_get_transmitters_at(md, m),
+              &writer);
+  }
+  g_key_file_set_integer(writer.kf, GROUP_PLAN, KEY_TRANSMITTERS,
+                         (gint)writer.num_transmitters);
+  const gboolean rv = g_key_file_save_to_file(writer.kf, path, error);
+  g_key_file_free(writer.kf);
+  return rv;
+}
+
+static gboolean get_uint_in_range(GKeyFile *kf, const gchar *group,
+                                  const gchar *key, guint min, guint max,
+                                  guint *value, GError **error) {
+  GError *err = NULL;
+  const gint read = g_key_file_get_integer(kf, group, key, &err);
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  if (read < (gint)min || read > (gint)max) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "%s must be between %u and %u", key, min, max);
+    return FALSE;
+  }
+  *value = (guint)read;
+  return TRUE;
+}
+
+static gboolean get_named(GKeyFile *kf, const gchar *group, const gchar *key,
+                          const struct named_value *values, gsize num,
+                          guint *value, GError **error) {
+  gchar *const name = g_key_file_get_string(kf, group, key, error);
+  if (!name) {
+    return FALSE;
+  }
+  const gboolean found = value_of(values, num, name, value);
+  if (!found) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "unknown %s %s", key, name);
+  }
+  g_free(name);
+  return found;
+}
+
+static gboolean read_transmitter(GKeyFile *kf, const gchar *group,
+                                 MuxData *md, GError **error) {
+  struct mux_params par = {.name = NULL, .info_html = NULL, .distance = 0};
+  guint mod, delsys;
+  GError *err = NULL;
+  gchar *const mux = g_key_file_get_string(kf, group, KEY_MUX, error);
+  if (!mux ||
+      !(par.name = g_key_file_get_string(kf, group, KEY_NAME, error)) ||
+      !get_uint_in_range(kf, group, KEY_FREQUENCY, 1, G_MAXINT,
+                         &par.tune_parms.freq_khz, error) ||
+      !get_uint_in_range(kf, group, KEY_BANDWIDTH, 1,
+                         PLAN_MAX_BANDWIDTH_MHZ, &par.tune_parms.bw_mhz,
+                         error) ||
+      !get_named(kf, group, KEY_MODULATION, modulations,
+                 G_N_ELEMENTS(modulations), &mod, error) ||
+      !get_named(kf, group, KEY_DELSYS, delivery_systems,
+                 G_N_ELEMENTS(delivery_systems), &delsys, error)) {
+    goto fail;
+  }
+  par.distance = g_key_file_get_double(kf, group, KEY_DISTANCE, &err);
+  if (err) {
+    g_propagate_error(error, err);
+    goto fail;
+  }
+  par.tune_parms.mod = (enum fe_modulation)mod;
+  par.tune_parms.dvb_type = (enum fe_delivery_system)delsys;
+  mux_data_append_transmitter(md, mux, &par);
+  g_free(mux);
+  return TRUE;
+
+fail:
+  g_prefix_error(error, "%s : ", group);
+  mux_params_clear(&par);
+  g_free(mux);
+  return FALSE;
+}
+
+MuxData *plan_load_from_data(const gchar *data, gsize len, GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  MuxData *md = NULL;
+  guint version, num_transmitters;
+  if (!g_key_file_load_from_data(kf, data, len, G_KEY_FILE_NONE, error) ||
+      !get_uint_in_range(kf, GROUP_PLAN, KEY_VERSION, 0, G_MAXINT, &version,
+                         error) ||
+      !get_uint_in_range(kf, GROUP_PLAN, KEY_TRANSMITTERS, 1, G_MAXINT,
+                         &num_transmitters, error)) {
+    goto beach;
+  }
+  if (version != PLAN_VERSION) {
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                "the plan is of version %u instead of %u, compile it again",
+                version, PLAN_VERSION);
+    goto beach;
+  }
+
+  md = mux_data_new();
+  for (guint i = 1; i <= num_transmitters; ++i) {
+    gchar *const group = g_strdup_printf(GROUP_TRANSMITTER_FMT, i);
+    const gboolean read = read_transmitter(kf, group, md, error);
+    g_free(group);
+    if (!read) {
+      g_clear_pointer(&md, mux_data_destroy);
+      break;
+    }
+  }
+
+beach:
+  g_key_file_free(kf);
+  return md;
+}
+
+MuxData *plan_load(const gchar *path, GError **error) {
+  gchar *contents;
+  gsize len;
+  if (!g_file_get_contents(path, &contents, &len, error)) {
+    return NULL;
+  }
+  MuxData *const md = plan_load_from_data(contents, len, error);
+  g_free(contents);
+  if (!md) {
+    g_prefix_error(error, "%s : ", path);
+  }
+  return md;
+}
+
+static void format_mux_channels(const gchar *mux, const GArray *transmitters,
+                                GString *out) {
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    const struct tune_params *const tp = &par->tune_parms;
+    const gchar *const mod =
+        name_of(modulations, G_N_ELEMENTS(modulations), tp->mod);
+    /* dvbv5 needs a delivery system, and DVB-T is what most of them are. */
+    const gboolean t2 = tp->dvb_type == SYS_DVBT2;
+    g_string_append_printf(out,
+                           "[%s %s]\n"
+                           "\tDELIVERY_SYSTEM = %s\n"
+                           "\tFREQUENCY = %u\n"
+                           "\tBANDWIDTH_HZ = %u\n"
+                           "\tMODULATION = %s\n"
+                           "\tINVERSION = AUTO\n"
+                           "\tCODE_RATE_HP = AUTO\n",
+                           mux, par->name, t2 ? "DVBT2" : "DVBT",
+                           tp->freq_khz * 1000, tp->bw_mhz * 1000000,
+                           mod ? mod : "QAM/AUTO");
+    if (!t2) {
+      g_string_append(out, "\tCODE_RATE_LP = AUTO\n"
+                           "\tHIERARCHY = AUTO\n");
+    }
+    g_string_append(out, "\tGUARD_INTERVAL = AUTO\n"
+                         "\tTRANSMISSION_MODE = AUTO\n"
+                         "\n");
+  }
+}
+
+gchar *plan_format_channels_conf(MuxData *md) {
+  GString *const out = g_string_new(NULL);
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    format_mux_channels(mux_data_get_mux_at(md, m),
+                        mux_data_get_transmitters_at(md, m), out);
+  }
+  return g_string_free(out, FALSE);
+}
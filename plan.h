@@ -0,0 +1,40 @@
+#ifndef GETPLMUX_PLAN_H
+#define GETPLMUX_PLAN_H
+
+#include <glib.h>
+
+#include "muxdata.h"
+
+/* the transmitters a run would capture, in the order it would try them,
+ * saved so that later runs can start tuning right away instead of reading
+ * the cache and the capture history again. it's a key file with a group per
+ * transmitter, listed in the order they're tried :
+ *
+ *   [plan]
+ *   version=1
+ *   transmitters=1
+ *
+ *   [transmitter 1]
+ *   mux=MUX-1
+ *   name=Poznań/Śrem
+ *   distance=12.5
+ *   frequency=474000
+ *   bandwidth=8
+ *   modulation=QAM/64
+ *   delivery-system=DVB-T
+ *
+ * frequencies are in kHz and bandwidths in MHz. the modulation and delivery
+ * system may be AUTO if they aren't known. */
+#define PLAN_VERSION 1
+
+gboolean plan_save(MuxData *md, const gchar *path, GError **error);
+
+/* checks everything in the plan, so that it can be tuned to as it is. */
+MuxData *plan_load(const gchar *path, GError **error);
+MuxData *plan_load_from_data(const gchar *data, gsize len, GError **error);
+
+/* the transmitters as a channels.conf in the format of the dvbv5 tools,
+ * with a channel named after the MUX and transmitter for every one. */
+gchar *plan_format_channels_conf(MuxData *md);
+
+#endif
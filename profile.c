@@ -0,0 +1,83 @@
+#include "profile.h"
+
+struct profile_step {
+  gchar *name;
+  gint64 start_us;
+  gint64 end_us;
+};
+
+struct Profile_ {
+  gchar *title;
+  gint64 start_us;
+  GMutex lock;
+  /* struct profile_step */
+  GArray *steps;
+};
+
+static void profile_step_clear(gpointer p) {
+  struct profile_step *const step = p;
+  g_free(step->name);
+}
+
+Profile *profile_new(const gchar *title, gint64 start_us) {
+  Profile *const profile = g_new(Profile, 1);
+  profile->title = g_strdup(title);
+  profile->start_us = start_us;
+  g_mutex_init(&profile->lock);
+  profile->steps = g_array_new(FALSE, FALSE, sizeof(struct profile_step));
+  g_array_set_clear_func(profile->steps, profile_step_clear);
+  return profile;
+}
+
+void profile_destroy(Profile *profile) {
+  if (!profile) {
+    return;
+  }
+  g_array_unref(profile->steps);
+  g_mutex_clear(&profile->lock);
+  g_free(profile->title);
+  g_free(profile);
+}
+
+void profile_add(Profile *profile, const gchar *step, gint64 start_us,
+                 gint64 end_us) {
+  if (!profile) {
+    return;
+  }
+  const struct profile_step added = {
+      .name = g_strdup(step), .start_us = start_us, .end_us = end_us};
+  g_mutex_lock(&profile->lock);
+  g_array_append_val(profile->steps, added);
+  g_mutex_unlock(&profile->lock);
+}
+
+static gint by_start_cmpfn(gconstpointer a, gconstpointer b) {
+  const struct profile_step *const sA = a, *sB = b;
+  if (sA->start_us != sB->start_us) {
+    return sA->start_us < sB->start_us ? -1 : 1;
+  }
+  return 0;
+}
+
+static gdouble to_ms(gint64 us) { return (gdouble)us / 1000; }
+
+gchar *profile_format(Profile *profile, gint64 now_us) {
+  if (!profile) {
+    return NULL;
+  }
+  GString *const out = g_string_new(NULL);
+  g_string_append_printf(out, "%s :\n", profile->title);
+  g_mutex_lock(&profile->lock);
+  g_array_sort(profile->steps, by_start_cmpfn);
+  for (guint i = 0; i < profile->steps->len; ++i) {
+    const struct profile_step *const step =
+        &g_array_index(profile->steps, struct profile_step, i);
+    g_string_append_printf(out, "  at %8.1f ms : %8.1f ms %s\n",
+                           to_ms(step->start_us - profile->start_us),
+                           to_ms(step->end_us - step->start_us), step->name);
+  }
+  g_mutex_unlock(&profile->lock);
+  g_string_append_printf(out, "  total          : %8.1f ms\n",
+                         to_ms(now_us - profile->start_us));
+  return g_string_free(out, FALSE);
+}
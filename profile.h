@@ -0,0 +1,23 @@
+#ifndef GETPLMUX_PROFILE_H
+#define GETPLMUX_PROFILE_H
+
+#include <glib.h>
+
+/* collects how long the steps of something took, to be printed at the end.
+ * every function accepts NULL, in which case nothing happens, so that callers
+ * don't need to check whether profiling was asked for. steps may be added
+ * from several threads at once. all times are monotonic. */
+typedef struct Profile_ Profile;
+
+Profile *profile_new(const gchar *title, gint64 start_us);
+void profile_destroy(Profile *profile);
+
+void profile_add(Profile *profile, const gchar *step, gint64 start_us,
+                 gint64 end_us);
+
+/* one line per step in the order they started, with the time it started at
+ * relative to the start of the profile, so that steps done at the same time
+ * can be told apart, followed by the total until now_us. */
+gchar *profile_format(Profile *profile, gint64 now_us);
+
+#endif
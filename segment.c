@@ -0,0 +1,187 @@
+#include "segment.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <glib/gstdio.h>
+
+#include "ts.h"
+
+struct SegmentWriter_ {
+  gchar *prefix;
+  struct segment_limits limits;
+  segment_done_fn fn;
+  void *fn_ctx;
+  struct ts_splitter splitter;
+  /* of the data being pushed */
+  gint64 now_us;
+  gint64 wall_us;
+
+  /* NULL until the first segment starts */
+  FILE *index;
+  gchar *index_path;
+  guint num_segments;
+  guint64 bytes_written;
+
+  /* NULL between segments */
+  FILE *f;
+  gchar *path;
+  guint64 offset;
+  guint64 len;
+  gint64 start_us;
+  gint64 start_wall_us;
+  /* G_MAXUINT16 until a PCR comes in */
+  guint16 pcr_pid;
+  guint64 pcr;
+
+  GError *write_error;
+};
+
+SegmentWriter *segment_writer_new(const gchar *prefix,
+                                  const struct segment_limits *limits,
+                                  segment_done_fn fn, void *ctx) {
+  SegmentWriter *const writer = g_new0(SegmentWriter, 1);
+  writer->prefix = g_strdup(prefix);
+  writer->limits = *limits;
+  writer->fn = fn;
+  writer->fn_ctx = ctx;
+  ts_splitter_init(&writer->splitter);
+  return writer;
+}
+
+static void set_error(SegmentWriter *writer, const gchar *what,
+                      const gchar *path) {
+  const int errsv = errno;
+  g_set_error(&writer->write_error, G_FILE_ERROR,
+              g_file_error_from_errno(errsv), "Could not %s %s : %s", what,
+              path, g_strerror(errsv));
+}
+
+static void segment_start(SegmentWriter *writer) {
+  if (!writer->index) {
+    writer->index_path = g_strconcat(writer->prefix, ".idx", NULL);
+    writer->index = g_fopen(writer->index_path, "w");
+    if (!writer->index) {
+      set_error(writer, "open", writer->index_path);
+      return;
+    }
+  }
+  writer->path = g_strdup_printf("%s_%05u.ts", writer->prefix,
+                                 writer->num_segments++);
+  writer->f = g_fopen(writer->path, "wb");
+  if (!writer->f) {
+    set_error(writer, "open", writer->path);
+    return;
+  }
+  writer->offset = writer->bytes_written;
+  writer->len = 0;
+  writer->start_us = writer->now_us;
+  writer->start_wall_us = writer->wall_us;
+  writer->pcr_pid = G_MAXUINT16;
+}
+
+static void write_index_line(SegmentWriter *writer) {
+  GDateTime *const start =
+      g_date_time_new_from_unix_utc(writer->start_wall_us / G_USEC_PER_SEC);
+  gchar *const start_str = g_date_time_format_iso8601(start);
+  g_date_time_unref(start);
+  gchar *const name = g_path_get_basename(writer->path);
+  gchar *const pcr_str =
+      writer->pcr_pid == G_MAXUINT16
+          ? g_strdup("-\t-")
+          : g_strdup_printf("%u\t%" G_GUINT64_FORMAT, writer->pcr_pid,
+                            writer->pcr);
+  if (fprintf(writer->index,
+              "%s\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%s\t%s\n",
+              name, writer->offset, writer->len, pcr_str, start_str) < 0 ||
+      fflush(writer->index) != 0) {
+    set_error(writer, "write to", writer->index_path);
+  }
+  g_free(pcr_str);
+  g_free(name);
+  g_free(start_str);
+}
+
+static void segment_finish(SegmentWriter *writer) {
+  if (fclose(g_steal_pointer(&writer->f)) != 0 && !writer->write_error) {
+    set_error(writer, "write to", writer->path);
+  }
+  if (!writer->write_error) {
+    write_index_line(writer);
+  }
+  if (!writer->write_error && writer->fn) {
+    writer->fn(writer->path, writer->fn_ctx);
+  }
+  g_clear_pointer(&writer->path, g_free);
+}
+
+static gboolean segment_is_full(const SegmentWriter *writer) {
+  const struct segment_limits *const limits = &writer->limits;
+  /* every segment holds at least a packet. */
+  return writer->len > 0 &&
+         ((limits->max_bytes > 0 &&
+           writer->len + TS_PACKET_SIZE > limits->max_bytes) ||
+          (limits->max_duration_us > 0 &&
+           writer->now_us - writer->start_us >= limits->max_duration_us));
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  SegmentWriter *const writer = ctx;
+  if (writer->write_error) {
+    return;
+  }
+  if (writer->f && segment_is_full(writer)) {
+    segment_finish(writer);
+  }
+  if (!writer->f) {
+    segment_start(writer);
+    if (writer->write_error) {
+      return;
+    }
+  }
+  if (writer->pcr_pid == G_MAXUINT16 &&
+      ts_packet_get_pcr(data, &writer->pcr)) {
+    writer->pcr_pid = (guint16)(((data[1] & 0x1f) << 8) | data[2]);
+  }
+  if (fwrite(data, TS_PACKET_SIZE, 1, writer->f) != 1) {
+    set_error(writer, "write to", writer->path);
+    return;
+  }
+  writer->len += TS_PACKET_SIZE;
+  writer->bytes_written += TS_PACKET_SIZE;
+}
+
+void segment_writer_push(SegmentWriter *writer, const guint8 *data, gsize len,
+                         gint64 now_us, gint64 wall_us) {
+  writer->now_us = now_us;
+  writer->wall_us = wall_us;
+  ts_splitter_push(&writer->splitter, data, len, on_packet, writer);
+}
+
+guint64 segment_writer_get_bytes_written(const SegmentWriter *writer) {
+  return writer->bytes_written;
+}
+
+gboolean segment_writer_close(SegmentWriter *writer, GError **error) {
+  if (writer->f) {
+    segment_finish(writer);
+  }
+  GError *err = g_steal_pointer(&writer->write_error);
+  if (writer->index && fclose(writer->index) != 0 && !err) {
+    const int errsv = errno;
+    g_set_error(&err, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", writer->index_path,
+                g_strerror(errsv));
+  }
+
+  g_free(writer->index_path);
+  g_free(writer->path);
+  g_free(writer->prefix);
+  g_free(writer);
+
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  return TRUE;
+}
@@ -0,0 +1,43 @@
+#ifndef GETPLMUX_SEGMENT_H
+#define GETPLMUX_SEGMENT_H
+
+#include <glib.h>
+
+/* writes a capture as a series of files, cut at packet boundaries once a
+ * segment is long or big enough, so that each can be processed as soon as
+ * it's done. the segments are named PREFIX_00000.ts and so on, and every
+ * one which is done gets a tab-separated line in PREFIX.idx :
+ *
+ *   PREFIX_00000.ts 0 1880000 256 1234567890 2024-05-01T12:00:00Z
+ *
+ * with its byte offset in the whole capture, its size, the PID and value
+ * of the first PCR in it, in 27 MHz ticks, or - for both if there isn't
+ * one, and the wall time it started at. */
+typedef struct SegmentWriter_ SegmentWriter;
+
+struct segment_limits {
+  /* 0 for no limit */
+  gint64 max_duration_us;
+  guint64 max_bytes;
+};
+
+/* gets the path of every segment once it's been written and closed. */
+typedef void (*segment_done_fn)(const gchar *path, void *ctx);
+
+/* nothing is created until something is pushed. fn may be NULL. */
+SegmentWriter *segment_writer_new(const gchar *prefix,
+                                  const struct segment_limits *limits,
+                                  segment_done_fn fn, void *ctx);
+
+/* now_us is monotonic time, wall_us real time. this may be called from a
+ * different thread than the rest, but never at the same time. */
+void segment_writer_push(SegmentWriter *writer, const guint8 *data, gsize len,
+                         gint64 now_us, gint64 wall_us);
+
+guint64 segment_writer_get_bytes_written(const SegmentWriter *writer);
+
+/* finishes the last segment and reports the first error that happened
+ * while writing. the writer is freed either way. */
+gboolean segment_writer_close(SegmentWriter *writer, GError **error);
+
+#endif
@@ -0,0 +1,217 @@
+#include "silog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "ts.h"
+
+static const guint16 si_pids[] = {TS_PID_PAT, TS_PID_NIT, TS_PID_SDT,
+                                  TS_PID_EIT, TS_PID_TDT};
+
+struct SiLog_ {
+  FILE *f;
+  gchar *path;
+  struct ts_splitter splitter;
+  TsSectionAssembler *assembler;
+  /* (table_id, table_id_extension, section_number, version) -> CRC of the
+   * section written last. the CRC is compared too, as the EIT of different
+   * transport streams may have the same key. */
+  GHashTable *written;
+  /* the short section written last, for each table_id */
+  GBytes *last_short[256];
+  gint64 now_us;
+  guint64 bytes_received;
+  guint sections_written;
+  GError *write_error;
+};
+
+static void write_section(SiLog *log, guint16 pid, const guint8 *section,
+                          gsize len) {
+  if (log->write_error) {
+    return;
+  }
+  guint8 hdr[SI_LOG_RECORD_HEADER_SIZE];
+  const guint64 time_us = (guint64)log->now_us;
+  for (int i = 0; i < 8; ++i) {
+    hdr[i] = (guint8)(time_us >> (56 - 8 * i));
+  }
+  hdr[8] = pid >> 8;
+  hdr[9] = pid & 0xff;
+  if (fwrite(hdr, sizeof(hdr), 1, log->f) != 1 ||
+      fwrite(section, len, 1, log->f) != 1) {
+    const int errsv = errno;
+    g_set_error(&log->write_error, G_FILE_ERROR,
+                g_file_error_from_errno(errsv), "Could not write to %s : %s",
+                log->path, g_strerror(errsv));
+    return;
+  }
+  ++log->sections_written;
+}
+
+static gboolean short_section_is_new(SiLog *log, const guint8 *section,
+                                     gsize len) {
+  GBytes **const last = &log->last_short[section[0]];
+  if (*last) {
+    gsize last_len;
+    const guint8 *const last_data = g_bytes_get_data(*last, &last_len);
+    if (last_len == len && memcmp(last_data, section, len) == 0) {
+      return FALSE;
+    }
+    g_bytes_unref(*last);
+  }
+  *last = g_bytes_new(section, len);
+  return TRUE;
+}
+
+static gboolean long_section_is_new(SiLog *log, const guint8 *section,
+                                    gsize len,
+                                    const struct ts_section_header *hdr) {
+  gint64 key = ((gint64)hdr->table_id << 32) |
+               ((gint64)hdr->table_id_extension << 16) |
+               ((gint64)hdr->section_number << 8) | hdr->version;
+  /* the CRC is the last thing in the section. */
+  const gpointer crc = GUINT_TO_POINTER(ts_read_u32(section + len - 4));
+  gpointer written_crc;
+  if (g_hash_table_lookup_extended(log->written, &key, NULL, &written_crc) &&
+      written_crc == crc) {
+    return FALSE;
+  }
+  g_hash_table_insert(log->written, g_memdup2(&key, sizeof(key)), crc);
+  return TRUE;
+}
+
+static void on_section(guint16 pid, const guint8 *section, gsize len,
+                       void *ctx) {
+  SiLog *const log = ctx;
+  struct ts_section_header hdr;
+  gboolean is_new;
+  if (ts_section_parse_header(section, len, &hdr)) {
+    is_new = hdr.current_next && long_section_is_new(log, section, len, &hdr);
+  } else {
+    is_new = short_section_is_new(log, section, len);
+  }
+  if (is_new) {
+    write_section(log, pid, section, len);
+  }
+}
+
+static void on_packet(const guint8 *data, void *ctx) {
+  SiLog *const log = ctx;
+  struct ts_packet pkt;
+  if (ts_packet_parse(data, &pkt)) {
+    ts_section_assembler_push(log->assembler, &pkt);
+  }
+}
+
+SiLog *si_log_open(const gchar *path, GError **error) {
+  FILE *const f = g_fopen(path, "wb");
+  if (!f) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not open %s : %s", path, g_strerror(errsv));
+    return NULL;
+  }
+
+  SiLog *const log = g_new0(SiLog, 1);
+  log->f = f;
+  log->path = g_strdup(path);
+  ts_splitter_init(&log->splitter);
+  log->assembler = ts_section_assembler_new(on_section, log);
+  for (gsize i = 0; i < G_N_ELEMENTS(si_pids); ++i) {
+    ts_section_assembler_add_pid(log->assembler, si_pids[i]);
+  }
+  log->written = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                       NULL);
+  log->write_error = NULL;
+
+  if (fwrite(SI_LOG_MAGIC, SI_LOG_MAGIC_LEN, 1, f) != 1) {
+    const int errsv = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", path, g_strerror(errsv));
+    si_log_close(log, NULL);
+    return NULL;
+  }
+  return log;
+}
+
+void si_log_push(SiLog *log, const guint8 *data, gsize len, gint64 now_us) {
+  log->now_us = now_us;
+  log->bytes_received += len;
+  ts_splitter_push(&log->splitter, data, len, on_packet, log);
+}
+
+guint64 si_log_get_bytes_received(const SiLog *log) {
+  return log->bytes_received;
+}
+
+guint si_log_get_sections_written(const SiLog *log) {
+  return log->sections_written;
+}
+
+gboolean si_log_close(SiLog *log, GError **error) {
+  GError *err = g_steal_pointer(&log->write_error);
+  if (fclose(log->f) != 0 && !err) {
+    const int errsv = errno;
+    g_set_error(&err, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                "Could not write to %s : %s", log->path, g_strerror(errsv));
+  }
+
+  ts_section_assembler_destroy(log->assembler);
+  g_hash_table_destroy(log->written);
+  for (gsize i = 0; i < G_N_ELEMENTS(log->last_short); ++i) {
+    g_clear_pointer(&log->last_short[i], g_bytes_unref);
+  }
+  g_free(log->path);
+  g_free(log);
+
+  if (err) {
+    g_propagate_error(error, err);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean si_log_read(const gchar *path, si_log_record_fn fn, void *ctx,
+                     GError **error) {
+  gchar *contents;
+  gsize len;
+  if (!g_file_get_contents(path, &contents, &len, error)) {
+    return FALSE;
+  }
+
+  gboolean rv = FALSE;
+  const guint8 *const data = (const guint8 *)contents;
+  if (len < SI_LOG_MAGIC_LEN ||
+      memcmp(data, SI_LOG_MAGIC, SI_LOG_MAGIC_LEN) != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "%s is not a section log", path);
+    goto beach;
+  }
+
+  gsize pos = SI_LOG_MAGIC_LEN;
+  while (pos < len) {
+    const guint8 *const record = data + pos;
+    const guint8 *const section = record + SI_LOG_RECORD_HEADER_SIZE;
+    const gsize left = len - pos;
+    if (left < SI_LOG_RECORD_HEADER_SIZE + 3 ||
+        left < SI_LOG_RECORD_HEADER_SIZE + 3 +
+                   (ts_read_u16(section + 1) & 0x0fffu)) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                  "%s is truncated at offset %" G_GSIZE_FORMAT, path, pos);
+      goto beach;
+    }
+    const gint64 time_us = (gint64)(((guint64)ts_read_u32(record) << 32) |
+                                    ts_read_u32(record + 4));
+    const gsize section_len = 3 + (ts_read_u16(section + 1) & 0x0fff);
+    fn(time_us, ts_read_u16(record + 8), section, section_len, ctx);
+    pos += SI_LOG_RECORD_HEADER_SIZE + section_len;
+  }
+  rv = TRUE;
+
+beach:
+  g_free(contents);
+  return rv;
+}
@@ -0,0 +1,46 @@
+#ifndef GETPLMUX_SILOG_H
+#define GETPLMUX_SILOG_H
+
+#include <glib.h>
+
+/* keeps the service information carried in a capture without the rest of the
+ * stream. the tables are repeated many times a second, so each section is
+ * only written when its table_id, table_id_extension, section_number and
+ * version, or the whole contents for short sections like the TDT, differ from
+ * what was written already.
+ *
+ * the log starts with SI_LOG_MAGIC, which is followed by one record per
+ * section : the time it was received in microseconds since the epoch (64
+ * bits) and its PID (16 bits), both big-endian, and then the section itself,
+ * whose header gives its length. */
+#define SI_LOG_MAGIC "GPMSI001"
+#define SI_LOG_MAGIC_LEN 8
+#define SI_LOG_RECORD_HEADER_SIZE 10
+
+/* PAT, NIT, SDT/BAT, EIT and TDT/TOT, as given to dvbsrc's pids property so
+ * that the demux drops everything else before it even gets to us. */
+#define SI_LOG_PIDS "0:16:17:18:20"
+
+typedef struct SiLog_ SiLog;
+
+SiLog *si_log_open(const gchar *path, GError **error);
+
+/* feeds the captured stream, which doesn't need to be aligned to packet
+ * boundaries. this may be called from a different thread than the rest, but
+ * never at the same time. */
+void si_log_push(SiLog *log, const guint8 *data, gsize len, gint64 now_us);
+
+guint64 si_log_get_bytes_received(const SiLog *log);
+guint si_log_get_sections_written(const SiLog *log);
+
+/* also reports the first write error that happened while pushing. the log is
+ * freed either way. */
+gboolean si_log_close(SiLog *log, GError **error);
+
+typedef void (*si_log_record_fn)(gint64 time_us, guint16 pid,
+                                 const guint8 *section, gsize len, void *ctx);
+
+gboolean si_log_read(const gchar *path, si_log_record_fn fn, void *ctx,
+                     GError **error);
+
+#endif
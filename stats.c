@@ -0,0 +1,403 @@
+#include "stats.h"
+
+#include <math.h>
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+/* a single failure might just be bad weather, so a transmitter is only
+ * skipped after failing this many times in a row. the TTL doubles with every
+ * further failure, up to STATS_BAD_TTL_MAX_DAYS. */
+#define STATS_BAD_AFTER_FAILURES 2
+#define STATS_BAD_TTL_DAYS 1
+#define STATS_BAD_TTL_MAX_DAYS 16
+
+struct stats_entry {
+  gchar *mux;
+  gchar *name;
+  guint freq_khz;
+
+  /* everything below is decayed to this point in time */
+  gint64 updated;
+  gdouble attempts;
+  gdouble locks;
+  /* sums over the attempts which locked */
+  gdouble lock_time_s;
+  gdouble capture_s;
+  gdouble read_fails;
+  gdouble bytes;
+
+  guint consecutive_failures;
+  gint64 bad_until;
+  /* not decayed, as it's only ever made bigger when needed */
+  guint dvr_buffer_size;
+  /* of the latest capture which had one, NULL if none did */
+  gchar *fingerprint;
+};
+
+struct TransmitterStats_ {
+  /* "MUX\nname\nfrequency" -> struct stats_entry */
+  GHashTable *by_key;
+};
+
+static void stats_entry_free(gpointer p) {
+  struct stats_entry *const entry = p;
+  g_free(entry->mux);
+  g_free(entry->name);
+  g_free(entry->fingerprint);
+  g_free(entry);
+}
+
+TransmitterStats *transmitter_stats_new(void) {
+  TransmitterStats *rv = g_new(TransmitterStats, 1);
+  rv->by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                     stats_entry_free);
+  return rv;
+}
+
+void transmitter_stats_destroy(TransmitterStats *stats) {
+  g_hash_table_destroy(stats->by_key);
+  g_free(stats);
+}
+
+static gchar *make_key(const gchar *mux, const gchar *name, guint freq_khz) {
+  return g_strdup_printf("%s\n%s\n%u", mux, name, freq_khz);
+}
+
+static struct stats_entry *lookup_entry(TransmitterStats *stats,
+                                        const gchar *mux,
+                                        const struct mux_params *params) {
+  gchar *const key = make_key(mux, params->name, params->tune_parms.freq_khz);
+  struct stats_entry *const entry = g_hash_table_lookup(stats->by_key, key);
+  g_free(key);
+  return entry;
+}
+
+static struct stats_entry *get_entry(TransmitterStats *stats, const gchar *mux,
+                                     const gchar *name, guint freq_khz) {
+  gchar *const key = make_key(mux, name, freq_khz);
+  struct stats_entry *entry = g_hash_table_lookup(stats->by_key, key);
+  if (entry) {
+    g_free(key);
+  } else {
+    entry = g_new0(struct stats_entry, 1);
+    entry->mux = g_strdup(mux);
+    entry->name = g_strdup(name);
+    entry->freq_khz = freq_khz;
+    g_hash_table_insert(stats->by_key, key, entry);
+  }
+  return entry;
+}
+
+static void stats_entry_decay(struct stats_entry *entry, gint64 now) {
+  if (now <= entry->updated) {
+    return;
+  }
+  const gdouble factor = exp2(-(gdouble)(now - entry->updated) /
+                              (STATS_HALF_LIFE_DAYS * SECONDS_PER_DAY));
+  entry->attempts *= factor;
+  entry->locks *= factor;
+  entry->lock_time_s *= factor;
+  entry->capture_s *= factor;
+  entry->read_fails *= factor;
+  entry->bytes *= factor;
+  entry->updated = now;
+}
+
+void transmitter_stats_record(TransmitterStats *stats, const gchar *mux,
+                              const struct mux_params *params,
+                              const struct capture_result *result,
+                              gint64 now) {
+  struct stats_entry *const entry =
+      get_entry(stats, mux, params->name, params->tune_parms.freq_khz);
+  stats_entry_decay(entry, now);
+
+  entry->attempts += 1.0;
+  if (result->locked) {
+    entry->locks += 1.0;
+    entry->lock_time_s += result->time_to_lock_s;
+    if (!result->filtered) {
+      entry->capture_s += result->duration_s;
+      entry->read_fails += result->read_fails;
+      entry->bytes += (gdouble)result->bytes;
+    }
+    if (result->dvr_buffer_size > 0) {
+      entry->dvr_buffer_size = result->dvr_buffer_size;
+    }
+    if (result->fingerprint) {
+      g_free(entry->fingerprint);
+      entry->fingerprint = g_strdup(result->fingerprint);
+    }
+    entry->consecutive_failures = 0;
+    entry->bad_until = 0;
+  } else if (++entry->consecutive_failures >= STATS_BAD_AFTER_FAILURES) {
+    const guint doublings = MIN(entry->consecutive_failures -
+                                    STATS_BAD_AFTER_FAILURES,
+                                4);
+    const gint64 ttl_days =
+        MIN(STATS_BAD_TTL_DAYS << doublings, STATS_BAD_TTL_MAX_DAYS);
+    entry->bad_until = now + ttl_days * SECONDS_PER_DAY;
+  }
+}
+
+gboolean transmitter_stats_is_known_bad(TransmitterStats *stats,
+                                        const gchar *mux,
+                                        const struct mux_params *params,
+                                        gint64 now) {
+  const struct stats_entry *const entry = lookup_entry(stats, mux, params);
+  return entry && entry->bad_until > now;
+}
+
+gboolean transmitter_stats_get_bitrate(TransmitterStats *stats,
+                                       const gchar *mux,
+                                       const struct mux_params *params,
+                                       guint64 *bitrate) {
+  const struct stats_entry *const entry = lookup_entry(stats, mux, params);
+  if (!entry || entry->capture_s <= 0 || entry->bytes <= 0) {
+    return FALSE;
+  }
+  /* both sums decay at the same rate, so the ratio doesn't change. */
+  *bitrate = (guint64)round(entry->bytes * 8 / entry->capture_s);
+  return TRUE;
+}
+
+guint transmitter_stats_get_dvr_buffer_size(TransmitterStats *stats,
+                                            const gchar *mux,
+                                            const struct mux_params *params) {
+  const struct stats_entry *const entry = lookup_entry(stats, mux, params);
+  return entry ? entry->dvr_buffer_size : 0;
+}
+
+/* the chance of locking, with a prior of one success and one failure so that
+ * transmitters without any history end up in the middle, scaled down by how
+ * often the signal broke up while capturing. */
+static gdouble stats_entry_score(const struct stats_entry *entry) {
+  if (!entry) {
+    return 0.5;
+  }
+  const gdouble lock_prob = (entry->locks + 1.0) / (entry->attempts + 2.0);
+  const gdouble read_fails_per_min =
+      entry->capture_s > 0 ? entry->read_fails * 60.0 / entry->capture_s : 0;
+  return lock_prob / (1.0 + read_fails_per_min);
+}
+
+static gdouble stats_entry_avg_lock_time(const struct stats_entry *entry) {
+  return entry && entry->locks > 0 ? entry->lock_time_s / entry->locks : 0;
+}
+
+struct ranked_transmitter {
+  gdouble score;
+  gdouble lock_time_s;
+  gboolean bad;
+  struct mux_params params;
+};
+
+static gint by_rank_cmpfn(gconstpointer a, gconstpointer b) {
+  const struct ranked_transmitter *const rA = a, *rB = b;
+  if (rA->score != rB->score) {
+    return rA->score > rB->score ? -1 : 1;
+  } else if (rA->lock_time_s != rB->lock_time_s) {
+    return rA->lock_time_s < rB->lock_time_s ? -1 : 1;
+  } else if (rA->params.distance != rB->params.distance) {
+    return rA->params.distance < rB->params.distance ? -1 : 1;
+  } else {
+    return 0;
+  }
+}
+
+static guint order_transmitters(TransmitterStats *stats, const gchar *mux,
+                                GArray *transmitters, gint64 now) {
+  GArray *const ranked = g_array_sized_new(
+      FALSE, FALSE, sizeof(struct ranked_transmitter), transmitters->len);
+  guint num_bad = 0;
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const params =
+        &g_array_index(transmitters, struct mux_params, i);
+    struct stats_entry *const entry = lookup_entry(stats, mux, params);
+    if (entry) {
+      stats_entry_decay(entry, now);
+    }
+    const struct ranked_transmitter r = {
+        .score = stats_entry_score(entry),
+        .lock_time_s = stats_entry_avg_lock_time(entry),
+        .bad = entry && entry->bad_until > now,
+        .params = *params};
+    num_bad += r.bad;
+    g_array_append_val(ranked, r);
+  }
+  g_array_sort(ranked, by_rank_cmpfn);
+
+  /* trying a known bad transmitter is still better than skipping the whole
+   * MUX. the params are moved back into the array, so the ones which are
+   * dropped need to be cleared here. */
+  const gboolean drop_bad = num_bad < transmitters->len;
+  guint out = 0;
+  for (guint i = 0; i < ranked->len; ++i) {
+    struct ranked_transmitter *const r =
+        &g_array_index(ranked, struct ranked_transmitter, i);
+    if (drop_bad && r->bad) {
+      g_print("Skipping %s transmitter %s, which failed recently\n", mux,
+              r->params.name);
+      mux_params_clear(&r->params);
+    } else {
+      g_array_index(transmitters, struct mux_params, out++) = r->params;
+    }
+  }
+  /* the tail only holds stale copies of params which were moved, so it's
+   * zeroed before shrinking in order for the clear func not to free them. */
+  if (out < transmitters->len) {
+    memset(&g_array_index(transmitters, struct mux_params, out), 0,
+           (transmitters->len - out) * sizeof(struct mux_params));
+    g_array_set_size(transmitters, out);
+  }
+  g_array_free(ranked, TRUE);
+  return drop_bad ? num_bad : 0;
+}
+
+guint transmitter_stats_order_muxdata(TransmitterStats *stats, MuxData *md,
+                                      gint64 now) {
+  guint num_removed = 0;
+  for (guint m = 0; m < mux_data_get_num_muxes(md); ++m) {
+    num_removed +=
+        order_transmitters(stats, mux_data_get_mux_at(md, m),
+                           mux_data_get_transmitters_at(md, m), now);
+  }
+  return num_removed;
+}
+
+/* on disk, every transmitter is a group in a key file, just like in the
+ * transmitter database. */
+#define KEY_MUX "mux"
+#define KEY_NAME "name"
+#define KEY_FREQUENCY "frequency"
+#define KEY_UPDATED "updated"
+#define KEY_ATTEMPTS "attempts"
+#define KEY_LOCKS "locks"
+#define KEY_LOCK_TIME "lock_time"
+#define KEY_CAPTURE_TIME "capture_time"
+#define KEY_READ_FAILS "read_fails"
+#define KEY_BYTES "bytes"
+#define KEY_CONSECUTIVE_FAILURES "consecutive_failures"
+#define KEY_BAD_UNTIL "bad_until"
+#define KEY_DVR_BUFFER_SIZE "dvr_buffer_size"
+#define KEY_FINGERPRINT "fingerprint"
+
+static gboolean load_entry(TransmitterStats *stats, GKeyFile *kf,
+                           const gchar *group, GError **error) {
+  gchar *mux = NULL, *name = NULL;
+  struct stats_entry loaded;
+  memset(&loaded, 0, sizeof(loaded));
+  GError *err = NULL;
+
+#define get_or_fail(dst, getter, key)                                          \
+  do {                                                                         \
+    dst = getter(kf, group, key, &err);                                        \
+    if (err) {                                                                 \
+      goto fail;                                                               \
+    }                                                                          \
+  } while (0)
+
+  get_or_fail(mux, g_key_file_get_string, KEY_MUX);
+  get_or_fail(name, g_key_file_get_string, KEY_NAME);
+  get_or_fail(loaded.freq_khz, g_key_file_get_integer, KEY_FREQUENCY);
+  get_or_fail(loaded.updated, g_key_file_get_int64, KEY_UPDATED);
+  get_or_fail(loaded.attempts, g_key_file_get_double, KEY_ATTEMPTS);
+  get_or_fail(loaded.locks, g_key_file_get_double, KEY_LOCKS);
+  get_or_fail(loaded.lock_time_s, g_key_file_get_double, KEY_LOCK_TIME);
+  get_or_fail(loaded.capture_s, g_key_file_get_double, KEY_CAPTURE_TIME);
+  get_or_fail(loaded.read_fails, g_key_file_get_double, KEY_READ_FAILS);
+  get_or_fail(loaded.bytes, g_key_file_get_double, KEY_BYTES);
+  get_or_fail(loaded.consecutive_failures, g_key_file_get_integer,
+              KEY_CONSECUTIVE_FAILURES);
+  get_or_fail(loaded.bad_until, g_key_file_get_int64, KEY_BAD_UNTIL);
+  /* not there in files written by older versions. */
+  if (g_key_file_has_key(kf, group, KEY_DVR_BUFFER_SIZE, NULL)) {
+    get_or_fail(loaded.dvr_buffer_size, g_key_file_get_integer,
+                KEY_DVR_BUFFER_SIZE);
+  }
+  loaded.fingerprint = g_key_file_get_string(kf, group, KEY_FINGERPRINT, NULL);
+
+#undef get_or_fail
+
+  struct stats_entry *const entry =
+      get_entry(stats, mux, name, loaded.freq_khz);
+  loaded.mux = entry->mux;
+  loaded.name = entry->name;
+  g_free(entry->fingerprint);
+  *entry = loaded;
+  g_free(mux);
+  g_free(name);
+  return TRUE;
+
+fail:
+  g_propagate_prefixed_error(error, err, "Transmitter %s : ", group);
+  g_free(loaded.fingerprint);
+  g_free(mux);
+  g_free(name);
+  return FALSE;
+}
+
+TransmitterStats *transmitter_stats_load(const gchar *path, GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  GError *err = NULL;
+  if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &err)) {
+    g_key_file_free(kf);
+    if (g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_error_free(err);
+      return transmitter_stats_new();
+    }
+    g_propagate_error(error, err);
+    return NULL;
+  }
+
+  TransmitterStats *stats = transmitter_stats_new();
+  gchar **const groups = g_key_file_get_groups(kf, NULL);
+  for (gchar **group = groups; *group; ++group) {
+    if (!load_entry(stats, kf, *group, error)) {
+      g_clear_pointer(&stats, transmitter_stats_destroy);
+      break;
+    }
+  }
+  g_strfreev(groups);
+  g_key_file_free(kf);
+  return stats;
+}
+
+static void save_entry(gpointer key, gpointer value, gpointer user_data) {
+  (void)key;
+  const struct stats_entry *const entry = value;
+  GKeyFile *const kf = user_data;
+  gchar *const group = g_strdup_printf("%s %u %s", entry->mux,
+                                       entry->freq_khz, entry->name);
+  g_strdelimit(group, "[]", '_');
+
+  g_key_file_set_string(kf, group, KEY_MUX, entry->mux);
+  g_key_file_set_string(kf, group, KEY_NAME, entry->name);
+  g_key_file_set_integer(kf, group, KEY_FREQUENCY, entry->freq_khz);
+  g_key_file_set_int64(kf, group, KEY_UPDATED, entry->updated);
+  g_key_file_set_double(kf, group, KEY_ATTEMPTS, entry->attempts);
+  g_key_file_set_double(kf, group, KEY_LOCKS, entry->locks);
+  g_key_file_set_double(kf, group, KEY_LOCK_TIME, entry->lock_time_s);
+  g_key_file_set_double(kf, group, KEY_CAPTURE_TIME, entry->capture_s);
+  g_key_file_set_double(kf, group, KEY_READ_FAILS, entry->read_fails);
+  g_key_file_set_double(kf, group, KEY_BYTES, entry->bytes);
+  g_key_file_set_integer(kf, group, KEY_CONSECUTIVE_FAILURES,
+                         entry->consecutive_failures);
+  g_key_file_set_int64(kf, group, KEY_BAD_UNTIL, entry->bad_until);
+  if (entry->dvr_buffer_size > 0) {
+    g_key_file_set_integer(kf, group, KEY_DVR_BUFFER_SIZE,
+                           entry->dvr_buffer_size);
+  }
+  if (entry->fingerprint) {
+    g_key_file_set_string(kf, group, KEY_FINGERPRINT, entry->fingerprint);
+  }
+  g_free(group);
+}
+
+gboolean transmitter_stats_save(TransmitterStats *stats, const gchar *path,
+                                GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  g_hash_table_foreach(stats->by_key, save_entry, kf);
+  const gboolean rv = g_key_file_save_to_file(kf, path, error);
+  g_key_file_free(kf);
+  return rv;
+}
@@ -0,0 +1,72 @@
+#ifndef GETPLMUX_STATS_H
+#define GETPLMUX_STATS_H
+
+#include <glib.h>
+
+#include "muxdata.h"
+
+/* remembers how capturing from each transmitter went in previous runs, so
+ * that the ones which usually work are tried first and the ones which
+ * consistently fail aren't tried at all for a while. transmitters are
+ * identified by their MUX, name and frequency, just like in TransmitterDb.
+ * older results count less and less, halving every STATS_HALF_LIFE_DAYS. */
+typedef struct TransmitterStats_ TransmitterStats;
+
+#define STATS_HALF_LIFE_DAYS 30.0
+
+struct capture_result {
+  gboolean locked;
+  /* the rest is only meaningful if locked */
+  gdouble time_to_lock_s;
+  gdouble duration_s;
+  guint read_fails;
+  guint64 bytes;
+  /* only some PIDs were captured, so neither the bytes nor the time go
+   * towards the bitrate and the failure rate */
+  gboolean filtered;
+  /* the DVR buffer size to use next time, 0 to keep the previous one */
+  guint dvr_buffer_size;
+  /* of the transport stream, as in CaptureFingerprint, NULL if not known */
+  const gchar *fingerprint;
+};
+
+TransmitterStats *transmitter_stats_new(void);
+void transmitter_stats_destroy(TransmitterStats *stats);
+
+/* a missing file isn't an error and results in empty statistics. */
+TransmitterStats *transmitter_stats_load(const gchar *path, GError **error);
+gboolean transmitter_stats_save(TransmitterStats *stats, const gchar *path,
+                                GError **error);
+
+/* all times are in seconds since the epoch, so that they can be faked. */
+void transmitter_stats_record(TransmitterStats *stats, const gchar *mux,
+                              const struct mux_params *params,
+                              const struct capture_result *result, gint64 now);
+
+/* whether the transmitter failed to lock often enough recently that it's not
+ * worth trying until its TTL expires. */
+gboolean transmitter_stats_is_known_bad(TransmitterStats *stats,
+                                        const gchar *mux,
+                                        const struct mux_params *params,
+                                        gint64 now);
+
+/* the average bitrate of the previous captures in bits per second, if there
+ * were any. */
+gboolean transmitter_stats_get_bitrate(TransmitterStats *stats,
+                                       const gchar *mux,
+                                       const struct mux_params *params,
+                                       guint64 *bitrate);
+
+/* 0 if none was recorded. */
+guint transmitter_stats_get_dvr_buffer_size(TransmitterStats *stats,
+                                            const gchar *mux,
+                                            const struct mux_params *params);
+
+/* reorders the transmitters of every MUX from the most to the least likely
+ * to work, falling back to the distance for ones without any history. known
+ * bad transmitters are removed, unless that would leave a MUX without any.
+ * returns the number of removed transmitters. */
+guint transmitter_stats_order_muxdata(TransmitterStats *stats, MuxData *md,
+                                      gint64 now);
+
+#endif
@@ -0,0 +1,224 @@
+#include "sweep.h"
+
+/* the order in which the variants of each channel are tried, from the most
+ * to the least common one. */
+static const struct {
+  guint bw_mhz;
+  enum fe_delivery_system delsys;
+} variants[] = {
+    {8, SYS_DVBT}, {8, SYS_DVBT2}, {7, SYS_DVBT}, {7, SYS_DVBT2}};
+
+#define NUM_CHANNELS (SWEEP_LAST_CHANNEL - SWEEP_FIRST_CHANNEL + 1)
+
+struct sweep_channel {
+  guint number;
+  /* bit n set if variants[n] was tried */
+  guint tried;
+  /* being probed by one of the frontends */
+  gboolean claimed;
+  /* locked or no signal, so there's nothing more to try */
+  gboolean done;
+};
+
+struct sweep_ctx {
+  const struct sweep_tuner_ops *ops;
+  guint lock_timeout_ms;
+
+  GMutex lock;
+  /* signalled whenever a channel is released */
+  GCond released;
+  struct sweep_channel channels[NUM_CHANNELS];
+  guint num_claimed;
+  MuxData *muxdata;
+};
+
+struct sweep_worker {
+  struct sweep_ctx *ctx;
+  const struct dvb_frontend *fe;
+};
+
+static gpointer tuner_open_wrap(const struct dvb_frontend *fe,
+                                GError **error) {
+  return frontend_tuner_open(fe, error);
+}
+
+static enum frontend_lock_status
+tuner_try_lock_wrap(gpointer tuner, struct tune_params *params,
+                    guint signal_timeout_ms, guint lock_timeout_ms) {
+  return frontend_tuner_try_lock(tuner, params, signal_timeout_ms,
+                                 lock_timeout_ms);
+}
+
+static void tuner_close_wrap(gpointer tuner) { frontend_tuner_close(tuner); }
+
+const struct sweep_tuner_ops sweep_default_tuner_ops = {
+    .open = tuner_open_wrap,
+    .try_lock = tuner_try_lock_wrap,
+    .close = tuner_close_wrap};
+
+guint sweep_channel_freq_khz(guint channel) {
+  /* UHF channels are 8 MHz wide, with channel 21 centered at 474 MHz. */
+  return (306 + 8 * channel) * 1000;
+}
+
+static gboolean variant_untried(const struct sweep_channel *ch,
+                                const struct dvb_frontend *fe, guint v) {
+  return !(ch->tried & (1u << v)) &&
+         dvb_frontend_supports(fe, variants[v].delsys);
+}
+
+static gboolean can_probe(const struct sweep_channel *ch,
+                          const struct dvb_frontend *fe) {
+  /* a claimed channel is only modified by the frontend probing it. */
+  if (ch->claimed || ch->done) {
+    return FALSE;
+  }
+  for (guint v = 0; v < G_N_ELEMENTS(variants); ++v) {
+    if (variant_untried(ch, fe, v)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* waits until there's a channel this frontend can probe, or returns NULL if
+ * there won't be any more of those. must be called with the lock held. */
+static struct sweep_channel *claim_channel(struct sweep_ctx *ctx,
+                                           const struct dvb_frontend *fe) {
+  for (;;) {
+    for (guint i = 0; i < NUM_CHANNELS; ++i) {
+      struct sweep_channel *const ch = &ctx->channels[i];
+      if (can_probe(ch, fe)) {
+        ch->claimed = TRUE;
+        ctx->num_claimed++;
+        return ch;
+      }
+    }
+    /* a channel released by a DVB-T only frontend might still need to be
+     * tried in DVB-T2, so only give up once nothing is being probed. */
+    if (ctx->num_claimed == 0) {
+      return NULL;
+    }
+    g_cond_wait(&ctx->released, &ctx->lock);
+  }
+}
+
+static void add_found(struct sweep_ctx *ctx, guint channel,
+                      const struct tune_params *params) {
+  gchar *const mux = g_strdup_printf("UHF-%u", channel);
+  const struct mux_params muxparm = {.name = g_strdup("sweep"),
+                                     .info_html = NULL,
+                                     .distance = 0,
+                                     .tune_parms = *params};
+  mux_data_append_transmitter(ctx->muxdata, mux, &muxparm);
+  g_free(mux);
+}
+
+static void probe_channel(struct sweep_worker *worker, gpointer tuner,
+                          struct sweep_channel *ch) {
+  struct sweep_ctx *const ctx = worker->ctx;
+  for (guint v = 0; v < G_N_ELEMENTS(variants); ++v) {
+    /* nobody else touches a claimed channel, so this doesn't need the lock. */
+    if (!variant_untried(ch, worker->fe, v)) {
+      continue;
+    }
+    ch->tried |= 1u << v;
+
+    struct tune_params params = {
+        .freq_khz = sweep_channel_freq_khz(ch->number),
+        .bw_mhz = variants[v].bw_mhz,
+        .mod = QAM_AUTO,
+        .dvb_type = variants[v].delsys};
+    const enum frontend_lock_status status = ctx->ops->try_lock(
+        tuner, &params, SWEEP_SIGNAL_TIMEOUT_MS, ctx->lock_timeout_ms);
+    if (status == FRONTEND_LOCKED) {
+      g_print("Channel %u : found %s with %u MHz bandwidth on "
+              "adapter%u/frontend%u\n",
+              ch->number, params.dvb_type == SYS_DVBT2 ? "DVB-T2" : "DVB-T",
+              params.bw_mhz, worker->fe->adapter, worker->fe->frontend);
+      g_mutex_lock(&ctx->lock);
+      add_found(ctx, ch->number, &params);
+      g_mutex_unlock(&ctx->lock);
+      ch->done = TRUE;
+      return;
+    } else if (status == FRONTEND_NO_SIGNAL) {
+      ch->done = TRUE;
+      return;
+    }
+  }
+}
+
+static void sweep_worker_run(gpointer data, gpointer user_data) {
+  struct sweep_worker *const worker = data;
+  struct sweep_ctx *const ctx = user_data;
+
+  GError *err = NULL;
+  const gpointer tuner = ctx->ops->open(worker->fe, &err);
+  if (!tuner) {
+    g_printerr("adapter%u/frontend%u unusable for sweeping : %s\n",
+               worker->fe->adapter, worker->fe->frontend, err->message);
+    g_error_free(err);
+    return;
+  }
+
+  g_mutex_lock(&ctx->lock);
+  struct sweep_channel *ch;
+  while ((ch = claim_channel(ctx, worker->fe))) {
+    g_mutex_unlock(&ctx->lock);
+    probe_channel(worker, tuner, ch);
+    g_mutex_lock(&ctx->lock);
+    ch->claimed = FALSE;
+    ctx->num_claimed--;
+    g_cond_broadcast(&ctx->released);
+  }
+  g_mutex_unlock(&ctx->lock);
+
+  ctx->ops->close(tuner);
+}
+
+MuxData *sweep_muxdata(const GArray *frontends,
+                       const struct sweep_tuner_ops *ops,
+                       guint lock_timeout_ms) {
+  struct sweep_ctx ctx = {.ops = ops,
+                          .lock_timeout_ms = lock_timeout_ms,
+                          .num_claimed = 0,
+                          .muxdata = mux_data_new()};
+  g_mutex_init(&ctx.lock);
+  g_cond_init(&ctx.released);
+  for (guint i = 0; i < NUM_CHANNELS; ++i) {
+    ctx.channels[i] = (struct sweep_channel){
+        .number = SWEEP_FIRST_CHANNEL + i, .tried = 0, .claimed = FALSE,
+        .done = FALSE};
+  }
+
+  GArray *const workers =
+      g_array_new(FALSE, FALSE, sizeof(struct sweep_worker));
+  for (guint i = 0; i < frontends->len; ++i) {
+    const struct dvb_frontend *const fe =
+        &g_array_index(frontends, struct dvb_frontend, i);
+    if (dvb_frontend_supports(fe, SYS_DVBT) ||
+        dvb_frontend_supports(fe, SYS_DVBT2)) {
+      const struct sweep_worker worker = {.ctx = &ctx, .fe = fe};
+      g_array_append_val(workers, worker);
+    }
+  }
+
+  if (workers->len > 0) {
+    /* the array isn't touched anymore, so pointers into it stay valid. */
+    GThreadPool *const pool = g_thread_pool_new(
+        sweep_worker_run, &ctx, (gint)workers->len, TRUE, NULL);
+    for (guint i = 0; i < workers->len; ++i) {
+      g_thread_pool_push(pool, &g_array_index(workers, struct sweep_worker, i),
+                         NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+  } else {
+    g_printerr("No frontend supports DVB-T or DVB-T2, nothing to sweep\n");
+  }
+
+  g_array_free(workers, TRUE);
+  g_cond_clear(&ctx.released);
+  g_mutex_clear(&ctx.lock);
+  mux_data_sort_transmitters(ctx.muxdata);
+  return ctx.muxdata;
+}
@@ -0,0 +1,40 @@
+#ifndef GETPLMUX_SWEEP_H
+#define GETPLMUX_SWEEP_H
+
+#include <glib.h>
+
+#include "frontend.h"
+#include "muxdata.h"
+
+/* finds transmissions without any help from the site by trying every UHF
+ * channel from SWEEP_FIRST_CHANNEL to SWEEP_LAST_CHANNEL with 8 and 7 MHz
+ * bandwidth, in DVB-T and DVB-T2 each. every frontend probes a different
+ * channel at the same time. the MUXes found are named after their channel,
+ * i.e. "UHF-n". */
+#define SWEEP_FIRST_CHANNEL 21
+#define SWEEP_LAST_CHANNEL 48
+
+#define SWEEP_SIGNAL_TIMEOUT_MS 500
+#define SWEEP_LOCK_TIMEOUT_MS 2000
+
+/* the frontend access used by the sweep, which is replaced in tests. the
+ * default one is frontend_tuner_*(). */
+struct sweep_tuner_ops {
+  gpointer (*open)(const struct dvb_frontend *fe, GError **error);
+  enum frontend_lock_status (*try_lock)(gpointer tuner,
+                                        struct tune_params *params,
+                                        guint signal_timeout_ms,
+                                        guint lock_timeout_ms);
+  void (*close)(gpointer tuner);
+};
+
+extern const struct sweep_tuner_ops sweep_default_tuner_ops;
+
+guint sweep_channel_freq_khz(guint channel);
+
+/* only the frontends supporting DVB-T or DVB-T2 are used. */
+MuxData *sweep_muxdata(const GArray *frontends,
+                       const struct sweep_tuner_ops *ops,
+                       guint lock_timeout_ms);
+
+#endif
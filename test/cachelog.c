@@ -0,0 +1,146 @@
+#include "../cachelog.h"
+
+#include <stdio.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+static void append(MuxData *md, const gchar *mux, const gchar *name,
+                   guint freq_khz) {
+  const struct mux_params params = {
+      .name = g_strdup(name),
+      .info_html = NULL,
+      .distance = 0,
+      .tune_parms = {.freq_khz = freq_khz, .bw_mhz = 8, .mod = QAM_64,
+                     .dvb_type = SYS_DVBT}};
+  mux_data_append_transmitter(md, mux, &params);
+}
+
+static MuxData *make_muxdata(void) {
+  MuxData *const md = mux_data_new();
+  append(md, "MUX-1", "Poznań/Śrem", 474000);
+  append(md, "MUX-1", "Tab\tbed", 522000);
+  append(md, "MUX-3", "Poznań/Śrem", 610000);
+  return md;
+}
+
+static const struct tune_params *params_at(MuxData *md, const gchar *mux,
+                                           guint idx) {
+  return &g_array_index(mux_data_get_transmitters_for_mux(md, mux),
+                        struct mux_params, idx)
+              .tune_parms;
+}
+
+static void test_snapshot_diff(void) {
+  MuxData *const md = make_muxdata();
+  GArray *const snapshot = cache_snapshot_take(md);
+  GArray *updates = cache_snapshot_diff(snapshot, md);
+  g_assert_cmpuint(updates->len, ==, 0);
+  g_array_unref(updates);
+
+  struct tune_params *const changed =
+      (struct tune_params *)params_at(md, "MUX-1", 1);
+  changed->freq_khz = 522166;
+  changed->dvb_type = SYS_DVBT2;
+  updates = cache_snapshot_diff(snapshot, md);
+  g_assert_cmpuint(updates->len, ==, 1);
+  const struct cache_update *const update =
+      &g_array_index(updates, struct cache_update, 0);
+  g_assert_cmpstr(update->mux, ==, "MUX-1");
+  g_assert_cmpstr(update->name, ==, "Tab\tbed");
+  g_assert_cmpuint(update->freq_khz, ==, 522000);
+  g_assert_cmpuint(update->tune_parms.freq_khz, ==, 522166);
+  g_assert_cmpint(update->tune_parms.dvb_type, ==, SYS_DVBT2);
+
+  g_array_unref(updates);
+  g_array_unref(snapshot);
+  mux_data_destroy(md);
+}
+
+static void test_append_replay(void) {
+  gchar *path = NULL;
+  const gint fd = g_file_open_tmp("getplmux-cachelog-XXXXXX.log", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+  g_unlink(path);
+
+  MuxData *md = make_muxdata();
+  guint num_records;
+  GError *err = NULL;
+  g_assert_true(cache_log_replay(path, md, &num_records, &err));
+  g_assert_cmpuint(num_records, ==, 0);
+
+  /* two changes to the same transmitter, and one to a transmitter which
+   * isn't there. */
+  GArray *const snapshot = cache_snapshot_take(md);
+  struct tune_params *const params =
+      (struct tune_params *)params_at(md, "MUX-1", 0);
+  params->bw_mhz = 7;
+  GArray *const first = cache_snapshot_diff(snapshot, md);
+  g_assert_true(cache_log_append(path, first, &err));
+  g_assert_no_error(err);
+  g_array_unref(snapshot);
+  g_array_unref(first);
+
+  GArray *const later = cache_snapshot_take(md);
+  params->freq_khz = 474166;
+  struct cache_update *const update =
+      &g_array_index(later, struct cache_update, 0);
+  g_array_remove_range(later, 1, later->len - 1);
+  update->tune_parms = *params;
+  const struct cache_update gone = {.mux = g_strdup("MUX-8"),
+                                    .name = g_strdup("Gone"),
+                                    .freq_khz = 700000,
+                                    .tune_parms = *params};
+  g_array_append_val(later, gone);
+
+  /* the tail of a write cut short by a crash. */
+  FILE *const f = g_fopen(path, "ab");
+  fputs("MUX-1\tTab\\tbed\t522000\t52", f);
+  fclose(f);
+  g_assert_true(cache_log_append(path, later, &err));
+  g_assert_no_error(err);
+  g_array_unref(later);
+  mux_data_destroy(md);
+
+  md = make_muxdata();
+  g_assert_true(cache_log_replay(path, md, &num_records, &err));
+  g_assert_no_error(err);
+  g_assert_cmpuint(num_records, ==, 3);
+  const struct tune_params *const replayed = params_at(md, "MUX-1", 0);
+  g_assert_cmpuint(replayed->freq_khz, ==, 474166);
+  g_assert_cmpuint(replayed->bw_mhz, ==, 7);
+  g_assert_cmpuint(params_at(md, "MUX-1", 1)->freq_khz, ==, 522000);
+  g_assert_cmpuint(params_at(md, "MUX-3", 0)->bw_mhz, ==, 8);
+  mux_data_destroy(md);
+
+  g_unlink(path);
+  g_free(path);
+}
+
+static void test_is_long(void) {
+  gchar *path = NULL;
+  const gint fd = g_file_open_tmp("getplmux-cachelog-XXXXXX.log", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+  g_assert_false(cache_log_is_long(path));
+
+  gchar *const contents = g_strnfill(CACHE_LOG_MAX_BYTES + 1, 'x');
+  g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+  g_assert_true(cache_log_is_long(path));
+  g_free(contents);
+
+  g_unlink(path);
+  g_assert_false(cache_log_is_long(path));
+  g_free(path);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/cachelog/snapshot_diff", test_snapshot_diff);
+  g_test_add_func("/cachelog/append_replay", test_append_replay);
+  g_test_add_func("/cachelog/is_long", test_is_long);
+
+  return g_test_run();
+}
@@ -0,0 +1,193 @@
+#include "../demux.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ts_builder.h"
+
+#define PMT_PID_1 0x100
+#define VIDEO_PID_1 0x101
+#define PMT_PID_2 0x200
+#define VIDEO_PID_2 0x201
+#define SHARED_AUDIO_PID 0x102
+#define OTHER_PID 0x300
+
+static void put_psi(GByteArray *stream, guint16 pid, guint8 table_id,
+                    guint16 table_id_extension, const guint8 *body,
+                    gsize body_len, guint8 *cc) {
+  GByteArray *const section = g_byte_array_new();
+  ts_put_section(section, table_id, table_id_extension, 0, 0, body, body_len);
+  const gsize start = 0;
+  ts_put_packets(stream, pid, section->data, section->len, &start, 1, cc);
+  g_byte_array_unref(section);
+}
+
+static void put_pat(GByteArray *stream, guint8 *cc) {
+  const guint8 pat[] = {0x00, 0x00, 0xe0, 0x10,
+                        0x00, 0x01, 0xe0 | (PMT_PID_1 >> 8), PMT_PID_1 & 0xff,
+                        0x00, 0x02, 0xe0 | (PMT_PID_2 >> 8), PMT_PID_2 & 0xff};
+  put_psi(stream, TS_PID_PAT, 0x00, 0x1234, pat, sizeof(pat), cc);
+}
+
+static void put_pmt(GByteArray *stream, guint16 program_number,
+                    guint16 pmt_pid, guint16 video_pid, guint8 *cc) {
+  const guint8 pmt[] = {
+      0xe0 | (video_pid >> 8), video_pid & 0xff, 0xf0, 0x00,
+      /* video, then audio */
+      0x1b, 0xe0 | (video_pid >> 8), video_pid & 0xff, 0xf0, 0x00, 0x03,
+      0xe0 | (SHARED_AUDIO_PID >> 8), SHARED_AUDIO_PID & 0xff, 0xf0, 0x00};
+  put_psi(stream, pmt_pid, 0x02, program_number, pmt, sizeof(pmt), cc);
+}
+
+static void put_es(GByteArray *stream, guint16 pid, guint8 *cc) {
+  guint8 payload[TS_PACKET_SIZE - 4];
+  memset(payload, pid & 0xff, sizeof(payload));
+  ts_put_packets(stream, pid, payload, sizeof(payload), NULL, 0, cc);
+}
+
+static GByteArray *make_stream(void) {
+  guint8 cc[TS_NUM_PIDS] = {0};
+  GByteArray *const stream = g_byte_array_new();
+  put_pat(stream, &cc[TS_PID_PAT]);
+  put_pmt(stream, 1, PMT_PID_1, VIDEO_PID_1, &cc[PMT_PID_1]);
+  put_pmt(stream, 2, PMT_PID_2, VIDEO_PID_2, &cc[PMT_PID_2]);
+  for (int i = 0; i < 15; ++i) {
+    if (i == 10) {
+      put_pat(stream, &cc[TS_PID_PAT]);
+      put_pmt(stream, 1, PMT_PID_1, VIDEO_PID_1, &cc[PMT_PID_1]);
+    }
+    put_es(stream, VIDEO_PID_1, &cc[VIDEO_PID_1]);
+    put_es(stream, SHARED_AUDIO_PID, &cc[SHARED_AUDIO_PID]);
+    put_es(stream, VIDEO_PID_2, &cc[VIDEO_PID_2]);
+    put_es(stream, OTHER_PID, &cc[OTHER_PID]);
+  }
+  return stream;
+}
+
+/* counts the packets of every PID in the file, checking that its PAT only
+ * lists the given program. */
+static guint *count_packets(const gchar *path, guint16 program_number,
+                            guint16 pmt_pid) {
+  gchar *contents;
+  gsize len;
+  g_assert_true(g_file_get_contents(path, &contents, &len, NULL));
+  g_assert_cmpuint(len % TS_PACKET_SIZE, ==, 0);
+
+  guint *const counts = g_new0(guint, TS_NUM_PIDS);
+  guint8 pat_cc = 0;
+  for (gsize pos = 0; pos < len; pos += TS_PACKET_SIZE) {
+    const guint8 *const data = (const guint8 *)contents + pos;
+    struct ts_packet pkt;
+    g_assert_true(ts_packet_parse(data, &pkt));
+    /* the file starts with the PAT */
+    if (pos == 0) {
+      g_assert_cmpuint(pkt.pid, ==, TS_PID_PAT);
+    }
+    if (pkt.pid == TS_PID_PAT) {
+      g_assert_cmpuint(pkt.continuity_counter, ==, pat_cc);
+      pat_cc = (pat_cc + 1) & 0x0f;
+      const guint8 *const section = pkt.payload + 1;
+      const gsize section_len = 3 + (ts_read_u16(section + 1) & 0x0fff);
+      g_assert_cmpuint(section_len, ==, 16);
+      g_assert_cmphex(ts_crc32(section, section_len), ==, 0);
+      g_assert_cmpuint(ts_read_u16(section + 3), ==, 0x1234);
+      g_assert_cmpuint(ts_read_u16(section + 8), ==, program_number);
+      g_assert_cmpuint(ts_read_u16(section + 10) & 0x1fff, ==, pmt_pid);
+    }
+    ++counts[pkt.pid];
+  }
+  g_free(contents);
+  return counts;
+}
+
+static void push_stream(ServiceDemux *demux, const GByteArray *stream) {
+  /* not aligned to packets */
+  for (guint pos = 0; pos < stream->len; pos += 1000) {
+    service_demux_push(demux, stream->data + pos,
+                       MIN(1000, stream->len - pos));
+  }
+}
+
+static void test_demux_all(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-demux-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const prefix = g_build_filename(dir, "capture", NULL);
+  gchar *const path_1 = g_strdup_printf("%s_1.ts", prefix);
+  gchar *const path_2 = g_strdup_printf("%s_2.ts", prefix);
+
+  GByteArray *const stream = make_stream();
+  ServiceDemux *const demux = service_demux_new(prefix, NULL);
+  push_stream(demux, stream);
+  g_assert_cmpuint(service_demux_get_num_outputs(demux), ==, 2);
+  GError *err = NULL;
+  g_assert_true(service_demux_close(demux, &err));
+  g_assert_no_error(err);
+
+  guint *const counts_1 = count_packets(path_1, 1, PMT_PID_1);
+  g_assert_cmpuint(counts_1[TS_PID_PAT], ==, 2);
+  g_assert_cmpuint(counts_1[PMT_PID_1], ==, 2);
+  g_assert_cmpuint(counts_1[VIDEO_PID_1], ==, 15);
+  g_assert_cmpuint(counts_1[SHARED_AUDIO_PID], ==, 15);
+  g_assert_cmpuint(counts_1[PMT_PID_2], ==, 0);
+  g_assert_cmpuint(counts_1[VIDEO_PID_2], ==, 0);
+  g_assert_cmpuint(counts_1[OTHER_PID], ==, 0);
+  g_free(counts_1);
+
+  guint *const counts_2 = count_packets(path_2, 2, PMT_PID_2);
+  g_assert_cmpuint(counts_2[TS_PID_PAT], ==, 2);
+  g_assert_cmpuint(counts_2[PMT_PID_2], ==, 1);
+  g_assert_cmpuint(counts_2[VIDEO_PID_2], ==, 15);
+  g_assert_cmpuint(counts_2[SHARED_AUDIO_PID], ==, 15);
+  g_assert_cmpuint(counts_2[PMT_PID_1], ==, 0);
+  g_assert_cmpuint(counts_2[VIDEO_PID_1], ==, 0);
+  g_free(counts_2);
+
+  g_byte_array_unref(stream);
+  g_unlink(path_1);
+  g_unlink(path_2);
+  g_rmdir(dir);
+  g_free(path_2);
+  g_free(path_1);
+  g_free(prefix);
+  g_free(dir);
+}
+
+static void test_demux_selected(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-demux-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const prefix = g_build_filename(dir, "capture", NULL);
+  gchar *const path_1 = g_strdup_printf("%s_1.ts", prefix);
+  gchar *const path_2 = g_strdup_printf("%s_2.ts", prefix);
+
+  GArray *const wanted = g_array_new(FALSE, FALSE, sizeof(guint16));
+  const guint16 program_number = 2;
+  g_array_append_val(wanted, program_number);
+  GByteArray *const stream = make_stream();
+  ServiceDemux *const demux = service_demux_new(prefix, wanted);
+  g_array_free(wanted, TRUE);
+  push_stream(demux, stream);
+  g_assert_cmpuint(service_demux_get_num_outputs(demux), ==, 1);
+  g_assert_true(service_demux_close(demux, NULL));
+
+  g_assert_false(g_file_test(path_1, G_FILE_TEST_EXISTS));
+  guint *const counts_2 = count_packets(path_2, 2, PMT_PID_2);
+  g_assert_cmpuint(counts_2[VIDEO_PID_2], ==, 15);
+  g_free(counts_2);
+
+  g_byte_array_unref(stream);
+  g_unlink(path_2);
+  g_rmdir(dir);
+  g_free(path_2);
+  g_free(path_1);
+  g_free(prefix);
+  g_free(dir);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/demux/all", test_demux_all);
+  g_test_add_func("/demux/selected", test_demux_selected);
+
+  return g_test_run();
+}
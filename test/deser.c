@@ -21,7 +21,7 @@ static MuxData *muxdata_from_const_char(const char *markup, size_t length) {
   GError *err = NULL;
   struct constchar_read_ctx ctx = {.src = markup, .siz = length, .pos = 0};
   MuxData *const md =
-      deserialize_muxdata_hash(read_from_const_char, &ctx, &err);
+      deserialize_muxdata_hash(read_from_const_char, &ctx, NULL, &err);
 
   g_assert_cmpuint(ctx.siz, ==, ctx.pos);
   g_assert_no_error(err);
@@ -43,10 +43,8 @@ static void test_deser_from_markup(void) {
                         "</mux>";
 
   MuxData *const md = muxdata_from_const_char(markup, sizeof(markup) - 1);
-  GList *const muxes = mux_data_get_muxes(md);
-  g_assert_cmpuint(g_list_length(muxes), ==, 1);
-  g_assert_cmpstr(muxes->data, ==, "MUX-1");
-  g_list_free(muxes);
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, 1);
+  g_assert_cmpstr(mux_data_get_mux_at(md, 0), ==, "MUX-1");
 
   GArray *const transmitters = mux_data_get_transmitters_for_mux(md, "MUX-1");
   g_assert_cmpuint(transmitters->len, ==, 1);
@@ -136,6 +134,203 @@ static void test_transmitter_sort(void) {
   mux_data_destroy(md);
 }
 
+static gchar *muxdata_to_markup(MuxData *md) {
+  GString *output = g_string_new(NULL);
+  serialize_muxdata_hash(md, append_to_gstring, output);
+  return g_string_free(output, FALSE);
+}
+
+static const char *const deser_corpus[] = {
+    "<mux name=\"MUX-1\">\n"
+    " <transmitter>\n"
+    "  <name>Pozna\xc5\x84/Sroda</name>\n"
+    "  <distance>12.75</distance>\n"
+    "  <frequency>474000</frequency>\n"
+    "  <bandwidth>8</bandwidth>\n"
+    "  <modulation>3</modulation>\n"
+    "  <delsys>3</delsys>\n"
+    " </transmitter>\n"
+    " <transmitter>\n"
+    "  <name>Piła/Rusinowo</name>\n"
+    "  <distance>1.5e2</distance>\n"
+    "  <frequency>522000</frequency>\n"
+    "  <bandwidth>8</bandwidth>\n"
+    "  <modulation>5</modulation>\n"
+    "  <delsys>16</delsys>\n"
+    " </transmitter>\n"
+    "</mux>\n"
+    "<mux name=\"MUX-8\">\n"
+    " <transmitter>\n"
+    "  <name>Poznań/Piątkowo</name>\n"
+    "  <distance>4</distance>\n"
+    "  <frequency>191500</frequency>\n"
+    "  <bandwidth>7</bandwidth>\n"
+    "  <modulation>3</modulation>\n"
+    "  <delsys>3</delsys>\n"
+    " </transmitter>\n"
+    "</mux>\n",
+    /* needs GMarkup for the entity */
+    "<mux name=\"MUX-2\"><transmitter><name>A &amp; B</name>"
+    "<distance>3</distance><frequency>482000</frequency></transmitter></mux>",
+    /* needs GMarkup for the attribute quoting and the comment */
+    "<!-- cache --><mux name='MUX-3'><transmitter><delsys>16</delsys>"
+    "<name>x</name></transmitter></mux>",
+    /* trailing garbage in numbers is ignored by strtoull */
+    "<mux name=\"MUX-4\"><transmitter><name>y</name>"
+    "<frequency>626000kHz</frequency></transmitter></mux>",
+    "<mux name=\"MUX-5\"></mux>"};
+
+static void test_deser_fast_path(void) {
+  for (gsize i = 0; i < G_N_ELEMENTS(deser_corpus); ++i) {
+    const char *const markup = deser_corpus[i];
+    MuxData *const slow = muxdata_from_const_char(markup, strlen(markup));
+
+    GError *err = NULL;
+    MuxData *const fast =
+        deserialize_muxdata_from_memory(markup, strlen(markup), NULL, &err);
+    g_assert_no_error(err);
+    g_assert_nonnull(fast);
+
+    gchar *const slow_markup = muxdata_to_markup(slow);
+    gchar *const fast_markup = muxdata_to_markup(fast);
+    g_assert_cmpstr(slow_markup, ==, fast_markup);
+
+    g_free(slow_markup);
+    g_free(fast_markup);
+    mux_data_destroy(slow);
+    mux_data_destroy(fast);
+  }
+}
+
+static void test_deser_fast_path_errors(void) {
+  const char *const broken[] = {"", "  \n", "<mux name=\"MUX-1\">",
+                                "<mux name=\"MUX-1\"><transmitter><foo>1</foo>"
+                                "</transmitter></mux>"};
+  for (gsize i = 0; i < G_N_ELEMENTS(broken); ++i) {
+    GError *err = NULL;
+    MuxData *const md = deserialize_muxdata_from_memory(
+        broken[i], strlen(broken[i]), NULL, &err);
+    g_assert_null(md);
+    g_assert_nonnull(err);
+    g_assert_true(err->domain == G_MARKUP_ERROR);
+    g_error_free(err);
+  }
+}
+
+static const gchar *first_transmitter_name(MuxData *md, const gchar *mux) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  g_assert_nonnull(transmitters);
+  return g_array_index(transmitters, struct mux_params, 0).name;
+}
+
+static void test_deser_roundtrip(void) {
+  /* whitespace around the elements must not become a part of their contents,
+   * no matter how many times the data is saved and read back. */
+  const char *const markup = deser_corpus[0];
+  MuxData *const md = muxdata_from_const_char(markup, strlen(markup));
+  g_assert_cmpstr(first_transmitter_name(md, "MUX-8"), ==, "Poznań/Piątkowo");
+
+  gchar *const again = muxdata_to_markup(md);
+  MuxData *const md2 = muxdata_from_const_char(again, strlen(again));
+  g_assert_cmpstr(first_transmitter_name(md2, "MUX-8"), ==,
+                  "Poznań/Piątkowo");
+
+  g_free(again);
+  mux_data_destroy(md);
+  mux_data_destroy(md2);
+}
+
+static void check_filtered(MuxData *md) {
+  g_assert_null(mux_data_get_transmitters_for_mux(md, "MUX-8"));
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, "MUX-1");
+  g_assert_nonnull(transmitters);
+  g_assert_cmpuint(transmitters->len, ==, 1);
+  g_assert_cmpstr(g_array_index(transmitters, struct mux_params, 0).name, ==,
+                  "Piła/Rusinowo");
+}
+
+static void test_deser_filter(void) {
+  /* both paths must skip the same transmitters, and applying the filter
+   * afterwards must give the same result as well. */
+  gchar *muxes[] = {"MUX-1", NULL};
+  struct mux_filter filter;
+  mux_filter_init(&filter);
+  filter.muxes = muxes;
+  filter.delsys = SYS_DVBT2;
+
+  const char *const markup = deser_corpus[0];
+  const gsize len = strlen(markup);
+  GError *err = NULL;
+  struct constchar_read_ctx ctx = {.src = markup, .siz = len, .pos = 0};
+  MuxData *const slow =
+      deserialize_muxdata_hash(read_from_const_char, &ctx, &filter, &err);
+  g_assert_no_error(err);
+  check_filtered(slow);
+
+  MuxData *const fast =
+      deserialize_muxdata_from_memory(markup, len, &filter, &err);
+  g_assert_no_error(err);
+  check_filtered(fast);
+
+  MuxData *const after = muxdata_from_const_char(markup, len);
+  mux_data_apply_filter(after, &filter);
+  check_filtered(after);
+
+  filter.delsys = SYS_UNDEFINED;
+  filter.max_distance = 100.0;
+  mux_data_apply_filter(after, &filter);
+  g_assert_null(mux_data_get_transmitters_for_mux(after, "MUX-1"));
+
+  mux_data_destroy(slow);
+  mux_data_destroy(fast);
+  mux_data_destroy(after);
+}
+
+static gboolean is_mux_2(const gchar *mux, const struct mux_params *par,
+                         void *ctx) {
+  (void)par;
+  (void)ctx;
+  return g_strcmp0(mux, "MUX-2") == 0;
+}
+
+static void test_natural_order(void) {
+  g_assert_cmpint(mux_data_compare_muxes("MUX-2", "MUX-10"), <, 0);
+  g_assert_cmpint(mux_data_compare_muxes("MUX-10", "MUX-9"), >, 0);
+  g_assert_cmpint(mux_data_compare_muxes("MUX-1", "MUX-01"), !=, 0);
+  g_assert_cmpint(mux_data_compare_muxes("MUX-1", "MUX-1a"), <, 0);
+  g_assert_cmpint(mux_data_compare_muxes("MUX-8", "MUX-8"), ==, 0);
+
+  /* added in any order, the MUXes come out sorted and serialized so. */
+  static const gchar *const added[] = {"MUX-10", "MUX-2", "MUX-8", "MUX-1"};
+  static const gchar *const sorted[] = {"MUX-1", "MUX-2", "MUX-8", "MUX-10"};
+  MuxData *const md = mux_data_new();
+  for (guint i = 0; i < G_N_ELEMENTS(added); ++i) {
+    const struct mux_params transmitter = {.name = g_strdup(added[i])};
+    mux_data_append_transmitter(md, added[i], &transmitter);
+  }
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, G_N_ELEMENTS(sorted));
+  for (guint i = 0; i < G_N_ELEMENTS(sorted); ++i) {
+    g_assert_cmpstr(mux_data_get_mux_at(md, i), ==, sorted[i]);
+    g_assert_true(mux_data_get_transmitters_at(md, i) ==
+                  mux_data_get_transmitters_for_mux(md, sorted[i]));
+  }
+
+  GString *const output = g_string_new(NULL);
+  serialize_muxdata_hash(md, append_to_gstring, output);
+  const gchar *const mux_2 = strstr(output->str, "\"MUX-2\"");
+  g_assert_nonnull(mux_2);
+  g_assert_nonnull(strstr(mux_2, "\"MUX-10\""));
+  g_string_free(output, TRUE);
+
+  /* removing a MUX shifts the ones after it. */
+  mux_data_remove_transmitters(md, is_mux_2, NULL);
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, 3);
+  g_assert_cmpstr(mux_data_get_mux_at(md, 1), ==, "MUX-8");
+  g_assert_null(mux_data_get_transmitters_for_mux(md, "MUX-2"));
+  g_assert_nonnull(mux_data_get_transmitters_for_mux(md, "MUX-10"));
+  mux_data_destroy(md);
+}
+
 int main(int argc, char **argv) {
   g_test_init(&argc, &argv, NULL);
 
@@ -143,6 +338,11 @@ int main(int argc, char **argv) {
   g_test_add_func("/deser/test_deser_to_markup", test_deser_to_markup);
   g_test_add_func("/deser/deserialize_sorts_transmitters",
                   test_transmitter_sort);
+  g_test_add_func("/deser/fast_path_matches_gmarkup", test_deser_fast_path);
+  g_test_add_func("/deser/fast_path_errors", test_deser_fast_path_errors);
+  g_test_add_func("/deser/roundtrip", test_deser_roundtrip);
+  g_test_add_func("/deser/filter", test_deser_filter);
+  g_test_add_func("/deser/natural_order", test_natural_order);
 
   return g_test_run();
 }
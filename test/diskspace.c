@@ -0,0 +1,92 @@
+#include "../diskspace.h"
+
+#include <glib.h>
+
+#define MB (1024 * 1024)
+
+static void test_estimate(void) {
+  /* 8 Mbit/s is a megabyte a second, give or take. */
+  g_assert_cmpuint(capture_estimate_size(8000000, 8), ==, 9000000);
+  g_assert_cmpuint(capture_estimate_size(0, 60), ==, 0);
+
+  g_assert_false(disk_has_room(DISK_RESERVE_BYTES - 1, 0));
+  g_assert_true(disk_has_room(DISK_RESERVE_BYTES + 10, 10));
+  g_assert_false(disk_has_room(DISK_RESERVE_BYTES + 10, 11));
+}
+
+static void test_space(void) {
+  DiskAdmission *const adm = disk_admission_new();
+  struct disk_info info = {.fs_id = 1,
+                           .free_bytes = DISK_RESERVE_BYTES + 100 * MB};
+  struct disk_writer first, second;
+
+  /* nothing's being written that could make room. */
+  g_assert_cmpint(disk_admission_request(adm, &info, 101 * MB, 0, &first), ==,
+                  DISK_FULL);
+  g_assert_cmpint(disk_admission_request(adm, &info, 60 * MB, 0, &first), ==,
+                  DISK_ADMIT);
+  /* the first one is yet to take its 60. */
+  g_assert_cmpint(disk_admission_request(adm, &info, 60 * MB, 0, &second), ==,
+                  DISK_WAIT);
+
+  /* other filesystems are counted separately. */
+  const struct disk_info other = {.fs_id = 2, .free_bytes = info.free_bytes};
+  g_assert_cmpint(disk_admission_request(adm, &other, 60 * MB, 0, &second),
+                  ==, DISK_ADMIT);
+  disk_admission_release(adm, &second);
+
+  /* it's done and took what it was expected to, which doesn't leave
+   * enough for the second. */
+  disk_admission_release(adm, &first);
+  info.free_bytes -= 60 * MB;
+  g_assert_cmpint(disk_admission_request(adm, &info, 60 * MB, 0, &second), ==,
+                  DISK_FULL);
+  disk_admission_destroy(adm);
+}
+
+static void test_write_rate(void) {
+  DiskAdmission *const adm = disk_admission_new();
+  const struct disk_info info = {.fs_id = 1, .free_bytes = G_MAXUINT64};
+  disk_admission_set_write_rate(adm, 1, 10 * MB);
+  struct disk_writer writers[3];
+
+  /* a single capture gets in even if it's more than the disk can take. */
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, 20 * MB, &writers[0]),
+                  ==, DISK_ADMIT);
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, MB, &writers[1]), ==,
+                  DISK_WAIT);
+  disk_admission_release(adm, &writers[0]);
+
+  /* 3 + 3 fits in 75% of 10, but not another 3 on top. */
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, 3 * MB, &writers[0]),
+                  ==, DISK_ADMIT);
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, 3 * MB, &writers[1]),
+                  ==, DISK_ADMIT);
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, 3 * MB, &writers[2]),
+                  ==, DISK_WAIT);
+  disk_admission_release(adm, &writers[1]);
+  g_assert_cmpint(disk_admission_request(adm, &info, MB, 3 * MB, &writers[2]),
+                  ==, DISK_ADMIT);
+  disk_admission_destroy(adm);
+}
+
+static void test_query(void) {
+  GError *err = NULL;
+  struct disk_info info;
+  g_assert_true(disk_query(".", &info, &err));
+  g_assert_no_error(err);
+  g_assert_false(disk_query("no/such/dir", &info, &err));
+  g_assert_error(err, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+  g_error_free(err);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/diskspace/estimate", test_estimate);
+  g_test_add_func("/diskspace/space", test_space);
+  g_test_add_func("/diskspace/write_rate", test_write_rate);
+  g_test_add_func("/diskspace/query", test_query);
+
+  return g_test_run();
+}
@@ -0,0 +1,60 @@
+#include "../dvbsrc.h"
+
+#include <glib.h>
+#include <gst/gst.h>
+
+/* the properties are set the same way on any element, and fakesrc is
+ * always there. */
+static gint get_int(GstElement *element, const gchar *name) {
+  gint value;
+  g_object_get(element, name, &value, NULL);
+  return value;
+}
+
+static void test_restore(void) {
+  GstElement *const src = gst_element_factory_make("fakesrc", NULL);
+  g_assert_nonnull(src);
+  gst_object_ref_sink(src);
+  GstStructure *const extra =
+      gst_structure_new("extra", "sizemax", G_TYPE_INT, 200, NULL);
+  GstStructure *const first = gst_structure_new(
+      "first", "num-buffers", G_TYPE_INT, 5, "sizemax", G_TYPE_INT, 100, NULL);
+  GstStructure *const retry =
+      gst_structure_new("retry", "num-buffers", G_TYPE_INT, 7, NULL);
+  GstStructure *const saved = gst_structure_new_empty("saved");
+
+  /* the first job on the frontend has params of its own. */
+  dvbsrc_set_extra_params(src, extra);
+  dvbsrc_override_params(src, first, saved);
+  g_assert_cmpint(get_int(src, "num-buffers"), ==, 5);
+  g_assert_cmpint(get_int(src, "sizemax"), ==, 100);
+  /* what was there before the first override is what's kept. */
+  dvbsrc_override_params(src, retry, saved);
+  g_assert_cmpint(get_int(src, "num-buffers"), ==, 7);
+  g_assert_cmpint(gst_structure_n_fields(saved), ==, 2);
+
+  /* the second one on the same frontend doesn't, and gets the defaults,
+   * apart from what applies to every job. */
+  dvbsrc_restore_params(src, saved);
+  g_assert_cmpint(gst_structure_n_fields(saved), ==, 0);
+  dvbsrc_set_extra_params(src, extra);
+  g_assert_cmpint(get_int(src, "num-buffers"), ==, -1);
+  g_assert_cmpint(get_int(src, "sizemax"), ==, 200);
+  dvbsrc_restore_params(src, saved);
+  g_assert_cmpint(get_int(src, "num-buffers"), ==, -1);
+
+  gst_structure_free(saved);
+  gst_structure_free(retry);
+  gst_structure_free(first);
+  gst_structure_free(extra);
+  gst_object_unref(src);
+}
+
+int main(int argc, char **argv) {
+  gst_init(&argc, &argv);
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/dvbsrc/restore", test_restore);
+
+  return g_test_run();
+}
@@ -0,0 +1,96 @@
+#include "../dvrbuf.h"
+
+#include <glib.h>
+
+#include "ts_builder.h"
+
+static void test_sizes(void) {
+  struct dvr_buffer_sizes sizes;
+  /* a quiet MUX gets dvbsrc's defaults. */
+  dvr_buffer_sizes_for_bitrate(500000, &sizes);
+  g_assert_cmpuint(sizes.buffer_size, ==, DVR_BUFFER_MIN_SIZE);
+  g_assert_cmpuint(sizes.blocksize, ==, DVR_BLOCK_MIN_SIZE);
+
+  /* 40 Mbit/s is 5 MB/s. */
+  dvr_buffer_sizes_for_bitrate(40000000, &sizes);
+  g_assert_cmpuint(sizes.buffer_size % TS_PACKET_SIZE, ==, 0);
+  g_assert_cmpuint(sizes.buffer_size, >=, 5000000);
+  g_assert_cmpuint(sizes.buffer_size, <, 5000000 + TS_PACKET_SIZE);
+  g_assert_cmpuint(sizes.blocksize % TS_PACKET_SIZE, ==, 0);
+  g_assert_cmpuint(sizes.blocksize, >=, 100000);
+  g_assert_cmpuint(sizes.blocksize, <, 100000 + TS_PACKET_SIZE);
+
+  dvr_buffer_sizes_for_bitrate(G_MAXUINT32, &sizes);
+  g_assert_cmpuint(sizes.buffer_size, ==, DVR_BUFFER_MAX_SIZE);
+  g_assert_cmpuint(sizes.blocksize, ==, DVR_BLOCK_MAX_SIZE);
+
+  g_assert_cmpuint(dvr_buffer_size_grow(DVR_BUFFER_MIN_SIZE), ==,
+                   2 * DVR_BUFFER_MIN_SIZE);
+  g_assert_cmpuint(dvr_buffer_size_grow(DVR_BUFFER_MAX_SIZE), ==,
+                   DVR_BUFFER_MAX_SIZE);
+  g_assert_cmpuint(dvr_default_bitrate(SYS_DVBT2), >,
+                   dvr_default_bitrate(SYS_DVBT));
+}
+
+static void test_monitor(void) {
+  /* 100 packets every 100 ms is 1504 kbit/s. */
+  GByteArray *const chunk = g_byte_array_new();
+  guint8 cc = 0;
+  const guint8 data[] = {0x00, 0x00, 0x01, 0xe0};
+
+  DvrMonitor *const mon = dvr_monitor_new();
+  gint64 now_us = G_USEC_PER_SEC;
+  gboolean measured = FALSE;
+  for (guint i = 0; i < 10 * (DVR_MEASURE_S + 1); ++i) {
+    g_byte_array_set_size(chunk, 0);
+    for (guint j = 0; j < 100; ++j) {
+      ts_put_packets(chunk, 0x100, data, sizeof(data), NULL, 0, &cc);
+    }
+    if (dvr_monitor_push(mon, chunk->data, chunk->len, now_us)) {
+      g_assert_false(measured);
+      measured = TRUE;
+    }
+    now_us += G_USEC_PER_SEC / 10;
+  }
+  g_assert_true(measured);
+  g_assert_cmpuint(dvr_monitor_get_bitrate(mon), ==, 1504000);
+  g_assert_cmpuint(dvr_monitor_get_overruns(mon), ==, 0);
+
+  /* a whole chunk goes missing at some point. */
+  dvr_monitor_start(mon);
+  g_assert_cmpuint(dvr_monitor_get_bitrate(mon), ==, 0);
+  cc = 0;
+  for (guint i = 0; i < 5; ++i) {
+    g_byte_array_set_size(chunk, 0);
+    for (guint j = 0; j < 10; ++j) {
+      ts_put_packets(chunk, 0x100, data, sizeof(data), NULL, 0, &cc);
+    }
+    if (i != 2) {
+      dvr_monitor_push(mon, chunk->data, chunk->len, now_us);
+    }
+  }
+  g_assert_cmpuint(dvr_monitor_get_overruns(mon), ==, 1);
+
+  /* while damage reported by the frontend is something else. */
+  dvr_monitor_start(mon);
+  g_byte_array_set_size(chunk, 0);
+  for (guint j = 0; j < 10; ++j) {
+    ts_put_packets(chunk, 0x100, data, sizeof(data), NULL, 0, &cc);
+  }
+  g_byte_array_remove_range(chunk, 5 * TS_PACKET_SIZE, TS_PACKET_SIZE);
+  chunk->data[5 * TS_PACKET_SIZE + 1] |= 0x80;
+  dvr_monitor_push(mon, chunk->data, chunk->len, now_us);
+  g_assert_cmpuint(dvr_monitor_get_overruns(mon), ==, 0);
+
+  dvr_monitor_destroy(mon);
+  g_byte_array_unref(chunk);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/dvrbuf/sizes", test_sizes);
+  g_test_add_func("/dvrbuf/monitor", test_monitor);
+
+  return g_test_run();
+}
@@ -0,0 +1,119 @@
+#include "../fingerprint.h"
+
+#include <glib.h>
+
+#include "ts_builder.h"
+
+#define PMT_PID 0x100
+
+static void put_section_packets(GByteArray *out, guint16 pid,
+                                const GByteArray *section, guint8 *cc) {
+  const gsize start = 0;
+  ts_put_packets(out, pid, section->data, section->len, &start, 1, cc);
+}
+
+/* a PAT listing one service, its PMT and an SDT of the given version, in
+ * the given order. */
+static GByteArray *make_stream(guint8 sdt_version, gboolean sdt_first) {
+  GByteArray *const stream = g_byte_array_new();
+  guint8 pat_cc = 0, pmt_cc = 0, sdt_cc = 0;
+
+  GByteArray *const pat = g_byte_array_new();
+  const guint8 pat_body[] = {0x00, 0x01, 0xe0 | (PMT_PID >> 8),
+                             PMT_PID & 0xff};
+  ts_put_section(pat, 0x00, 0x0001, 0, 0, pat_body, sizeof(pat_body));
+
+  GByteArray *const pmt = g_byte_array_new();
+  const guint8 pmt_body[] = {0xe1, 0x01, 0xf0, 0x00,
+                             0x02, 0xe1, 0x01, 0xf0, 0x00};
+  ts_put_section(pmt, 0x02, 0x0001, 3, 0, pmt_body, sizeof(pmt_body));
+
+  GByteArray *const sdt = g_byte_array_new();
+  const guint8 sdt_body[] = {0x20, 0xd0, 0xff, 0x00, 0x01,
+                             0xfc, 0x80, 0x00};
+  ts_put_section(sdt, 0x42, 0x0001, sdt_version, 0, sdt_body,
+                 sizeof(sdt_body));
+
+  if (sdt_first) {
+    put_section_packets(stream, TS_PID_SDT, sdt, &sdt_cc);
+  }
+  /* the PMT is only looked for once the PAT is known. */
+  for (int i = 0; i < 2; ++i) {
+    put_section_packets(stream, TS_PID_PAT, pat, &pat_cc);
+    put_section_packets(stream, PMT_PID, pmt, &pmt_cc);
+  }
+  if (!sdt_first) {
+    put_section_packets(stream, TS_PID_SDT, sdt, &sdt_cc);
+  }
+  g_byte_array_unref(pat);
+  g_byte_array_unref(pmt);
+  g_byte_array_unref(sdt);
+  return stream;
+}
+
+/* pushed in uneven pieces, like dvbsrc does. */
+static gchar *digest_of(const GByteArray *stream, gsize piece) {
+  CaptureFingerprint *const fp = capture_fingerprint_new();
+  for (gsize pos = 0; pos < stream->len; pos += piece) {
+    capture_fingerprint_push(fp, stream->data + pos,
+                             MIN(piece, stream->len - pos));
+  }
+  gchar *const digest = capture_fingerprint_get_digest(fp);
+  capture_fingerprint_destroy(fp);
+  return digest;
+}
+
+static void test_digest(void) {
+  CaptureFingerprint *const empty = capture_fingerprint_new();
+  g_assert_null(capture_fingerprint_get_digest(empty));
+  capture_fingerprint_destroy(empty);
+
+  GByteArray *const stream = make_stream(1, FALSE);
+  GByteArray *const reordered = make_stream(1, TRUE);
+  GByteArray *const changed = make_stream(2, FALSE);
+
+  gchar *const digest = digest_of(stream, 1000);
+  g_assert_nonnull(digest);
+  g_assert_cmpuint(strlen(digest), ==, 64);
+  gchar *const same = digest_of(reordered, 77);
+  g_assert_cmpstr(digest, ==, same);
+  gchar *const other = digest_of(changed, 1000);
+  g_assert_cmpstr(digest, !=, other);
+
+  g_free(digest);
+  g_free(same);
+  g_free(other);
+  g_byte_array_unref(stream);
+  g_byte_array_unref(reordered);
+  g_byte_array_unref(changed);
+}
+
+static void test_find_original(void) {
+  const struct mux_capture captures[] = {
+      {.path = "a.ts", .fingerprint = "1", .complete = FALSE},
+      {.path = "b.ts", .fingerprint = "2", .complete = FALSE},
+      {.path = "c.ts", .fingerprint = NULL, .complete = FALSE},
+      {.path = "d.ts", .fingerprint = "1", .complete = TRUE}};
+  GArray *const arr = g_array_new(FALSE, FALSE, sizeof(struct mux_capture));
+  g_array_append_vals(arr, captures, G_N_ELEMENTS(captures));
+
+  const struct mux_capture *const original =
+      mux_captures_find_original(arr, 0);
+  g_assert_nonnull(original);
+  g_assert_cmpstr(original->path, ==, "d.ts");
+  /* a regional variant, and one of which nothing is known. */
+  g_assert_null(mux_captures_find_original(arr, 1));
+  g_assert_null(mux_captures_find_original(arr, 2));
+  /* the complete one is always kept. */
+  g_assert_null(mux_captures_find_original(arr, 3));
+  g_array_unref(arr);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/fingerprint/digest", test_digest);
+  g_test_add_func("/fingerprint/find_original", test_find_original);
+
+  return g_test_run();
+}
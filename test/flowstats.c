@@ -0,0 +1,174 @@
+#include "../flowstats.h"
+
+#include <glib.h>
+#include <string.h>
+
+#define MS(x) ((gint64)(x) * 1000)
+
+static void push(FlowRecorder *rec, gint64 arrival_us, gint64 latency_us,
+                 gint64 write_us, guint32 size) {
+  const struct flow_sample sample = {.arrival_us = arrival_us,
+                                     .latency_us = latency_us,
+                                     .write_us = write_us,
+                                     .size = size};
+  flow_recorder_push(rec, &sample);
+}
+
+static void test_summary(void) {
+  FlowRecorder *const rec = flow_recorder_new();
+  /* 20 ms apart apart from one 30 ms gap. */
+  push(rec, MS(1000), MS(2), MS(1), 100000);
+  push(rec, MS(1020), MS(4), MS(3), 100000);
+  push(rec, MS(1040), -1, MS(2), 50000);
+  push(rec, MS(1070), MS(3), MS(2), 150000);
+
+  struct flow_summary summary;
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.buffers, ==, 4);
+  g_assert_cmpuint(summary.bytes, ==, 400000);
+  g_assert_cmpuint(summary.latencies, ==, 3);
+  g_assert_cmpint(summary.latency_max_us, ==, MS(4));
+  g_assert_cmpuint(summary.intervals, ==, 3);
+  g_assert_cmpuint(summary.dropped, ==, 0);
+
+  gchar *const formatted = flow_summary_format(&summary, MS(1000));
+  g_assert_cmpstr(formatted, ==,
+                  "Flow over the last 1.0 s : 4 buffers, 3.2 Mbit/s\n"
+                  "  size       : avg 100000 bytes, max 150000 bytes\n"
+                  "  latency    : avg 3.0 ms, max 4.0 ms\n"
+                  "  sink write : avg 2.0 ms, max 3.0 ms\n"
+                  "  interval   : avg 23.3 ms, jitter 4.7 ms\n");
+  g_free(formatted);
+
+  /* collecting empties the ring, but the next interval is still known. */
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.buffers, ==, 0);
+  push(rec, MS(1090), MS(1), MS(1), 1000);
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.intervals, ==, 1);
+  g_assert_cmpint(summary.interval_sum_us, ==, MS(20));
+
+  flow_recorder_destroy(rec);
+}
+
+static void test_intervals(void) {
+  FlowRecorder *const rec = flow_recorder_new();
+  /* 10, 10 and 20 ms, so a mean of 13.3 and a standard deviation of
+   * sqrt(200 - 13.3^2) = 4.7. */
+  push(rec, MS(0), 0, 0, 188);
+  push(rec, MS(10), 0, 0, 188);
+  push(rec, MS(20), 0, 0, 188);
+  push(rec, MS(40), 0, 0, 188);
+  struct flow_summary summary;
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.intervals, ==, 3);
+  g_assert_cmpint(summary.interval_sum_us, ==, MS(40));
+  g_assert_cmpfloat(summary.interval_sum_sq, ==, 6e8);
+  gchar *formatted = flow_summary_format(&summary, MS(1000));
+  g_assert_true(g_str_has_suffix(
+      formatted, "  interval   : avg 13.3 ms, jitter 4.7 ms\n"));
+  g_free(formatted);
+
+  /* a new capture starts after a while spent tuning, which isn't an
+   * interval. */
+  flow_recorder_reset(rec);
+  push(rec, MS(5000), 0, 0, 188);
+  push(rec, MS(5020), 0, 0, 188);
+  push(rec, MS(5040), 0, 0, 188);
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.intervals, ==, 2);
+  g_assert_cmpint(summary.interval_sum_us, ==, MS(40));
+  formatted = flow_summary_format(&summary, MS(1000));
+  g_assert_true(g_str_has_suffix(
+      formatted, "  interval   : avg 20.0 ms, jitter 0.0 ms\n"));
+  g_free(formatted);
+
+  /* nothing to go by for a single buffer. */
+  flow_recorder_reset(rec);
+  push(rec, MS(9000), 0, 0, 188);
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.intervals, ==, 0);
+  formatted = flow_summary_format(&summary, MS(1000));
+  g_assert_null(strstr(formatted, "interval"));
+  g_free(formatted);
+  flow_recorder_destroy(rec);
+}
+
+static void test_full(void) {
+  FlowRecorder *const rec = flow_recorder_new();
+  for (guint i = 0; i < FLOW_RING_SIZE + 5; ++i) {
+    push(rec, MS(i), 0, 0, 188);
+  }
+  struct flow_summary summary;
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.buffers, ==, FLOW_RING_SIZE);
+  g_assert_cmpuint(summary.dropped, ==, 5);
+
+  /* there's room again afterwards. */
+  push(rec, MS(FLOW_RING_SIZE + 5), 0, 0, 188);
+  flow_recorder_collect(rec, &summary);
+  g_assert_cmpuint(summary.buffers, ==, 1);
+  g_assert_cmpuint(summary.dropped, ==, 0);
+  g_assert_cmpint(summary.interval_sum_us, ==, MS(1));
+  flow_recorder_destroy(rec);
+}
+
+#define PUSHES_PER_THREAD 1000
+
+struct pusher {
+  FlowRecorder *rec;
+  gint done;
+};
+
+static gpointer push_from_thread(gpointer data) {
+  struct pusher *const pusher = data;
+  for (guint i = 0; i < PUSHES_PER_THREAD; ++i) {
+    push(pusher->rec, MS(i + 1), 0, 0, 188);
+  }
+  g_atomic_int_inc(&pusher->done);
+  return NULL;
+}
+
+static void test_threads(void) {
+  struct pusher pusher = {.rec = flow_recorder_new(), .done = 0};
+  GThread *threads[4];
+  for (guint i = 0; i < G_N_ELEMENTS(threads); ++i) {
+    threads[i] = g_thread_new("push", push_from_thread, &pusher);
+  }
+
+  /* collected while the threads are still pushing. */
+  guint64 buffers = 0, intervals = 0;
+  gint64 interval_sum_us = 0;
+  struct flow_summary summary;
+  gboolean done;
+  do {
+    done = g_atomic_int_get(&pusher.done) == G_N_ELEMENTS(threads);
+    flow_recorder_collect(pusher.rec, &summary);
+    buffers += summary.buffers;
+    intervals += summary.intervals;
+    interval_sum_us += summary.interval_sum_us;
+    g_assert_cmpuint(summary.dropped, ==, 0);
+  } while (!done);
+  for (guint i = 0; i < G_N_ELEMENTS(threads); ++i) {
+    g_thread_join(threads[i]);
+  }
+
+  g_assert_cmpuint(buffers, ==, G_N_ELEMENTS(threads) * PUSHES_PER_THREAD);
+  /* every thread has its own intervals. */
+  g_assert_cmpuint(intervals, ==,
+                   G_N_ELEMENTS(threads) * (PUSHES_PER_THREAD - 1));
+  g_assert_cmpint(interval_sum_us, ==,
+                  G_N_ELEMENTS(threads) * MS(PUSHES_PER_THREAD - 1));
+  flow_recorder_destroy(pusher.rec);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/flowstats/summary", test_summary);
+  g_test_add_func("/flowstats/intervals", test_intervals);
+  g_test_add_func("/flowstats/full", test_full);
+  g_test_add_func("/flowstats/threads", test_threads);
+
+  return g_test_run();
+}
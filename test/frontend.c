@@ -0,0 +1,117 @@
+#include "../frontend.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* pretends that frontend0 of every adapter is DVB-T only, and all the other
+ * ones support DVB-T2 as well. */
+static gboolean fake_probe(const gchar *path, struct dvb_frontend *fe,
+                           void *ctx) {
+  guint *const num_probes = ctx;
+  ++*num_probes;
+  if (g_str_has_suffix(path, "frontend9")) {
+    return FALSE;
+  }
+  fe->name = g_path_get_basename(path);
+  fe->delsys_mask = 1 << SYS_DVBT;
+  if (!g_str_has_suffix(path, "frontend0")) {
+    fe->delsys_mask |= 1 << SYS_DVBT2;
+  }
+  return TRUE;
+}
+
+static void touch(const gchar *root, const gchar *relpath) {
+  gchar *const path = g_build_filename(root, relpath, NULL);
+  gchar *const dir = g_path_get_dirname(path);
+  g_assert_cmpint(g_mkdir_with_parents(dir, 0700), ==, 0);
+  g_assert_true(g_file_set_contents(path, "", 0, NULL));
+  g_free(dir);
+  g_free(path);
+}
+
+static void remove_tree(const gchar *path) {
+  GDir *const dir = g_dir_open(path, 0, NULL);
+  if (dir) {
+    const gchar *name;
+    while ((name = g_dir_read_name(dir))) {
+      gchar *const child = g_build_filename(path, name, NULL);
+      remove_tree(child);
+      g_free(child);
+    }
+    g_dir_close(dir);
+  }
+  g_remove(path);
+}
+
+static const struct dvb_frontend *fe_at(GArray *frontends, guint idx) {
+  g_assert_cmpuint(idx, <, frontends->len);
+  return &g_array_index(frontends, struct dvb_frontend, idx);
+}
+
+static void test_frontend_discover(void) {
+  gchar *const root = g_dir_make_tmp("getplmux-dvb-XXXXXX", NULL);
+  g_assert_nonnull(root);
+  touch(root, "adapter1/frontend0");
+  touch(root, "adapter0/frontend1");
+  touch(root, "adapter0/frontend0");
+  touch(root, "adapter0/frontend9");
+  touch(root, "adapter0/demux0");
+  touch(root, "adapter0/dvr0");
+  touch(root, "adapterx/frontend0");
+  gchar *const cache_path = g_build_filename(root, "frontends.ini", NULL);
+
+  guint num_probes = 0;
+  GArray *frontends =
+      frontends_discover(root, cache_path, fake_probe, &num_probes);
+  g_assert_cmpuint(num_probes, ==, 4);
+  g_assert_cmpuint(frontends->len, ==, 3);
+  g_assert_cmpuint(fe_at(frontends, 0)->adapter, ==, 0);
+  g_assert_cmpuint(fe_at(frontends, 0)->frontend, ==, 0);
+  g_assert_cmpuint(fe_at(frontends, 1)->adapter, ==, 0);
+  g_assert_cmpuint(fe_at(frontends, 1)->frontend, ==, 1);
+  g_assert_cmpuint(fe_at(frontends, 2)->adapter, ==, 1);
+  g_assert_cmpuint(fe_at(frontends, 2)->frontend, ==, 0);
+
+  /* T2 transmitters go to the only frontend which can receive them. */
+  g_assert_true(frontends_find(frontends, SYS_DVBT) == fe_at(frontends, 0));
+  g_assert_true(frontends_find(frontends, SYS_DVBT2) == fe_at(frontends, 1));
+  g_assert_true(frontends_find(frontends, SYS_UNDEFINED) ==
+                fe_at(frontends, 0));
+  g_assert_null(frontends_find(frontends, SYS_DVBS2));
+
+  gchar *const delsys = dvb_frontend_describe_delsys(fe_at(frontends, 1));
+  g_assert_cmpstr(delsys, ==, "DVB-T, DVB-T2");
+  g_free(delsys);
+  g_array_unref(frontends);
+
+  /* everything but the broken frontend comes from the cache now. */
+  num_probes = 0;
+  frontends = frontends_discover(root, cache_path, fake_probe, &num_probes);
+  g_assert_cmpuint(num_probes, ==, 1);
+  g_assert_cmpuint(frontends->len, ==, 3);
+  g_assert_cmpstr(fe_at(frontends, 1)->name, ==, "frontend1");
+  g_assert_true(frontends_find(frontends, SYS_DVBT2) == fe_at(frontends, 1));
+  g_array_unref(frontends);
+
+  remove_tree(root);
+  g_free(cache_path);
+  g_free(root);
+}
+
+static void test_frontend_no_devices(void) {
+  guint num_probes = 0;
+  GArray *const frontends = frontends_discover(
+      "/nonexistent/dev/dvb", NULL, fake_probe, &num_probes);
+  g_assert_cmpuint(frontends->len, ==, 0);
+  g_assert_cmpuint(num_probes, ==, 0);
+  g_array_unref(frontends);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/frontend/discover", test_frontend_discover);
+  g_test_add_func("/frontend/no_devices", test_frontend_no_devices);
+
+  return g_test_run();
+}
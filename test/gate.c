@@ -0,0 +1,145 @@
+#include "../gate.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ts_builder.h"
+
+/* 100 packets of two PIDs, so 18800 bytes. */
+static GByteArray *make_stream(void) {
+  GByteArray *const stream = g_byte_array_new();
+  guint8 cc[2] = {0, 0};
+  const guint8 data[] = {0x00, 0x00, 0x01, 0xe0};
+  for (guint i = 0; i < 100; ++i) {
+    ts_put_packets(stream, 0x100 + i % 2, data, sizeof(data), NULL, 0,
+                   &cc[i % 2]);
+  }
+  return stream;
+}
+
+/* feeds the stream in chunks of 10 packets, 1 ms apart. */
+static enum capture_gate_state push_stream(CaptureGate *gate,
+                                           const GByteArray *stream,
+                                           gint64 *now_us) {
+  enum capture_gate_state state = CAPTURE_GATE_PENDING;
+  const guint chunk = 10 * TS_PACKET_SIZE;
+  for (guint pos = 0; pos < stream->len; pos += chunk) {
+    state = capture_gate_push(gate, stream->data + pos,
+                              MIN(chunk, stream->len - pos), *now_us);
+    *now_us += 1000;
+  }
+  return state;
+}
+
+static void collect_data(const guint8 *data, gsize len, void *ctx) {
+  g_byte_array_append(ctx, data, (guint)len);
+}
+
+static void test_accept(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-gate-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const path = g_build_filename(dir, "capture.ts", NULL);
+  GByteArray *const stream = make_stream();
+  GByteArray *const forwarded = g_byte_array_new();
+
+  /* decided after 5 chunks, the rest is written straight away. */
+  struct capture_gate_limits limits;
+  capture_gate_limits_init(&limits, 4000);
+  CaptureGate *const gate = capture_gate_new(path, &limits, collect_data,
+                                             forwarded);
+  gint64 now_us = 0;
+  g_assert_cmpint(capture_gate_push(gate, stream->data, TS_PACKET_SIZE, now_us),
+                  ==, CAPTURE_GATE_PENDING);
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+  now_us += 1000;
+  g_assert_cmpint(push_stream(gate, stream, &now_us), ==,
+                  CAPTURE_GATE_ACCEPTED);
+  g_assert_cmpint(capture_gate_end(gate, now_us), ==, CAPTURE_GATE_ACCEPTED);
+  g_assert_null(capture_gate_get_reason(gate));
+  g_assert_cmpuint(capture_gate_get_bytes_received(gate), ==,
+                   stream->len + TS_PACKET_SIZE);
+  GError *err = NULL;
+  g_assert_true(capture_gate_close(gate, &err));
+  g_assert_no_error(err);
+
+  gchar *contents;
+  gsize len;
+  g_assert_true(g_file_get_contents(path, &contents, &len, &err));
+  g_assert_cmpmem(contents, TS_PACKET_SIZE, stream->data, TS_PACKET_SIZE);
+  g_assert_cmpmem(contents + TS_PACKET_SIZE, len - TS_PACKET_SIZE,
+                  stream->data, stream->len);
+  g_assert_cmpmem(forwarded->data, forwarded->len, contents, len);
+
+  g_free(contents);
+  g_byte_array_unref(forwarded);
+  g_byte_array_unref(stream);
+  g_unlink(path);
+  g_free(path);
+  g_rmdir(dir);
+  g_free(dir);
+}
+
+static void test_reject(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-gate-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const path = g_build_filename(dir, "capture.ts", NULL);
+  struct capture_gate_limits limits;
+  capture_gate_limits_init(&limits, 1000000);
+
+  /* a packet goes missing. */
+  GByteArray *const stream = make_stream();
+  g_byte_array_remove_range(stream, 50 * TS_PACKET_SIZE, TS_PACKET_SIZE);
+  CaptureGate *gate = capture_gate_new(path, &limits, NULL, NULL);
+  gint64 now_us = 0;
+  g_assert_cmpint(push_stream(gate, stream, &now_us), ==,
+                  CAPTURE_GATE_PENDING);
+  g_assert_cmpint(capture_gate_end(gate, now_us), ==, CAPTURE_GATE_REJECTED);
+  g_assert_nonnull(capture_gate_get_reason(gate));
+  g_assert_true(capture_gate_close(gate, NULL));
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+  /* a damaged one. */
+  g_byte_array_unref(stream);
+  GByteArray *const damaged = make_stream();
+  damaged->data[TS_PACKET_SIZE + 1] |= 0x80;
+  gate = capture_gate_new(path, &limits, NULL, NULL);
+  now_us = 0;
+  push_stream(gate, damaged, &now_us);
+  g_assert_cmpint(capture_gate_end(gate, now_us), ==, CAPTURE_GATE_REJECTED);
+  g_assert_true(capture_gate_close(gate, NULL));
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+  /* nothing wrong with the packets, but far too few of them. */
+  limits.min_bitrate = 1000000000;
+  gate = capture_gate_new(path, &limits, NULL, NULL);
+  now_us = 0;
+  push_stream(gate, damaged, &now_us);
+  g_assert_cmpint(capture_gate_end(gate, now_us), ==, CAPTURE_GATE_REJECTED);
+  g_assert_true(capture_gate_close(gate, NULL));
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+  /* the buffer filling up forces the decision. */
+  limits.min_bitrate = CAPTURE_GATE_MIN_BITRATE;
+  limits.max_buffered = 3 * 10 * TS_PACKET_SIZE;
+  gate = capture_gate_new(path, &limits, NULL, NULL);
+  now_us = 0;
+  g_assert_cmpint(push_stream(gate, damaged, &now_us), ==,
+                  CAPTURE_GATE_REJECTED);
+  g_assert_cmpuint(capture_gate_get_bytes_received(gate), ==, damaged->len);
+  g_assert_true(capture_gate_close(gate, NULL));
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+  g_byte_array_unref(damaged);
+  g_free(path);
+  g_rmdir(dir);
+  g_free(dir);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/gate/accept", test_accept);
+  g_test_add_func("/gate/reject", test_reject);
+
+  return g_test_run();
+}
@@ -37,7 +37,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  MuxData *const parsed = parse_mux_params_from_html(content, (int)len);
+  MuxData *const parsed = parse_mux_params_from_html(content, (int)len, NULL);
   g_free(content);
 
   if (!read_whole_file(argv[2], &content, &len)) {
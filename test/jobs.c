@@ -0,0 +1,119 @@
+#include "../jobs.h"
+
+#include <glib.h>
+
+static const gchar jobs_data[] = "[profile narrow]\n"
+                                 "dvbsrc-extra-params=dvb-buffer-size=1\n"
+                                 "\n"
+                                 "[EPG]\n"
+                                 "mux=MUX-3\n"
+                                 "duration=60\n"
+                                 "profile=narrow\n"
+                                 "\n"
+                                 "[Śrem]\n"
+                                 "mux=MUX-1\n"
+                                 "transmitter=Poznań/Śrem\n"
+                                 "adapter=1\n"
+                                 "frontend=0\n";
+
+static void test_load(void) {
+  GError *err = NULL;
+  GPtrArray *const jobs = capture_jobs_load_from_data(
+      jobs_data, sizeof(jobs_data) - 1, 30, &err);
+  g_assert_no_error(err);
+  g_assert_cmpuint(jobs->len, ==, 2);
+
+  const struct capture_job *job = g_ptr_array_index(jobs, 0);
+  g_assert_cmpstr(job->name, ==, "EPG");
+  g_assert_cmpstr(job->mux, ==, "MUX-3");
+  g_assert_null(job->transmitter);
+  g_assert_cmpstr(job->dvbsrc_params, ==, "dvb-buffer-size=1");
+  g_assert_cmpuint(job->duration_s, ==, 60);
+  g_assert_cmpint(job->adapter, ==, -1);
+  g_assert_cmpint(job->frontend, ==, -1);
+
+  job = g_ptr_array_index(jobs, 1);
+  g_assert_cmpstr(job->name, ==, "Śrem");
+  g_assert_cmpstr(job->transmitter, ==, "Poznań/Śrem");
+  g_assert_null(job->dvbsrc_params);
+  g_assert_cmpuint(job->duration_s, ==, 30);
+  g_assert_cmpint(job->adapter, ==, 1);
+  g_assert_cmpint(job->frontend, ==, 0);
+  g_ptr_array_unref(jobs);
+
+  static const gchar *const broken[] = {
+      "[no mux]\nduration=5\n", "[zero]\nmux=MUX-1\nduration=0\n",
+      "[profile]\nmux=MUX-1\nprofile=wide\n",
+      "[profile wide]\ndvbsrc-extra-params=adapter=1\n", "not a key file"};
+  for (guint i = 0; i < G_N_ELEMENTS(broken); ++i) {
+    g_assert_null(
+        capture_jobs_load_from_data(broken[i], (gsize)-1, 30, &err));
+    g_assert_nonnull(err);
+    g_clear_error(&err);
+  }
+}
+
+static gboolean fits_delsys(const struct capture_job *job,
+                            const struct dvb_frontend *fe, void *ctx) {
+  (void)ctx;
+  const enum fe_delivery_system delsys =
+      g_str_has_prefix(job->mux, "T2") ? SYS_DVBT2 : SYS_DVBT;
+  return (fe->delsys_mask & (G_GUINT64_CONSTANT(1) << delsys)) != 0;
+}
+
+static struct capture_job make_job(const gchar *mux, guint duration_s,
+                                   gint adapter) {
+  const struct capture_job job = {.name = (gchar *)mux,
+                                  .mux = (gchar *)mux,
+                                  .duration_s = duration_s,
+                                  .adapter = adapter,
+                                  .frontend = -1};
+  return job;
+}
+
+static void test_schedule(void) {
+  const struct dvb_frontend fes[] = {
+      {.adapter = 0, .delsys_mask = G_GUINT64_CONSTANT(1) << SYS_DVBT},
+      {.adapter = 1,
+       .delsys_mask = G_GUINT64_CONSTANT(1) << SYS_DVBT |
+                      G_GUINT64_CONSTANT(1) << SYS_DVBT2}};
+  GArray *const frontends =
+      g_array_new(FALSE, FALSE, sizeof(struct dvb_frontend));
+  g_array_append_vals(frontends, fes, G_N_ELEMENTS(fes));
+
+  struct capture_job jobs[] = {
+      make_job("T-long", 60, -1), make_job("T2", 30, -1),
+      make_job("T-pinned", 10, 0), make_job("T2-pinned", 10, 0)};
+  GPtrArray *const job_ptrs = g_ptr_array_new();
+  for (guint i = 0; i < G_N_ELEMENTS(jobs); ++i) {
+    g_ptr_array_add(job_ptrs, &jobs[i]);
+  }
+
+  JobScheduler *const sched =
+      job_scheduler_new(job_ptrs, frontends, fits_delsys, NULL);
+  /* only the second adapter does DVB-T2, but the job needs the first. */
+  const GPtrArray *const unfit = job_scheduler_get_unfit(sched);
+  g_assert_cmpuint(unfit->len, ==, 1);
+  g_assert_true(g_ptr_array_index(unfit, 0) == &jobs[3]);
+  g_assert_cmpuint(job_scheduler_get_num_pending(sched), ==, 3);
+
+  /* the jobs only one frontend can run go first. */
+  g_assert_true(job_scheduler_next(sched, 0) == &jobs[2]);
+  g_assert_true(job_scheduler_next(sched, 1) == &jobs[1]);
+  g_assert_true(job_scheduler_next(sched, 0) == &jobs[0]);
+  g_assert_null(job_scheduler_next(sched, 1));
+  g_assert_cmpuint(job_scheduler_get_num_pending(sched), ==, 0);
+
+  job_scheduler_destroy(sched);
+  g_ptr_array_unref(job_ptrs);
+  g_array_unref(frontends);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/jobs/load", test_load);
+  g_test_add_func("/jobs/schedule", test_schedule);
+
+  return g_test_run();
+}
@@ -0,0 +1,180 @@
+#include "../nit.h"
+
+#include <glib.h>
+
+#include "ts_builder.h"
+
+#define ONID 0x20d0
+
+/* a NIT describing a DVB-T2 stream on 474 MHz with an alternative frequency of
+ * 522 MHz, and a DVB-T one on 690 MHz. */
+static GByteArray *make_nit_stream(gboolean corrupt) {
+  GByteArray *const body = g_byte_array_new();
+
+  /* a long network name, so that the section doesn't fit in one packet */
+  ts_put_u16(body, 0xf000 | (2 + 200));
+  const guint8 name_hdr[] = {0x40, 200};
+  g_byte_array_append(body, name_hdr, sizeof(name_hdr));
+  for (guint i = 0; i < 200; ++i) {
+    const guint8 c = 'x';
+    g_byte_array_append(body, &c, 1);
+  }
+
+  GByteArray *const streams = g_byte_array_new();
+  {
+    GByteArray *const desc = g_byte_array_new();
+    /* T2 delivery : PLP 0, 8 MHz, a single cell without TFS */
+    const guint8 t2[] = {0x7f, 13, 0x04, 0x00, 0x00, 0x01,
+                         0x00, 0x00, 0x00, 0x01};
+    g_byte_array_append(desc, t2, sizeof(t2));
+    ts_put_u32(desc, 47400000);
+    const guint8 no_subcells = 0;
+    g_byte_array_append(desc, &no_subcells, 1);
+    /* frequency list, terrestrial */
+    const guint8 freq_list[] = {0x62, 5, 0x03};
+    g_byte_array_append(desc, freq_list, sizeof(freq_list));
+    ts_put_u32(desc, 52200000);
+
+    ts_put_u16(streams, 1);
+    ts_put_u16(streams, ONID);
+    ts_put_u16(streams, 0xf000 | desc->len);
+    g_byte_array_append(streams, desc->data, desc->len);
+    g_byte_array_unref(desc);
+  }
+  {
+    /* terrestrial delivery : 8 MHz, 64-QAM */
+    const guint8 terrestrial_hdr[] = {0x5a, 11};
+    const guint8 terrestrial_tail[] = {0x1f, 0x80 | 0x02, 0xff, 0xff,
+                                       0xff, 0xff, 0xff};
+    ts_put_u16(streams, 2);
+    ts_put_u16(streams, ONID);
+    ts_put_u16(streams, 0xf000 | 13);
+    g_byte_array_append(streams, terrestrial_hdr, sizeof(terrestrial_hdr));
+    ts_put_u32(streams, 69000000);
+    g_byte_array_append(streams, terrestrial_tail, sizeof(terrestrial_tail));
+  }
+  ts_put_u16(body, 0xf000 | streams->len);
+  g_byte_array_append(body, streams->data, streams->len);
+  g_byte_array_unref(streams);
+
+  GByteArray *const section = g_byte_array_new();
+  ts_put_section(section, 0x40, 0x3001, 3, 0, body->data, body->len);
+  g_byte_array_unref(body);
+  if (corrupt) {
+    section->data[section->len - 10] ^= 0x01;
+  }
+
+  /* starting somewhere in the middle of a packet, with other PIDs mixed in */
+  GByteArray *const stream = g_byte_array_new();
+  const guint8 garbage[] = {0x00, 0x00, 0x01};
+  g_byte_array_append(stream, garbage, sizeof(garbage));
+  guint8 cc = 5, other_cc = 0;
+  const gsize start = 0;
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    ts_put_packets(stream, 0x100, garbage, sizeof(garbage), NULL, 0,
+                   &other_cc);
+    ts_put_packets(stream, TS_PID_NIT, section->data, section->len, &start, 1,
+                   &cc);
+  }
+  g_byte_array_unref(section);
+  return stream;
+}
+
+static void push_stream(NitCollector *nit, const GByteArray *stream) {
+  for (guint pos = 0; pos < stream->len; pos += 100) {
+    nit_collector_push(nit, stream->data + pos, MIN(100, stream->len - pos));
+  }
+}
+
+static void append(MuxData *md, const gchar *mux, const gchar *name,
+                   guint freq_khz) {
+  const struct mux_params params = {.name = g_strdup(name),
+                                    .info_html = NULL,
+                                    .distance = 0,
+                                    .tune_parms = {.freq_khz = freq_khz,
+                                                   .bw_mhz = 7,
+                                                   .mod = QAM_64,
+                                                   .dvb_type = SYS_DVBT}};
+  mux_data_append_transmitter(md, mux, &params);
+}
+
+static MuxData *make_muxdata(void) {
+  MuxData *const md = mux_data_new();
+  append(md, "MUX-1", "Main", 474000);
+  append(md, "MUX-1", "Alternative", 522100);
+  append(md, "MUX-1", "Unknown", 610000);
+  append(md, "MUX-2", "Other", 690000);
+  return md;
+}
+
+static const struct tune_params *params_at(MuxData *md, const gchar *mux,
+                                           guint idx) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  g_assert_cmpuint(idx, <, transmitters->len);
+  return &g_array_index(transmitters, struct mux_params, idx).tune_parms;
+}
+
+static void check_params(const struct tune_params *params, guint freq_khz,
+                         guint bw_mhz, enum fe_modulation mod,
+                         enum fe_delivery_system delsys) {
+  g_assert_cmpuint(params->freq_khz, ==, freq_khz);
+  g_assert_cmpuint(params->bw_mhz, ==, bw_mhz);
+  g_assert_cmpint(params->mod, ==, mod);
+  g_assert_cmpint(params->dvb_type, ==, delsys);
+}
+
+static void test_nit_apply(void) {
+  GByteArray *const stream = make_nit_stream(FALSE);
+  MuxData *const md = make_muxdata();
+  NitCollector *const nit = nit_collector_new();
+
+  /* nothing was captured yet */
+  g_assert_cmpuint(nit_collector_apply(nit, md), ==, 0);
+
+  nit_collector_start(nit, "MUX-1", 474000);
+  push_stream(nit, stream);
+  g_assert_cmpuint(nit_collector_apply(nit, md), ==, 2);
+  check_params(params_at(md, "MUX-1", 0), 474000, 8, QAM_AUTO, SYS_DVBT2);
+  check_params(params_at(md, "MUX-1", 1), 522000, 8, QAM_AUTO, SYS_DVBT2);
+  check_params(params_at(md, "MUX-1", 2), 610000, 7, QAM_64, SYS_DVBT);
+  /* the stream on 690 MHz isn't known to be MUX-2 until it's captured. */
+  check_params(params_at(md, "MUX-2", 0), 690000, 7, QAM_64, SYS_DVBT);
+
+  nit_collector_start(nit, "MUX-2", 690000);
+  push_stream(nit, stream);
+  g_assert_cmpuint(nit_collector_apply(nit, md), ==, 1);
+  check_params(params_at(md, "MUX-2", 0), 690000, 8, QAM_64, SYS_DVBT);
+  g_assert_cmpuint(nit_collector_apply(nit, md), ==, 0);
+
+  /* what was learned applies to other copies of the data as well. */
+  MuxData *const fresh = make_muxdata();
+  g_assert_cmpuint(nit_collector_apply(nit, fresh), ==, 3);
+  mux_data_destroy(fresh);
+
+  nit_collector_destroy(nit);
+  mux_data_destroy(md);
+  g_byte_array_unref(stream);
+}
+
+static void test_nit_corrupt(void) {
+  GByteArray *const stream = make_nit_stream(TRUE);
+  MuxData *const md = make_muxdata();
+  NitCollector *const nit = nit_collector_new();
+
+  nit_collector_start(nit, "MUX-1", 474000);
+  push_stream(nit, stream);
+  g_assert_cmpuint(nit_collector_apply(nit, md), ==, 0);
+
+  nit_collector_destroy(nit);
+  mux_data_destroy(md);
+  g_byte_array_unref(stream);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/nit/apply", test_nit_apply);
+  g_test_add_func("/nit/corrupt", test_nit_corrupt);
+
+  return g_test_run();
+}
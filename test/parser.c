@@ -0,0 +1,158 @@
+#include "../parser.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* the pages are cut down to the tables the parsers look at. there mustn't be
+ * any whitespace between the cells, as the parsers take all the text in a
+ * cell as its contents. */
+#define LOCATION_HEADER                                                        \
+  "<html><body><table border=\"1\" class=\"tabelka_dvbt\">"                    \
+  "<tr><td>#</td><td>f</td><td>MUX</td><td>name</td><td>ERP</td>"              \
+  "<td>km</td><td>az</td></tr>"
+#define LOCATION_ROW(freq, mux, name, km)                                      \
+  "<tr><td>1</td><td>" freq "</td><td>" mux "</td><td>" name "</td>"           \
+  "<td>100</td><td>" km "</td><td>90</td></tr>"
+#define COMPLETE_HEADER                                                        \
+  "<html><body><table border=\"1\" class=\"tabelka\">"                         \
+  "<tr><td>#</td><td>f</td><td>MUX</td><td>name</td><td>ch</td>"               \
+  "<td>pol</td><td>type</td></tr>"
+#define COMPLETE_ROW(freq, mux, name, type)                                    \
+  "<tr><td>1</td><td>" freq "</td><td>" mux "</td><td>" name "</td>"           \
+  "<td>30</td><td>H</td><td>" type "</td></tr>"
+#define FOOTER "</table></body></html>"
+
+static const char warsaw_html[] =
+    LOCATION_HEADER
+    LOCATION_ROW("538", "MUX-1", "PKiN", "0.3")
+    LOCATION_ROW("522", "MUX-2T2", "Raszyn", "10.2")
+    LOCATION_ROW("674", "MUX-3", "Raszyn", "10.2")
+    LOCATION_ROW("191.5", "MUX-8", "PKiN", "0.3")
+    LOCATION_ROW("610", "MUX-6", "Siedlce", "101.7")
+    FOOTER;
+
+static const char lodz_html[] =
+    LOCATION_HEADER
+    LOCATION_ROW("546", "MUX-1", "Lodz", "4.1")
+    LOCATION_ROW("522", "MUX-2T2", "Raszyn", "118.0")
+    FOOTER;
+
+/* Raszyn on MUX-3 is listed twice, and Lodz on MUX-1 is listed on another
+ * frequency than the location-based list has it on. */
+static const char complete_html[] =
+    COMPLETE_HEADER
+    COMPLETE_ROW("538", "MUX-1", "PKiN", "DVB-T")
+    COMPLETE_ROW("538", "MUX-1", "Krakow", "DVB-T")
+    COMPLETE_ROW("522", "MUX-2T2", "Raszyn", "DVB-T2")
+    COMPLETE_ROW("674", "MUX-3", "Raszyn", "DVB-T")
+    COMPLETE_ROW("674", "MUX-3", "Raszyn", "DVB-T2")
+    COMPLETE_ROW("191.5", "MUX-8", "PKiN", "DVB-T")
+    COMPLETE_ROW("554", "MUX-1", "Lodz", "DVB-T")
+    FOOTER;
+
+static MuxData *parse_location(const char *html) {
+  return parse_mux_params_from_html(html, (int)strlen(html), NULL);
+}
+
+static const struct tune_params *tune_params_of(MuxData *md, const gchar *mux,
+                                                const gchar *name) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  g_assert_nonnull(transmitters);
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    if (g_strcmp0(par->name, name) == 0) {
+      return &par->tune_parms;
+    }
+  }
+  g_assert_not_reached();
+}
+
+static void check_tune_params(const struct tune_params *tp, guint freq_khz,
+                              guint bw_mhz, enum fe_modulation mod,
+                              enum fe_delivery_system dvb_type) {
+  g_assert_cmpuint(tp->freq_khz, ==, freq_khz);
+  g_assert_cmpuint(tp->bw_mhz, ==, bw_mhz);
+  g_assert_cmpint(tp->mod, ==, mod);
+  g_assert_cmpint(tp->dvb_type, ==, dvb_type);
+}
+
+static void test_index_apply(void) {
+  TuneParamsIndex *const index = parse_tune_params_index(
+      complete_html, (int)strlen(complete_html), NULL);
+
+  /* the index is parsed once and applied to every location, as in batch
+   * mode. */
+  MuxData *const warsaw = parse_location(warsaw_html);
+  MuxData *const lodz = parse_location(lodz_html);
+  g_assert_cmpuint(mux_data_get_num_muxes(warsaw), ==, 5);
+  g_assert_cmpuint(mux_data_get_num_muxes(lodz), ==, 2);
+  tune_params_index_apply(index, warsaw);
+  tune_params_index_apply(index, lodz);
+
+  check_tune_params(tune_params_of(warsaw, "MUX-1", "PKiN"), 538000, 8, QAM_64,
+                    SYS_DVBT);
+  check_tune_params(tune_params_of(warsaw, "MUX-2", "Raszyn"), 522000, 8,
+                    QAM_256, SYS_DVBT2);
+  /* the last one listed wins. */
+  check_tune_params(tune_params_of(warsaw, "MUX-3", "Raszyn"), 674000, 8,
+                    QAM_256, SYS_DVBT2);
+  check_tune_params(tune_params_of(warsaw, "MUX-8", "PKiN"), 191500, 7, QAM_64,
+                    SYS_DVBT);
+  /* a MUX the complete list doesn't have is left as it was parsed. */
+  check_tune_params(tune_params_of(warsaw, "MUX-6", "Siedlce"), 610000, 0, 0,
+                    0);
+
+  /* so is a transmitter listed on another frequency. */
+  check_tune_params(tune_params_of(lodz, "MUX-1", "Lodz"), 546000, 0, 0, 0);
+  check_tune_params(tune_params_of(lodz, "MUX-2", "Raszyn"), 522000, 8,
+                    QAM_256, SYS_DVBT2);
+
+  mux_data_destroy(lodz);
+  mux_data_destroy(warsaw);
+  tune_params_index_destroy(index);
+}
+
+static void test_index_filter(void) {
+  const gchar *const muxes[] = {"MUX-3", "MUX-8", NULL};
+  struct mux_filter filter;
+  mux_filter_init(&filter);
+  filter.muxes = g_strdupv((gchar **)muxes);
+  TuneParamsIndex *const index = parse_tune_params_index(
+      complete_html, (int)strlen(complete_html), &filter);
+
+  MuxData *const warsaw = parse_location(warsaw_html);
+  tune_params_index_apply(index, warsaw);
+  check_tune_params(tune_params_of(warsaw, "MUX-1", "PKiN"), 538000, 0, 0, 0);
+  check_tune_params(tune_params_of(warsaw, "MUX-3", "Raszyn"), 674000, 8,
+                    QAM_256, SYS_DVBT2);
+  check_tune_params(tune_params_of(warsaw, "MUX-8", "PKiN"), 191500, 7, QAM_64,
+                    SYS_DVBT);
+
+  mux_data_destroy(warsaw);
+  tune_params_index_destroy(index);
+  mux_filter_clear(&filter);
+}
+
+/* the one-shot version is the same as parsing an index and applying it. */
+static void test_tune_params_to_mux_params(void) {
+  MuxData *const warsaw = parse_location(warsaw_html);
+  parse_tune_params_to_mux_params(warsaw, complete_html,
+                                  (int)strlen(complete_html));
+  check_tune_params(tune_params_of(warsaw, "MUX-3", "Raszyn"), 674000, 8,
+                    QAM_256, SYS_DVBT2);
+  check_tune_params(tune_params_of(warsaw, "MUX-6", "Siedlce"), 610000, 0, 0,
+                    0);
+  mux_data_destroy(warsaw);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/parser/index_apply", test_index_apply);
+  g_test_add_func("/parser/index_filter", test_index_filter);
+  g_test_add_func("/parser/tune_params_to_mux_params",
+                  test_tune_params_to_mux_params);
+
+  return g_test_run();
+}
@@ -0,0 +1,111 @@
+#include "../plan.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+static void append(MuxData *md, const gchar *mux, const gchar *name,
+                   guint freq_khz, enum fe_modulation mod,
+                   enum fe_delivery_system delsys) {
+  const struct mux_params params = {.name = g_strdup(name),
+                                    .info_html = NULL,
+                                    .distance = 12.5,
+                                    .tune_parms = {.freq_khz = freq_khz,
+                                                   .bw_mhz = 8,
+                                                   .mod = mod,
+                                                   .dvb_type = delsys}};
+  mux_data_append_transmitter(md, mux, &params);
+}
+
+static MuxData *make_muxdata(void) {
+  MuxData *const md = mux_data_new();
+  append(md, "MUX-1", "Poznań/Śrem", 474000, QAM_64, SYS_DVBT);
+  append(md, "MUX-1", "Piła/Rusinowo", 522000, QAM_64, SYS_DVBT);
+  append(md, "MUX-6", "Poznań/Śrem", 690000, QAM_AUTO, SYS_DVBT2);
+  return md;
+}
+
+static void test_save_load(void) {
+  gchar *path = NULL;
+  const gint fd = g_file_open_tmp("getplmux-plan-XXXXXX.ini", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+
+  MuxData *md = make_muxdata();
+  GError *err = NULL;
+  g_assert_true(plan_save(md, path, &err));
+  g_assert_no_error(err);
+  mux_data_destroy(md);
+
+  md = plan_load(path, &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(md);
+  const GArray *transmitters = mux_data_get_transmitters_for_mux(md, "MUX-1");
+  g_assert_cmpuint(transmitters->len, ==, 2);
+  /* in the order they were tried, not by distance or anything else. */
+  const struct mux_params *par =
+      &g_array_index(transmitters, struct mux_params, 1);
+  g_assert_cmpstr(par->name, ==, "Piła/Rusinowo");
+  g_assert_cmpfloat(par->distance, ==, 12.5);
+  g_assert_cmpuint(par->tune_parms.freq_khz, ==, 522000);
+  g_assert_cmpuint(par->tune_parms.bw_mhz, ==, 8);
+  g_assert_cmpint(par->tune_parms.mod, ==, QAM_64);
+  g_assert_cmpint(par->tune_parms.dvb_type, ==, SYS_DVBT);
+  transmitters = mux_data_get_transmitters_for_mux(md, "MUX-6");
+  par = &g_array_index(transmitters, struct mux_params, 0);
+  g_assert_cmpint(par->tune_parms.mod, ==, QAM_AUTO);
+  g_assert_cmpint(par->tune_parms.dvb_type, ==, SYS_DVBT2);
+  mux_data_destroy(md);
+
+  g_unlink(path);
+  g_free(path);
+}
+
+static void test_validate(void) {
+  static const gchar *const broken[] = {
+      "not a key file",
+      "[plan]\nversion=2\ntransmitters=1\n",
+      "[plan]\nversion=1\ntransmitters=0\n",
+      /* one transmitter missing */
+      "[plan]\nversion=1\ntransmitters=2\n[transmitter 1]\nmux=MUX-1\n"
+      "name=A\ndistance=1\nfrequency=474000\nbandwidth=8\n"
+      "modulation=QAM/64\ndelivery-system=DVB-T\n",
+      "[plan]\nversion=1\ntransmitters=1\n[transmitter 1]\nmux=MUX-1\n"
+      "name=A\ndistance=1\nfrequency=474000\nbandwidth=80\n"
+      "modulation=QAM/64\ndelivery-system=DVB-T\n",
+      "[plan]\nversion=1\ntransmitters=1\n[transmitter 1]\nmux=MUX-1\n"
+      "name=A\ndistance=1\nfrequency=474000\nbandwidth=8\n"
+      "modulation=QAM/64\ndelivery-system=DVB-S\n"};
+  for (guint i = 0; i < G_N_ELEMENTS(broken); ++i) {
+    GError *err = NULL;
+    g_assert_null(plan_load_from_data(broken[i], (gsize)-1, &err));
+    g_assert_nonnull(err);
+    g_error_free(err);
+  }
+}
+
+static void test_channels_conf(void) {
+  MuxData *const md = make_muxdata();
+  gchar *const conf = plan_format_channels_conf(md);
+  g_assert_true(g_str_has_prefix(conf, "[MUX-1 Poznań/Śrem]\n"
+                                       "\tDELIVERY_SYSTEM = DVBT\n"
+                                       "\tFREQUENCY = 474000000\n"
+                                       "\tBANDWIDTH_HZ = 8000000\n"
+                                       "\tMODULATION = QAM/64\n"));
+  g_assert_nonnull(strstr(conf, "[MUX-6 Poznań/Śrem]\n"
+                                "\tDELIVERY_SYSTEM = DVBT2\n"
+                                "\tFREQUENCY = 690000000\n"));
+  g_free(conf);
+  mux_data_destroy(md);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/plan/save_load", test_save_load);
+  g_test_add_func("/plan/validate", test_validate);
+  g_test_add_func("/plan/channels_conf", test_channels_conf);
+
+  return g_test_run();
+}
@@ -0,0 +1,30 @@
+#include "../profile.h"
+
+#include <glib.h>
+
+static void test_format(void) {
+  Profile *const profile = profile_new("Startup", 1000000);
+  profile_add(profile, "second", 1500000, 1750000);
+  profile_add(profile, "first", 1000000, 2000000);
+  gchar *const formatted = profile_format(profile, 2500000);
+  g_assert_cmpstr(formatted, ==,
+                  "Startup :\n"
+                  "  at      0.0 ms :   1000.0 ms first\n"
+                  "  at    500.0 ms :    250.0 ms second\n"
+                  "  total          :   1500.0 ms\n");
+  g_free(formatted);
+  profile_destroy(profile);
+
+  /* not profiling. */
+  profile_add(NULL, "ignored", 0, 1);
+  g_assert_null(profile_format(NULL, 0));
+  profile_destroy(NULL);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/profile/format", test_format);
+
+  return g_test_run();
+}
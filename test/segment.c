@@ -0,0 +1,162 @@
+#include "../segment.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ts_builder.h"
+
+#define PCR_PID 0x100
+/* 2024-05-01T12:00:00Z */
+#define WALL_START_US (G_GINT64_CONSTANT(1714564800) * G_USEC_PER_SEC)
+
+/* 10 groups of a packet with a PCR of 1000 times the group's number
+ * followed by 9 with data, so 100 packets. */
+static GByteArray *make_stream(void) {
+  GByteArray *const stream = g_byte_array_new();
+  guint8 cc = 0;
+  const guint8 data[] = {0x00, 0x00, 0x01, 0xe0};
+  for (guint i = 0; i < 10; ++i) {
+    ts_put_pcr_packet(stream, PCR_PID, i * 1000);
+    for (guint j = 0; j < 9; ++j) {
+      ts_put_packets(stream, 0x101, data, sizeof(data), NULL, 0, &cc);
+    }
+  }
+  return stream;
+}
+
+/* in chunks which don't line up with the packets, 1 ms apart. */
+static void push_stream(SegmentWriter *writer, const GByteArray *stream,
+                        guint chunk) {
+  gint64 now_us = 0;
+  for (guint pos = 0; pos < stream->len; pos += chunk) {
+    segment_writer_push(writer, stream->data + pos,
+                        MIN(chunk, stream->len - pos), now_us,
+                        WALL_START_US + now_us);
+    now_us += 1000;
+  }
+}
+
+static void collect_path(const gchar *path, void *ctx) {
+  g_ptr_array_add(ctx, g_strdup(path));
+}
+
+static gchar **read_index(const gchar *prefix) {
+  gchar *const path = g_strconcat(prefix, ".idx", NULL);
+  gchar *contents;
+  g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+  g_unlink(path);
+  g_free(path);
+  gchar **const lines = g_strsplit(g_strchomp(contents), "\n", -1);
+  g_free(contents);
+  return lines;
+}
+
+/* checks that the segments add up to the stream and removes them. */
+static void check_segments(const GPtrArray *paths, const GByteArray *stream) {
+  GByteArray *const joined = g_byte_array_new();
+  for (guint i = 0; i < paths->len; ++i) {
+    gchar *contents;
+    gsize len;
+    g_assert_true(
+        g_file_get_contents(paths->pdata[i], &contents, &len, NULL));
+    g_byte_array_append(joined, (const guint8 *)contents, (guint)len);
+    g_free(contents);
+    g_unlink(paths->pdata[i]);
+  }
+  g_assert_cmpmem(joined->data, joined->len, stream->data, stream->len);
+  g_byte_array_unref(joined);
+}
+
+static void test_size(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-segment-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const prefix = g_build_filename(dir, "capture", NULL);
+  GByteArray *const stream = make_stream();
+  GPtrArray *const paths = g_ptr_array_new_with_free_func(g_free);
+
+  const struct segment_limits limits = {.max_bytes = 25 * TS_PACKET_SIZE +
+                                                     100};
+  SegmentWriter *const writer =
+      segment_writer_new(prefix, &limits, collect_path, paths);
+  push_stream(writer, stream, 1000);
+  g_assert_cmpuint(segment_writer_get_bytes_written(writer), ==, stream->len);
+  /* the last one is only done once the writer is closed. */
+  g_assert_cmpuint(paths->len, ==, 3);
+  GError *err = NULL;
+  g_assert_true(segment_writer_close(writer, &err));
+  g_assert_no_error(err);
+  g_assert_cmpuint(paths->len, ==, 4);
+  g_assert_true(g_str_has_suffix(paths->pdata[3], "capture_00003.ts"));
+
+  gchar **const lines = read_index(prefix);
+  g_assert_cmpuint(g_strv_length(lines), ==, 4);
+  g_assert_cmpstr(lines[0], ==,
+                  "capture_00000.ts\t0\t4700\t256\t0\t2024-05-01T12:00:00Z");
+  /* starts at the 26th packet, while the next PCR is in the 31st. */
+  g_assert_true(g_str_has_prefix(lines[1],
+                                 "capture_00001.ts\t4700\t4700\t256\t3000\t"));
+  g_assert_true(g_str_has_prefix(lines[3], "capture_00003.ts\t14100\t4700\t"));
+  g_strfreev(lines);
+
+  check_segments(paths, stream);
+  g_ptr_array_unref(paths);
+  g_byte_array_unref(stream);
+  g_free(prefix);
+  g_rmdir(dir);
+  g_free(dir);
+}
+
+static void test_duration(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-segment-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const prefix = g_build_filename(dir, "capture", NULL);
+  GByteArray *const stream = make_stream();
+  GPtrArray *const paths = g_ptr_array_new_with_free_func(g_free);
+
+  /* 10 packets a millisecond, so 50 packets to a segment. */
+  const struct segment_limits limits = {.max_duration_us = 5000};
+  SegmentWriter *const writer =
+      segment_writer_new(prefix, &limits, collect_path, paths);
+  gchar *const index_path = g_strconcat(prefix, ".idx", NULL);
+  g_assert_false(g_file_test(index_path, G_FILE_TEST_EXISTS));
+  g_free(index_path);
+  push_stream(writer, stream, 10 * TS_PACKET_SIZE);
+  g_assert_true(segment_writer_close(writer, NULL));
+  g_assert_cmpuint(paths->len, ==, 2);
+
+  gchar **const lines = read_index(prefix);
+  g_assert_cmpuint(g_strv_length(lines), ==, 2);
+  g_assert_true(g_str_has_prefix(lines[1], "capture_00001.ts\t9400\t9400\t"));
+  g_strfreev(lines);
+
+  check_segments(paths, stream);
+  g_ptr_array_unref(paths);
+  g_byte_array_unref(stream);
+  g_free(prefix);
+  g_rmdir(dir);
+  g_free(dir);
+}
+
+static void test_errors(void) {
+  const struct segment_limits limits = {.max_bytes = 0};
+  SegmentWriter *const writer =
+      segment_writer_new("no/such/dir/capture", &limits, NULL, NULL);
+  GByteArray *const stream = make_stream();
+  push_stream(writer, stream, 1000);
+  g_assert_cmpuint(segment_writer_get_bytes_written(writer), ==, 0);
+  GError *err = NULL;
+  g_assert_false(segment_writer_close(writer, &err));
+  g_assert_error(err, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+  g_error_free(err);
+  g_byte_array_unref(stream);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/segment/size", test_size);
+  g_test_add_func("/segment/duration", test_duration);
+  g_test_add_func("/segment/errors", test_errors);
+
+  return g_test_run();
+}
@@ -0,0 +1,121 @@
+#include "../silog.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ts_builder.h"
+
+struct record {
+  gint64 time_us;
+  guint16 pid;
+  guint8 table_id;
+  guint8 version;
+};
+
+static void collect_record(gint64 time_us, guint16 pid, const guint8 *section,
+                           gsize len, void *ctx) {
+  GArray *const records = ctx;
+  const struct record rec = {.time_us = time_us,
+                             .pid = pid,
+                             .table_id = section[0],
+                             .version = len > 5 ? (section[5] >> 1) & 0x1f
+                                                : 0};
+  if (section[1] & 0x80) {
+    g_assert_cmphex(ts_crc32(section, len), ==, 0);
+  }
+  g_array_append_val(records, rec);
+}
+
+static void put_sdt(GByteArray *stream, guint8 version, guint8 *cc) {
+  guint8 body[200];
+  memset(body, version, sizeof(body));
+  GByteArray *const section = g_byte_array_new();
+  ts_put_section(section, 0x42, 1, version, 0, body, sizeof(body));
+  const gsize start = 0;
+  ts_put_packets(stream, TS_PID_SDT, section->data, section->len, &start, 1,
+                 cc);
+  g_byte_array_unref(section);
+}
+
+static void put_tdt(GByteArray *stream, guint8 seconds, guint8 *cc) {
+  /* UTC time as MJD and BCD, no CRC */
+  const guint8 tdt[] = {0x70, 0x70, 0x05, 0xea, 0x5f, 0x12, 0x00, seconds};
+  const gsize start = 0;
+  ts_put_packets(stream, TS_PID_TDT, tdt, sizeof(tdt), &start, 1, cc);
+}
+
+static void test_si_log(void) {
+  gchar *const dir = g_dir_make_tmp("getplmux-silog-XXXXXX", NULL);
+  g_assert_nonnull(dir);
+  gchar *const path = g_build_filename(dir, "capture.si", NULL);
+
+  GByteArray *const stream = g_byte_array_new();
+  guint8 sdt_cc = 0, tdt_cc = 0, video_cc = 0;
+  put_sdt(stream, 1, &sdt_cc);
+  put_tdt(stream, 0x00, &tdt_cc);
+  const guint8 video[] = {0x00, 0x00, 0x01, 0xe0};
+  ts_put_packets(stream, 0x100, video, sizeof(video), NULL, 0, &video_cc);
+  put_sdt(stream, 1, &sdt_cc);
+  put_tdt(stream, 0x00, &tdt_cc);
+  put_tdt(stream, 0x01, &tdt_cc);
+  put_sdt(stream, 2, &sdt_cc);
+  put_sdt(stream, 2, &sdt_cc);
+
+  GError *err = NULL;
+  SiLog *const log = si_log_open(path, &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(log);
+  /* split at odd places, with the time moving on */
+  gint64 now_us = 1000;
+  for (guint pos = 0; pos < stream->len; pos += 150) {
+    si_log_push(log, stream->data + pos, MIN(150, stream->len - pos),
+                now_us++);
+  }
+  g_assert_cmpuint(si_log_get_bytes_received(log), ==, stream->len);
+  g_assert_cmpuint(si_log_get_sections_written(log), ==, 4);
+  g_assert_true(si_log_close(log, &err));
+  g_assert_no_error(err);
+
+  GArray *const records = g_array_new(FALSE, FALSE, sizeof(struct record));
+  g_assert_true(si_log_read(path, collect_record, records, &err));
+  g_assert_no_error(err);
+  g_assert_cmpuint(records->len, ==, 4);
+  const struct record *const rec = (const struct record *)records->data;
+  g_assert_cmpuint(rec[0].pid, ==, TS_PID_SDT);
+  g_assert_cmpuint(rec[0].version, ==, 1);
+  g_assert_cmpuint(rec[1].pid, ==, TS_PID_TDT);
+  g_assert_cmpuint(rec[2].pid, ==, TS_PID_TDT);
+  g_assert_cmpuint(rec[3].pid, ==, TS_PID_SDT);
+  g_assert_cmpuint(rec[3].version, ==, 2);
+  for (guint i = 1; i < records->len; ++i) {
+    g_assert_cmpint(rec[i - 1].time_us, <, rec[i].time_us);
+  }
+  g_array_free(records, TRUE);
+
+  /* a log cut short while being written */
+  gchar *contents;
+  gsize len;
+  g_assert_true(g_file_get_contents(path, &contents, &len, NULL));
+  g_assert_true(g_file_set_contents(path, contents, (gssize)len - 1, NULL));
+  g_free(contents);
+  GArray *const partial = g_array_new(FALSE, FALSE, sizeof(struct record));
+  g_assert_false(si_log_read(path, collect_record, partial, &err));
+  g_assert_error(err, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+  g_clear_error(&err);
+  g_assert_cmpuint(partial->len, ==, 3);
+  g_array_free(partial, TRUE);
+
+  g_byte_array_unref(stream);
+  g_unlink(path);
+  g_rmdir(dir);
+  g_free(path);
+  g_free(dir);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/silog/dedup", test_si_log);
+
+  return g_test_run();
+}
@@ -0,0 +1,248 @@
+#include "../stats.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define DAY (24 * 60 * 60)
+#define T0 ((gint64)1700000000)
+
+static const struct capture_result locked = {.locked = TRUE,
+                                             .time_to_lock_s = 1.5,
+                                             .duration_s = 30,
+                                             .read_fails = 0,
+                                             .bytes = 90000000};
+static const struct capture_result failed = {.locked = FALSE};
+
+static void append(MuxData *md, const gchar *mux, const gchar *name,
+                   guint freq_khz, gdouble distance) {
+  const struct mux_params params = {.name = g_strdup(name),
+                                    .info_html = NULL,
+                                    .distance = distance,
+                                    .tune_parms = {.freq_khz = freq_khz}};
+  mux_data_append_transmitter(md, mux, &params);
+}
+
+static MuxData *make_muxdata(void) {
+  MuxData *const md = mux_data_new();
+  append(md, "MUX-1", "Near", 474000, 10);
+  append(md, "MUX-1", "Middle", 522000, 40);
+  append(md, "MUX-1", "Far", 610000, 90);
+  return md;
+}
+
+static const gchar *name_at(MuxData *md, guint idx) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, "MUX-1");
+  g_assert_cmpuint(idx, <, transmitters->len);
+  return g_array_index(transmitters, struct mux_params, idx).name;
+}
+
+static guint num_transmitters(MuxData *md) {
+  return mux_data_get_transmitters_for_mux(md, "MUX-1")->len;
+}
+
+static const struct mux_params *params_of(MuxData *md, const gchar *name) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, "MUX-1");
+  for (guint i = 0; i < transmitters->len; ++i) {
+    const struct mux_params *const par =
+        &g_array_index(transmitters, struct mux_params, i);
+    if (g_strcmp0(par->name, name) == 0) {
+      return par;
+    }
+  }
+  g_assert_not_reached();
+}
+
+static void test_stats_no_history(void) {
+  TransmitterStats *const stats = transmitter_stats_new();
+  MuxData *const md = make_muxdata();
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0), ==, 0);
+  g_assert_cmpstr(name_at(md, 0), ==, "Near");
+  g_assert_cmpstr(name_at(md, 1), ==, "Middle");
+  g_assert_cmpstr(name_at(md, 2), ==, "Far");
+  mux_data_destroy(md);
+  transmitter_stats_destroy(stats);
+}
+
+static void test_stats_order(void) {
+  TransmitterStats *const stats = transmitter_stats_new();
+  MuxData *const md = make_muxdata();
+  /* a single failure doesn't make a transmitter bad, but moves it back. */
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Near"), &failed, T0);
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Far"), &locked, T0);
+
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0 + 60), ==, 0);
+  g_assert_cmpstr(name_at(md, 0), ==, "Far");
+  g_assert_cmpstr(name_at(md, 1), ==, "Middle");
+  g_assert_cmpstr(name_at(md, 2), ==, "Near");
+  mux_data_destroy(md);
+  transmitter_stats_destroy(stats);
+}
+
+static void test_stats_known_bad(void) {
+  TransmitterStats *const stats = transmitter_stats_new();
+  MuxData *md = make_muxdata();
+  const struct mux_params *const near = params_of(md, "Near");
+  transmitter_stats_record(stats, "MUX-1", near, &failed, T0);
+  g_assert_false(transmitter_stats_is_known_bad(stats, "MUX-1", near, T0));
+  transmitter_stats_record(stats, "MUX-1", near, &failed, T0);
+  g_assert_true(transmitter_stats_is_known_bad(stats, "MUX-1", near, T0));
+  g_assert_false(
+      transmitter_stats_is_known_bad(stats, "MUX-1", near, T0 + 2 * DAY));
+
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0), ==, 1);
+  g_assert_cmpuint(num_transmitters(md), ==, 2);
+  g_assert_cmpstr(name_at(md, 0), ==, "Middle");
+  mux_data_destroy(md);
+
+  /* once the TTL expires, it's tried again, just after the unknown ones. */
+  md = make_muxdata();
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0 + 2 * DAY),
+                   ==, 0);
+  g_assert_cmpuint(num_transmitters(md), ==, 3);
+  g_assert_cmpstr(name_at(md, 2), ==, "Near");
+
+  /* if every transmitter is bad, all of them are kept. */
+  for (guint i = 0; i < num_transmitters(md); ++i) {
+    const struct mux_params *const par = &g_array_index(
+        mux_data_get_transmitters_for_mux(md, "MUX-1"), struct mux_params, i);
+    transmitter_stats_record(stats, "MUX-1", par, &failed, T0 + 3 * DAY);
+    transmitter_stats_record(stats, "MUX-1", par, &failed, T0 + 3 * DAY);
+  }
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0 + 3 * DAY),
+                   ==, 0);
+  g_assert_cmpuint(num_transmitters(md), ==, 3);
+
+  mux_data_destroy(md);
+  transmitter_stats_destroy(stats);
+}
+
+static void test_stats_decay(void) {
+  /* an old streak of failures is outweighed by a recent success. */
+  TransmitterStats *const stats = transmitter_stats_new();
+  MuxData *const md = make_muxdata();
+  for (int i = 0; i < 5; ++i) {
+    transmitter_stats_record(stats, "MUX-1", params_of(md, "Near"), &failed,
+                             T0);
+    transmitter_stats_record(stats, "MUX-1", params_of(md, "Far"), &locked,
+                             T0);
+  }
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Near"), &locked,
+                           T0 + 365 * DAY);
+
+  transmitter_stats_order_muxdata(stats, md, T0 + 365 * DAY);
+  g_assert_cmpstr(name_at(md, 0), ==, "Near");
+  mux_data_destroy(md);
+  transmitter_stats_destroy(stats);
+}
+
+static void test_stats_save_load(void) {
+  TransmitterStats *stats = transmitter_stats_new();
+  MuxData *const md = make_muxdata();
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Near"), &failed, T0);
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Near"), &failed, T0);
+  transmitter_stats_record(stats, "MUX-1", params_of(md, "Far"), &locked, T0);
+
+  gchar *path = NULL;
+  const gint fd = g_file_open_tmp("getplmux-stats-XXXXXX.ini", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+
+  GError *err = NULL;
+  g_assert_true(transmitter_stats_save(stats, path, &err));
+  g_assert_no_error(err);
+  transmitter_stats_destroy(stats);
+
+  stats = transmitter_stats_load(path, &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(stats);
+  g_assert_true(transmitter_stats_is_known_bad(stats, "MUX-1",
+                                               params_of(md, "Near"), T0));
+  g_assert_cmpuint(transmitter_stats_order_muxdata(stats, md, T0), ==, 1);
+  g_assert_cmpstr(name_at(md, 0), ==, "Far");
+
+  g_unlink(path);
+  g_free(path);
+  transmitter_stats_destroy(stats);
+
+  /* a missing file means no history. */
+  stats = transmitter_stats_load("/nonexistent/stats.ini", &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(stats);
+  transmitter_stats_destroy(stats);
+  mux_data_destroy(md);
+}
+
+static void test_stats_dvr(void) {
+  TransmitterStats *stats = transmitter_stats_new();
+  MuxData *const md = make_muxdata();
+  const struct mux_params *const far = params_of(md, "Far");
+  guint64 bitrate;
+  g_assert_false(transmitter_stats_get_bitrate(stats, "MUX-1", far, &bitrate));
+  g_assert_cmpuint(transmitter_stats_get_dvr_buffer_size(stats, "MUX-1", far),
+                   ==, 0);
+
+  /* 90 MB in 30 s, twice. */
+  struct capture_result result = locked;
+  result.dvr_buffer_size = 4000000;
+  transmitter_stats_record(stats, "MUX-1", far, &result, T0);
+  transmitter_stats_record(stats, "MUX-1", far, &locked, T0 + DAY);
+  transmitter_stats_record(stats, "MUX-1", far, &failed, T0 + DAY);
+  g_assert_true(transmitter_stats_get_bitrate(stats, "MUX-1", far, &bitrate));
+  g_assert_cmpuint(bitrate, ==, 24000000);
+  /* an SI-only capture of a few kB doesn't drag it down. */
+  struct capture_result si_only = locked;
+  si_only.bytes = 20000;
+  si_only.filtered = TRUE;
+  transmitter_stats_record(stats, "MUX-1", far, &si_only, T0 + DAY);
+  g_assert_true(transmitter_stats_get_bitrate(stats, "MUX-1", far, &bitrate));
+  g_assert_cmpuint(bitrate, ==, 24000000);
+
+  gchar *path = NULL;
+  const gint fd = g_file_open_tmp("getplmux-stats-XXXXXX.ini", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+  GError *err = NULL;
+  g_assert_true(transmitter_stats_save(stats, path, &err));
+  transmitter_stats_destroy(stats);
+  stats = transmitter_stats_load(path, &err);
+  g_assert_no_error(err);
+  g_assert_cmpuint(transmitter_stats_get_dvr_buffer_size(stats, "MUX-1", far),
+                   ==, 4000000);
+
+  /* a fingerprint is kept until a later capture has one of its own. */
+  result = locked;
+  result.fingerprint = "0123abcd";
+  transmitter_stats_record(stats, "MUX-1", far, &result, T0 + 2 * DAY);
+  transmitter_stats_record(stats, "MUX-1", far, &locked, T0 + 2 * DAY);
+  g_assert_true(transmitter_stats_save(stats, path, &err));
+  transmitter_stats_destroy(stats);
+  stats = transmitter_stats_load(path, &err);
+  g_assert_no_error(err);
+  g_assert_true(transmitter_stats_save(stats, path, &err));
+  GKeyFile *const kf = g_key_file_new();
+  g_assert_true(g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &err));
+  gchar *const fingerprint =
+      g_key_file_get_string(kf, "MUX-1 610000 Far", "fingerprint", &err);
+  g_assert_no_error(err);
+  g_assert_cmpstr(fingerprint, ==, "0123abcd");
+  g_free(fingerprint);
+  g_key_file_free(kf);
+
+  g_unlink(path);
+  g_free(path);
+  transmitter_stats_destroy(stats);
+  mux_data_destroy(md);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/stats/no_history", test_stats_no_history);
+  g_test_add_func("/stats/order", test_stats_order);
+  g_test_add_func("/stats/known_bad", test_stats_known_bad);
+  g_test_add_func("/stats/decay", test_stats_decay);
+  g_test_add_func("/stats/save_load", test_stats_save_load);
+  g_test_add_func("/stats/dvr", test_stats_dvr);
+
+  return g_test_run();
+}
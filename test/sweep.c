@@ -0,0 +1,119 @@
+#include "../sweep.h"
+
+#include <glib.h>
+
+/* what the fake frontends receive : DVB-T on channel 30, DVB-T2 on 40,
+ * DVB-T with 7 MHz channels on 45, and something undecodable on 41. */
+static const struct {
+  guint channel;
+  guint bw_mhz;
+  enum fe_delivery_system delsys;
+} on_air[] = {{30, 8, SYS_DVBT}, {40, 8, SYS_DVBT2}, {45, 7, SYS_DVBT}};
+#define UNDECODABLE_CHANNEL 41
+
+static GMutex fake_lock;
+static guint num_tries;
+static gboolean t2_on_t_only;
+static gboolean tried_twice;
+static GHashTable *tried;
+
+static gpointer fake_open(const struct dvb_frontend *fe, GError **error) {
+  (void)error;
+  return (gpointer)fe;
+}
+
+static void fake_close(gpointer tuner) { (void)tuner; }
+
+static enum frontend_lock_status fake_try_lock(gpointer tuner,
+                                               struct tune_params *params,
+                                               guint signal_timeout_ms,
+                                               guint lock_timeout_ms) {
+  (void)signal_timeout_ms;
+  (void)lock_timeout_ms;
+  const struct dvb_frontend *const fe = tuner;
+
+  g_mutex_lock(&fake_lock);
+  ++num_tries;
+  if (!dvb_frontend_supports(fe, params->dvb_type)) {
+    t2_on_t_only = TRUE;
+  }
+  gchar *const key = g_strdup_printf("%u %u %d", params->freq_khz,
+                                     params->bw_mhz, params->dvb_type);
+  if (!g_hash_table_add(tried, key)) {
+    tried_twice = TRUE;
+  }
+  g_mutex_unlock(&fake_lock);
+
+  /* give the other frontend a chance to pick up some channels. */
+  g_usleep(1000);
+
+  for (gsize i = 0; i < G_N_ELEMENTS(on_air); ++i) {
+    if (params->freq_khz == sweep_channel_freq_khz(on_air[i].channel)) {
+      if (params->bw_mhz == on_air[i].bw_mhz &&
+          params->dvb_type == on_air[i].delsys) {
+        params->mod = params->dvb_type == SYS_DVBT2 ? QAM_256 : QAM_64;
+        return FRONTEND_LOCKED;
+      }
+      return FRONTEND_NO_LOCK;
+    }
+  }
+  return params->freq_khz == sweep_channel_freq_khz(UNDECODABLE_CHANNEL)
+             ? FRONTEND_NO_LOCK
+             : FRONTEND_NO_SIGNAL;
+}
+
+static const struct sweep_tuner_ops fake_ops = {
+    .open = fake_open, .try_lock = fake_try_lock, .close = fake_close};
+
+static void check_found(MuxData *md, const gchar *mux, guint bw_mhz,
+                        enum fe_delivery_system delsys,
+                        enum fe_modulation mod) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  g_assert_nonnull(transmitters);
+  g_assert_cmpuint(transmitters->len, ==, 1);
+  const struct tune_params *const params =
+      &g_array_index(transmitters, struct mux_params, 0).tune_parms;
+  g_assert_cmpuint(params->bw_mhz, ==, bw_mhz);
+  g_assert_cmpint(params->dvb_type, ==, delsys);
+  g_assert_cmpint(params->mod, ==, mod);
+}
+
+static void test_sweep(void) {
+  struct dvb_frontend frontends[] = {
+      {.adapter = 0, .frontend = 0, .delsys_mask = 1 << SYS_DVBT},
+      {.adapter = 1,
+       .frontend = 0,
+       .delsys_mask = (1 << SYS_DVBT) | (1 << SYS_DVBT2)},
+      {.adapter = 2, .frontend = 0, .delsys_mask = 1 << SYS_DVBS2}};
+  GArray *const fe_array = g_array_new(FALSE, FALSE, sizeof(*frontends));
+  g_array_append_vals(fe_array, frontends, G_N_ELEMENTS(frontends));
+  tried = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  MuxData *const md = sweep_muxdata(fe_array, &fake_ops, 100);
+  check_found(md, "UHF-30", 8, SYS_DVBT, QAM_64);
+  check_found(md, "UHF-40", 8, SYS_DVBT2, QAM_256);
+  check_found(md, "UHF-45", 7, SYS_DVBT, QAM_64);
+  g_assert_null(mux_data_get_transmitters_for_mux(md, "UHF-41"));
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, 3);
+
+  g_assert_false(t2_on_t_only);
+  g_assert_false(tried_twice);
+  /* the empty channels only need a single try and the undecodable one needs
+   * all four variants. the found ones stop at the first lock, which takes
+   * one more try for 40 and one less for 45 if the DVB-T only frontend gets
+   * to them. */
+  const guint num_channels = SWEEP_LAST_CHANNEL - SWEEP_FIRST_CHANNEL + 1;
+  g_assert_cmpuint(num_tries, <=, (num_channels - 4) + 4 + 1 + 3 + 3);
+
+  mux_data_destroy(md);
+  g_hash_table_destroy(tried);
+  g_array_free(fe_array, TRUE);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/sweep/fake_frontends", test_sweep);
+
+  return g_test_run();
+}
@@ -0,0 +1,164 @@
+#include "../ts.h"
+
+#include <glib.h>
+
+#include "ts_builder.h"
+
+static void test_crc32(void) {
+  const guint8 check[] = "123456789";
+  g_assert_cmphex(ts_crc32(check, 9), ==, 0x0376e6e7);
+
+  GByteArray *const section = g_byte_array_new();
+  const guint8 body[] = {1, 2, 3};
+  ts_put_section(section, 0x42, 1, 0, 0, body, sizeof(body));
+  g_assert_cmphex(ts_crc32(section->data, section->len), ==, 0);
+  g_byte_array_unref(section);
+}
+
+static void count_packet(const guint8 *data, void *ctx) {
+  GArray *const pids = ctx;
+  struct ts_packet pkt;
+  g_assert_true(ts_packet_parse(data, &pkt));
+  g_array_append_val(pids, pkt.pid);
+}
+
+static void test_splitter(void) {
+  GByteArray *const stream = g_byte_array_new();
+  const guint8 garbage[] = {0x00, 0x12, 0x34};
+  g_byte_array_append(stream, garbage, sizeof(garbage));
+  guint8 cc = 0;
+  const guint8 data[] = {0xaa};
+  for (guint16 pid = 0x100; pid < 0x105; ++pid) {
+    ts_put_packets(stream, pid, data, sizeof(data), NULL, 0, &cc);
+  }
+
+  GArray *const pids = g_array_new(FALSE, FALSE, sizeof(guint16));
+  struct ts_splitter splitter;
+  ts_splitter_init(&splitter);
+  for (guint pos = 0; pos < stream->len; pos += 100) {
+    ts_splitter_push(&splitter, stream->data + pos, MIN(100, stream->len - pos),
+                     count_packet, pids);
+  }
+  g_assert_cmpuint(pids->len, ==, 5);
+  for (guint i = 0; i < pids->len; ++i) {
+    g_assert_cmpuint(g_array_index(pids, guint16, i), ==, 0x100 + i);
+  }
+
+  g_array_free(pids, TRUE);
+  g_byte_array_unref(stream);
+}
+
+static void collect_section(guint16 pid, const guint8 *section, gsize len,
+                            void *ctx) {
+  GPtrArray *const sections = ctx;
+  g_assert_cmpuint(pid, ==, TS_PID_NIT);
+  g_ptr_array_add(sections, g_bytes_new(section, len));
+}
+
+static void push_packets(TsSectionAssembler *assembler,
+                         const GByteArray *stream) {
+  for (guint pos = 0; pos + TS_PACKET_SIZE <= stream->len;
+       pos += TS_PACKET_SIZE) {
+    struct ts_packet pkt;
+    g_assert_true(ts_packet_parse(stream->data + pos, &pkt));
+    ts_section_assembler_push(assembler, &pkt);
+  }
+}
+
+static void test_assembler(void) {
+  guint8 body[300];
+  for (gsize i = 0; i < sizeof(body); ++i) {
+    body[i] = (guint8)i;
+  }
+  /* a long one, directly followed by a short one which then starts in the
+   * middle of a packet. */
+  GByteArray *const sections = g_byte_array_new();
+  ts_put_section(sections, 0x40, 1, 0, 0, body, sizeof(body));
+  const gsize starts[] = {0, sections->len};
+  ts_put_section(sections, 0x40, 1, 0, 1, body, 10);
+
+  guint8 cc = 0;
+  GByteArray *const stream = g_byte_array_new();
+  ts_put_packets(stream, TS_PID_NIT, sections->data, sections->len, starts,
+                 G_N_ELEMENTS(starts), &cc);
+  g_assert_cmpuint(stream->len, ==, 2 * TS_PACKET_SIZE);
+
+  GPtrArray *const received =
+      g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+  TsSectionAssembler *const assembler =
+      ts_section_assembler_new(collect_section, received);
+  ts_section_assembler_add_pid(assembler, TS_PID_NIT);
+
+  push_packets(assembler, stream);
+  g_assert_cmpuint(received->len, ==, 2);
+  gsize len;
+  const guint8 *const first = g_bytes_get_data(received->pdata[0], &len);
+  g_assert_cmpuint(len, ==, starts[1]);
+  struct ts_section_header hdr;
+  g_assert_true(ts_section_parse_header(first, len, &hdr));
+  g_assert_cmpuint(hdr.table_id, ==, 0x40);
+  g_assert_cmpuint(hdr.table_id_extension, ==, 1);
+  g_assert_cmpuint(hdr.section_number, ==, 0);
+  g_assert_cmpmem(first + TS_LONG_SECTION_HEADER_SIZE, sizeof(body), body,
+                  sizeof(body));
+
+  /* a lost packet breaks the section it was part of. */
+  g_ptr_array_set_size(received, 0);
+  GByteArray *const lossy = g_byte_array_new();
+  ts_put_packets(lossy, TS_PID_NIT, sections->data, sections->len, starts,
+                 G_N_ELEMENTS(starts), &cc);
+  g_byte_array_remove_range(lossy, 0, TS_PACKET_SIZE);
+  push_packets(assembler, lossy);
+  g_assert_cmpuint(received->len, ==, 1);
+
+  /* so does a corrupted one, which the CRC catches. */
+  g_ptr_array_set_size(received, 0);
+  ts_section_assembler_reset(assembler);
+  stream->data[100] ^= 0x01;
+  push_packets(assembler, stream);
+  g_assert_cmpuint(received->len, ==, 1);
+
+  /* other PIDs are ignored. */
+  g_ptr_array_set_size(received, 0);
+  g_byte_array_set_size(stream, 0);
+  ts_put_packets(stream, TS_PID_SDT, sections->data, sections->len, starts,
+                 G_N_ELEMENTS(starts), &cc);
+  push_packets(assembler, stream);
+  g_assert_cmpuint(received->len, ==, 0);
+
+  ts_section_assembler_destroy(assembler);
+  g_ptr_array_unref(received);
+  g_byte_array_unref(lossy);
+  g_byte_array_unref(stream);
+  g_byte_array_unref(sections);
+}
+
+static void test_pcr(void) {
+  GByteArray *const stream = g_byte_array_new();
+  /* the largest PCR there is, so that every bit of it is set. */
+  const guint64 max_pcr = (G_GUINT64_CONSTANT(1) << 33) * 300 - 1;
+  ts_put_pcr_packet(stream, 0x100, max_pcr);
+  ts_put_pcr_packet(stream, 0x100, 27000000 + 299);
+  guint8 cc = 0;
+  const guint8 data[] = {0xaa};
+  ts_put_packets(stream, 0x100, data, sizeof(data), NULL, 0, &cc);
+
+  guint64 pcr;
+  g_assert_true(ts_packet_get_pcr(stream->data, &pcr));
+  g_assert_cmpuint(pcr, ==, max_pcr);
+  g_assert_true(ts_packet_get_pcr(stream->data + TS_PACKET_SIZE, &pcr));
+  g_assert_cmpuint(pcr, ==, 27000000 + 299);
+  g_assert_false(ts_packet_get_pcr(stream->data + 2 * TS_PACKET_SIZE, &pcr));
+  g_byte_array_unref(stream);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/ts/crc32", test_crc32);
+  g_test_add_func("/ts/splitter", test_splitter);
+  g_test_add_func("/ts/assembler", test_assembler);
+  g_test_add_func("/ts/pcr", test_pcr);
+
+  return g_test_run();
+}
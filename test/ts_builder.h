@@ -0,0 +1,103 @@
+#ifndef GETPLMUX_TEST_TS_BUILDER_H
+#define GETPLMUX_TEST_TS_BUILDER_H
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "../ts.h"
+
+/* helpers for putting together synthetic streams. */
+
+static inline void ts_put_u16(GByteArray *out, guint16 v) {
+  const guint8 bytes[] = {v >> 8, v & 0xff};
+  g_byte_array_append(out, bytes, sizeof(bytes));
+}
+
+static inline void ts_put_u32(GByteArray *out, guint32 v) {
+  const guint8 bytes[] = {v >> 24, (v >> 16) & 0xff, (v >> 8) & 0xff,
+                          v & 0xff};
+  g_byte_array_append(out, bytes, sizeof(bytes));
+}
+
+/* appends a long section with a valid CRC around the given body. */
+static inline void ts_put_section(GByteArray *out, guint8 table_id,
+                                  guint16 table_id_extension, guint8 version,
+                                  guint8 section_number, const guint8 *body,
+                                  gsize body_len) {
+  const guint start = out->len;
+  const gsize section_length = 5 + body_len + 4;
+  const guint8 hdr[] = {table_id,
+                        0xb0 | (section_length >> 8),
+                        section_length & 0xff,
+                        table_id_extension >> 8,
+                        table_id_extension & 0xff,
+                        0xc1 | (version << 1),
+                        section_number,
+                        section_number};
+  g_byte_array_append(out, hdr, sizeof(hdr));
+  g_byte_array_append(out, body, (guint)body_len);
+  ts_put_u32(out, ts_crc32(out->data + start, out->len - start));
+}
+
+/* cuts data into packets of the given PID, setting the pointer field for the
+ * sections starting at the given offsets. the continuity counter is updated
+ * along the way. */
+static inline void ts_put_packets(GByteArray *out, guint16 pid,
+                                  const guint8 *data, gsize len,
+                                  const gsize *starts, gsize num_starts,
+                                  guint8 *cc) {
+  gsize pos = 0, next = 0;
+  while (pos < len) {
+    guint8 pkt[TS_PACKET_SIZE];
+    memset(pkt, 0xff, sizeof(pkt));
+    const gboolean pusi =
+        next < num_starts && starts[next] < pos + TS_PACKET_SIZE - 5;
+    gsize offset = 4;
+    gsize max_len = TS_PACKET_SIZE - 4;
+    if (pusi) {
+      pkt[4] = (guint8)(starts[next] - pos);
+      offset = 5;
+      max_len = TS_PACKET_SIZE - 5;
+      while (next < num_starts && starts[next] < pos + max_len) {
+        ++next;
+      }
+    } else if (next < num_starts) {
+      /* the next section needs to start in a packet of its own. */
+      max_len = MIN(max_len, starts[next] - pos);
+    }
+    pkt[0] = TS_SYNC_BYTE;
+    pkt[1] = (pusi ? 0x40 : 0x00) | (pid >> 8);
+    pkt[2] = pid & 0xff;
+    pkt[3] = 0x10 | *cc;
+    *cc = (*cc + 1) & 0x0f;
+    const gsize n = MIN(max_len, len - pos);
+    memcpy(pkt + offset, data + pos, n);
+    pos += n;
+    g_byte_array_append(out, pkt, sizeof(pkt));
+  }
+}
+
+/* appends a packet with nothing but an adaptation field carrying the PCR. */
+static inline void ts_put_pcr_packet(GByteArray *out, guint16 pid,
+                                     guint64 pcr) {
+  const guint64 base = pcr / 300;
+  const guint ext = pcr % 300;
+  guint8 pkt[TS_PACKET_SIZE];
+  memset(pkt, 0xff, sizeof(pkt));
+  pkt[0] = TS_SYNC_BYTE;
+  pkt[1] = pid >> 8;
+  pkt[2] = pid & 0xff;
+  pkt[3] = 0x20;
+  pkt[4] = TS_PACKET_SIZE - 5;
+  pkt[5] = 0x10;
+  pkt[6] = (guint8)(base >> 25);
+  pkt[7] = (guint8)(base >> 17);
+  pkt[8] = (guint8)(base >> 9);
+  pkt[9] = (guint8)(base >> 1);
+  pkt[10] = (guint8)((base & 0x01) << 7 | 0x7e | ext >> 8);
+  pkt[11] = ext & 0xff;
+  g_byte_array_append(out, pkt, sizeof(pkt));
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "../tuneprof.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#define MS(x) ((gint64)(x) * 1000)
+
+static void add_tune(TuneProfiler *prof, guint adapter, guint freq_khz,
+                     gint64 lock_ms, gint64 first_buffer_ms) {
+  const gint64 playing_us = MS(1000);
+  struct tune_timing timing = {.adapter = adapter,
+                               .frontend = 0,
+                               .freq_khz = freq_khz,
+                               .playing_us = playing_us};
+  if (lock_ms) {
+    timing.stage_us[TUNE_STAGE_LOCK] = playing_us + MS(lock_ms);
+  }
+  if (first_buffer_ms) {
+    timing.stage_us[TUNE_STAGE_FIRST_BUFFER] =
+        playing_us + MS(first_buffer_ms);
+    timing.stage_us[TUNE_STAGE_FIRST_WRITE] =
+        playing_us + MS(first_buffer_ms) + 1;
+  }
+  tune_profiler_add(prof, &timing);
+}
+
+static void test_format(void) {
+  TuneProfiler *const prof = tune_profiler_new();
+  add_tune(prof, 1, 522000, 300, 400);
+  add_tune(prof, 1, 522000, 350, 450);
+  add_tune(prof, 0, 690000, 1200, 1300);
+  /* never locked. */
+  add_tune(prof, 1, 690000, 0, 0);
+  g_assert_cmpuint(tune_profiler_get_num_tunes(prof), ==, 4);
+
+  struct tune_timing timing = {.playing_us = MS(1000)};
+  timing.stage_us[TUNE_STAGE_LOCK] = MS(1312);
+  gchar *const described = tune_timing_describe(&timing);
+  g_assert_cmpstr(described, ==,
+                  "Lock after 312.0 ms, first buffer never, first write never");
+  g_free(described);
+
+  gchar *const formatted = tune_profiler_format(prof);
+  g_assert_cmpstr(
+      formatted, ==,
+      "adapter0/frontend0 :\n"
+      "  lock         : 1 of 1 tunes, min 1200.0 ms, median 1200.0 ms, "
+      "max 1200.0 ms\n"
+      "    <  2000 ms : # 1\n"
+      "  first buffer : 1 of 1 tunes, min 1300.0 ms, median 1300.0 ms, "
+      "max 1300.0 ms\n"
+      "    <  2000 ms : # 1\n"
+      "  first write  : 1 of 1 tunes, min 1300.0 ms, median 1300.0 ms, "
+      "max 1300.0 ms\n"
+      "    <  2000 ms : # 1\n"
+      "adapter1/frontend0 :\n"
+      "  lock         : 2 of 3 tunes, min 300.0 ms, median 350.0 ms, "
+      "max 350.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "  first buffer : 2 of 3 tunes, min 400.0 ms, median 450.0 ms, "
+      "max 450.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "  first write  : 2 of 3 tunes, min 400.0 ms, median 450.0 ms, "
+      "max 450.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "522000 kHz :\n"
+      "  lock         : 2 of 2 tunes, min 300.0 ms, median 350.0 ms, "
+      "max 350.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "  first buffer : 2 of 2 tunes, min 400.0 ms, median 450.0 ms, "
+      "max 450.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "  first write  : 2 of 2 tunes, min 400.0 ms, median 450.0 ms, "
+      "max 450.0 ms\n"
+      "    <   500 ms : ## 2\n"
+      "690000 kHz :\n"
+      "  lock         : 1 of 2 tunes, min 1200.0 ms, median 1200.0 ms, "
+      "max 1200.0 ms\n"
+      "    <  2000 ms : # 1\n"
+      "  first buffer : 1 of 2 tunes, min 1300.0 ms, median 1300.0 ms, "
+      "max 1300.0 ms\n"
+      "    <  2000 ms : # 1\n"
+      "  first write  : 1 of 2 tunes, min 1300.0 ms, median 1300.0 ms, "
+      "max 1300.0 ms\n"
+      "    <  2000 ms : # 1\n");
+  g_free(formatted);
+  tune_profiler_destroy(prof);
+}
+
+static void test_histogram(void) {
+  TuneProfiler *const prof = tune_profiler_new();
+  /* the bars are scaled down once they'd get too long. */
+  for (guint i = 0; i < 80; ++i) {
+    add_tune(prof, 0, 522000, 150, 0);
+  }
+  for (guint i = 0; i < 8; ++i) {
+    add_tune(prof, 0, 522000, 20000, 0);
+  }
+  gchar *const formatted = tune_profiler_format(prof);
+  g_assert_nonnull(strstr(formatted, "    <   250 ms : "
+                                     "######################################"
+                                     "## 80\n"
+                                     "    <   500 ms : 0\n"));
+  g_assert_nonnull(strstr(formatted, "   >= 10000 ms : #### 8\n"));
+  g_assert_nonnull(strstr(formatted, "  first buffer : 0 of 88 tunes\n"));
+  g_free(formatted);
+  tune_profiler_destroy(prof);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/tuneprof/format", test_format);
+  g_test_add_func("/tuneprof/histogram", test_histogram);
+
+  return g_test_run();
+}
@@ -0,0 +1,339 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../parser.h"
+#include "../txdb.h"
+
+/* without arguments, runs the tests on a small database made up here. given
+ * a database and the pages the site returned for a location, compares the
+ * offline lookup against them instead. */
+
+#define MAX_DISTANCE_DIFF_KM 1.0
+
+#define WARSAW_LAT 52.23
+#define WARSAW_LON 21.01
+
+static void add(TransmitterDb *db, const gchar *mux, const gchar *name,
+                guint freq_khz, gdouble lat, gdouble lon) {
+  const struct mux_params params = {
+      .name = (gchar *)name,
+      .info_html = NULL,
+      .distance = 0,
+      .tune_parms = {.freq_khz = freq_khz, .bw_mhz = 8, .mod = QAM_64}};
+  transmitter_db_add(db, mux, &params, lat, lon);
+}
+
+static TransmitterDb *make_db(void) {
+  TransmitterDb *const db = transmitter_db_new();
+  add(db, "MUX-1", "Raszyn", 538000, 52.1544, 20.9253);
+  add(db, "MUX-1", "Krakow", 554000, 50.0614, 19.9366);
+  add(db, "MUX-1", "PKiN", 538000, 52.2318, 21.0060);
+  add(db, "MUX-2", "Siedlce", 474000, 52.3000, 22.5000);
+  add(db, "MUX-2", "Raszyn", 522000, 52.1544, 20.9253);
+  return db;
+}
+
+static const struct mux_params *transmitter_at(MuxData *md, const gchar *mux,
+                                               guint idx) {
+  GArray *const transmitters = mux_data_get_transmitters_for_mux(md, mux);
+  g_assert_nonnull(transmitters);
+  g_assert_cmpuint(idx, <, transmitters->len);
+  return &g_array_index(transmitters, struct mux_params, idx);
+}
+
+static void check_warsaw(MuxData *md) {
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, 2);
+  g_assert_cmpuint(mux_data_get_transmitters_for_mux(md, "MUX-1")->len, ==, 2);
+  g_assert_cmpuint(mux_data_get_transmitters_for_mux(md, "MUX-2")->len, ==, 2);
+
+  const struct mux_params *par = transmitter_at(md, "MUX-1", 0);
+  g_assert_cmpstr(par->name, ==, "PKiN");
+  g_assert_cmpfloat_with_epsilon(par->distance, 0.34, 0.01);
+  g_assert_cmpuint(par->tune_parms.freq_khz, ==, 538000);
+  g_assert_cmpuint(par->tune_parms.bw_mhz, ==, 8);
+  g_assert_cmpint(par->tune_parms.mod, ==, QAM_64);
+  par = transmitter_at(md, "MUX-1", 1);
+  g_assert_cmpstr(par->name, ==, "Raszyn");
+  g_assert_cmpfloat_with_epsilon(par->distance, 10.20, 0.01);
+
+  par = transmitter_at(md, "MUX-2", 0);
+  g_assert_cmpstr(par->name, ==, "Raszyn");
+  g_assert_cmpuint(par->tune_parms.freq_khz, ==, 522000);
+  par = transmitter_at(md, "MUX-2", 1);
+  g_assert_cmpstr(par->name, ==, "Siedlce");
+  g_assert_cmpfloat_with_epsilon(par->distance, 101.69, 0.01);
+}
+
+static void test_lookup(void) {
+  TransmitterDb *const db = make_db();
+  g_assert_cmpuint(transmitter_db_size(db), ==, 5);
+
+  /* Krakow is further than the radius. */
+  MuxData *md = transmitter_db_lookup(db, WARSAW_LAT, WARSAW_LON,
+                                      TRANSMITTER_DB_LOOKUP_RADIUS_KM);
+  check_warsaw(md);
+  mux_data_destroy(md);
+
+  /* a MUX with nothing close enough isn't there at all. */
+  md = transmitter_db_lookup(db, WARSAW_LAT, WARSAW_LON, 5.0);
+  g_assert_cmpuint(mux_data_get_num_muxes(md), ==, 1);
+  g_assert_cmpuint(mux_data_get_transmitters_for_mux(md, "MUX-1")->len, ==, 1);
+  g_assert_cmpstr(transmitter_at(md, "MUX-1", 0)->name, ==, "PKiN");
+  mux_data_destroy(md);
+
+  md = transmitter_db_lookup(db, 0.0, 0.0, TRANSMITTER_DB_LOOKUP_RADIUS_KM);
+  g_assert_true(mux_data_is_empty(md));
+  mux_data_destroy(md);
+
+  transmitter_db_destroy(db);
+}
+
+static void test_replace(void) {
+  TransmitterDb *const db = make_db();
+  const struct mux_params pkin = {.name = "PKiN",
+                                  .tune_parms = {.freq_khz = 538000}};
+  const struct mux_params other_freq = {.name = "PKiN",
+                                        .tune_parms = {.freq_khz = 546000}};
+  g_assert_true(transmitter_db_contains(db, "MUX-1", &pkin));
+  g_assert_false(transmitter_db_contains(db, "MUX-2", &pkin));
+  g_assert_false(transmitter_db_contains(db, "MUX-1", &other_freq));
+
+  /* the index has been built by now, and has to follow the move. */
+  mux_data_destroy(transmitter_db_lookup(db, WARSAW_LAT, WARSAW_LON,
+                                         TRANSMITTER_DB_LOOKUP_RADIUS_KM));
+  add(db, "MUX-1", "PKiN", 538000, 50.0614, 19.9366);
+  g_assert_cmpuint(transmitter_db_size(db), ==, 5);
+
+  MuxData *const md = transmitter_db_lookup(db, WARSAW_LAT, WARSAW_LON,
+                                            TRANSMITTER_DB_LOOKUP_RADIUS_KM);
+  g_assert_cmpuint(mux_data_get_transmitters_for_mux(md, "MUX-1")->len, ==, 1);
+  g_assert_cmpstr(transmitter_at(md, "MUX-1", 0)->name, ==, "Raszyn");
+  mux_data_destroy(md);
+
+  transmitter_db_destroy(db);
+}
+
+static void test_save_load(void) {
+  gchar *path;
+  const gint fd = g_file_open_tmp("txdb-XXXXXX.ini", &path, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  g_close(fd, NULL);
+
+  TransmitterDb *db = make_db();
+  GError *err = NULL;
+  g_assert_true(transmitter_db_save(db, path, &err));
+  g_assert_no_error(err);
+  transmitter_db_destroy(db);
+
+  db = transmitter_db_load(path, &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(db);
+  g_assert_cmpuint(transmitter_db_size(db), ==, 5);
+  MuxData *const md = transmitter_db_lookup(db, WARSAW_LAT, WARSAW_LON,
+                                            TRANSMITTER_DB_LOOKUP_RADIUS_KM);
+  check_warsaw(md);
+  mux_data_destroy(md);
+  transmitter_db_destroy(db);
+
+  g_unlink(path);
+  g_free(path);
+}
+
+static void check_location(const gchar *html, gdouble lat, gdouble lon) {
+  gdouble parsed_lat = 0, parsed_lon = 0;
+  g_assert_true(parse_transmitter_location_from_html(
+      html, (int)strlen(html), &parsed_lat, &parsed_lon));
+  g_assert_cmpfloat_with_epsilon(parsed_lat, lat, 1e-6);
+  g_assert_cmpfloat_with_epsilon(parsed_lon, lon, 1e-6);
+}
+
+static void check_no_location(const gchar *html) {
+  gdouble lat, lon;
+  g_assert_false(parse_transmitter_location_from_html(html, (int)strlen(html),
+                                                      &lat, &lon));
+}
+
+static void test_location(void) {
+  /* map links, with or without the ampersands escaped. */
+  check_location("<a href=\"map.php?lat=52.2318&lng=21.0060\">", 52.2318,
+                 21.0060);
+  check_location("<a href=\"/x?z=9&amp;LAT=-33.5&amp;lon=-70.25\">", -33.5,
+                 -70.25);
+
+  /* degrees, minutes and seconds, in every encoding the site uses. */
+  const gdouble dms_lat = 52 + 13 / 60.0 + 54 / 3600.0;
+  const gdouble dms_lon = 21 + 0 / 60.0 + 22.5 / 3600.0;
+  check_location("52\xc2\xb0 13' 54\" N, 21\xc2\xb0 00' 22.5\" E", dms_lat,
+                 dms_lon);
+  check_location("52\xb0" "13\x92" "54N 21\xb0" "00\x92" "22,5E", dms_lat,
+                 dms_lon);
+  check_location("52&deg;13&#39;54&quot;N<br>21&#176;0&#39;22.5&quot;E",
+                 dms_lat, dms_lon);
+
+  /* decimal degrees. */
+  check_location("Location: 52.2318\xc2\xb0 N, 21.0060\xc2\xb0 E", 52.2318,
+                 21.0060);
+  check_location("<td>52.2318; 21.0060</td>", 52.2318, 21.0060);
+
+  check_no_location("");
+  check_no_location("Height 52.5 m, power 21.0 kW");
+  /* out of range. */
+  check_no_location("map.php?lat=95.1234&lng=21.0060");
+
+  /* whatever is past the given size isn't looked at. */
+  const gchar *const html = "map.php?lat=52.2318&lng=21.0060";
+  gdouble lat, lon;
+  g_assert_true(parse_transmitter_location_from_html(
+      html, (int)strlen(html) - 2, &lat, &lon));
+  g_assert_cmpfloat_with_epsilon(lon, 21.00, 1e-6);
+}
+
+static gboolean read_whole_file(const char *name, gchar **contents,
+                                gsize *siz) {
+  GError *error = 0;
+  if (g_file_get_contents(name, contents, siz, &error)) {
+    return TRUE;
+  } else {
+    g_printerr("Failed to read %s : %s\n", name, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+}
+
+static MuxData *muxdata_from_fixtures(const char *location_html,
+                                      const char *tune_params_html) {
+  gchar *content;
+  gsize len;
+  if (!read_whole_file(location_html, &content, &len)) {
+    return NULL;
+  }
+  MuxData *const parsed = parse_mux_params_from_html(content, (int)len, NULL);
+  g_free(content);
+
+  if (!read_whole_file(tune_params_html, &content, &len)) {
+    mux_data_destroy(parsed);
+    return NULL;
+  }
+  parse_tune_params_to_mux_params(parsed, content, (int)len);
+  g_free(content);
+  return parsed;
+}
+
+static const struct mux_params *find_transmitter(const GArray *transmitters,
+                                                 const struct mux_params *p) {
+  for (guint i = 0; transmitters && i < transmitters->len; ++i) {
+    const struct mux_params *const other =
+        &g_array_index(transmitters, struct mux_params, i);
+    if (other->tune_parms.freq_khz == p->tune_parms.freq_khz &&
+        g_strcmp0(other->name, p->name) == 0) {
+      return other;
+    }
+  }
+  return NULL;
+}
+
+static guint compare_mux(const gchar *mux, const GArray *expected,
+                         const GArray *actual) {
+  guint num_errors = 0;
+  for (guint i = 0; i < expected->len; ++i) {
+    const struct mux_params *const exp =
+        &g_array_index(expected, struct mux_params, i);
+    const struct mux_params *const act = find_transmitter(actual, exp);
+    if (!act) {
+      printf("%s : %s (%u kHz) missing\n", mux, exp->name,
+             exp->tune_parms.freq_khz);
+      num_errors++;
+      continue;
+    }
+    if (fabs(exp->distance - act->distance) > MAX_DISTANCE_DIFF_KM) {
+      printf("%s : %s distance %.2f, expected %.2f\n", mux, exp->name,
+             act->distance, exp->distance);
+      num_errors++;
+    }
+    if (memcmp(&exp->tune_parms, &act->tune_parms, sizeof(exp->tune_parms))) {
+      printf("%s : %s tune params differ\n", mux, exp->name);
+      num_errors++;
+    }
+    if (act != &g_array_index(actual, struct mux_params, i)) {
+      printf("%s : %s not at position %u\n", mux, exp->name, i);
+      num_errors++;
+    }
+  }
+  return num_errors;
+}
+
+static int compare_with_fixtures(int argc, char **argv) {
+  if (argc != 5) {
+    g_printerr(
+        "Usage : %s transmitter-db.ini nadajniki.php dvb-t.php lat:lon\n",
+        argv[0]);
+    return 1;
+  }
+
+  gchar **const latlon = g_strsplit(argv[4], ":", 2);
+  if (g_strv_length(latlon) != 2) {
+    g_printerr("Could not parse %s as a location\n", argv[4]);
+    return 1;
+  }
+  const gdouble lat = g_ascii_strtod(latlon[0], NULL);
+  const gdouble lon = g_ascii_strtod(latlon[1], NULL);
+  g_strfreev(latlon);
+
+  GError *err = NULL;
+  TransmitterDb *const db = transmitter_db_load(argv[1], &err);
+  if (!db) {
+    g_printerr("Failed to load %s : %s\n", argv[1], err->message);
+    g_error_free(err);
+    return 1;
+  }
+
+  MuxData *const expected = muxdata_from_fixtures(argv[2], argv[3]);
+  if (!expected) {
+    transmitter_db_destroy(db);
+    return 1;
+  }
+
+  /* the first lookup also builds the index. */
+  mux_data_destroy(
+      transmitter_db_lookup(db, lat, lon, TRANSMITTER_DB_LOOKUP_RADIUS_KM));
+  const gint64 start = g_get_monotonic_time();
+  MuxData *const actual =
+      transmitter_db_lookup(db, lat, lon, TRANSMITTER_DB_LOOKUP_RADIUS_KM);
+  const gint64 elapsed = g_get_monotonic_time() - start;
+
+  guint num_errors = 0;
+  for (guint m = 0; m < mux_data_get_num_muxes(expected); ++m) {
+    const gchar *const mux = mux_data_get_mux_at(expected, m);
+    num_errors += compare_mux(mux, mux_data_get_transmitters_at(expected, m),
+                              mux_data_get_transmitters_for_mux(actual, mux));
+  }
+
+  printf("%u differences, lookup took %" G_GINT64_FORMAT " us\n", num_errors,
+         elapsed);
+
+  mux_data_destroy(actual);
+  mux_data_destroy(expected);
+  transmitter_db_destroy(db);
+  return num_errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  setlocale(LC_ALL, "");
+
+  if (argc > 1 && argv[1][0] != '-') {
+    return compare_with_fixtures(argc, argv);
+  }
+
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/txdb/lookup", test_lookup);
+  g_test_add_func("/txdb/replace", test_replace);
+  g_test_add_func("/txdb/save_load", test_save_load);
+  g_test_add_func("/txdb/location", test_location);
+
+  return g_test_run();
+}
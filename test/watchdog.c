@@ -0,0 +1,121 @@
+#include "../watchdog.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#define S(x) ((gint64)(x) * G_USEC_PER_SEC)
+
+static void test_pre_lock(void) {
+  struct watchdog_limits limits;
+  watchdog_limits_init(&limits);
+  ReadWatchdog *const wd = read_watchdog_new(&limits);
+  read_watchdog_start(wd);
+
+  /* spread out enough not to matter. */
+  const gint64 window_us = S(WATCHDOG_PRE_LOCK_WINDOW_S);
+  g_assert_false(read_watchdog_fail(wd, S(1)));
+  g_assert_false(read_watchdog_fail(wd, S(1) + window_us));
+  g_assert_false(read_watchdog_fail(wd, S(1) + 2 * window_us));
+  g_assert_null(read_watchdog_get_reason(wd));
+  /* but not these. */
+  g_assert_true(read_watchdog_fail(wd, S(1) + 3 * window_us - 1));
+  g_assert_nonnull(read_watchdog_get_reason(wd));
+  g_assert_nonnull(strstr(read_watchdog_get_reason(wd), "before the lock"));
+
+  /* a new capture starts from scratch. */
+  read_watchdog_start(wd);
+  g_assert_null(read_watchdog_get_reason(wd));
+  g_assert_false(read_watchdog_fail(wd, S(10)));
+
+  read_watchdog_destroy(wd);
+}
+
+static void test_locked(void) {
+  struct watchdog_limits limits;
+  watchdog_limits_init(&limits);
+  ReadWatchdog *const wd = read_watchdog_new(&limits);
+  read_watchdog_start(wd);
+
+  g_assert_false(read_watchdog_fail(wd, S(1)));
+  read_watchdog_buffer(wd, S(2));
+  /* what happened before the lock is forgotten, and the limit is higher. */
+  for (gint64 t = 0; t < WATCHDOG_LOCKED_MAX_FAILS - 1; ++t) {
+    g_assert_false(read_watchdog_fail(wd, S(3 + 2 * t)));
+  }
+  /* the first one has expired by then. */
+  g_assert_false(read_watchdog_fail(wd, S(3 + WATCHDOG_LOCKED_WINDOW_S)));
+  g_assert_true(read_watchdog_fail(wd, S(4 + WATCHDOG_LOCKED_WINDOW_S)));
+  g_assert_nonnull(strstr(read_watchdog_get_reason(wd), "after the lock"));
+
+  read_watchdog_destroy(wd);
+}
+
+/* as fast as dvbsrc reports them with its default timeout. */
+static void test_dvbsrc_rate(void) {
+  struct watchdog_limits limits;
+  watchdog_limits_init(&limits);
+  ReadWatchdog *const wd = read_watchdog_new(&limits);
+
+  read_watchdog_start(wd);
+  gint64 t = 1;
+  while (!read_watchdog_fail(wd, S(t)) && t < 100) {
+    ++t;
+  }
+  g_assert_cmpint(t, ==, WATCHDOG_PRE_LOCK_MAX_FAILS);
+
+  read_watchdog_start(wd);
+  read_watchdog_buffer(wd, S(100));
+  t = 101;
+  while (!read_watchdog_fail(wd, S(t)) && t < 200) {
+    ++t;
+  }
+  g_assert_cmpint(t, ==, 100 + WATCHDOG_LOCKED_MAX_FAILS);
+
+  /* and with some jitter on top. */
+  read_watchdog_start(wd);
+  read_watchdog_buffer(wd, S(100));
+  t = S(101);
+  while (!read_watchdog_fail(wd, t) && t < S(200)) {
+    t += G_USEC_PER_SEC + G_USEC_PER_SEC / 2;
+  }
+  g_assert_cmpint(t, <, S(200));
+
+  read_watchdog_destroy(wd);
+}
+
+static void test_stall(void) {
+  struct watchdog_limits limits;
+  watchdog_limits_init(&limits);
+  ReadWatchdog *const wd = read_watchdog_new(&limits);
+  read_watchdog_start(wd);
+
+  /* nothing to go by before the lock. */
+  g_assert_false(read_watchdog_check_stall(wd, S(100)));
+  read_watchdog_buffer(wd, S(100));
+  read_watchdog_buffer(wd, S(101));
+  const gint64 stalled_us = S(101 + WATCHDOG_MAX_STALL_S);
+  g_assert_false(read_watchdog_check_stall(wd, stalled_us - 1));
+  g_assert_true(read_watchdog_check_stall(wd, stalled_us));
+  g_assert_nonnull(strstr(read_watchdog_get_reason(wd), "no data"));
+
+  limits.max_stall_us = 0;
+  ReadWatchdog *const disabled = read_watchdog_new(&limits);
+  read_watchdog_start(disabled);
+  read_watchdog_buffer(disabled, S(1));
+  g_assert_false(read_watchdog_check_stall(disabled, S(1000)));
+
+  read_watchdog_destroy(disabled);
+  read_watchdog_destroy(wd);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/watchdog/pre-lock", test_pre_lock);
+  g_test_add_func("/watchdog/locked", test_locked);
+  g_test_add_func("/watchdog/dvbsrc_rate", test_dvbsrc_rate);
+  g_test_add_func("/watchdog/stall", test_stall);
+
+  return g_test_run();
+}
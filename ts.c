@@ -0,0 +1,309 @@
+#include "ts.h"
+
+#include <string.h>
+
+gboolean ts_packet_parse(const guint8 *data, struct ts_packet *pkt) {
+  if (data[0] != TS_SYNC_BYTE) {
+    return FALSE;
+  }
+
+  pkt->transport_error = (data[1] & 0x80) != 0;
+  pkt->payload_unit_start = (data[1] & 0x40) != 0;
+  pkt->pid = (guint16)(((data[1] & 0x1f) << 8) | data[2]);
+  pkt->continuity_counter = data[3] & 0x0f;
+
+  const guint8 adaptation_field_control = (data[3] >> 4) & 0x03;
+  if (adaptation_field_control == 0) {
+    /* reserved */
+    return FALSE;
+  }
+
+  gsize offset = 4;
+  pkt->has_adaptation = (adaptation_field_control & 0x02) != 0;
+  pkt->discontinuity = FALSE;
+  if (pkt->has_adaptation) {
+    const guint8 adaptation_len = data[4];
+    if (adaptation_len > TS_PACKET_SIZE - 5) {
+      return FALSE;
+    }
+    if (adaptation_len > 0) {
+      pkt->discontinuity = (data[5] & 0x80) != 0;
+    }
+    offset = 5 + adaptation_len;
+  }
+
+  if ((adaptation_field_control & 0x01) && offset < TS_PACKET_SIZE) {
+    pkt->payload = data + offset;
+    pkt->payload_len = TS_PACKET_SIZE - offset;
+  } else {
+    pkt->payload = NULL;
+    pkt->payload_len = 0;
+  }
+  return TRUE;
+}
+
+gboolean ts_packet_get_pcr(const guint8 *data, guint64 *pcr) {
+  /* an adaptation field long enough for the flags and the PCR. */
+  if (data[0] != TS_SYNC_BYTE || (data[3] & 0x20) == 0 || data[4] < 7 ||
+      (data[5] & 0x10) == 0) {
+    return FALSE;
+  }
+  const guint64 base = (guint64)data[6] << 25 | (guint64)data[7] << 17 |
+                       (guint64)data[8] << 9 | (guint64)data[9] << 1 |
+                       data[10] >> 7;
+  const guint ext = (guint)(data[10] & 0x01) << 8 | data[11];
+  *pcr = base * 300 + ext;
+  return TRUE;
+}
+
+void ts_splitter_init(struct ts_splitter *splitter) {
+  splitter->partial_len = 0;
+}
+
+void ts_splitter_push(struct ts_splitter *splitter, const guint8 *data,
+                      gsize len, ts_packet_fn fn, void *ctx) {
+  while (len > 0) {
+    if (splitter->partial_len > 0) {
+      const gsize take = MIN(TS_PACKET_SIZE - splitter->partial_len, len);
+      memcpy(splitter->partial + splitter->partial_len, data, take);
+      splitter->partial_len += take;
+      data += take;
+      len -= take;
+      if (splitter->partial_len == TS_PACKET_SIZE) {
+        fn(splitter->partial, ctx);
+        splitter->partial_len = 0;
+      }
+    } else if (data[0] != TS_SYNC_BYTE) {
+      const guint8 *const sync = memchr(data, TS_SYNC_BYTE, len);
+      if (!sync) {
+        return;
+      }
+      len -= (gsize)(sync - data);
+      data = sync;
+    } else if (len >= TS_PACKET_SIZE) {
+      fn(data, ctx);
+      data += TS_PACKET_SIZE;
+      len -= TS_PACKET_SIZE;
+    } else {
+      memcpy(splitter->partial, data, len);
+      splitter->partial_len = len;
+      len = 0;
+    }
+  }
+}
+
+void ts_stats_init(struct ts_stats *stats) {
+  stats->packets = 0;
+  stats->transport_errors = 0;
+  stats->cc_errors = 0;
+  memset(stats->last_cc, TS_CC_UNKNOWN, sizeof(stats->last_cc));
+}
+
+void ts_stats_push(struct ts_stats *stats, const struct ts_packet *pkt) {
+  ++stats->packets;
+  if (pkt->transport_error) {
+    ++stats->transport_errors;
+    return;
+  }
+  if (pkt->pid == TS_NULL_PID) {
+    return;
+  }
+
+  guint8 *const last_cc = &stats->last_cc[pkt->pid];
+  /* the counter only goes up in packets with a payload, and a packet may be
+   * sent twice in a row. */
+  if (*last_cc != TS_CC_UNKNOWN && !pkt->discontinuity) {
+    const guint8 expected = pkt->payload ? (*last_cc + 1) & 0x0f : *last_cc;
+    if (pkt->continuity_counter != expected &&
+        pkt->continuity_counter != *last_cc) {
+      ++stats->cc_errors;
+    }
+  }
+  *last_cc = pkt->continuity_counter;
+}
+
+static guint32 crc_table[256];
+
+static void crc_table_init(void) {
+  for (guint i = 0; i < 256; ++i) {
+    guint32 crc = (guint32)i << 24;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    crc_table[i] = crc;
+  }
+}
+
+guint32 ts_crc32(const guint8 *data, gsize len) {
+  static gsize table_ready = 0;
+  if (g_once_init_enter(&table_ready)) {
+    crc_table_init();
+    g_once_init_leave(&table_ready, 1);
+  }
+
+  guint32 crc = 0xffffffff;
+  for (gsize i = 0; i < len; ++i) {
+    crc = (crc << 8) ^ crc_table[(crc >> 24) ^ data[i]];
+  }
+  return crc;
+}
+
+struct pid_state {
+  GByteArray *buf;
+  gboolean in_section;
+  gboolean cc_valid;
+  guint8 last_cc;
+};
+
+struct TsSectionAssembler_ {
+  /* PID -> struct pid_state */
+  GHashTable *pids;
+  ts_section_fn fn;
+  void *fn_ctx;
+};
+
+static void pid_state_free(gpointer p) {
+  struct pid_state *const state = p;
+  g_byte_array_unref(state->buf);
+  g_free(state);
+}
+
+static void pid_state_reset(struct pid_state *state) {
+  g_byte_array_set_size(state->buf, 0);
+  state->in_section = FALSE;
+  state->cc_valid = FALSE;
+}
+
+TsSectionAssembler *ts_section_assembler_new(ts_section_fn fn, void *ctx) {
+  TsSectionAssembler *rv = g_new(TsSectionAssembler, 1);
+  rv->pids = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                   pid_state_free);
+  rv->fn = fn;
+  rv->fn_ctx = ctx;
+  return rv;
+}
+
+void ts_section_assembler_destroy(TsSectionAssembler *assembler) {
+  g_hash_table_destroy(assembler->pids);
+  g_free(assembler);
+}
+
+void ts_section_assembler_add_pid(TsSectionAssembler *assembler, guint16 pid) {
+  if (ts_section_assembler_has_pid(assembler, pid)) {
+    return;
+  }
+  struct pid_state *const state = g_new(struct pid_state, 1);
+  state->buf = g_byte_array_new();
+  pid_state_reset(state);
+  g_hash_table_insert(assembler->pids, GUINT_TO_POINTER(pid), state);
+}
+
+gboolean ts_section_assembler_has_pid(TsSectionAssembler *assembler,
+                                      guint16 pid) {
+  return g_hash_table_contains(assembler->pids, GUINT_TO_POINTER(pid));
+}
+
+static void reset_foreach(gpointer key, gpointer value, gpointer user_data) {
+  (void)key;
+  (void)user_data;
+  pid_state_reset(value);
+}
+
+void ts_section_assembler_reset(TsSectionAssembler *assembler) {
+  g_hash_table_foreach(assembler->pids, reset_foreach, NULL);
+}
+
+/* passes on all the complete sections at the start of the buffer. */
+static void emit_sections(TsSectionAssembler *assembler, guint16 pid,
+                          struct pid_state *state) {
+  GByteArray *const buf = state->buf;
+  gsize consumed = 0;
+  while (buf->len - consumed >= 3) {
+    const guint8 *const section = buf->data + consumed;
+    if (section[0] == 0xff) {
+      /* stuffing until the end of the packet */
+      consumed = buf->len;
+      state->in_section = FALSE;
+      break;
+    }
+    const gsize section_len = 3 + (((section[1] & 0x0f) << 8) | section[2]);
+    if (buf->len - consumed < section_len) {
+      break;
+    }
+    const gboolean has_crc = (section[1] & 0x80) != 0;
+    if (!has_crc || ts_crc32(section, section_len) == 0) {
+      assembler->fn(pid, section, section_len, assembler->fn_ctx);
+    }
+    consumed += section_len;
+  }
+  g_byte_array_remove_range(buf, 0, (guint)consumed);
+}
+
+void ts_section_assembler_push(TsSectionAssembler *assembler,
+                               const struct ts_packet *pkt) {
+  struct pid_state *const state =
+      g_hash_table_lookup(assembler->pids, GUINT_TO_POINTER(pkt->pid));
+  if (!state) {
+    return;
+  }
+  if (pkt->transport_error) {
+    pid_state_reset(state);
+    return;
+  }
+  if (!pkt->payload) {
+    return;
+  }
+
+  if (state->cc_valid && !pkt->discontinuity &&
+      pkt->continuity_counter != ((state->last_cc + 1) & 0x0f)) {
+    if (pkt->continuity_counter == state->last_cc) {
+      /* duplicate packet */
+      return;
+    }
+    /* something got lost, so the section in progress is incomplete. */
+    g_byte_array_set_size(state->buf, 0);
+    state->in_section = FALSE;
+  }
+  state->last_cc = pkt->continuity_counter;
+  state->cc_valid = TRUE;
+
+  const guint8 *payload = pkt->payload;
+  gsize len = pkt->payload_len;
+  if (pkt->payload_unit_start) {
+    const guint8 pointer = payload[0];
+    ++payload;
+    --len;
+    if (pointer > len) {
+      pid_state_reset(state);
+      return;
+    }
+    if (state->in_section) {
+      g_byte_array_append(state->buf, payload, pointer);
+      emit_sections(assembler, pkt->pid, state);
+    }
+    /* whatever is left of the previous section can't be completed. */
+    g_byte_array_set_size(state->buf, 0);
+    payload += pointer;
+    len -= pointer;
+    state->in_section = TRUE;
+  } else if (!state->in_section) {
+    return;
+  }
+
+  g_byte_array_append(state->buf, payload, (guint)len);
+  emit_sections(assembler, pkt->pid, state);
+}
+
+gboolean ts_section_parse_header(const guint8 *section, gsize len,
+                                 struct ts_section_header *hdr) {
+  if (len < TS_LONG_SECTION_HEADER_SIZE + 4 || !(section[1] & 0x80)) {
+    return FALSE;
+  }
+  hdr->table_id = section[0];
+  hdr->table_id_extension = ts_read_u16(section + 3);
+  hdr->version = (section[5] >> 1) & 0x1f;
+  hdr->current_next = section[5] & 0x01;
+  hdr->section_number = section[6];
+  hdr->last_section_number = section[7];
+  return TRUE;
+}
@@ -0,0 +1,110 @@
+#ifndef GETPLMUX_TS_H
+#define GETPLMUX_TS_H
+
+#include <glib.h>
+
+/* just enough of MPEG-TS to get the PSI/SI tables out of a capture. */
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_NULL_PID 0x1fff
+#define TS_NUM_PIDS 0x2000
+
+#define TS_PID_PAT 0x0000
+#define TS_PID_NIT 0x0010
+#define TS_PID_SDT 0x0011
+#define TS_PID_EIT 0x0012
+#define TS_PID_TDT 0x0014
+
+struct ts_packet {
+  guint16 pid;
+  gboolean payload_unit_start;
+  gboolean transport_error;
+  guint8 continuity_counter;
+  gboolean has_adaptation;
+  gboolean discontinuity;
+  /* NULL if the packet doesn't carry any */
+  const guint8 *payload;
+  gsize payload_len;
+};
+
+/* returns FALSE if the packet is malformed. */
+gboolean ts_packet_parse(const guint8 *data, struct ts_packet *pkt);
+
+/* the PCR in 27 MHz ticks, if the packet carries one. */
+gboolean ts_packet_get_pcr(const guint8 *data, guint64 *pcr);
+
+/* cuts a stream which isn't necessarily aligned to packet boundaries into
+ * packets, resynchronizing on the sync byte if needed. */
+struct ts_splitter {
+  guint8 partial[TS_PACKET_SIZE];
+  gsize partial_len;
+};
+
+typedef void (*ts_packet_fn)(const guint8 *data, void *ctx);
+
+void ts_splitter_init(struct ts_splitter *splitter);
+void ts_splitter_push(struct ts_splitter *splitter, const guint8 *data,
+                      gsize len, ts_packet_fn fn, void *ctx);
+
+/* counts the packets which were damaged on the way, according to the
+ * transport_error_indicator and the continuity counters. */
+struct ts_stats {
+  guint64 packets;
+  guint64 transport_errors;
+  guint64 cc_errors;
+  /* the last continuity counter of every PID, TS_CC_UNKNOWN at first */
+  guint8 last_cc[TS_NUM_PIDS];
+};
+
+#define TS_CC_UNKNOWN 0xff
+
+void ts_stats_init(struct ts_stats *stats);
+void ts_stats_push(struct ts_stats *stats, const struct ts_packet *pkt);
+
+/* the MPEG-2 CRC, which is 0 when calculated over a whole section. */
+guint32 ts_crc32(const guint8 *data, gsize len);
+
+/* reassembles sections from the packets of the PIDs it's told about. only
+ * complete sections with a valid CRC, if they have one, are passed on. */
+typedef struct TsSectionAssembler_ TsSectionAssembler;
+
+typedef void (*ts_section_fn)(guint16 pid, const guint8 *section, gsize len,
+                              void *ctx);
+
+TsSectionAssembler *ts_section_assembler_new(ts_section_fn fn, void *ctx);
+void ts_section_assembler_destroy(TsSectionAssembler *assembler);
+void ts_section_assembler_add_pid(TsSectionAssembler *assembler, guint16 pid);
+gboolean ts_section_assembler_has_pid(TsSectionAssembler *assembler,
+                                      guint16 pid);
+/* drops partially assembled sections, e.g. after retuning. */
+void ts_section_assembler_reset(TsSectionAssembler *assembler);
+void ts_section_assembler_push(TsSectionAssembler *assembler,
+                               const struct ts_packet *pkt);
+
+/* the common header of long sections. */
+struct ts_section_header {
+  guint8 table_id;
+  guint16 table_id_extension;
+  guint8 version;
+  gboolean current_next;
+  guint8 section_number;
+  guint8 last_section_number;
+};
+
+#define TS_LONG_SECTION_HEADER_SIZE 8
+
+/* returns FALSE if the section isn't a long one. */
+gboolean ts_section_parse_header(const guint8 *section, gsize len,
+                                 struct ts_section_header *hdr);
+
+static inline guint16 ts_read_u16(const guint8 *p) {
+  return (guint16)((p[0] << 8) | p[1]);
+}
+
+static inline guint32 ts_read_u32(const guint8 *p) {
+  return ((guint32)p[0] << 24) | ((guint32)p[1] << 16) | ((guint32)p[2] << 8) |
+         p[3];
+}
+
+#endif
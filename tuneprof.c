@@ -0,0 +1,204 @@
+#include "tuneprof.h"
+
+struct TuneProfiler_ {
+  /* struct tune_timing */
+  GArray *timings;
+};
+
+static const guint histogram_bounds_ms[] = {TUNE_HISTOGRAM_BOUNDS_MS};
+#define NUM_BUCKETS (G_N_ELEMENTS(histogram_bounds_ms) + 1)
+
+/* the longest bar, in characters. */
+#define MAX_BAR_LEN 40
+
+static const gchar *const stage_names[TUNE_NUM_STAGES] = {
+    [TUNE_STAGE_LOCK] = "lock",
+    [TUNE_STAGE_FIRST_BUFFER] = "first buffer",
+    [TUNE_STAGE_FIRST_WRITE] = "first write"};
+
+static gdouble to_ms(gint64 us) { return (gdouble)us / 1000; }
+
+gchar *tune_timing_describe(const struct tune_timing *timing) {
+  GString *const out = g_string_new(NULL);
+  for (enum tune_stage stage = 0; stage < TUNE_NUM_STAGES; ++stage) {
+    g_string_append_printf(out, "%s%s", stage == 0 ? "" : ", ",
+                           stage_names[stage]);
+    if (timing->stage_us[stage] != 0) {
+      g_string_append_printf(
+          out, " after %.1f ms",
+          to_ms(timing->stage_us[stage] - timing->playing_us));
+    } else {
+      g_string_append(out, " never");
+    }
+  }
+  out->str[0] = g_ascii_toupper(out->str[0]);
+  return g_string_free(out, FALSE);
+}
+
+TuneProfiler *tune_profiler_new(void) {
+  TuneProfiler *const prof = g_new(TuneProfiler, 1);
+  prof->timings = g_array_new(FALSE, FALSE, sizeof(struct tune_timing));
+  return prof;
+}
+
+void tune_profiler_destroy(TuneProfiler *prof) {
+  g_array_unref(prof->timings);
+  g_free(prof);
+}
+
+void tune_profiler_add(TuneProfiler *prof, const struct tune_timing *timing) {
+  g_array_append_val(prof->timings, *timing);
+}
+
+guint tune_profiler_get_num_tunes(const TuneProfiler *prof) {
+  return prof->timings->len;
+}
+
+/* tunes are grouped by a key, which is also what the groups are sorted by. */
+typedef guint (*group_key_fn)(const struct tune_timing *timing);
+
+struct grouping {
+  group_key_fn key_fn;
+  void (*append_label)(GString *out, guint key);
+};
+
+static guint adapter_key(const struct tune_timing *timing) {
+  return timing->adapter << 16 | timing->frontend;
+}
+
+static void append_adapter_label(GString *out, guint key) {
+  g_string_append_printf(out, "adapter%u/frontend%u :\n", key >> 16,
+                         key & 0xffff);
+}
+
+static guint freq_key(const struct tune_timing *timing) {
+  return timing->freq_khz;
+}
+
+static void append_freq_label(GString *out, guint key) {
+  g_string_append_printf(out, "%u kHz :\n", key);
+}
+
+static const struct grouping by_adapter = {adapter_key, append_adapter_label};
+static const struct grouping by_freq = {freq_key, append_freq_label};
+
+static gint guint_cmpfn(gconstpointer a, gconstpointer b) {
+  const guint uA = *(const guint *)a, uB = *(const guint *)b;
+  return uA < uB ? -1 : uA > uB;
+}
+
+static gint gint64_cmpfn(gconstpointer a, gconstpointer b) {
+  const gint64 iA = *(const gint64 *)a, iB = *(const gint64 *)b;
+  return iA < iB ? -1 : iA > iB;
+}
+
+static GArray *group_keys(const GArray *timings, group_key_fn key_fn) {
+  GArray *const keys = g_array_new(FALSE, FALSE, sizeof(guint));
+  for (guint i = 0; i < timings->len; ++i) {
+    const guint key = key_fn(&g_array_index(timings, struct tune_timing, i));
+    guint found;
+    if (!g_array_binary_search(keys, &key, guint_cmpfn, &found)) {
+      g_array_append_val(keys, key);
+      g_array_sort(keys, guint_cmpfn);
+    }
+  }
+  return keys;
+}
+
+static guint bucket_of(gint64 elapsed_us) {
+  guint i = 0;
+  while (i < G_N_ELEMENTS(histogram_bounds_ms) &&
+         elapsed_us >= (gint64)histogram_bounds_ms[i] * 1000) {
+    ++i;
+  }
+  return i;
+}
+
+static void format_bucket(GString *out, guint bucket, guint count,
+                          guint max_count) {
+  if (bucket < G_N_ELEMENTS(histogram_bounds_ms)) {
+    g_string_append_printf(out, "    < %5u ms : ", histogram_bounds_ms[bucket]);
+  } else {
+    g_string_append_printf(out, "   >= %5u ms : ",
+                           histogram_bounds_ms[bucket - 1]);
+  }
+  /* the bars are scaled down once the longest wouldn't fit. */
+  const guint bar_len = max_count > MAX_BAR_LEN
+                            ? (count * MAX_BAR_LEN + max_count - 1) / max_count
+                            : count;
+  for (guint i = 0; i < bar_len; ++i) {
+    g_string_append_c(out, '#');
+  }
+  g_string_append_printf(out, "%s%u\n", bar_len > 0 ? " " : "", count);
+}
+
+static void format_stage(GString *out, const GArray *timings,
+                         group_key_fn key_fn, guint key,
+                         enum tune_stage stage) {
+  GArray *const elapsed = g_array_new(FALSE, FALSE, sizeof(gint64));
+  guint num_tunes = 0;
+  for (guint i = 0; i < timings->len; ++i) {
+    const struct tune_timing *const t =
+        &g_array_index(timings, struct tune_timing, i);
+    if (key_fn(t) != key) {
+      continue;
+    }
+    ++num_tunes;
+    if (t->stage_us[stage] != 0) {
+      const gint64 us = t->stage_us[stage] - t->playing_us;
+      g_array_append_val(elapsed, us);
+    }
+  }
+
+  g_string_append_printf(out, "  %-12s : %u of %u tunes", stage_names[stage],
+                         elapsed->len, num_tunes);
+  if (elapsed->len == 0) {
+    g_string_append_c(out, '\n');
+    goto beach;
+  }
+  g_array_sort(elapsed, gint64_cmpfn);
+  g_string_append_printf(
+      out, ", min %.1f ms, median %.1f ms, max %.1f ms\n",
+      to_ms(g_array_index(elapsed, gint64, 0)),
+      to_ms(g_array_index(elapsed, gint64, elapsed->len / 2)),
+      to_ms(g_array_index(elapsed, gint64, elapsed->len - 1)));
+
+  guint counts[NUM_BUCKETS] = {0};
+  for (guint i = 0; i < elapsed->len; ++i) {
+    ++counts[bucket_of(g_array_index(elapsed, gint64, i))];
+  }
+  /* the empty buckets at either end are left out. */
+  const guint first = bucket_of(g_array_index(elapsed, gint64, 0));
+  const guint last =
+      bucket_of(g_array_index(elapsed, gint64, elapsed->len - 1));
+  guint max_count = 0;
+  for (guint i = first; i <= last; ++i) {
+    max_count = MAX(max_count, counts[i]);
+  }
+  for (guint i = first; i <= last; ++i) {
+    format_bucket(out, i, counts[i], max_count);
+  }
+
+beach:
+  g_array_unref(elapsed);
+}
+
+static void format_groups(GString *out, const GArray *timings,
+                          const struct grouping *grouping) {
+  GArray *const keys = group_keys(timings, grouping->key_fn);
+  for (guint i = 0; i < keys->len; ++i) {
+    const guint key = g_array_index(keys, guint, i);
+    grouping->append_label(out, key);
+    for (enum tune_stage stage = 0; stage < TUNE_NUM_STAGES; ++stage) {
+      format_stage(out, timings, grouping->key_fn, key, stage);
+    }
+  }
+  g_array_unref(keys);
+}
+
+gchar *tune_profiler_format(const TuneProfiler *prof) {
+  GString *const out = g_string_new(NULL);
+  format_groups(out, prof->timings, &by_adapter);
+  format_groups(out, prof->timings, &by_freq);
+  return g_string_free(out, FALSE);
+}
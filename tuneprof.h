@@ -0,0 +1,48 @@
+#ifndef GETPLMUX_TUNEPROF_H
+#define GETPLMUX_TUNEPROF_H
+
+#include <glib.h>
+
+/* collects how long it took to get from setting the pipeline to PLAYING to
+ * every following step of a tune, so that the capture windows and timeouts
+ * can be chosen after what the hardware actually does. */
+enum tune_stage {
+  /* the frontend reported a lock */
+  TUNE_STAGE_LOCK,
+  /* the first buffer left dvbsrc */
+  TUNE_STAGE_FIRST_BUFFER,
+  /* the first buffer reached the sink */
+  TUNE_STAGE_FIRST_WRITE,
+  TUNE_NUM_STAGES
+};
+
+struct tune_timing {
+  guint adapter;
+  guint frontend;
+  guint freq_khz;
+  /* monotonic times, the stages are 0 if they were never reached */
+  gint64 playing_us;
+  gint64 stage_us[TUNE_NUM_STAGES];
+};
+
+/* the upper bounds of the histogram buckets, anything slower goes into a
+ * last one. */
+#define TUNE_HISTOGRAM_BOUNDS_MS 100, 250, 500, 1000, 2000, 5000, 10000
+
+/* how long every stage of a single tune took, for example : Lock after
+ * 312.0 ms, first buffer after 400.2 ms, first write never */
+gchar *tune_timing_describe(const struct tune_timing *timing);
+
+typedef struct TuneProfiler_ TuneProfiler;
+
+TuneProfiler *tune_profiler_new(void);
+void tune_profiler_destroy(TuneProfiler *prof);
+
+void tune_profiler_add(TuneProfiler *prof, const struct tune_timing *timing);
+guint tune_profiler_get_num_tunes(const TuneProfiler *prof);
+
+/* histograms of every stage per adapter and per frequency, in the order of
+ * the adapters and frequencies. */
+gchar *tune_profiler_format(const TuneProfiler *prof);
+
+#endif
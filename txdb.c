@@ -0,0 +1,327 @@
+#include "txdb.h"
+
+#include <math.h>
+
+#define EARTH_RADIUS_KM 6371.0
+
+struct db_entry {
+  gchar *mux;
+  struct mux_params params;
+  gdouble latitude;
+  gdouble longitude;
+};
+
+/* the transmitters are indexed with a k-d tree built over points on the unit
+ * sphere, as the straight-line distance between them grows monotonically with
+ * the great-circle distance, which makes it usable for range queries. the
+ * tree is implicit : every subarray is split at its middle element. */
+struct kd_point {
+  gdouble xyz[3];
+  guint entry;
+};
+
+struct TransmitterDb_ {
+  GArray *entries;
+  /* "MUX\nname\nfrequency" -> index in entries */
+  GHashTable *by_key;
+
+  GArray *kd_tree;
+  gboolean kd_tree_stale;
+};
+
+static void db_entry_clear(gpointer p) {
+  struct db_entry *const entry = p;
+  g_free(entry->mux);
+  mux_params_clear(&entry->params);
+}
+
+TransmitterDb *transmitter_db_new(void) {
+  TransmitterDb *rv = g_new(TransmitterDb, 1);
+  rv->entries = g_array_new(FALSE, FALSE, sizeof(struct db_entry));
+  g_array_set_clear_func(rv->entries, db_entry_clear);
+  rv->by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  rv->kd_tree = g_array_new(FALSE, FALSE, sizeof(struct kd_point));
+  rv->kd_tree_stale = TRUE;
+  return rv;
+}
+
+void transmitter_db_destroy(TransmitterDb *db) {
+  g_array_free(db->entries, TRUE);
+  g_hash_table_destroy(db->by_key);
+  g_array_free(db->kd_tree, TRUE);
+  g_free(db);
+}
+
+guint transmitter_db_size(TransmitterDb *db) { return db->entries->len; }
+
+static gchar *make_key(const gchar *mux, const struct mux_params *params) {
+  return g_strdup_printf("%s\n%s\n%u", mux, params->name,
+                         params->tune_parms.freq_khz);
+}
+
+gboolean transmitter_db_contains(TransmitterDb *db, const gchar *mux,
+                                 const struct mux_params *params) {
+  gchar *const key = make_key(mux, params);
+  const gboolean rv = g_hash_table_contains(db->by_key, key);
+  g_free(key);
+  return rv;
+}
+
+void transmitter_db_add(TransmitterDb *db, const gchar *mux,
+                        const struct mux_params *params, gdouble lat,
+                        gdouble lon) {
+  const struct db_entry entry = {
+      .mux = g_strdup(mux),
+      .params = {.name = g_strdup(params->name),
+                 .info_html = g_strdup(params->info_html),
+                 .distance = 0,
+                 .tune_parms = params->tune_parms},
+      .latitude = lat,
+      .longitude = lon};
+
+  gchar *const key = make_key(mux, params);
+  gpointer idx;
+  if (g_hash_table_lookup_extended(db->by_key, key, NULL, &idx)) {
+    struct db_entry *const existing =
+        &g_array_index(db->entries, struct db_entry, GPOINTER_TO_UINT(idx));
+    db_entry_clear(existing);
+    *existing = entry;
+    g_free(key);
+  } else {
+    g_hash_table_insert(db->by_key, key, GUINT_TO_POINTER(db->entries->len));
+    g_array_append_val(db->entries, entry);
+  }
+  db->kd_tree_stale = TRUE;
+}
+
+static void latlon_to_xyz(gdouble lat, gdouble lon, gdouble xyz[3]) {
+  const gdouble phi = lat * G_PI / 180.0, lambda = lon * G_PI / 180.0;
+  xyz[0] = cos(phi) * cos(lambda);
+  xyz[1] = cos(phi) * sin(lambda);
+  xyz[2] = sin(phi);
+}
+
+static gdouble chord_sq(const gdouble a[3], const gdouble b[3]) {
+  const gdouble dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+static void kd_swap(struct kd_point *a, struct kd_point *b) {
+  const struct kd_point tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+/* quickselect : puts the k-th smallest point along axis at pts[k], with
+ * everything before it not greater and everything after it not smaller. */
+static void kd_select(struct kd_point *pts, guint n, guint k, guint axis) {
+  guint lo = 0, hi = n - 1;
+  while (lo < hi) {
+    kd_swap(&pts[(lo + hi) / 2], &pts[hi]);
+    const gdouble pivot = pts[hi].xyz[axis];
+    guint store = lo;
+    for (guint i = lo; i < hi; ++i) {
+      if (pts[i].xyz[axis] < pivot) {
+        kd_swap(&pts[i], &pts[store++]);
+      }
+    }
+    kd_swap(&pts[store], &pts[hi]);
+    if (store == k) {
+      return;
+    } else if (store < k) {
+      lo = store + 1;
+    } else {
+      hi = store - 1;
+    }
+  }
+}
+
+static void kd_build(struct kd_point *pts, guint n, guint depth) {
+  if (n <= 1) {
+    return;
+  }
+  const guint mid = n / 2;
+  kd_select(pts, n, mid, depth % 3);
+  kd_build(pts, mid, depth + 1);
+  kd_build(pts + mid + 1, n - mid - 1, depth + 1);
+}
+
+static void kd_tree_rebuild(TransmitterDb *db) {
+  g_array_set_size(db->kd_tree, db->entries->len);
+  for (guint i = 0; i < db->entries->len; ++i) {
+    const struct db_entry *const entry =
+        &g_array_index(db->entries, struct db_entry, i);
+    struct kd_point *const pt = &g_array_index(db->kd_tree, struct kd_point, i);
+    latlon_to_xyz(entry->latitude, entry->longitude, pt->xyz);
+    pt->entry = i;
+  }
+  kd_build((struct kd_point *)(void *)db->kd_tree->data, db->kd_tree->len, 0);
+  db->kd_tree_stale = FALSE;
+}
+
+struct kd_query {
+  gdouble xyz[3];
+  gdouble max_chord;
+  GArray *hits;
+};
+
+static void kd_range_query(const struct kd_point *pts, guint n, guint depth,
+                           struct kd_query *query) {
+  if (n == 0) {
+    return;
+  }
+  const guint mid = n / 2;
+  const guint axis = depth % 3;
+  const struct kd_point *const pt = &pts[mid];
+  if (chord_sq(pt->xyz, query->xyz) <= query->max_chord * query->max_chord) {
+    g_array_append_val(query->hits, pt->entry);
+  }
+
+  const gdouble diff = query->xyz[axis] - pt->xyz[axis];
+  if (diff <= query->max_chord) {
+    kd_range_query(pts, mid, depth + 1, query);
+  }
+  if (diff >= -query->max_chord) {
+    kd_range_query(pts + mid + 1, n - mid - 1, depth + 1, query);
+  }
+}
+
+MuxData *transmitter_db_lookup(TransmitterDb *db, gdouble lat, gdouble lon,
+                               gdouble max_distance_km) {
+  if (db->kd_tree_stale) {
+    kd_tree_rebuild(db);
+  }
+
+  const gdouble max_angle = MIN(max_distance_km / EARTH_RADIUS_KM, G_PI);
+  struct kd_query query = {.max_chord = 2.0 * sin(max_angle / 2.0),
+                           .hits = g_array_new(FALSE, FALSE, sizeof(guint))};
+  latlon_to_xyz(lat, lon, query.xyz);
+  kd_range_query((const struct kd_point *)(const void *)db->kd_tree->data,
+                 db->kd_tree->len, 0, &query);
+
+  MuxData *const md = mux_data_new();
+  for (guint i = 0; i < query.hits->len; ++i) {
+    const struct db_entry *const entry = &g_array_index(
+        db->entries, struct db_entry, g_array_index(query.hits, guint, i));
+    gdouble xyz[3];
+    latlon_to_xyz(entry->latitude, entry->longitude, xyz);
+    const gdouble chord = sqrt(chord_sq(xyz, query.xyz));
+
+    const struct mux_params params = {
+        .name = g_strdup(entry->params.name),
+        .info_html = g_strdup(entry->params.info_html),
+        .distance = 2.0 * EARTH_RADIUS_KM * asin(MIN(chord / 2.0, 1.0)),
+        .tune_parms = entry->params.tune_parms};
+    mux_data_append_transmitter(md, entry->mux, &params);
+  }
+  g_array_free(query.hits, TRUE);
+
+  mux_data_sort_transmitters(md);
+  return md;
+}
+
+/* on disk, every transmitter is a group in a key file. the group names are
+ * only there to be unique and aren't interpreted when loading. */
+#define KEY_MUX "mux"
+#define KEY_NAME "name"
+#define KEY_INFO "info"
+#define KEY_LATITUDE "latitude"
+#define KEY_LONGITUDE "longitude"
+#define KEY_FREQUENCY "frequency"
+#define KEY_BANDWIDTH "bandwidth"
+#define KEY_MODULATION "modulation"
+#define KEY_DELSYS "delsys"
+
+static gboolean load_entry(TransmitterDb *db, GKeyFile *kf, const gchar *group,
+                           GError **error) {
+  struct mux_params params;
+  memset(&params, 0, sizeof(params));
+  gchar *mux = NULL;
+  gdouble lat = 0, lon = 0;
+  GError *err = NULL;
+
+#define get_or_fail(dst, getter, key)                                          \
+  do {                                                                         \
+    dst = getter(kf, group, key, &err);                                        \
+    if (err) {                                                                 \
+      goto fail;                                                               \
+    }                                                                          \
+  } while (0)
+
+  get_or_fail(mux, g_key_file_get_string, KEY_MUX);
+  get_or_fail(params.name, g_key_file_get_string, KEY_NAME);
+  get_or_fail(lat, g_key_file_get_double, KEY_LATITUDE);
+  get_or_fail(lon, g_key_file_get_double, KEY_LONGITUDE);
+  get_or_fail(params.tune_parms.freq_khz, g_key_file_get_integer,
+              KEY_FREQUENCY);
+  get_or_fail(params.tune_parms.bw_mhz, g_key_file_get_integer, KEY_BANDWIDTH);
+  get_or_fail(params.tune_parms.mod, g_key_file_get_integer, KEY_MODULATION);
+  get_or_fail(params.tune_parms.dvb_type, g_key_file_get_integer, KEY_DELSYS);
+
+#undef get_or_fail
+
+  /* optional */
+  params.info_html = g_key_file_get_string(kf, group, KEY_INFO, NULL);
+
+  transmitter_db_add(db, mux, &params, lat, lon);
+  mux_params_clear(&params);
+  g_free(mux);
+  return TRUE;
+
+fail:
+  g_propagate_prefixed_error(error, err, "Transmitter %s : ", group);
+  mux_params_clear(&params);
+  g_free(mux);
+  return FALSE;
+}
+
+TransmitterDb *transmitter_db_load(const gchar *path, GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, error)) {
+    g_key_file_free(kf);
+    return NULL;
+  }
+
+  TransmitterDb *db = transmitter_db_new();
+  gchar **const groups = g_key_file_get_groups(kf, NULL);
+  for (gchar **group = groups; *group; ++group) {
+    if (!load_entry(db, kf, *group, error)) {
+      g_clear_pointer(&db, transmitter_db_destroy);
+      break;
+    }
+  }
+  g_strfreev(groups);
+  g_key_file_free(kf);
+  return db;
+}
+
+gboolean transmitter_db_save(TransmitterDb *db, const gchar *path,
+                             GError **error) {
+  GKeyFile *const kf = g_key_file_new();
+  for (guint i = 0; i < db->entries->len; ++i) {
+    const struct db_entry *const entry =
+        &g_array_index(db->entries, struct db_entry, i);
+    const struct tune_params *const tunepars = &entry->params.tune_parms;
+    gchar *const group =
+        g_strdup_printf("%s %u %s", entry->mux, tunepars->freq_khz,
+                        entry->params.name);
+    g_strdelimit(group, "[]", '_');
+
+    g_key_file_set_string(kf, group, KEY_MUX, entry->mux);
+    g_key_file_set_string(kf, group, KEY_NAME, entry->params.name);
+    if (entry->params.info_html) {
+      g_key_file_set_string(kf, group, KEY_INFO, entry->params.info_html);
+    }
+    g_key_file_set_double(kf, group, KEY_LATITUDE, entry->latitude);
+    g_key_file_set_double(kf, group, KEY_LONGITUDE, entry->longitude);
+    g_key_file_set_integer(kf, group, KEY_FREQUENCY, tunepars->freq_khz);
+    g_key_file_set_integer(kf, group, KEY_BANDWIDTH, tunepars->bw_mhz);
+    g_key_file_set_integer(kf, group, KEY_MODULATION, tunepars->mod);
+    g_key_file_set_integer(kf, group, KEY_DELSYS, tunepars->dvb_type);
+    g_free(group);
+  }
+
+  const gboolean rv = g_key_file_save_to_file(kf, path, error);
+  g_key_file_free(kf);
+  return rv;
+}
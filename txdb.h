@@ -0,0 +1,39 @@
+#ifndef GETPLMUX_TXDB_H
+#define GETPLMUX_TXDB_H
+
+#include <glib.h>
+
+#include "muxdata.h"
+
+/* a local database of transmitters along with their coordinates, which allows
+ * getting the same data that the site returns for a location without
+ * querying it. */
+typedef struct TransmitterDb_ TransmitterDb;
+
+TransmitterDb *transmitter_db_new(void);
+void transmitter_db_destroy(TransmitterDb *db);
+
+TransmitterDb *transmitter_db_load(const gchar *path, GError **error);
+gboolean transmitter_db_save(TransmitterDb *db, const gchar *path,
+                             GError **error);
+
+guint transmitter_db_size(TransmitterDb *db);
+
+/* transmitters are identified by their MUX, name and frequency. adding one
+ * which is already in the database replaces it. the distance member of
+ * params is ignored. */
+gboolean transmitter_db_contains(TransmitterDb *db, const gchar *mux,
+                                 const struct mux_params *params);
+void transmitter_db_add(TransmitterDb *db, const gchar *mux,
+                        const struct mux_params *params, gdouble lat,
+                        gdouble lon);
+
+/* generous enough to cover everything the site lists for a location. */
+#define TRANSMITTER_DB_LOOKUP_RADIUS_KM 150.0
+
+/* returns all transmitters closer than max_distance_km, grouped by MUX and
+ * sorted by distance, just like parse_mux_params_from_html() does. */
+MuxData *transmitter_db_lookup(TransmitterDb *db, gdouble lat, gdouble lon,
+                               gdouble max_distance_km);
+
+#endif
@@ -0,0 +1,105 @@
+#include "watchdog.h"
+
+struct ReadWatchdog_ {
+  struct watchdog_limits limits;
+  GMutex lock;
+  /* 0 until the first buffer comes in */
+  gint64 lock_us;
+  gint64 last_buffer_us;
+  /* the times of the most recent failures, oldest first. failures from
+   * before the lock are dropped once it happens. */
+  GArray *fails;
+  gchar *reason;
+};
+
+void watchdog_limits_init(struct watchdog_limits *limits) {
+  limits->pre_lock.max_fails = WATCHDOG_PRE_LOCK_MAX_FAILS;
+  limits->pre_lock.window_us =
+      (gint64)WATCHDOG_PRE_LOCK_WINDOW_S * G_USEC_PER_SEC;
+  limits->locked.max_fails = WATCHDOG_LOCKED_MAX_FAILS;
+  limits->locked.window_us = (gint64)WATCHDOG_LOCKED_WINDOW_S * G_USEC_PER_SEC;
+  limits->max_stall_us = (gint64)WATCHDOG_MAX_STALL_S * G_USEC_PER_SEC;
+}
+
+ReadWatchdog *read_watchdog_new(const struct watchdog_limits *limits) {
+  ReadWatchdog *const wd = g_new0(ReadWatchdog, 1);
+  wd->limits = *limits;
+  g_mutex_init(&wd->lock);
+  wd->fails = g_array_new(FALSE, FALSE, sizeof(gint64));
+  return wd;
+}
+
+void read_watchdog_destroy(ReadWatchdog *wd) {
+  g_mutex_clear(&wd->lock);
+  g_array_unref(wd->fails);
+  g_free(wd->reason);
+  g_free(wd);
+}
+
+void read_watchdog_start(ReadWatchdog *wd) {
+  g_mutex_lock(&wd->lock);
+  wd->lock_us = 0;
+  wd->last_buffer_us = 0;
+  g_array_set_size(wd->fails, 0);
+  g_clear_pointer(&wd->reason, g_free);
+  g_mutex_unlock(&wd->lock);
+}
+
+void read_watchdog_buffer(ReadWatchdog *wd, gint64 now_us) {
+  g_mutex_lock(&wd->lock);
+  if (wd->lock_us == 0) {
+    wd->lock_us = now_us;
+    g_array_set_size(wd->fails, 0);
+  }
+  wd->last_buffer_us = now_us;
+  g_mutex_unlock(&wd->lock);
+}
+
+gboolean read_watchdog_fail(ReadWatchdog *wd, gint64 now_us) {
+  g_mutex_lock(&wd->lock);
+  const gboolean locked = wd->lock_us != 0;
+  const struct watchdog_window *const window =
+      locked ? &wd->limits.locked : &wd->limits.pre_lock;
+  g_array_append_val(wd->fails, now_us);
+  guint expired = 0;
+  while (expired < wd->fails->len &&
+         g_array_index(wd->fails, gint64, expired) <=
+             now_us - window->window_us) {
+    ++expired;
+  }
+  g_array_remove_range(wd->fails, 0, expired);
+
+  if (!wd->reason && wd->fails->len >= window->max_fails) {
+    wd->reason = g_strdup_printf(
+        "%u read failures in the last %.1f s %s the lock, the limit is %u "
+        "in %.1f s",
+        wd->fails->len,
+        (gdouble)(now_us - g_array_index(wd->fails, gint64, 0)) /
+            G_USEC_PER_SEC,
+        locked ? "after" : "before", window->max_fails,
+        (gdouble)window->window_us / G_USEC_PER_SEC);
+  }
+  const gboolean tripped = wd->reason != NULL;
+  g_mutex_unlock(&wd->lock);
+  return tripped;
+}
+
+gboolean read_watchdog_check_stall(ReadWatchdog *wd, gint64 now_us) {
+  g_mutex_lock(&wd->lock);
+  /* before the lock, it's up to dvbsrc to give up on tuning. */
+  if (!wd->reason && wd->limits.max_stall_us > 0 && wd->lock_us != 0 &&
+      now_us - wd->last_buffer_us >= wd->limits.max_stall_us) {
+    wd->reason = g_strdup_printf(
+        "no data for %.1f s after receiving %.1f s of it, the limit is %.1f s",
+        (gdouble)(now_us - wd->last_buffer_us) / G_USEC_PER_SEC,
+        (gdouble)(wd->last_buffer_us - wd->lock_us) / G_USEC_PER_SEC,
+        (gdouble)wd->limits.max_stall_us / G_USEC_PER_SEC);
+  }
+  const gboolean tripped = wd->reason != NULL;
+  g_mutex_unlock(&wd->lock);
+  return tripped;
+}
+
+const gchar *read_watchdog_get_reason(const ReadWatchdog *wd) {
+  return wd->reason;
+}
@@ -0,0 +1,56 @@
+#ifndef GETPLMUX_WATCHDOG_H
+#define GETPLMUX_WATCHDOG_H
+
+#include <glib.h>
+
+/* decides when a capture isn't worth continuing, based on how often reading
+ * from the DVR device fails and on how long it's been since data last came
+ * in. failures are counted over a sliding window, with separate limits
+ * before and after the lock, which is when the first buffer comes in : a
+ * transmitter which is dead from the start should be given up on quickly,
+ * while the occasional hiccup during a long capture shouldn't stop it.
+ *
+ * all times are monotonic and passed in, so that they can be faked. the
+ * buffers may be reported from a different thread than the rest. */
+typedef struct ReadWatchdog_ ReadWatchdog;
+
+struct watchdog_window {
+  guint max_fails;
+  gint64 window_us;
+};
+
+struct watchdog_limits {
+  struct watchdog_window pre_lock;
+  struct watchdog_window locked;
+  /* 0 disables the stall detection */
+  gint64 max_stall_us;
+};
+
+/* dvbsrc reports a read failure at most once per its timeout, which is a
+ * second by default, so the limits have to be reachable at that rate. */
+#define WATCHDOG_PRE_LOCK_MAX_FAILS 2
+#define WATCHDOG_PRE_LOCK_WINDOW_S 3
+#define WATCHDOG_LOCKED_MAX_FAILS 5
+#define WATCHDOG_LOCKED_WINDOW_S 10
+#define WATCHDOG_MAX_STALL_S 5
+
+/* fills in the defaults above. */
+void watchdog_limits_init(struct watchdog_limits *limits);
+
+ReadWatchdog *read_watchdog_new(const struct watchdog_limits *limits);
+void read_watchdog_destroy(ReadWatchdog *wd);
+
+/* forgets everything about the previous capture. */
+void read_watchdog_start(ReadWatchdog *wd);
+
+void read_watchdog_buffer(ReadWatchdog *wd, gint64 now_us);
+
+/* these return TRUE once the capture should be given up on, from then on
+ * read_watchdog_get_reason() explains why. */
+gboolean read_watchdog_fail(ReadWatchdog *wd, gint64 now_us);
+gboolean read_watchdog_check_stall(ReadWatchdog *wd, gint64 now_us);
+
+/* NULL unless the watchdog tripped. */
+const gchar *read_watchdog_get_reason(const ReadWatchdog *wd);
+
+#endif